@@ -933,3 +933,250 @@ chafa_canvas_config_set_passthrough (ChafaCanvasConfig *config, ChafaPassthrough
 
     config->passthrough = passthrough;
 }
+
+/**
+ * chafa_canvas_config_get_color_merge_threshold:
+ * @config: A #ChafaCanvasConfig
+ *
+ * Returns @config's color merge threshold. See
+ * chafa_canvas_config_set_color_merge_threshold () for details.
+ *
+ * Returns: The color merge threshold [0.0 - 1.0]
+ *
+ * Since: 1.20
+ **/
+gfloat
+chafa_canvas_config_get_color_merge_threshold (const ChafaCanvasConfig *config)
+{
+    g_return_val_if_fail (config != NULL, 0.0f);
+    g_return_val_if_fail (config->refs > 0, 0.0f);
+
+    return config->color_merge_threshold;
+}
+
+/**
+ * chafa_canvas_config_set_color_merge_threshold:
+ * @config: A #ChafaCanvasConfig
+ * @threshold: Color merge threshold [0.0 - 1.0]
+ *
+ * Sets @config's color merge threshold. When printing symbols in truecolor
+ * or 256-color modes, a cell whose colors are within this distance of the
+ * colors currently in effect will be printed using the latter instead. A cell
+ * may also be printed as its inverse symbol with the colors swapped, if that
+ * lets it use the colors in effect. This avoids emitting control sequences
+ * for small color changes and can make the output much smaller.
+ *
+ * The distance is Euclidean, and the threshold is relative to the full range
+ * of a color channel. Truecolor output is compared in RGB, since that is
+ * what gets printed. Palette colors are compared in the canvas' color space.
+ *
+ * The default is 0.0, which disables merging. Values around 0.05 can cut the
+ * size of photographic output in half without obvious loss of quality.
+ *
+ * Since: 1.20
+ **/
+void
+chafa_canvas_config_set_color_merge_threshold (ChafaCanvasConfig *config, gfloat threshold)
+{
+    g_return_if_fail (config != NULL);
+    g_return_if_fail (config->refs > 0);
+    g_return_if_fail (threshold >= 0.0f);
+    g_return_if_fail (threshold <= 1.0f);
+
+    config->color_merge_threshold = threshold;
+}
+
+/**
+ * chafa_canvas_config_get_kitty_transport:
+ * @config: A #ChafaCanvasConfig
+ *
+ * Returns @config's #ChafaKittyTransport setting. This defaults to
+ * #CHAFA_KITTY_TRANSPORT_DIRECT.
+ *
+ * Returns: The #ChafaKittyTransport setting
+ *
+ * Since: 1.20
+ **/
+ChafaKittyTransport
+chafa_canvas_config_get_kitty_transport (const ChafaCanvasConfig *config)
+{
+    g_return_val_if_fail (config != NULL, CHAFA_KITTY_TRANSPORT_DIRECT);
+    g_return_val_if_fail (config->refs > 0, CHAFA_KITTY_TRANSPORT_DIRECT);
+
+    return config->kitty_transport;
+}
+
+/**
+ * chafa_canvas_config_set_kitty_transport:
+ * @config: A #ChafaCanvasConfig
+ * @transport: A #ChafaKittyTransport value
+ *
+ * Selects the medium used to send pixel data to the terminal in
+ * #CHAFA_PIXEL_MODE_KITTY. This defaults to #CHAFA_KITTY_TRANSPORT_DIRECT.
+ *
+ * Writing large images to a temporary file or a shared memory object and
+ * sending only its name is much cheaper than base64-encoding the pixels
+ * into the output, but only works when the terminal can see the same
+ * filesystem as the canvas. The setting is only honored if the
+ * #ChafaTermInfo passed to chafa_canvas_print () has the corresponding
+ * sequences; otherwise the pixels are sent directly.
+ *
+ * Since: 1.20
+ **/
+void
+chafa_canvas_config_set_kitty_transport (ChafaCanvasConfig *config, ChafaKittyTransport transport)
+{
+    g_return_if_fail (config != NULL);
+    g_return_if_fail (config->refs > 0);
+    g_return_if_fail (transport < CHAFA_KITTY_TRANSPORT_MAX);
+
+    config->kitty_transport = transport;
+}
+
+/**
+ * chafa_canvas_config_get_terminal_scaling_enabled:
+ * @config: A #ChafaCanvasConfig
+ *
+ * Queries whether images are left for the terminal to scale. See
+ * chafa_canvas_config_set_terminal_scaling_enabled () for details.
+ *
+ * Returns: %TRUE if the terminal does the scaling, %FALSE otherwise.
+ *
+ * Since: 1.20
+ **/
+gboolean
+chafa_canvas_config_get_terminal_scaling_enabled (const ChafaCanvasConfig *config)
+{
+    g_return_val_if_fail (config != NULL, FALSE);
+    g_return_val_if_fail (config->refs > 0, FALSE);
+
+    return config->terminal_scaling_enabled;
+}
+
+/**
+ * chafa_canvas_config_set_terminal_scaling_enabled:
+ * @config: A #ChafaCanvasConfig
+ * @terminal_scaling_enabled: Whether to let the terminal scale images
+ *
+ * Indicates whether to leave scaling to the terminal. This is relevant
+ * only when the #ChafaPixelMode is set to #CHAFA_PIXEL_MODE_KITTY or
+ * #CHAFA_PIXEL_MODE_ITERM2. This defaults to %FALSE.
+ *
+ * Normally, the image is resampled to the canvas' exact size in pixels
+ * before it is sent. When this is set, it is sent at its own resolution,
+ * limited by chafa_canvas_config_set_terminal_scaling_max_size (), and
+ * the terminal stretches it over the canvas' cells. The image can then be
+ * shown at a different size with chafa_canvas_print_placement () without
+ * being scaled or, in Kitty mode, sent again.
+ *
+ * Since: 1.20
+ **/
+void
+chafa_canvas_config_set_terminal_scaling_enabled (ChafaCanvasConfig *config, gboolean terminal_scaling_enabled)
+{
+    g_return_if_fail (config != NULL);
+    g_return_if_fail (config->refs > 0);
+
+    config->terminal_scaling_enabled = terminal_scaling_enabled ? TRUE : FALSE;
+}
+
+/**
+ * chafa_canvas_config_get_terminal_scaling_max_size:
+ * @config: A #ChafaCanvasConfig
+ * @width_out: Location to store the maximum width in, or %NULL
+ * @height_out: Location to store the maximum height in, or %NULL
+ *
+ * Returns the largest size in pixels an image will be sent at when
+ * the terminal does the scaling. Zero means there is no limit.
+ *
+ * Since: 1.20
+ **/
+void
+chafa_canvas_config_get_terminal_scaling_max_size (const ChafaCanvasConfig *config,
+                                                   gint *width_out, gint *height_out)
+{
+    g_return_if_fail (config != NULL);
+    g_return_if_fail (config->refs > 0);
+
+    if (width_out)
+        *width_out = config->terminal_scaling_max_width;
+    if (height_out)
+        *height_out = config->terminal_scaling_max_height;
+}
+
+/**
+ * chafa_canvas_config_set_terminal_scaling_max_size:
+ * @config: A #ChafaCanvasConfig
+ * @width: Maximum width in pixels, or 0 for no limit
+ * @height: Maximum height in pixels, or 0 for no limit
+ *
+ * Sets the largest size in pixels an image will be sent at when the
+ * terminal does the scaling. Larger images are scaled down to fit,
+ * keeping their aspect. This defaults to no limit, i.e. the image is
+ * sent at its own resolution.
+ *
+ * Since: 1.20
+ **/
+void
+chafa_canvas_config_set_terminal_scaling_max_size (ChafaCanvasConfig *config,
+                                                   gint width, gint height)
+{
+    g_return_if_fail (config != NULL);
+    g_return_if_fail (config->refs > 0);
+    g_return_if_fail (width >= 0);
+    g_return_if_fail (height >= 0);
+
+    config->terminal_scaling_max_width = width;
+    config->terminal_scaling_max_height = height;
+}
+
+/**
+ * chafa_canvas_config_get_adaptive_symbols_enabled:
+ * @config: A #ChafaCanvasConfig
+ *
+ * Queries whether the symbol search adapts to the content of successive
+ * frames. See chafa_canvas_config_set_adaptive_symbols_enabled () for
+ * details.
+ *
+ * Returns: %TRUE if adaptive symbol search is enabled, %FALSE otherwise.
+ *
+ * Since: 1.20
+ **/
+gboolean
+chafa_canvas_config_get_adaptive_symbols_enabled (const ChafaCanvasConfig *config)
+{
+    g_return_val_if_fail (config != NULL, FALSE);
+    g_return_val_if_fail (config->refs > 0, FALSE);
+
+    return config->adaptive_symbols_enabled;
+}
+
+/**
+ * chafa_canvas_config_set_adaptive_symbols_enabled:
+ * @config: A #ChafaCanvasConfig
+ * @adaptive_symbols_enabled: Whether to adapt the symbol search to the content
+ *
+ * Indicates whether a canvas that is drawn repeatedly, e.g. with the
+ * frames of an animation, should learn which symbols its content uses.
+ * This defaults to %FALSE.
+ *
+ * The first few frames are searched in full while symbol usage is
+ * recorded. After that, only the symbols seen so far are considered,
+ * except in the occasional full refresh frame and in cells where none
+ * of them fit well. This makes rendering with large symbol maps much
+ * faster at a small cost in quality.
+ *
+ * This only applies at the high work factors where every symbol would
+ * otherwise be evaluated for every cell.
+ *
+ * Since: 1.20
+ **/
+void
+chafa_canvas_config_set_adaptive_symbols_enabled (ChafaCanvasConfig *config,
+                                                  gboolean adaptive_symbols_enabled)
+{
+    g_return_if_fail (config != NULL);
+    g_return_if_fail (config->refs > 0);
+
+    config->adaptive_symbols_enabled = adaptive_symbols_enabled ? TRUE : FALSE;
+}
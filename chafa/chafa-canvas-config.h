@@ -136,6 +136,34 @@ ChafaPassthrough chafa_canvas_config_get_passthrough (const ChafaCanvasConfig *c
 CHAFA_AVAILABLE_IN_1_14
 void chafa_canvas_config_set_passthrough (ChafaCanvasConfig *config, ChafaPassthrough passthrough);
 
+CHAFA_AVAILABLE_IN_1_20
+gfloat chafa_canvas_config_get_color_merge_threshold (const ChafaCanvasConfig *config);
+CHAFA_AVAILABLE_IN_1_20
+void chafa_canvas_config_set_color_merge_threshold (ChafaCanvasConfig *config, gfloat threshold);
+
+CHAFA_AVAILABLE_IN_1_20
+ChafaKittyTransport chafa_canvas_config_get_kitty_transport (const ChafaCanvasConfig *config);
+CHAFA_AVAILABLE_IN_1_20
+void chafa_canvas_config_set_kitty_transport (ChafaCanvasConfig *config, ChafaKittyTransport transport);
+
+CHAFA_AVAILABLE_IN_1_20
+gboolean chafa_canvas_config_get_terminal_scaling_enabled (const ChafaCanvasConfig *config);
+CHAFA_AVAILABLE_IN_1_20
+void chafa_canvas_config_set_terminal_scaling_enabled (ChafaCanvasConfig *config, gboolean terminal_scaling_enabled);
+
+CHAFA_AVAILABLE_IN_1_20
+void chafa_canvas_config_get_terminal_scaling_max_size (const ChafaCanvasConfig *config,
+                                                        gint *width_out, gint *height_out);
+CHAFA_AVAILABLE_IN_1_20
+void chafa_canvas_config_set_terminal_scaling_max_size (ChafaCanvasConfig *config,
+                                                        gint width, gint height);
+
+CHAFA_AVAILABLE_IN_1_20
+gboolean chafa_canvas_config_get_adaptive_symbols_enabled (const ChafaCanvasConfig *config);
+CHAFA_AVAILABLE_IN_1_20
+void chafa_canvas_config_set_adaptive_symbols_enabled (ChafaCanvasConfig *config,
+                                                       gboolean adaptive_symbols_enabled);
+
 G_END_DECLS
 
 #endif /* __CHAFA_CANVAS_CONFIG_H__ */
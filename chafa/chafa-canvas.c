@@ -292,6 +292,50 @@ setup_palette (ChafaCanvas *canvas)
     chafa_palette_set_transparent_index (&canvas->bg_palette, CHAFA_PALETTE_INDEX_TRANSPARENT);
 }
 
+/* The pen pair search needs both palettes to be small and fixed, with the
+ * BG palette a prefix of the FG one. Median colors aren't meant to
+ * minimize the error, so those are left alone.
+ *
+ * The per-cell tables it builds only pay off over the exhaustive symbol
+ * search. A short list of candidates is quicker to quantize, so lower work
+ * factors keep doing that. */
+static void
+setup_pens (ChafaCanvas *canvas)
+{
+    ChafaPaletteType fg_pal_type = chafa_palette_get_type (&canvas->fg_palette);
+    ChafaPaletteType bg_pal_type = chafa_palette_get_type (&canvas->bg_palette);
+    gint i;
+
+    canvas->use_pen_pair_search = FALSE;
+    canvas->n_pens [CHAFA_COLOR_PAIR_BG] = canvas->n_pens [CHAFA_COLOR_PAIR_FG] = 0;
+
+    if (canvas->config.pixel_mode != CHAFA_PIXEL_MODE_SYMBOLS
+        || canvas->work_factor_int < 8
+        || canvas->config.fg_only_enabled
+        || !canvas->extract_colors
+        || canvas->config.color_extractor != CHAFA_COLOR_EXTRACTOR_AVERAGE
+        || (fg_pal_type != CHAFA_PALETTE_TYPE_FIXED_16 && fg_pal_type != CHAFA_PALETTE_TYPE_FIXED_8)
+        || (bg_pal_type != CHAFA_PALETTE_TYPE_FIXED_16 && bg_pal_type != CHAFA_PALETTE_TYPE_FIXED_8))
+        return;
+
+    canvas->n_pens [CHAFA_COLOR_PAIR_FG] = chafa_palette_get_n_colors (&canvas->fg_palette);
+    canvas->n_pens [CHAFA_COLOR_PAIR_BG] = chafa_palette_get_n_colors (&canvas->bg_palette);
+    g_assert (canvas->n_pens [CHAFA_COLOR_PAIR_FG] <= CHAFA_WORK_CELL_N_PENS_MAX);
+    g_assert (canvas->n_pens [CHAFA_COLOR_PAIR_BG] <= canvas->n_pens [CHAFA_COLOR_PAIR_FG]);
+
+    for (i = 0; i < canvas->n_pens [CHAFA_COLOR_PAIR_FG]; i++)
+    {
+        const ChafaColor *c = chafa_palette_get_color (&canvas->fg_palette,
+                                                       canvas->config.color_space, i);
+
+        canvas->pens [i] = *c;
+        canvas->pen_norms [i] = c->ch [0] * c->ch [0] + c->ch [1] * c->ch [1]
+            + c->ch [2] * c->ch [2];
+    }
+
+    canvas->use_pen_pair_search = TRUE;
+}
+
 static gunichar
 find_best_blank_char (ChafaCanvas *canvas)
 {
@@ -388,18 +432,72 @@ destroy_pixel_renderer (ChafaCanvas *canvas)
     }
 }
 
+static void
+destroy_viewport (ChafaCanvas *canvas)
+{
+    if (canvas->viewport)
+    {
+        chafa_viewport_destroy (canvas->viewport);
+        canvas->viewport = NULL;
+    }
+}
+
+/* With terminal-side scaling, the whole canvas is sent at a resolution
+ * where the image is at its own size, or as close to it as the limits
+ * allow. The terminal then stretches it over the canvas' cells. */
+static void
+calc_terminal_scaled_size (ChafaCanvas *canvas, gint src_width, gint src_height,
+                           ChafaAlign halign, ChafaAlign valign, ChafaTuck tuck,
+                           gint *width_out, gint *height_out)
+{
+    gint max_width = canvas->config.terminal_scaling_max_width;
+    gint max_height = canvas->config.terminal_scaling_max_height;
+    gint placement_x, placement_y;
+    gint placement_width, placement_height;
+    gdouble scale;
+
+    chafa_tuck_and_align (src_width, src_height,
+                          canvas->width_pixels, canvas->height_pixels,
+                          halign, valign,
+                          tuck,
+                          &placement_x, &placement_y,
+                          &placement_width, &placement_height);
+
+    scale = MIN (src_width / (gdouble) MAX (placement_width, 1),
+                 src_height / (gdouble) MAX (placement_height, 1));
+
+    if (max_width > 0)
+        scale = MIN (scale, max_width / (gdouble) canvas->width_pixels);
+    if (max_height > 0)
+        scale = MIN (scale, max_height / (gdouble) canvas->height_pixels);
+
+    *width_out = MAX (canvas->width_pixels * scale + 0.5, 1);
+    *height_out = MAX (canvas->height_pixels * scale + 0.5, 1);
+
+    if (max_width > 0)
+        *width_out = MIN (*width_out, max_width);
+    if (max_height > 0)
+        *height_out = MIN (*height_out, max_height);
+}
+
+/* If the pixels come from a frame, it's passed in too, so renderers can use
+ * any other data it has for them */
 static void
 draw_all_pixels (ChafaCanvas *canvas, ChafaPixelType src_pixel_type,
                  const guint8 *src_pixels,
-                 gint src_width, gint src_height, gint src_rowstride)
+                 gint src_width, gint src_height, gint src_rowstride,
+                 const ChafaFrame *frame)
 {
     ChafaColor bg_color;
     ChafaAlign halign = CHAFA_ALIGN_START, valign = CHAFA_ALIGN_START;
     ChafaTuck tuck = CHAFA_TUCK_STRETCH;
+    gint width_pixels, height_pixels;
 
     if (src_width == 0 || src_height == 0)
         return;
 
+    destroy_viewport (canvas);
+
     if (canvas->placement)
     {
         halign = chafa_placement_get_halign (canvas->placement);
@@ -422,6 +520,14 @@ draw_all_pixels (ChafaCanvas *canvas, ChafaPixelType src_pixel_type,
         bg_color.ch [3] = canvas->config.alpha_threshold < 1 ? 0x00 : 0xff;
     }
 
+    width_pixels = canvas->width_pixels;
+    height_pixels = canvas->height_pixels;
+
+    if (canvas->config.terminal_scaling_enabled)
+        calc_terminal_scaled_size (canvas, src_width, src_height,
+                                   halign, valign, tuck,
+                                   &width_pixels, &height_pixels);
+
     if (canvas->config.pixel_mode == CHAFA_PIXEL_MODE_SYMBOLS)
     {
         /* Symbol mode */
@@ -450,22 +556,34 @@ draw_all_pixels (ChafaCanvas *canvas, ChafaPixelType src_pixel_type,
                                                            canvas->config.color_space,
                                                            &canvas->fg_palette,
                                                            &canvas->dither);
-        chafa_sixel_renderer_draw_all_pixels (canvas->pixel_renderer,
-                                              src_pixel_type,
-                                              src_pixels,
-                                              src_width, src_height,
-                                              src_rowstride,
-                                              halign, valign,
-                                              tuck,
-                                              canvas->config.work_factor);
+
+        if (!frame || !frame->indices
+            || !chafa_sixel_renderer_draw_indexed_pixels (canvas->pixel_renderer,
+                                                          frame->indices,
+                                                          frame->index_colors,
+                                                          frame->n_index_colors,
+                                                          src_width, src_height,
+                                                          frame->index_rowstride,
+                                                          halign, valign,
+                                                          tuck))
+        {
+            chafa_sixel_renderer_draw_all_pixels (canvas->pixel_renderer,
+                                                  src_pixel_type,
+                                                  src_pixels,
+                                                  src_width, src_height,
+                                                  src_rowstride,
+                                                  halign, valign,
+                                                  tuck,
+                                                  canvas->config.work_factor);
+        }
     }
     else if (canvas->config.pixel_mode == CHAFA_PIXEL_MODE_KITTY)
     {
         /* Kitty mode */
 
         canvas->fg_palette.alpha_threshold = canvas->config.alpha_threshold;
-        canvas->pixel_renderer = chafa_kitty_renderer_new (canvas->width_pixels,
-                                                           canvas->height_pixels);
+        canvas->pixel_renderer = chafa_kitty_renderer_new (width_pixels,
+                                                           height_pixels);
 
         if (canvas->pixel_renderer)
             chafa_kitty_renderer_draw_all_pixels (canvas->pixel_renderer,
@@ -482,8 +600,9 @@ draw_all_pixels (ChafaCanvas *canvas, ChafaPixelType src_pixel_type,
         /* iTerm2 mode */
 
         canvas->fg_palette.alpha_threshold = canvas->config.alpha_threshold;
-        canvas->pixel_renderer = chafa_iterm2_renderer_new (canvas->width_pixels,
-                                                            canvas->height_pixels);
+        canvas->pixel_renderer = chafa_iterm2_renderer_new (width_pixels,
+                                                            height_pixels,
+                                                            canvas->config.terminal_scaling_enabled);
 
         if (canvas->pixel_renderer)
             chafa_iterm2_renderer_draw_all_pixels (canvas->pixel_renderer,
@@ -549,6 +668,7 @@ chafa_canvas_new (const ChafaCanvasConfig *config)
     }
 
     canvas->pixels = NULL;
+    canvas->cell_max_alpha = NULL;
     canvas->cells = g_new (ChafaCanvasCell, canvas->config.width * canvas->config.height);
     canvas->work_factor_int = canvas->config.work_factor * 10 + 0.5f;
     canvas->needs_clear = TRUE;
@@ -568,6 +688,8 @@ chafa_canvas_new (const ChafaCanvasConfig *config)
         (canvas->config.canvas_mode == CHAFA_CANVAS_MODE_INDEXED_16_8
          && !canvas->config.fg_only_enabled);
 
+    canvas->cull_transparent_cells = !canvas->config.fg_only_enabled;
+
     chafa_symbol_map_prepare (&canvas->config.symbol_map);
     chafa_symbol_map_prepare (&canvas->config.fill_symbol_map);
 
@@ -623,6 +745,7 @@ chafa_canvas_new (const ChafaCanvasConfig *config)
 
     update_display_colors (canvas);
     setup_palette (canvas);
+    setup_pens (canvas);
 
     return canvas;
 }
@@ -649,6 +772,7 @@ chafa_canvas_new_similar (ChafaCanvas *orig)
     chafa_canvas_config_copy_contents (&canvas->config, &orig->config);
 
     canvas->pixels = NULL;
+    canvas->cell_max_alpha = NULL;
     canvas->pixel_renderer = NULL;
     canvas->cells = g_new (ChafaCanvasCell, canvas->config.width * canvas->config.height);
     canvas->needs_clear = TRUE;
@@ -656,6 +780,8 @@ chafa_canvas_new_similar (ChafaCanvas *orig)
     chafa_dither_copy (&orig->dither, &canvas->dither);
 
     canvas->placement = NULL;
+    canvas->viewport = NULL;
+    memset (&canvas->symbol_usage, 0, sizeof (canvas->symbol_usage));
 
     return canvas;
 }
@@ -698,12 +824,15 @@ chafa_canvas_unref (ChafaCanvas *canvas)
     {
         if (canvas->placement)
             chafa_placement_unref (canvas->placement);
+        destroy_viewport (canvas);
         chafa_canvas_config_deinit (&canvas->config);
         destroy_pixel_renderer (canvas);
         chafa_dither_deinit (&canvas->dither);
         chafa_palette_deinit (&canvas->fg_palette);
         chafa_palette_deinit (&canvas->bg_palette);
+        chafa_symbol_renderer_clear_usage (&canvas->symbol_usage);
         g_free (canvas->pixels);
+        g_free (canvas->cell_max_alpha);
         g_free (canvas->cells);
         g_free (canvas);
     }
@@ -763,7 +892,8 @@ chafa_canvas_set_placement (ChafaCanvas *canvas, ChafaPlacement *placement)
         return;
 
     draw_all_pixels (canvas, frame->pixel_type, frame->data,
-                     frame->width, frame->height, frame->rowstride);
+                     frame->width, frame->height, frame->rowstride,
+                     frame);
 }
 
 /**
@@ -793,7 +923,82 @@ chafa_canvas_draw_all_pixels (ChafaCanvas *canvas, ChafaPixelType src_pixel_type
     g_return_if_fail (src_height >= 0);
 
     draw_all_pixels (canvas, src_pixel_type, src_pixels,
-                     src_width, src_height, src_rowstride);
+                     src_width, src_height, src_rowstride,
+                     NULL);
+}
+
+/**
+ * chafa_canvas_set_viewport_source:
+ * @canvas: Canvas to show the image on
+ * @src_pixel_type: Pixel format of @src_pixels
+ * @src_pixels: Pointer to the start of source pixel memory
+ * @src_width: Width in pixels of source pixel data
+ * @src_height: Height in pixels of source pixel data
+ * @src_rowstride: Number of bytes between the start of each pixel row
+ * @zoom_width: Width of the zoomed image, in cells
+ * @zoom_height: Height of the zoomed image, in cells
+ *
+ * Prepares @canvas for showing a part of a large image. The image is
+ * stretched to @zoom_width by @zoom_height cells, and
+ * chafa_canvas_set_viewport() selects which part of it is shown.
+ *
+ * The zoomed image is rendered in tiles as they come into view, and the
+ * tiles are cached so that panning around only renders the parts that
+ * have not been seen recently. Since tiles are rendered independently,
+ * error diffusion and normalization are done per tile, and wide symbols
+ * will not straddle tile boundaries.
+ *
+ * The pixel data is not copied, and must stay valid until the source is
+ * replaced, chafa_canvas_draw_all_pixels() is called or the canvas is
+ * freed. Viewports are only supported in %CHAFA_PIXEL_MODE_SYMBOLS.
+ *
+ * Since: 1.20
+ **/
+void
+chafa_canvas_set_viewport_source (ChafaCanvas *canvas, ChafaPixelType src_pixel_type,
+                                  const guint8 *src_pixels,
+                                  gint src_width, gint src_height, gint src_rowstride,
+                                  gint zoom_width, gint zoom_height)
+{
+    g_return_if_fail (canvas != NULL);
+    g_return_if_fail (canvas->refs > 0);
+    g_return_if_fail (canvas->config.pixel_mode == CHAFA_PIXEL_MODE_SYMBOLS);
+    g_return_if_fail (src_pixel_type < CHAFA_PIXEL_MAX);
+    g_return_if_fail (src_pixels != NULL);
+    g_return_if_fail (src_width > 0);
+    g_return_if_fail (src_height > 0);
+    g_return_if_fail (zoom_width > 0);
+    g_return_if_fail (zoom_height > 0);
+
+    destroy_viewport (canvas);
+    canvas->viewport = chafa_viewport_new (canvas, src_pixel_type, src_pixels,
+                                           src_width, src_height, src_rowstride,
+                                           zoom_width, zoom_height);
+}
+
+/**
+ * chafa_canvas_set_viewport:
+ * @canvas: Canvas with a viewport source
+ * @x: Leftmost column of the zoomed image to show
+ * @y: Topmost row of the zoomed image to show
+ *
+ * Replaces the contents of @canvas with the part of the zoomed image
+ * whose top left corner is at (@x, @y), in cells. The position is
+ * clamped so the canvas stays within the image where possible.
+ *
+ * Any tiles that are not in the cache are rendered first. The canvas
+ * must have a viewport source set with chafa_canvas_set_viewport_source().
+ *
+ * Since: 1.20
+ **/
+void
+chafa_canvas_set_viewport (ChafaCanvas *canvas, gint x, gint y)
+{
+    g_return_if_fail (canvas != NULL);
+    g_return_if_fail (canvas->refs > 0);
+    g_return_if_fail (canvas->viewport != NULL);
+
+    chafa_viewport_move (canvas->viewport, x, y);
 }
 
 /**
@@ -816,7 +1021,8 @@ chafa_canvas_set_contents_rgba8 (ChafaCanvas *canvas, const guint8 *src_pixels,
                                  gint src_width, gint src_height, gint src_rowstride)
 {
     draw_all_pixels (canvas, CHAFA_PIXEL_RGBA8_UNASSOCIATED,
-                     src_pixels, src_width, src_height, src_rowstride);
+                     src_pixels, src_width, src_height, src_rowstride,
+                     NULL);
 }
 
 /**
@@ -898,7 +1104,9 @@ chafa_canvas_print (ChafaCanvas *canvas, ChafaTermInfo *term_info)
         chafa_kitty_renderer_build_ansi (canvas->pixel_renderer, term_info, str,
                                          canvas->config.width, canvas->config.height,
                                          canvas->placement ? canvas->placement->id : -1,
-                                         canvas->config.passthrough);
+                                         canvas->config.passthrough,
+                                         canvas->config.kitty_transport,
+                                         canvas->config.terminal_scaling_enabled);
     }
     else if (canvas->config.pixel_mode == CHAFA_PIXEL_MODE_ITERM2
              && canvas->pixel_renderer)
@@ -918,6 +1126,85 @@ chafa_canvas_print (ChafaCanvas *canvas, ChafaTermInfo *term_info)
     return str;
 }
 
+/**
+ * chafa_canvas_print_placement:
+ * @canvas: The canvas whose image to show again
+ * @term_info: Terminal to format for, or %NULL for fallback
+ * @width_cells: Width to show the image at, in cells
+ * @height_cells: Height to show the image at, in cells
+ *
+ * Builds a UTF-8 string of terminal control sequences that shows the
+ * image in @canvas again at a size of @width_cells x @height_cells,
+ * e.g. after the terminal has been resized. It assumes the output of
+ * chafa_canvas_print () has already been sent to the terminal.
+ *
+ * This requires terminal-side scaling to be enabled with
+ * chafa_canvas_config_set_terminal_scaling_enabled (), and is only
+ * useful in #CHAFA_PIXEL_MODE_KITTY and #CHAFA_PIXEL_MODE_ITERM2.
+ *
+ * In Kitty mode, if a #ChafaPlacement with a positive ID has been set
+ * on @canvas, the image is placed by referring to that ID, and the pixels
+ * are not sent again. Otherwise, and in iTerm2 mode, where the protocol
+ * can't refer back to an earlier image, they are sent again as they were,
+ * without being rescaled.
+ *
+ * In other modes, or if terminal-side scaling is not enabled, an empty
+ * string is returned. A new canvas must then be made for the new size.
+ *
+ * Returns: A UTF-8 string of terminal control sequences
+ *
+ * Since: 1.20
+ **/
+GString *
+chafa_canvas_print_placement (ChafaCanvas *canvas, ChafaTermInfo *term_info,
+                              gint width_cells, gint height_cells)
+{
+    GString *str;
+
+    g_return_val_if_fail (canvas != NULL, NULL);
+    g_return_val_if_fail (canvas->refs > 0, NULL);
+    g_return_val_if_fail (width_cells > 0, NULL);
+    g_return_val_if_fail (height_cells > 0, NULL);
+
+    if (term_info)
+        chafa_term_info_ref (term_info);
+    else
+        term_info = chafa_term_db_get_fallback_info (chafa_term_db_get_default ());
+
+    str = g_string_new ("");
+
+    if (!canvas->config.terminal_scaling_enabled || !canvas->pixel_renderer)
+    {
+        /* Nothing to place */
+    }
+    else if (canvas->config.pixel_mode == CHAFA_PIXEL_MODE_KITTY
+             && chafa_term_info_get_seq (term_info, CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_IMAGE_V1))
+    {
+        gint placement_id = canvas->placement ? canvas->placement->id : -1;
+
+        if (!chafa_kitty_renderer_build_placement (canvas->pixel_renderer, term_info, str,
+                                                   width_cells, height_cells,
+                                                   placement_id,
+                                                   canvas->config.passthrough))
+        {
+            chafa_kitty_renderer_build_ansi (canvas->pixel_renderer, term_info, str,
+                                             width_cells, height_cells,
+                                             placement_id,
+                                             canvas->config.passthrough,
+                                             canvas->config.kitty_transport,
+                                             TRUE);
+        }
+    }
+    else if (canvas->config.pixel_mode == CHAFA_PIXEL_MODE_ITERM2)
+    {
+        chafa_iterm2_renderer_build_ansi (canvas->pixel_renderer, term_info, str,
+                                          width_cells, height_cells);
+    }
+
+    chafa_term_info_unref (term_info);
+    return str;
+}
+
 /**
  * chafa_canvas_print_rows:
  * @canvas: The canvas to generate a printable representation of
@@ -49,8 +49,20 @@ CHAFA_AVAILABLE_IN_1_2
 void chafa_canvas_draw_all_pixels (ChafaCanvas *canvas, ChafaPixelType src_pixel_type,
                                    const guint8 *src_pixels,
                                    gint src_width, gint src_height, gint src_rowstride);
+
+CHAFA_AVAILABLE_IN_1_20
+void chafa_canvas_set_viewport_source (ChafaCanvas *canvas, ChafaPixelType src_pixel_type,
+                                       const guint8 *src_pixels,
+                                       gint src_width, gint src_height, gint src_rowstride,
+                                       gint zoom_width, gint zoom_height);
+CHAFA_AVAILABLE_IN_1_20
+void chafa_canvas_set_viewport (ChafaCanvas *canvas, gint x, gint y);
+
 CHAFA_AVAILABLE_IN_1_6
 GString *chafa_canvas_print (ChafaCanvas *canvas, ChafaTermInfo *term_info);
+CHAFA_AVAILABLE_IN_1_20
+GString *chafa_canvas_print_placement (ChafaCanvas *canvas, ChafaTermInfo *term_info,
+                                       gint width_cells, gint height_cells);
 CHAFA_AVAILABLE_IN_1_14
 void chafa_canvas_print_rows (ChafaCanvas *canvas, ChafaTermInfo *term_info,
                               GString ***array_out, gint *array_len_out);
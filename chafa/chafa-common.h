@@ -267,6 +267,32 @@ typedef enum
 }
 ChafaPassthrough;
 
+/* Kitty transmission mediums */
+
+/**
+ * ChafaKittyTransport:
+ * @CHAFA_KITTY_TRANSPORT_DIRECT: Pixel data is sent inline as base64 chunks.
+ * @CHAFA_KITTY_TRANSPORT_TEMP_FILE: Pixel data is written to a temporary file
+ *  that the terminal reads and deletes.
+ * @CHAFA_KITTY_TRANSPORT_SHARED_MEMORY: Pixel data is written to a POSIX shared
+ *  memory object that the terminal reads and unlinks.
+ * @CHAFA_KITTY_TRANSPORT_MAX: Last supported transmission medium plus one.
+ *
+ * The medium used to transfer pixel data to the terminal in
+ * #CHAFA_PIXEL_MODE_KITTY. Anything but #CHAFA_KITTY_TRANSPORT_DIRECT
+ * requires the terminal to run on the same host.
+ **/
+
+typedef enum
+{
+    CHAFA_KITTY_TRANSPORT_DIRECT,
+    CHAFA_KITTY_TRANSPORT_TEMP_FILE,
+    CHAFA_KITTY_TRANSPORT_SHARED_MEMORY,
+
+    CHAFA_KITTY_TRANSPORT_MAX
+}
+ChafaKittyTransport;
+
 G_END_DECLS
 
 #endif /* __CHAFA_COMMON_H__ */
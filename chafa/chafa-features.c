@@ -19,7 +19,12 @@
 
 #include "config.h"
 
+#ifdef HAVE_SCHED_GETAFFINITY
+# include <sched.h>
+#endif
+
 #include "chafa.h"
+#include "internal/chafa-batch.h"
 #include "internal/chafa-private.h"
 
 /**
@@ -42,6 +47,18 @@
  * @CHAFA_FEATURE_WASM_SIMD: Flag indicating WebAssembly SIMD support.
  **/
 
+/**
+ * ChafaThreadAffinity:
+ * @CHAFA_THREAD_AFFINITY_NONE: Let the OS schedule worker threads freely.
+ * @CHAFA_THREAD_AFFINITY_COMPACT: Pin worker threads to consecutive CPUs.
+ * @CHAFA_THREAD_AFFINITY_SCATTER: Pin worker threads to CPUs spread evenly
+ *   across the available ones.
+ * @CHAFA_THREAD_AFFINITY_EXPLICIT: Pin worker threads to CPUs from a list.
+ * @CHAFA_THREAD_AFFINITY_MAX: Last supported thread affinity policy plus one.
+ *
+ * Since: 1.20
+ **/
+
 static gboolean chafa_initialized;
 
 static gboolean have_mmx;
@@ -51,6 +68,14 @@ static gboolean have_avx2;
 
 static gint n_threads = -1;
 
+/* Thread affinity. The batch code checks the generation to see if its
+ * workers need to be replaced. */
+G_LOCK_DEFINE_STATIC (affinity);
+static ChafaThreadAffinity affinity_policy = CHAFA_THREAD_AFFINITY_NONE;
+static gint *affinity_cpus;
+static gint affinity_n_cpus;
+static gint affinity_generation;
+
 static void
 init_features (void)
 {
@@ -279,3 +304,156 @@ chafa_get_n_actual_threads (void)
 
     return n_actual_threads;
 }
+
+/* CPUs we're allowed to run on, in ascending order */
+static gint *
+get_allowed_cpus (gint *n_cpus_out)
+{
+    gint *cpus;
+    gint n_cpus = 0;
+
+#ifdef HAVE_SCHED_GETAFFINITY
+    cpu_set_t set;
+    gint i;
+
+    CPU_ZERO (&set);
+
+    if (sched_getaffinity (0, sizeof (set), &set) == 0)
+    {
+        cpus = g_new (gint, CPU_COUNT (&set) + 1);
+
+        for (i = 0; i < CPU_SETSIZE; i++)
+        {
+            if (CPU_ISSET (i, &set))
+                cpus [n_cpus++] = i;
+        }
+    }
+    else
+#endif
+    {
+        gint i;
+
+        n_cpus = MAX (g_get_num_processors (), 1);
+        cpus = g_new (gint, n_cpus);
+
+        for (i = 0; i < n_cpus; i++)
+            cpus [i] = i;
+    }
+
+    *n_cpus_out = n_cpus;
+    return cpus;
+}
+
+/* Returns the CPU a worker should be pinned to, or -1 if it shouldn't be
+ * pinned. Workers are numbered from 0, and batches are handed out to them
+ * in order. */
+gint
+chafa_get_thread_affinity_cpu (gint worker_index, gint *generation_out)
+{
+    gint cpu = -1;
+
+    G_LOCK (affinity);
+
+    switch (affinity_policy)
+    {
+        case CHAFA_THREAD_AFFINITY_COMPACT:
+        case CHAFA_THREAD_AFFINITY_EXPLICIT:
+            cpu = affinity_cpus [worker_index % affinity_n_cpus];
+            break;
+
+        case CHAFA_THREAD_AFFINITY_SCATTER:
+        {
+            gint n_workers = CLAMP (chafa_get_n_actual_threads (), 1, affinity_n_cpus);
+            gint stride = affinity_n_cpus / n_workers;
+
+            cpu = affinity_cpus [(worker_index % n_workers) * stride];
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    if (generation_out)
+        *generation_out = affinity_generation;
+
+    G_UNLOCK (affinity);
+
+    return cpu;
+}
+
+/**
+ * chafa_get_thread_affinity_policy:
+ *
+ * Queries how worker threads are assigned to CPUs.
+ *
+ * Returns: The current #ChafaThreadAffinity policy
+ *
+ * Since: 1.20
+ **/
+ChafaThreadAffinity
+chafa_get_thread_affinity_policy (void)
+{
+    ChafaThreadAffinity policy;
+
+    G_LOCK (affinity);
+    policy = affinity_policy;
+    G_UNLOCK (affinity);
+
+    return policy;
+}
+
+/**
+ * chafa_set_thread_affinity_policy:
+ * @policy: A #ChafaThreadAffinity policy
+ * @cpus: (array length=n_cpus) (nullable): CPU numbers to use with
+ *   #CHAFA_THREAD_AFFINITY_EXPLICIT
+ * @n_cpus: Number of elements in @cpus
+ *
+ * Sets how worker threads are assigned to CPUs. The default is
+ * #CHAFA_THREAD_AFFINITY_NONE, which leaves it to the OS.
+ *
+ * With any other policy, work is handed out to a persistent set of
+ * worker threads, each pinned to a CPU, and a given slice of the work
+ * goes to the same worker every time. When rendering consecutive
+ * frames of the same size, this keeps each part of the image on the
+ * same core and its caches.
+ *
+ * #CHAFA_THREAD_AFFINITY_COMPACT pins workers to the available CPUs in
+ * order, and #CHAFA_THREAD_AFFINITY_SCATTER spreads them out as far as
+ * possible. #CHAFA_THREAD_AFFINITY_EXPLICIT uses the CPUs in @cpus, in
+ * the order given. If there are more workers than CPUs, they wrap
+ * around.
+ *
+ * This has no effect on platforms that don't support thread affinity.
+ *
+ * Since: 1.20
+ **/
+void
+chafa_set_thread_affinity_policy (ChafaThreadAffinity policy, const gint *cpus, gint n_cpus)
+{
+    g_return_if_fail (policy >= 0 && policy < CHAFA_THREAD_AFFINITY_MAX);
+    g_return_if_fail (policy != CHAFA_THREAD_AFFINITY_EXPLICIT || (cpus && n_cpus > 0));
+
+    G_LOCK (affinity);
+
+    g_free (affinity_cpus);
+
+    if (policy == CHAFA_THREAD_AFFINITY_EXPLICIT)
+    {
+        affinity_cpus = g_memdup (cpus, n_cpus * sizeof (gint));
+        affinity_n_cpus = n_cpus;
+    }
+    else
+    {
+        affinity_cpus = get_allowed_cpus (&affinity_n_cpus);
+    }
+
+    affinity_policy = policy;
+    affinity_generation++;
+
+    G_UNLOCK (affinity);
+
+    /* Workers for the old policy are of no further use */
+    chafa_batch_reset_workers ();
+}
@@ -38,6 +38,19 @@ typedef enum
 }
 ChafaFeatures;
 
+/* Thread affinity */
+
+typedef enum
+{
+    CHAFA_THREAD_AFFINITY_NONE,
+    CHAFA_THREAD_AFFINITY_COMPACT,
+    CHAFA_THREAD_AFFINITY_SCATTER,
+    CHAFA_THREAD_AFFINITY_EXPLICIT,
+
+    CHAFA_THREAD_AFFINITY_MAX
+}
+ChafaThreadAffinity;
+
 CHAFA_AVAILABLE_IN_ALL
 ChafaFeatures chafa_get_builtin_features (void);
 CHAFA_AVAILABLE_IN_ALL
@@ -53,6 +66,12 @@ void chafa_set_n_threads (gint n);
 CHAFA_AVAILABLE_IN_1_10
 gint chafa_get_n_actual_threads (void);
 
+CHAFA_AVAILABLE_IN_1_20
+ChafaThreadAffinity chafa_get_thread_affinity_policy (void);
+CHAFA_AVAILABLE_IN_1_20
+void chafa_set_thread_affinity_policy (ChafaThreadAffinity policy,
+                                       const gint *cpus, gint n_cpus);
+
 G_END_DECLS
 
 #endif /* __CHAFA_FEATURES_H__ */
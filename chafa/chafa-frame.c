@@ -136,6 +136,51 @@ chafa_frame_new_borrow (gconstpointer data,
     return new_frame ((gpointer)(uintptr_t) data, pixel_type, width, height, rowstride, FALSE);
 }
 
+/**
+ * chafa_frame_set_indexed_pixels:
+ * @frame: Frame to add indexed pixels to
+ * @indices: Pointer to palette indices, one byte per pixel
+ * @rowstride: Number of bytes to advance from the start of one row of @indices to the next
+ * @colors: Palette colors packed as 0xAARRGGBB, with unassociated alpha
+ * @n_colors: Number of colors in @colors, at most 256
+ *
+ * Gives @frame a copy of its pixels as indices into a palette, for sources
+ * that come with one, like GIF and palette PNG images. The indices must
+ * describe the same image as the frame's pixel data, which is still used
+ * where the indices can't be.
+ *
+ * When rendering to sixels without scaling, the source palette is then
+ * used directly instead of generating one from the pixels.
+ *
+ * Since: 1.20
+ **/
+void
+chafa_frame_set_indexed_pixels (ChafaFrame *frame,
+                                const guint8 *indices, gint rowstride,
+                                const guint32 *colors, gint n_colors)
+{
+    gint i;
+
+    g_return_if_fail (frame != NULL);
+    g_return_if_fail (indices != NULL);
+    g_return_if_fail (rowstride >= frame->width);
+    g_return_if_fail (colors != NULL);
+    g_return_if_fail (n_colors > 0 && n_colors <= 256);
+
+    g_free (frame->indices);
+    g_free (frame->index_colors);
+
+    frame->indices = g_malloc ((gsize) frame->width * frame->height);
+    frame->index_rowstride = frame->width;
+    frame->index_colors = g_memdup (colors, n_colors * sizeof (guint32));
+    frame->n_index_colors = n_colors;
+
+    for (i = 0; i < frame->height; i++)
+        memcpy (frame->indices + (gsize) i * frame->width,
+                indices + (gsize) i * rowstride,
+                frame->width);
+}
+
 /**
  * chafa_frame_ref:
  * @frame: Frame to add a reference to
@@ -178,6 +223,8 @@ chafa_frame_unref (ChafaFrame *frame)
     {
         if (frame->data_is_owned)
             g_free (frame->data);
+        g_free (frame->indices);
+        g_free (frame->index_colors);
         g_free (frame);
     }
 }
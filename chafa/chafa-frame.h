@@ -41,6 +41,11 @@ ChafaFrame *chafa_frame_new_borrow (gconstpointer data,
                                     ChafaPixelType pixel_type,
                                     gint width, gint height, gint rowstride);
 
+CHAFA_AVAILABLE_IN_1_20
+void chafa_frame_set_indexed_pixels (ChafaFrame *frame,
+                                     const guint8 *indices, gint rowstride,
+                                     const guint32 *colors, gint n_colors);
+
 CHAFA_AVAILABLE_IN_1_14
 void chafa_frame_ref (ChafaFrame *frame);
 CHAFA_AVAILABLE_IN_1_14
@@ -279,6 +279,17 @@ static const SeqStr rep_seqs [] =
     { CHAFA_TERM_SEQ_MAX, NULL }
 };
 
+/* DEC private mode 2026. Terminals ignore private modes they don't know, but
+ * we only list it for terminals known to implement it. See
+ * https://gist.github.com/christianparpart/d8a62cc1ab659194337d73e399004036 */
+static const SeqStr sync_update_seqs [] =
+{
+    { CHAFA_TERM_SEQ_BEGIN_SYNCHRONIZED_UPDATE, "\033[?2026h" },
+    { CHAFA_TERM_SEQ_END_SYNCHRONIZED_UPDATE, "\033[?2026l" },
+
+    { CHAFA_TERM_SEQ_MAX, NULL }
+};
+
 static const SeqStr sixel_seqs [] =
 {
     { CHAFA_TERM_SEQ_BEGIN_SIXELS, "\033P%1;%2;%3q" },
@@ -427,6 +438,8 @@ static const SeqStr kitty_seqs [] =
     { CHAFA_TERM_SEQ_END_KITTY_IMAGE, "\033_Gm=0\033\\" },
     { CHAFA_TERM_SEQ_BEGIN_KITTY_IMAGE_CHUNK, "\033_Gm=1;" },
     { CHAFA_TERM_SEQ_END_KITTY_IMAGE_CHUNK, "\033\\" },
+    { CHAFA_TERM_SEQ_BEGIN_KITTY_TRANSMIT_IMAGE_V1, "\033_Ga=t,q=2,f=%1,s=%2,v=%3,i=%4,m=1\033\\" },
+    { CHAFA_TERM_SEQ_PLACE_KITTY_IMAGE_V1, "\033_Ga=p,q=2,i=%1,c=%2,r=%3\033\\" },
 
     { CHAFA_TERM_SEQ_MAX, NULL }
 };
@@ -434,6 +447,22 @@ static const SeqStr kitty_seqs [] =
 static const SeqStr kitty_virt_seqs [] =
 {
     { CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_VIRT_IMAGE_V1, "\033_Ga=T,U=1,q=2,f=%1,s=%2,v=%3,c=%4,r=%5,i=%6,m=1\033\\" },
+    { CHAFA_TERM_SEQ_PLACE_KITTY_VIRT_IMAGE_V1, "\033_Ga=p,U=1,q=2,i=%1,c=%2,r=%3\033\\" },
+
+    { CHAFA_TERM_SEQ_MAX, NULL }
+};
+
+/* Transmission through the filesystem (t=t) and POSIX shared memory (t=s).
+ * Only useful when the terminal runs on the same host, so they're kept out of
+ * the fallback list and are only used when requested. */
+static const SeqStr kitty_local_seqs [] =
+{
+    { CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_TEMP_FILE_IMAGE_V1, "\033_Ga=T,t=t,f=%1,s=%2,v=%3,c=%4,r=%5;" },
+    { CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_VIRT_TEMP_FILE_IMAGE_V1, "\033_Ga=T,U=1,q=2,t=t,f=%1,s=%2,v=%3,c=%4,r=%5,i=%6;" },
+    { CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_SHM_IMAGE_V1, "\033_Ga=T,t=s,f=%1,s=%2,v=%3,c=%4,r=%5;" },
+    { CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_VIRT_SHM_IMAGE_V1, "\033_Ga=T,U=1,q=2,t=s,f=%1,s=%2,v=%3,c=%4,r=%5,i=%6;" },
+    { CHAFA_TERM_SEQ_BEGIN_KITTY_TRANSMIT_TEMP_FILE_IMAGE_V1, "\033_Ga=t,q=2,t=t,f=%1,s=%2,v=%3,i=%4;" },
+    { CHAFA_TERM_SEQ_BEGIN_KITTY_TRANSMIT_SHM_IMAGE_V1, "\033_Ga=t,q=2,t=s,f=%1,s=%2,v=%3,i=%4;" },
 
     { CHAFA_TERM_SEQ_MAX, NULL }
 };
@@ -464,6 +493,15 @@ static const ChafaTermSeq tmux_inherit_seqs [] =
     CHAFA_TERM_SEQ_END_KITTY_IMAGE,
     CHAFA_TERM_SEQ_BEGIN_KITTY_IMAGE_CHUNK,
     CHAFA_TERM_SEQ_END_KITTY_IMAGE_CHUNK,
+    CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_TEMP_FILE_IMAGE_V1,
+    CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_VIRT_TEMP_FILE_IMAGE_V1,
+    CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_SHM_IMAGE_V1,
+    CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_VIRT_SHM_IMAGE_V1,
+    CHAFA_TERM_SEQ_BEGIN_KITTY_TRANSMIT_IMAGE_V1,
+    CHAFA_TERM_SEQ_BEGIN_KITTY_TRANSMIT_TEMP_FILE_IMAGE_V1,
+    CHAFA_TERM_SEQ_BEGIN_KITTY_TRANSMIT_SHM_IMAGE_V1,
+    CHAFA_TERM_SEQ_PLACE_KITTY_IMAGE_V1,
+    CHAFA_TERM_SEQ_PLACE_KITTY_VIRT_IMAGE_V1,
 
     CHAFA_TERM_SEQ_MAX
 };
@@ -502,6 +540,15 @@ static const ChafaTermSeq screen_inherit_seqs [] =
     CHAFA_TERM_SEQ_END_KITTY_IMAGE,
     CHAFA_TERM_SEQ_BEGIN_KITTY_IMAGE_CHUNK,
     CHAFA_TERM_SEQ_END_KITTY_IMAGE_CHUNK,
+    CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_TEMP_FILE_IMAGE_V1,
+    CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_VIRT_TEMP_FILE_IMAGE_V1,
+    CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_SHM_IMAGE_V1,
+    CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_VIRT_SHM_IMAGE_V1,
+    CHAFA_TERM_SEQ_BEGIN_KITTY_TRANSMIT_IMAGE_V1,
+    CHAFA_TERM_SEQ_BEGIN_KITTY_TRANSMIT_TEMP_FILE_IMAGE_V1,
+    CHAFA_TERM_SEQ_BEGIN_KITTY_TRANSMIT_SHM_IMAGE_V1,
+    CHAFA_TERM_SEQ_PLACE_KITTY_IMAGE_V1,
+    CHAFA_TERM_SEQ_PLACE_KITTY_VIRT_IMAGE_V1,
 
     CHAFA_TERM_SEQ_MAX
 };
@@ -562,6 +609,15 @@ static const ChafaTermSeq lf_inherit_seqs [] =
     CHAFA_TERM_SEQ_END_KITTY_IMAGE,
     CHAFA_TERM_SEQ_BEGIN_KITTY_IMAGE_CHUNK,
     CHAFA_TERM_SEQ_END_KITTY_IMAGE_CHUNK,
+    CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_TEMP_FILE_IMAGE_V1,
+    CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_VIRT_TEMP_FILE_IMAGE_V1,
+    CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_SHM_IMAGE_V1,
+    CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_VIRT_SHM_IMAGE_V1,
+    CHAFA_TERM_SEQ_BEGIN_KITTY_TRANSMIT_IMAGE_V1,
+    CHAFA_TERM_SEQ_BEGIN_KITTY_TRANSMIT_TEMP_FILE_IMAGE_V1,
+    CHAFA_TERM_SEQ_BEGIN_KITTY_TRANSMIT_SHM_IMAGE_V1,
+    CHAFA_TERM_SEQ_PLACE_KITTY_IMAGE_V1,
+    CHAFA_TERM_SEQ_PLACE_KITTY_VIRT_IMAGE_V1,
 
     CHAFA_TERM_SEQ_MAX
 };
@@ -589,7 +645,8 @@ static const TermDef term_def [] =
      * It can only be detected interactively. It has the overshoot quirk. */
     { TERM_TYPE_TERM, "alacritty", VARIANT_NONE, VERSION_NONE,
       { { ENV_OP_INCL, ENV_CMP_EXACT,  "TERM", "alacritty", 10 } },
-      { vt220_seqs, color_direct_seqs, color_256_seqs, color_16_seqs, color_8_seqs },
+      { vt220_seqs, color_direct_seqs, color_256_seqs, color_16_seqs, color_8_seqs,
+        sync_update_seqs },
       INHERIT_NONE, CHAFA_PASSTHROUGH_NONE, PIXEL_PT_NONE,
       CHAFA_TERM_QUIRK_SIXEL_OVERSHOOT, LINUX_DESKTOP_SYMS },
 
@@ -601,7 +658,8 @@ static const TermDef term_def [] =
     { TERM_TYPE_TERM, "contour", VARIANT_NONE, VERSION_NONE,
       { { ENV_OP_INCL, ENV_CMP_EXACT,  "TERMINAL_NAME", "contour", 0 } },
       { vt220_seqs, color_direct_seqs, color_256_seqs, color_16_seqs, color_8_seqs,
-        sixel_seqs }, INHERIT_NONE, CHAFA_PASSTHROUGH_NONE, PIXEL_PT_NONE,
+        sixel_seqs, sync_update_seqs },
+      INHERIT_NONE, CHAFA_PASSTHROUGH_NONE, PIXEL_PT_NONE,
       QUIRKS_NONE, LINUX_DESKTOP_SYMS },
 
     { TERM_TYPE_TERM, "ctx", VARIANT_NONE, VERSION_NONE,
@@ -657,7 +715,8 @@ static const TermDef term_def [] =
       { { ENV_OP_INCL, ENV_CMP_EXACT,  "TERM", "foot", 10 },
         { ENV_OP_INCL, ENV_CMP_PREFIX, "TERM", "foot-", 10 } },
       { vt220_seqs, color_direct_seqs, color_256_seqs, color_16_seqs, color_8_seqs,
-        sixel_seqs }, INHERIT_NONE, CHAFA_PASSTHROUGH_NONE, PIXEL_PT_NONE,
+        sixel_seqs, sync_update_seqs },
+      INHERIT_NONE, CHAFA_PASSTHROUGH_NONE, PIXEL_PT_NONE,
       QUIRKS_NONE, LINUX_DESKTOP_SYMS },
 
     { TERM_TYPE_TERM, "ghostty", VARIANT_NONE, VERSION_NONE,
@@ -665,7 +724,8 @@ static const TermDef term_def [] =
         { ENV_OP_INCL, ENV_CMP_EXACT,  "TERM_PROGRAM", "ghostty", 0 },
         { ENV_OP_INCL, ENV_CMP_ISSET,  "GHOSTTY_BIN_DIR", NULL, 0 } },
       { vt220_seqs, color_direct_seqs, color_256_seqs, color_16_seqs, color_8_seqs,
-        kitty_seqs, kitty_virt_seqs }, INHERIT_NONE, CHAFA_PASSTHROUGH_NONE,
+        kitty_seqs, kitty_virt_seqs, kitty_local_seqs, sync_update_seqs },
+      INHERIT_NONE, CHAFA_PASSTHROUGH_NONE,
       PIXEL_PT_NONE, QUIRKS_NONE, LINUX_DESKTOP_SYMS },
 
     /* GNU/Hurd console */
@@ -679,14 +739,16 @@ static const TermDef term_def [] =
       { { ENV_OP_INCL, ENV_CMP_EXACT,  "LC_TERMINAL", "iTerm2", 0 },
         { ENV_OP_INCL, ENV_CMP_EXACT,  "TERM_PROGRAM", "iTerm.app", 0 } },
       { vt220_seqs, color_direct_seqs, color_256_seqs, color_16_seqs, color_8_seqs,
-        iterm2_seqs }, INHERIT_NONE, CHAFA_PASSTHROUGH_NONE, PIXEL_PT_NONE,
+        iterm2_seqs, sync_update_seqs },
+      INHERIT_NONE, CHAFA_PASSTHROUGH_NONE, PIXEL_PT_NONE,
       QUIRKS_NONE, LINUX_DESKTOP_SYMS },
 
     { TERM_TYPE_TERM, "kitty", VARIANT_NONE, VERSION_NONE,
       { { ENV_OP_INCL, ENV_CMP_EXACT,  "TERM", "xterm-kitty", 10 },
         { ENV_OP_INCL, ENV_CMP_ISSET,  "KITTY_PID", NULL, 0 } },
       { vt220_seqs, color_direct_seqs, color_256_seqs, color_16_seqs, color_8_seqs,
-        kitty_seqs, kitty_virt_seqs }, INHERIT_NONE, CHAFA_PASSTHROUGH_NONE,
+        kitty_seqs, kitty_virt_seqs, kitty_local_seqs, sync_update_seqs },
+      INHERIT_NONE, CHAFA_PASSTHROUGH_NONE,
       PIXEL_PT_NONE, QUIRKS_NONE, LINUX_DESKTOP_SYMS },
 
     { TERM_TYPE_TERM, "konsole", VARIANT_NONE, VERSION_NONE,
@@ -728,7 +790,7 @@ static const TermDef term_def [] =
       { { ENV_OP_INCL, ENV_CMP_EXACT, "TERM", "mintty", 10 },
         { ENV_OP_INCL, ENV_CMP_EXACT, "TERM_PROGRAM", "mintty", 0 } },
       { vt220_seqs, color_direct_seqs, color_256_seqs, color_16_seqs, color_8_seqs,
-        iterm2_seqs, sixel_seqs },
+        iterm2_seqs, sixel_seqs, sync_update_seqs },
       INHERIT_NONE, CHAFA_PASSTHROUGH_NONE, PIXEL_PT_NONE,
       CHAFA_TERM_QUIRK_SIXEL_OVERSHOOT, WIN_TERMINAL_SYMS },
 
@@ -758,7 +820,7 @@ static const TermDef term_def [] =
       { { ENV_OP_INCL, ENV_CMP_EXACT,  "TERM", "rio", 10 },
         { ENV_OP_INCL, ENV_CMP_EXACT,  "TERM_PROGRAM", "rio", 0 } },
       { vt220_seqs, color_direct_seqs, color_256_seqs, color_16_seqs, color_8_seqs,
-        iterm2_seqs, sixel_seqs },
+        iterm2_seqs, sixel_seqs, sync_update_seqs },
       INHERIT_NONE, CHAFA_PASSTHROUGH_NONE, PIXEL_PT_NONE,
       CHAFA_TERM_QUIRK_SIXEL_OVERSHOOT, LINUX_DESKTOP_SYMS },
 
@@ -845,7 +907,8 @@ static const TermDef term_def [] =
       { { ENV_OP_INCL, ENV_CMP_EXACT,  "TERM_PROGRAM", "WezTerm", 0 },
         { ENV_OP_INCL, ENV_CMP_ISSET,  "WEZTERM_EXECUTABLE", NULL, 0 } },
       { vt220_seqs, color_direct_seqs, color_256_seqs, color_16_seqs, color_8_seqs,
-        sixel_seqs, iterm2_seqs }, INHERIT_NONE, CHAFA_PASSTHROUGH_NONE, PIXEL_PT_NONE,
+        sixel_seqs, iterm2_seqs, sync_update_seqs },
+      INHERIT_NONE, CHAFA_PASSTHROUGH_NONE, PIXEL_PT_NONE,
       QUIRKS_NONE, LINUX_DESKTOP_SYMS },
 
     /* The MS Windows 10 TH2 (v1511+) console supports ANSI escape codes,
@@ -201,6 +201,17 @@
  * @CHAFA_TERM_SEQ_BEGIN_HYPERLINK: Begins an OSC 8-style hyperlink. The URL follows this.
  * @CHAFA_TERM_SEQ_BEGIN_HYPERLINK_ANCHOR: Separates an OSC 8-style hyperlink URL from its anchor (label). The label follows this.
  * @CHAFA_TERM_SEQ_END_HYPERLINK: Ends an OSC 8-style hyperlink. Closes both the preceding #CHAFA_TERM_SEQ_BEGIN_HYPERLINK and #CHAFA_TERM_SEQ_BEGIN_HYPERLINK_ANCHOR.
+ * @CHAFA_TERM_SEQ_BEGIN_SYNCHRONIZED_UPDATE: Tells the terminal to hold off on redrawing until the update is complete (DEC mode 2026).
+ * @CHAFA_TERM_SEQ_END_SYNCHRONIZED_UPDATE: Ends a synchronized update, letting the terminal show the result in one go.
+ * @CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_TEMP_FILE_IMAGE_V1: Begins Kitty graphics protocol image, read from a temporary file.
+ * @CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_VIRT_TEMP_FILE_IMAGE_V1: Begins Kitty graphics protocol virtual image, read from a temporary file.
+ * @CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_SHM_IMAGE_V1: Begins Kitty graphics protocol image, read from a shared memory object.
+ * @CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_VIRT_SHM_IMAGE_V1: Begins Kitty graphics protocol virtual image, read from a shared memory object.
+ * @CHAFA_TERM_SEQ_BEGIN_KITTY_TRANSMIT_IMAGE_V1: Begins Kitty graphics protocol image to be stored for later placement.
+ * @CHAFA_TERM_SEQ_BEGIN_KITTY_TRANSMIT_TEMP_FILE_IMAGE_V1: Begins Kitty graphics protocol image to be stored for later placement, read from a temporary file.
+ * @CHAFA_TERM_SEQ_BEGIN_KITTY_TRANSMIT_SHM_IMAGE_V1: Begins Kitty graphics protocol image to be stored for later placement, read from a shared memory object.
+ * @CHAFA_TERM_SEQ_PLACE_KITTY_IMAGE_V1: Displays a stored Kitty graphics protocol image.
+ * @CHAFA_TERM_SEQ_PLACE_KITTY_VIRT_IMAGE_V1: Creates a virtual placement for a stored Kitty graphics protocol image.
  * @CHAFA_TERM_SEQ_MAX: Last control sequence plus one.
  *
  * An enumeration of the control sequences supported by #ChafaTermInfo.
@@ -544,6 +555,18 @@ emit_seq_3_args_uint (const ChafaTermInfo *term_info, gchar *out, ChafaTermSeq s
     return emit_seq_guint (term_info, out, seq, args, 3);
 }
 
+static gchar *
+emit_seq_4_args_uint (const ChafaTermInfo *term_info, gchar *out, ChafaTermSeq seq, guint arg0, guint arg1, guint arg2, guint arg3)
+{
+    guint args [4];
+
+    args [0] = arg0;
+    args [1] = arg1;
+    args [2] = arg2;
+    args [3] = arg3;
+    return emit_seq_guint (term_info, out, seq, args, 4);
+}
+
 static gchar *
 emit_seq_5_args_uint (const ChafaTermInfo *term_info, gchar *out, ChafaTermSeq seq, guint arg0, guint arg1, guint arg2, guint arg3, guint arg4)
 {
@@ -1749,6 +1772,10 @@ gchar *chafa_term_info_emit_##func_name(const ChafaTermInfo *term_info, gchar *d
 gchar *chafa_term_info_emit_##func_name(const ChafaTermInfo *term_info, gchar *dest, guint arg0, guint arg1, guint arg2) \
 { return emit_seq_3_args_uint (term_info, dest, CHAFA_TERM_SEQ_##seq_name, arg0, arg1, arg2); }
 
+#define DEFINE_EMIT_SEQ_4_none_guint(func_name, seq_name) \
+gchar *chafa_term_info_emit_##func_name(const ChafaTermInfo *term_info, gchar *dest, guint arg0, guint arg1, guint arg2, guint arg3) \
+{ return emit_seq_4_args_uint (term_info, dest, CHAFA_TERM_SEQ_##seq_name, arg0, arg1, arg2, arg3); }
+
 #define DEFINE_EMIT_SEQ_5_none_guint(func_name, seq_name) \
 gchar *chafa_term_info_emit_##func_name(const ChafaTermInfo *term_info, gchar *dest, guint arg0, guint arg1, guint arg2, guint arg3, guint arg4) \
 { return emit_seq_5_args_uint (term_info, dest, CHAFA_TERM_SEQ_##seq_name, arg0, arg1, arg2, arg3, arg4); }
@@ -2885,6 +2885,300 @@ CHAFA_TERM_SEQ_DEF(begin_hyperlink_anchor, BEGIN_HYPERLINK_ANCHOR, 0, none, char
  **/
 CHAFA_TERM_SEQ_DEF(end_hyperlink, END_HYPERLINK, 0, none, char)
 
+/* --- Available in 1.20+ --- */
+
+#undef CHAFA_TERM_SEQ_AVAILABILITY
+#define CHAFA_TERM_SEQ_AVAILABILITY CHAFA_AVAILABLE_IN_1_20
+
+/**
+ * chafa_term_info_emit_begin_synchronized_update:
+ * @term_info: A #ChafaTermInfo
+ * @dest: String destination
+ *
+ * Prints the control sequence for #CHAFA_TERM_SEQ_BEGIN_SYNCHRONIZED_UPDATE.
+ *
+ * @dest must have enough space to hold
+ * #CHAFA_TERM_SEQ_LENGTH_MAX bytes, even if the emitted sequence is
+ * shorter. The output will not be zero-terminated.
+ *
+ * Returns: Pointer to first byte after emitted string
+ *
+ * Since: 1.20
+ **/
+CHAFA_TERM_SEQ_DEF(begin_synchronized_update, BEGIN_SYNCHRONIZED_UPDATE, 0, none, char)
+
+/**
+ * chafa_term_info_emit_end_synchronized_update:
+ * @term_info: A #ChafaTermInfo
+ * @dest: String destination
+ *
+ * Prints the control sequence for #CHAFA_TERM_SEQ_END_SYNCHRONIZED_UPDATE.
+ *
+ * @dest must have enough space to hold
+ * #CHAFA_TERM_SEQ_LENGTH_MAX bytes, even if the emitted sequence is
+ * shorter. The output will not be zero-terminated.
+ *
+ * Returns: Pointer to first byte after emitted string
+ *
+ * Since: 1.20
+ **/
+CHAFA_TERM_SEQ_DEF(end_synchronized_update, END_SYNCHRONIZED_UPDATE, 0, none, char)
+
+/**
+ * chafa_term_info_emit_begin_kitty_immediate_temp_file_image_v1:
+ * @term_info: A #ChafaTermInfo
+ * @dest: String destination
+ * @bpp: Bits per pixel
+ * @width_pixels: Image width in pixels
+ * @height_pixels: Image height in pixels
+ * @width_cells: Target width in cells
+ * @height_cells: Target height in cells
+ *
+ * Prints the control sequence for #CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_TEMP_FILE_IMAGE_V1.
+ *
+ * @dest must have enough space to hold
+ * #CHAFA_TERM_SEQ_LENGTH_MAX bytes, even if the emitted sequence is
+ * shorter. The output will not be zero-terminated.
+ *
+ * @bpp must be set to either 24 for RGB data, 32 for RGBA, or 100 for a
+ * PNG file.
+ *
+ * This sequence must be followed by the base-64 encoded path of a temporary file holding the
+ * image data, and then by #CHAFA_TERM_SEQ_END_KITTY_IMAGE_CHUNK. The terminal
+ * will remove the file after reading it.
+ *
+ * Returns: Pointer to first byte after emitted string
+ *
+ * Since: 1.20
+ **/
+CHAFA_TERM_SEQ_DEF(begin_kitty_immediate_temp_file_image_v1, BEGIN_KITTY_IMMEDIATE_TEMP_FILE_IMAGE_V1, 5, none, guint, CHAFA_TERM_SEQ_ARGS guint bpp, guint width_pixels, guint height_pixels, guint width_cells, guint height_cells)
+
+/**
+ * chafa_term_info_emit_begin_kitty_immediate_virt_temp_file_image_v1:
+ * @term_info: A #ChafaTermInfo
+ * @dest: String destination
+ * @bpp: Bits per pixel
+ * @width_pixels: Image width in pixels
+ * @height_pixels: Image height in pixels
+ * @width_cells: Target width in cells
+ * @height_cells: Target height in cells
+ * @id: Image ID
+ *
+ * Prints the control sequence for #CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_VIRT_TEMP_FILE_IMAGE_V1.
+ *
+ * @dest must have enough space to hold
+ * #CHAFA_TERM_SEQ_LENGTH_MAX bytes, even if the emitted sequence is
+ * shorter. The output will not be zero-terminated.
+ *
+ * @bpp must be set to either 24 for RGB data, 32 for RGBA, or 100 for a
+ * PNG file.
+ *
+ * This sequence must be followed by the base-64 encoded path of a temporary file holding the
+ * image data, and then by #CHAFA_TERM_SEQ_END_KITTY_IMAGE_CHUNK. The terminal
+ * will remove the file after reading it.
+ *
+ * Returns: Pointer to first byte after emitted string
+ *
+ * Since: 1.20
+ **/
+CHAFA_TERM_SEQ_DEF(begin_kitty_immediate_virt_temp_file_image_v1, BEGIN_KITTY_IMMEDIATE_VIRT_TEMP_FILE_IMAGE_V1, 6, none, guint, CHAFA_TERM_SEQ_ARGS guint bpp, guint width_pixels, guint height_pixels, guint width_cells, guint height_cells, guint id)
+
+/**
+ * chafa_term_info_emit_begin_kitty_immediate_shm_image_v1:
+ * @term_info: A #ChafaTermInfo
+ * @dest: String destination
+ * @bpp: Bits per pixel
+ * @width_pixels: Image width in pixels
+ * @height_pixels: Image height in pixels
+ * @width_cells: Target width in cells
+ * @height_cells: Target height in cells
+ *
+ * Prints the control sequence for #CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_SHM_IMAGE_V1.
+ *
+ * @dest must have enough space to hold
+ * #CHAFA_TERM_SEQ_LENGTH_MAX bytes, even if the emitted sequence is
+ * shorter. The output will not be zero-terminated.
+ *
+ * @bpp must be set to either 24 for RGB data, 32 for RGBA, or 100 for a
+ * PNG file.
+ *
+ * This sequence must be followed by the base-64 encoded name of a POSIX shared memory object holding the
+ * image data, and then by #CHAFA_TERM_SEQ_END_KITTY_IMAGE_CHUNK. The terminal
+ * will remove the object after reading it.
+ *
+ * Returns: Pointer to first byte after emitted string
+ *
+ * Since: 1.20
+ **/
+CHAFA_TERM_SEQ_DEF(begin_kitty_immediate_shm_image_v1, BEGIN_KITTY_IMMEDIATE_SHM_IMAGE_V1, 5, none, guint, CHAFA_TERM_SEQ_ARGS guint bpp, guint width_pixels, guint height_pixels, guint width_cells, guint height_cells)
+
+/**
+ * chafa_term_info_emit_begin_kitty_immediate_virt_shm_image_v1:
+ * @term_info: A #ChafaTermInfo
+ * @dest: String destination
+ * @bpp: Bits per pixel
+ * @width_pixels: Image width in pixels
+ * @height_pixels: Image height in pixels
+ * @width_cells: Target width in cells
+ * @height_cells: Target height in cells
+ * @id: Image ID
+ *
+ * Prints the control sequence for #CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_VIRT_SHM_IMAGE_V1.
+ *
+ * @dest must have enough space to hold
+ * #CHAFA_TERM_SEQ_LENGTH_MAX bytes, even if the emitted sequence is
+ * shorter. The output will not be zero-terminated.
+ *
+ * @bpp must be set to either 24 for RGB data, 32 for RGBA, or 100 for a
+ * PNG file.
+ *
+ * This sequence must be followed by the base-64 encoded name of a POSIX shared memory object holding the
+ * image data, and then by #CHAFA_TERM_SEQ_END_KITTY_IMAGE_CHUNK. The terminal
+ * will remove the object after reading it.
+ *
+ * Returns: Pointer to first byte after emitted string
+ *
+ * Since: 1.20
+ **/
+CHAFA_TERM_SEQ_DEF(begin_kitty_immediate_virt_shm_image_v1, BEGIN_KITTY_IMMEDIATE_VIRT_SHM_IMAGE_V1, 6, none, guint, CHAFA_TERM_SEQ_ARGS guint bpp, guint width_pixels, guint height_pixels, guint width_cells, guint height_cells, guint id)
+
+/**
+ * chafa_term_info_emit_begin_kitty_transmit_image_v1:
+ * @term_info: A #ChafaTermInfo
+ * @dest: String destination
+ * @bpp: Bits per pixel
+ * @width_pixels: Image width in pixels
+ * @height_pixels: Image height in pixels
+ * @id: Image ID
+ *
+ * Prints the control sequence for #CHAFA_TERM_SEQ_BEGIN_KITTY_TRANSMIT_IMAGE_V1.
+ *
+ * @dest must have enough space to hold
+ * #CHAFA_TERM_SEQ_LENGTH_MAX bytes, even if the emitted sequence is
+ * shorter. The output will not be zero-terminated.
+ *
+ * @bpp must be set to either 24 for RGB data, 32 for RGBA, or 100 to embed a
+ * PNG file.
+ *
+ * This sequence must be followed by zero or more paired sequences of
+ * type #CHAFA_TERM_SEQ_BEGIN_KITTY_IMAGE_CHUNK and #CHAFA_TERM_SEQ_END_KITTY_IMAGE_CHUNK
+ * with base-64 encoded image data between them.
+ *
+ * When the image data has been transferred, #CHAFA_TERM_SEQ_END_KITTY_IMAGE must
+ * be emitted. The image is stored under @id, but not displayed until it is
+ * placed with #CHAFA_TERM_SEQ_PLACE_KITTY_IMAGE_V1.
+ *
+ * Returns: Pointer to first byte after emitted string
+ *
+ * Since: 1.20
+ **/
+CHAFA_TERM_SEQ_DEF(begin_kitty_transmit_image_v1, BEGIN_KITTY_TRANSMIT_IMAGE_V1, 4, none, guint, CHAFA_TERM_SEQ_ARGS guint bpp, guint width_pixels, guint height_pixels, guint id)
+
+/**
+ * chafa_term_info_emit_begin_kitty_transmit_temp_file_image_v1:
+ * @term_info: A #ChafaTermInfo
+ * @dest: String destination
+ * @bpp: Bits per pixel
+ * @width_pixels: Image width in pixels
+ * @height_pixels: Image height in pixels
+ * @id: Image ID
+ *
+ * Prints the control sequence for #CHAFA_TERM_SEQ_BEGIN_KITTY_TRANSMIT_TEMP_FILE_IMAGE_V1.
+ *
+ * @dest must have enough space to hold
+ * #CHAFA_TERM_SEQ_LENGTH_MAX bytes, even if the emitted sequence is
+ * shorter. The output will not be zero-terminated.
+ *
+ * @bpp must be set to either 24 for RGB data, 32 for RGBA, or 100 for a
+ * PNG file.
+ *
+ * This sequence must be followed by the base-64 encoded path of a temporary file holding the
+ * image data, and then by #CHAFA_TERM_SEQ_END_KITTY_IMAGE_CHUNK. The terminal
+ * will remove the file after reading it. The image is stored under @id, but not
+ * displayed until it is placed with #CHAFA_TERM_SEQ_PLACE_KITTY_IMAGE_V1.
+ *
+ * Returns: Pointer to first byte after emitted string
+ *
+ * Since: 1.20
+ **/
+CHAFA_TERM_SEQ_DEF(begin_kitty_transmit_temp_file_image_v1, BEGIN_KITTY_TRANSMIT_TEMP_FILE_IMAGE_V1, 4, none, guint, CHAFA_TERM_SEQ_ARGS guint bpp, guint width_pixels, guint height_pixels, guint id)
+
+/**
+ * chafa_term_info_emit_begin_kitty_transmit_shm_image_v1:
+ * @term_info: A #ChafaTermInfo
+ * @dest: String destination
+ * @bpp: Bits per pixel
+ * @width_pixels: Image width in pixels
+ * @height_pixels: Image height in pixels
+ * @id: Image ID
+ *
+ * Prints the control sequence for #CHAFA_TERM_SEQ_BEGIN_KITTY_TRANSMIT_SHM_IMAGE_V1.
+ *
+ * @dest must have enough space to hold
+ * #CHAFA_TERM_SEQ_LENGTH_MAX bytes, even if the emitted sequence is
+ * shorter. The output will not be zero-terminated.
+ *
+ * @bpp must be set to either 24 for RGB data, 32 for RGBA, or 100 for a
+ * PNG file.
+ *
+ * This sequence must be followed by the base-64 encoded name of a POSIX shared memory object holding the
+ * image data, and then by #CHAFA_TERM_SEQ_END_KITTY_IMAGE_CHUNK. The terminal
+ * will remove the object after reading it. The image is stored under @id, but
+ * not displayed until it is placed with #CHAFA_TERM_SEQ_PLACE_KITTY_IMAGE_V1.
+ *
+ * Returns: Pointer to first byte after emitted string
+ *
+ * Since: 1.20
+ **/
+CHAFA_TERM_SEQ_DEF(begin_kitty_transmit_shm_image_v1, BEGIN_KITTY_TRANSMIT_SHM_IMAGE_V1, 4, none, guint, CHAFA_TERM_SEQ_ARGS guint bpp, guint width_pixels, guint height_pixels, guint id)
+
+/**
+ * chafa_term_info_emit_place_kitty_image_v1:
+ * @term_info: A #ChafaTermInfo
+ * @dest: String destination
+ * @id: Image ID
+ * @width_cells: Target width in cells
+ * @height_cells: Target height in cells
+ *
+ * Prints the control sequence for #CHAFA_TERM_SEQ_PLACE_KITTY_IMAGE_V1.
+ *
+ * @dest must have enough space to hold
+ * #CHAFA_TERM_SEQ_LENGTH_MAX bytes, even if the emitted sequence is
+ * shorter. The output will not be zero-terminated.
+ *
+ * Displays the previously transmitted image @id at the cursor position,
+ * scaled by the terminal to cover @width_cells by @height_cells.
+ *
+ * Returns: Pointer to first byte after emitted string
+ *
+ * Since: 1.20
+ **/
+CHAFA_TERM_SEQ_DEF(place_kitty_image_v1, PLACE_KITTY_IMAGE_V1, 3, none, guint, CHAFA_TERM_SEQ_ARGS guint id, guint width_cells, guint height_cells)
+
+/**
+ * chafa_term_info_emit_place_kitty_virt_image_v1:
+ * @term_info: A #ChafaTermInfo
+ * @dest: String destination
+ * @id: Image ID
+ * @width_cells: Target width in cells
+ * @height_cells: Target height in cells
+ *
+ * Prints the control sequence for #CHAFA_TERM_SEQ_PLACE_KITTY_VIRT_IMAGE_V1.
+ *
+ * @dest must have enough space to hold
+ * #CHAFA_TERM_SEQ_LENGTH_MAX bytes, even if the emitted sequence is
+ * shorter. The output will not be zero-terminated.
+ *
+ * Creates a virtual placement of the previously transmitted image @id,
+ * scaled by the terminal to cover @width_cells by @height_cells. It is
+ * displayed where Unicode placeholders referencing @id are printed.
+ *
+ * Returns: Pointer to first byte after emitted string
+ *
+ * Since: 1.20
+ **/
+CHAFA_TERM_SEQ_DEF(place_kitty_virt_image_v1, PLACE_KITTY_VIRT_IMAGE_V1, 3, none, guint, CHAFA_TERM_SEQ_ARGS guint id, guint width_cells, guint height_cells)
+
 #undef CHAFA_TERM_SEQ_AVAILABILITY
 
 #undef CHAFA_TERM_SEQ_ARGS
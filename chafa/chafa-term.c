@@ -19,6 +19,7 @@
 
 #include "config.h"
 
+#include <errno.h>
 #include <stdio.h>  /* ctermid */
 #include <sys/types.h>  /* open */
 #include <fcntl.h>  /* open */
@@ -33,6 +34,7 @@
 #include <glib/gstdio.h>  /* g_open, g_close */
 
 #include "chafa.h"
+#include "internal/chafa-byte-fifo.h"
 
 /* Include after glib.h for G_OS_WIN32 */
 #ifdef G_OS_WIN32
@@ -96,6 +98,39 @@ struct ChafaTerm
 
     GQueue *event_queue;
     guint in_idle_id;
+
+    /* TRUE if the reader and writer threads may have been started */
+    guint in_sync_used : 1;
+    guint out_sync_used : 1;
+
+    /* Event loop integration. In async mode, the caller polls our fds and
+     * we do non-blocking I/O when told to. See chafa_term_get_pollfds (). */
+
+    ChafaByteFifo *out_fifo;
+    ChafaTermProbeFunc probe_func;
+    gpointer probe_data;
+    gint64 probe_end_time_us;
+#ifdef HAVE_TERMIOS_H
+    struct termios probe_saved_termios;
+    gboolean probe_termios_changed;
+#endif
+
+    guint is_async : 1;
+    guint out_error : 1;
+    guint probe_pending : 1;
+};
+
+/* Queries sent when probing. The terminal replies to the primary device
+ * attributes query last, which tells us we're done. */
+static const gint probe_seqs [] =
+{
+    CHAFA_TERM_SEQ_QUERY_DEFAULT_FG,
+    CHAFA_TERM_SEQ_QUERY_DEFAULT_BG,
+    CHAFA_TERM_SEQ_QUERY_TEXT_AREA_SIZE_CELLS,
+    CHAFA_TERM_SEQ_QUERY_TEXT_AREA_SIZE_PX,
+    CHAFA_TERM_SEQ_QUERY_CELL_SIZE_PX,
+    CHAFA_TERM_SEQ_QUERY_PRIMARY_DEVICE_ATTRIBUTES,
+    -1
 };
 
 /* ------------------ *
@@ -575,6 +610,8 @@ in_sync_pull (ChafaTerm *term, gint timeout_ms)
     if ((event = chafa_parser_pop_event (term->parser)))
         return event;
 
+    term->in_sync_used = TRUE;
+
     if (timeout_ms > 0)
         end_time_us = g_get_monotonic_time () + timeout_ms * 1000;
 
@@ -607,6 +644,418 @@ in_sync_pull (ChafaTerm *term, gint timeout_ms)
     return event;
 }
 
+/* Blocking write that bypasses the writer thread */
+static gboolean
+write_blocking (gint fd, gconstpointer data, gint len)
+{
+    const guchar *p = data;
+
+    while (len > 0)
+    {
+        gint n_written = write (fd, p, len);
+
+        if (n_written < 0)
+        {
+#ifdef G_OS_UNIX
+            if (errno == EAGAIN)
+            {
+                GPollFD poll_fd = { fd, G_IO_OUT, 0 };
+
+                /* Someone else made it non-blocking */
+                g_poll (&poll_fd, 1, -1);
+                if (poll_fd.revents & (G_IO_HUP | G_IO_ERR))
+                    return FALSE;
+                continue;
+            }
+#endif
+            if (errno == EINTR)
+                continue;
+            return FALSE;
+        }
+
+        p += n_written;
+        len -= n_written;
+    }
+
+    return TRUE;
+}
+
+static void
+write_out (ChafaTerm *term, gconstpointer data, gint len)
+{
+    if (term->is_async)
+    {
+        if (!term->out_error)
+            chafa_byte_fifo_push (term->out_fifo, data, len);
+    }
+    else
+    {
+        term->out_sync_used = TRUE;
+        chafa_stream_writer_write (term->writer, data, len);
+    }
+}
+
+/* ---------------------- *
+ * Event loop integration *
+ * ---------------------- */
+
+#ifdef G_OS_UNIX
+
+/* Like the stream reader, we only keep the fds non-blocking for the duration
+ * of each call. They may be shared with the shell (github#293). */
+
+static gint
+read_nonblocking (gint fd, gpointer out, gint max)
+{
+    gint result;
+    gint saved_errno;
+
+    g_unix_set_fd_nonblocking (fd, TRUE, NULL);
+    result = read (fd, out, max);
+    saved_errno = errno;
+    g_unix_set_fd_nonblocking (fd, FALSE, NULL);
+
+    /* Zero means EOF here; report it as an error */
+    if (result < 0)
+        return (saved_errno == EAGAIN || saved_errno == EINTR) ? 0 : -1;
+    return result > 0 ? result : -1;
+}
+
+static gint
+write_nonblocking (gint fd, gconstpointer data, gint len)
+{
+    gint result;
+    gint saved_errno;
+
+    g_unix_set_fd_nonblocking (fd, TRUE, NULL);
+    result = write (fd, data, len);
+    saved_errno = errno;
+    g_unix_set_fd_nonblocking (fd, FALSE, NULL);
+
+    if (result < 0)
+        return (saved_errno == EAGAIN || saved_errno == EINTR) ? 0 : -1;
+    return result;
+}
+
+static void
+async_read (ChafaTerm *term)
+{
+    guchar buf [READ_BUF_MAX];
+    ChafaEvent *event;
+    gint len;
+
+    len = read_nonblocking (chafa_stream_reader_get_fd (term->reader), buf, READ_BUF_MAX);
+
+    if (len > 0)
+        chafa_parser_push_data (term->parser, buf, len);
+    else if (len < 0)
+        chafa_parser_push_eof (term->parser);
+
+    while ((event = chafa_parser_pop_event (term->parser)))
+    {
+        g_queue_push_head (term->event_queue, event);
+        handle_event (term, event);
+    }
+}
+
+static void
+async_write (ChafaTerm *term)
+{
+    gconstpointer data;
+    gint len;
+
+    while ((data = chafa_byte_fifo_peek (term->out_fifo, &len)) && len > 0)
+    {
+        gint n_written = write_nonblocking (chafa_stream_writer_get_fd (term->writer), data, len);
+
+        if (n_written < 0)
+        {
+            /* The terminal went away. Discard output from now on */
+            term->out_error = TRUE;
+            chafa_byte_fifo_drop (term->out_fifo, chafa_byte_fifo_get_len (term->out_fifo));
+            break;
+        }
+
+        if (n_written == 0)
+            break;
+
+        chafa_byte_fifo_drop (term->out_fifo, n_written);
+    }
+}
+
+static void
+enter_async_mode (ChafaTerm *term)
+{
+    if (term->is_async)
+        return;
+
+    /* Let the threads finish what they started, then retire them. Input
+     * that was already read is handed over to the parser. */
+
+    if (term->writer && term->out_sync_used)
+        chafa_stream_writer_flush (term->writer);
+
+    if (term->reader && term->in_sync_used)
+    {
+        gint fd = chafa_stream_reader_get_fd (term->reader);
+        guchar buf [READ_BUF_MAX];
+        gint len;
+
+        while ((len = chafa_stream_reader_read (term->reader, buf, READ_BUF_MAX)) > 0)
+            chafa_parser_push_data (term->parser, buf, len);
+
+        chafa_stream_reader_unref (term->reader);
+        term->reader = chafa_stream_reader_new_from_fd (fd);
+    }
+
+    term->out_fifo = chafa_byte_fifo_new ();
+    term->is_async = TRUE;
+}
+
+static gint
+add_pollfd (GPollFD *pollfds, gint n, gint fd, gushort events)
+{
+    gint i;
+
+    /* The input and output fds may be the same, e.g. for a socket */
+    for (i = 0; i < n; i++)
+    {
+        if (pollfds [i].fd == fd)
+        {
+            pollfds [i].events |= events;
+            return n;
+        }
+    }
+
+    pollfds [n].fd = fd;
+    pollfds [n].events = events;
+    pollfds [n].revents = 0;
+    return n + 1;
+}
+
+#else /* !G_OS_UNIX */
+
+/* We can't poll console handles like fds. Output goes through the writer
+ * thread as usual, and probes complete with failure. */
+
+static void
+enter_async_mode (G_GNUC_UNUSED ChafaTerm *term)
+{
+}
+
+#endif /* !G_OS_UNIX */
+
+static void
+begin_probe (ChafaTerm *term)
+{
+#ifdef HAVE_TERMIOS_H
+    /* Terminal must be in raw mode for response to get picked up without
+     * user interaction. */
+    term->probe_termios_changed = FALSE;
+    if (chafa_stream_reader_is_console (term->reader))
+        ensure_raw_mode_enabled (term, &term->probe_saved_termios,
+                                 &term->probe_termios_changed);
+#endif
+
+    term->probe_attempt = TRUE;
+
+    /* Terminal doesn't support any of the probe sequences */
+    if (print_multiple (term, probe_seqs) == 0)
+        term->probe_end_time_us = g_get_monotonic_time ();
+}
+
+static void
+update_probe (ChafaTerm *term)
+{
+    ChafaTermProbeFunc probe_func;
+    gpointer probe_data;
+
+    if (!term->probe_pending)
+        return;
+
+    if (!term->probe_success && !term->in_eof_seen
+        && (term->probe_end_time_us < 0
+            || g_get_monotonic_time () < term->probe_end_time_us))
+        return;
+
+#ifdef HAVE_TERMIOS_H
+    restore_termios (term, &term->probe_saved_termios, &term->probe_termios_changed);
+#endif
+
+    /* The callback may start another probe */
+    probe_func = term->probe_func;
+    probe_data = term->probe_data;
+    term->probe_pending = FALSE;
+    term->probe_func = NULL;
+    term->probe_data = NULL;
+
+    if (probe_func)
+        probe_func (term, term->probe_success, probe_data);
+}
+
+static gint
+get_probe_timeout_ms (ChafaTerm *term)
+{
+    gint64 remain_us;
+
+    if (!term->probe_pending || term->probe_end_time_us < 0)
+        return -1;
+    if (term->probe_success || term->in_eof_seen)
+        return 0;
+
+    /* Round up, so we don't wake up early and spin */
+    remain_us = term->probe_end_time_us - g_get_monotonic_time ();
+    return remain_us > 0 ? (remain_us + 999) / 1000 : 0;
+}
+
+/* --- GSource --- */
+
+#ifdef G_OS_UNIX
+
+#define TERM_SOURCE_FDS_MAX 2
+
+typedef struct
+{
+    GSource source;
+    ChafaTerm *term;
+    gint fds [TERM_SOURCE_FDS_MAX];
+    gpointer tags [TERM_SOURCE_FDS_MAX];
+    gint n_fds;
+}
+TermSource;
+
+static gboolean
+term_source_prepare (GSource *source, gint *timeout)
+{
+    TermSource *term_source = (TermSource *) source;
+    ChafaTerm *term = term_source->term;
+    GPollFD pollfds [TERM_SOURCE_FDS_MAX];
+    gint n_pollfds;
+    gint i, j;
+
+    n_pollfds = chafa_term_get_pollfds (term, pollfds, TERM_SOURCE_FDS_MAX, timeout);
+
+    /* The set of fds never changes, but which conditions we want does */
+    for (j = 0; j < term_source->n_fds; j++)
+        g_source_modify_unix_fd (source, term_source->tags [j], 0);
+
+    for (i = 0; i < n_pollfds; i++)
+    {
+        for (j = 0; j < term_source->n_fds; j++)
+        {
+            if (term_source->fds [j] == pollfds [i].fd)
+                break;
+        }
+
+        if (j == term_source->n_fds)
+        {
+            term_source->fds [j] = pollfds [i].fd;
+            term_source->tags [j] = g_source_add_unix_fd (source, pollfds [i].fd, 0);
+            term_source->n_fds++;
+        }
+
+        g_source_modify_unix_fd (source, term_source->tags [j], pollfds [i].events);
+    }
+
+    return !g_queue_is_empty (term->event_queue) || *timeout == 0;
+}
+
+static gboolean
+term_source_check (GSource *source)
+{
+    TermSource *term_source = (TermSource *) source;
+    ChafaTerm *term = term_source->term;
+    gint j;
+
+    for (j = 0; j < term_source->n_fds; j++)
+    {
+        if (g_source_query_unix_fd (source, term_source->tags [j]))
+            return TRUE;
+    }
+
+    return !g_queue_is_empty (term->event_queue) || get_probe_timeout_ms (term) == 0;
+}
+
+static gboolean
+term_source_dispatch (GSource *source, GSourceFunc callback, gpointer user_data)
+{
+    TermSource *term_source = (TermSource *) source;
+    ChafaTerm *term = term_source->term;
+    GPollFD pollfds [TERM_SOURCE_FDS_MAX];
+    gint j;
+
+    for (j = 0; j < term_source->n_fds; j++)
+    {
+        pollfds [j].fd = term_source->fds [j];
+        pollfds [j].events = 0;
+        pollfds [j].revents = g_source_query_unix_fd (source, term_source->tags [j]);
+    }
+
+    chafa_term_dispatch (term, pollfds, term_source->n_fds);
+
+    if (callback && !g_queue_is_empty (term->event_queue))
+        return callback (user_data);
+
+    return G_SOURCE_CONTINUE;
+}
+
+#else /* !G_OS_UNIX */
+
+/* There are no fds to watch, so the source only wakes up to time out
+ * probes. Those complete with failure, like other async I/O here. */
+
+typedef struct
+{
+    GSource source;
+    ChafaTerm *term;
+}
+TermSource;
+
+static gboolean
+term_source_prepare (GSource *source, gint *timeout)
+{
+    TermSource *term_source = (TermSource *) source;
+    ChafaTerm *term = term_source->term;
+
+    *timeout = get_probe_timeout_ms (term);
+    return !g_queue_is_empty (term->event_queue) || *timeout == 0;
+}
+
+static gboolean
+term_source_check (GSource *source)
+{
+    TermSource *term_source = (TermSource *) source;
+    ChafaTerm *term = term_source->term;
+
+    return !g_queue_is_empty (term->event_queue) || get_probe_timeout_ms (term) == 0;
+}
+
+static gboolean
+term_source_dispatch (GSource *source, GSourceFunc callback, gpointer user_data)
+{
+    TermSource *term_source = (TermSource *) source;
+    ChafaTerm *term = term_source->term;
+
+    chafa_term_dispatch (term, NULL, 0);
+
+    if (callback && !g_queue_is_empty (term->event_queue))
+        return callback (user_data);
+
+    return G_SOURCE_CONTINUE;
+}
+
+#endif /* !G_OS_UNIX */
+
+static GSourceFuncs term_source_funcs =
+{
+    term_source_prepare,
+    term_source_check,
+    term_source_dispatch,
+    NULL,
+    NULL,
+    NULL
+};
+
 /* --------------------- *
  * Construct and destroy *
  * --------------------- */
@@ -717,7 +1166,34 @@ chafa_term_destroy (ChafaTerm *term)
 {
     g_return_if_fail (term != NULL);
 
-    chafa_term_flush (term);
+    if (term->is_async)
+    {
+        gconstpointer data;
+        gint len;
+
+        /* Write out what's left, blocking if necessary */
+        if (term->writer && !term->out_error
+            && (data = chafa_byte_fifo_peek (term->out_fifo, &len)))
+        {
+            while (data && len > 0
+                   && write_blocking (chafa_stream_writer_get_fd (term->writer), data, len))
+            {
+                chafa_byte_fifo_drop (term->out_fifo, len);
+                data = chafa_byte_fifo_peek (term->out_fifo, &len);
+            }
+        }
+
+#ifdef HAVE_TERMIOS_H
+        if (term->probe_pending)
+            restore_termios (term, &term->probe_saved_termios, &term->probe_termios_changed);
+#endif
+
+        chafa_byte_fifo_unref (term->out_fifo);
+    }
+    else
+    {
+        chafa_term_flush (term);
+    }
 
     if (term->reader)
         chafa_stream_reader_unref (term->reader);
@@ -782,7 +1258,8 @@ chafa_term_read_event (ChafaTerm *term, guint timeout_ms)
     if (event)
         goto out;
 
-    if (term->in_eof_seen)
+    /* In async mode, events are only read in chafa_term_dispatch () */
+    if (term->in_eof_seen || term->is_async)
         goto out;
 
     event = in_sync_pull (term, timeout_ms);
@@ -798,7 +1275,7 @@ chafa_term_write (ChafaTerm *term, gconstpointer data, gint len)
     if (!term->writer)
         return;
 
-    chafa_stream_writer_write (term->writer, data, len);
+    write_out (term, data, len);
 }
 
 gint
@@ -816,7 +1293,7 @@ chafa_term_print (ChafaTerm *term, const gchar *format, ...)
     va_end (args);
 
     if (len > 0)
-        chafa_stream_writer_write (term->writer, str, len);
+        write_out (term, str, len);
 
     g_free (str);
     return len;
@@ -839,7 +1316,7 @@ chafa_term_print_seq (ChafaTerm *term, ChafaTermSeq seq, ...)
     if (str)
     {
         len = strlen (str);
-        chafa_stream_writer_write (term->writer, str, len);
+        write_out (term, str, len);
     }
 
     g_free (str);
@@ -852,6 +1329,16 @@ chafa_term_flush (ChafaTerm *term)
     if (!term->writer)
         return FALSE;
 
+#ifdef G_OS_UNIX
+    /* Never blocks in async mode; returns TRUE if everything was written */
+    if (term->is_async)
+    {
+        async_write (term);
+        return !term->out_error && chafa_byte_fifo_get_len (term->out_fifo) == 0;
+    }
+#endif
+
+    term->out_sync_used = TRUE;
     return chafa_stream_writer_flush (term->writer);
 }
 
@@ -861,7 +1348,11 @@ chafa_term_write_err (ChafaTerm *term, gconstpointer data, gint len)
     if (!term->err_writer)
         return;
 
-    chafa_stream_writer_write (term->err_writer, data, len);
+    /* Error output is rare and unbuffered; skip the thread in async mode */
+    if (term->is_async)
+        write_blocking (chafa_stream_writer_get_fd (term->err_writer), data, len);
+    else
+        chafa_stream_writer_write (term->err_writer, data, len);
 }
 
 gint
@@ -916,18 +1407,10 @@ chafa_term_sync_probe (ChafaTerm *term, gint timeout_ms)
     struct termios saved_termios;
     gboolean termios_changed = FALSE;
 #endif
-    const gint probe_seqs [] =
-    {
-        CHAFA_TERM_SEQ_QUERY_DEFAULT_FG,
-        CHAFA_TERM_SEQ_QUERY_DEFAULT_BG,
-        CHAFA_TERM_SEQ_QUERY_TEXT_AREA_SIZE_CELLS,
-        CHAFA_TERM_SEQ_QUERY_TEXT_AREA_SIZE_PX,
-        CHAFA_TERM_SEQ_QUERY_CELL_SIZE_PX,
-        CHAFA_TERM_SEQ_QUERY_PRIMARY_DEVICE_ATTRIBUTES,
-        -1
-    };
     gint n_probes = 0;
 
+    g_return_val_if_fail (!term->is_async, FALSE);
+
     if (term->probe_success)
         return TRUE;
     if (!term->interactive_supported)
@@ -994,3 +1477,135 @@ chafa_term_get_default_bg_color (ChafaTerm *term)
 {
     return term->default_bg_rgb;
 }
+
+/* Event loop integration: Calling any of the functions below switches the
+ * terminal to async mode. From then on, output is queued without limit and
+ * written when the output fd becomes writable, and input is only read when
+ * the input fd becomes readable. The caller is responsible for polling the
+ * fds returned by chafa_term_get_pollfds () and passing the results to
+ * chafa_term_dispatch (), or it can attach the source returned by
+ * chafa_term_create_source () to a GMainContext to have this done for it.
+ * No threads are used in this mode.
+ *
+ * On Windows, there are no fds to poll. Output still goes through the
+ * writer thread, and the source only serves to time out probes, which
+ * always fail there.
+ *
+ * chafa_term_read_event () never blocks in async mode, and returns NULL
+ * when there are no more events queued. chafa_term_flush () never blocks
+ * either, and returns TRUE if all output was written. */
+
+void
+chafa_term_probe_async (ChafaTerm *term, gint timeout_ms,
+                        ChafaTermProbeFunc callback, gpointer user_data)
+{
+    g_return_if_fail (term != NULL);
+    g_return_if_fail (!term->probe_pending);
+
+    enter_async_mode (term);
+
+    term->probe_func = callback;
+    term->probe_data = user_data;
+    term->probe_pending = TRUE;
+    term->probe_end_time_us = timeout_ms > 0
+        ? g_get_monotonic_time () + (gint64) timeout_ms * 1000 : -1;
+
+    /* Unlike chafa_term_sync_probe (), we don't require a tty here. The
+     * caller may be talking to the terminal over a socket. Either way, the
+     * callback is always invoked from chafa_term_dispatch (). */
+    if (term->probe_success || !term->is_async
+        || !term->reader || !term->writer || term->in_eof_seen)
+    {
+        term->probe_end_time_us = g_get_monotonic_time ();
+        return;
+    }
+
+    begin_probe (term);
+}
+
+gint
+chafa_term_get_pollfds (ChafaTerm *term, GPollFD *pollfds_out, gint n_pollfds_max,
+                        gint *timeout_ms_out)
+{
+    GPollFD pollfds [2];
+    gint n_pollfds = 0;
+    gint i;
+
+    g_return_val_if_fail (term != NULL, 0);
+    g_return_val_if_fail (n_pollfds_max == 0 || pollfds_out != NULL, 0);
+
+    enter_async_mode (term);
+
+#ifdef G_OS_UNIX
+    if (term->reader && !term->in_eof_seen)
+        n_pollfds = add_pollfd (pollfds, n_pollfds,
+                                chafa_stream_reader_get_fd (term->reader),
+                                G_IO_IN | G_IO_HUP | G_IO_ERR);
+
+    if (term->writer && chafa_byte_fifo_get_len (term->out_fifo) > 0)
+        n_pollfds = add_pollfd (pollfds, n_pollfds,
+                                chafa_stream_writer_get_fd (term->writer),
+                                G_IO_OUT | G_IO_HUP | G_IO_ERR);
+#endif
+
+    for (i = 0; i < MIN (n_pollfds, n_pollfds_max); i++)
+        pollfds_out [i] = pollfds [i];
+
+    if (timeout_ms_out)
+        *timeout_ms_out = get_probe_timeout_ms (term);
+
+    /* May be greater than n_pollfds_max, like g_main_context_query () */
+    return n_pollfds;
+}
+
+void
+chafa_term_dispatch (ChafaTerm *term, const GPollFD *pollfds, gint n_pollfds)
+{
+    gint i;
+
+    g_return_if_fail (term != NULL);
+    g_return_if_fail (n_pollfds == 0 || pollfds != NULL);
+
+    enter_async_mode (term);
+
+#ifdef G_OS_UNIX
+    for (i = 0; i < n_pollfds; i++)
+    {
+        gushort revents = pollfds [i].revents;
+
+        if (!revents)
+            continue;
+
+        if (term->reader && !term->in_eof_seen
+            && pollfds [i].fd == chafa_stream_reader_get_fd (term->reader)
+            && (revents & (G_IO_IN | G_IO_HUP | G_IO_ERR)))
+            async_read (term);
+
+        if (term->writer
+            && pollfds [i].fd == chafa_stream_writer_get_fd (term->writer)
+            && (revents & (G_IO_OUT | G_IO_HUP | G_IO_ERR)))
+            async_write (term);
+    }
+#else
+    (void) i;
+#endif
+
+    update_probe (term);
+}
+
+GSource *
+chafa_term_create_source (ChafaTerm *term)
+{
+    TermSource *term_source;
+
+    g_return_val_if_fail (term != NULL, NULL);
+
+    enter_async_mode (term);
+
+    /* The terminal must outlive the source */
+    term_source = (TermSource *) g_source_new (&term_source_funcs, sizeof (TermSource));
+    term_source->term = term;
+    g_source_set_name ((GSource *) term_source, "ChafaTerm");
+
+    return (GSource *) term_source;
+}
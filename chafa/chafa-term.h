@@ -31,6 +31,8 @@ G_BEGIN_DECLS
 
 typedef struct ChafaTerm ChafaTerm;
 
+typedef void (*ChafaTermProbeFunc) (ChafaTerm *term, gboolean success, gpointer user_data);
+
 CHAFA_AVAILABLE_IN_1_20
 ChafaTerm *chafa_term_new (ChafaTermInfo *term_info, gint in_fd, gint out_fd, gint err_fd);
 CHAFA_AVAILABLE_IN_1_20
@@ -80,6 +82,17 @@ gint32 chafa_term_get_default_fg_color (ChafaTerm *term);
 CHAFA_AVAILABLE_IN_1_20
 gint32 chafa_term_get_default_bg_color (ChafaTerm *term);
 
+CHAFA_AVAILABLE_IN_1_20
+void chafa_term_probe_async (ChafaTerm *term, gint timeout_ms,
+                             ChafaTermProbeFunc callback, gpointer user_data);
+CHAFA_AVAILABLE_IN_1_20
+gint chafa_term_get_pollfds (ChafaTerm *term, GPollFD *pollfds_out, gint n_pollfds_max,
+                             gint *timeout_ms_out);
+CHAFA_AVAILABLE_IN_1_20
+void chafa_term_dispatch (ChafaTerm *term, const GPollFD *pollfds, gint n_pollfds);
+CHAFA_AVAILABLE_IN_1_20
+GSource *chafa_term_create_source (ChafaTerm *term);
+
 G_END_DECLS
 
 #endif /* __CHAFA_TERM_H__ */
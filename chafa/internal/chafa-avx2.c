@@ -163,3 +163,55 @@ chafa_color_accum_div_scalar_avx2 (ChafaColorAccum *accum, guint16 divisor)
     accum_u64 = extract_128_epi64 (accum_128, 0);
     memcpy (accum, &accum_u64, sizeof (guint64));
 }
+
+/* Like chafa_find_nearest_color_sse41 (), but n must be a multiple of 16 */
+gint
+chafa_find_nearest_color_avx2 (const gint16 *ch0, const gint16 *ch1, const gint16 *ch2,
+                               gint n, guint32 color)
+{
+    __m256i want0, want1, want2, zero, step;
+    __m256i best_256, idx_lo, idx_hi;
+    __m128i best;
+    gint i;
+
+    want0 = _mm256_set1_epi16 (color & 0xff);
+    want1 = _mm256_set1_epi16 ((color >> 8) & 0xff);
+    want2 = _mm256_set1_epi16 ((color >> 16) & 0xff);
+    zero = _mm256_setzero_si256 ();
+    step = _mm256_set1_epi32 (16);
+
+    /* Unpacking works within each 128-bit lane, so the low and high halves
+     * get entries from both lanes. */
+    best_256 = _mm256_set1_epi32 (G_MAXINT32);
+    idx_lo = _mm256_setr_epi32 (0, 1, 2, 3, 8, 9, 10, 11);
+    idx_hi = _mm256_setr_epi32 (4, 5, 6, 7, 12, 13, 14, 15);
+
+    for (i = 0; i < n; i += 16)
+    {
+        __m256i d0, d1, d2, t, u, dist;
+
+        d0 = _mm256_sub_epi16 (_mm256_loadu_si256 ((const __m256i *) (ch0 + i)), want0);
+        d1 = _mm256_sub_epi16 (_mm256_loadu_si256 ((const __m256i *) (ch1 + i)), want1);
+        d2 = _mm256_sub_epi16 (_mm256_loadu_si256 ((const __m256i *) (ch2 + i)), want2);
+
+        t = _mm256_unpacklo_epi16 (d0, d1);
+        u = _mm256_unpacklo_epi16 (d2, zero);
+        dist = _mm256_add_epi32 (_mm256_madd_epi16 (t, t), _mm256_madd_epi16 (u, u));
+        best_256 = _mm256_min_epi32 (best_256, _mm256_or_si256 (_mm256_slli_epi32 (dist, 8), idx_lo));
+
+        t = _mm256_unpackhi_epi16 (d0, d1);
+        u = _mm256_unpackhi_epi16 (d2, zero);
+        dist = _mm256_add_epi32 (_mm256_madd_epi16 (t, t), _mm256_madd_epi16 (u, u));
+        best_256 = _mm256_min_epi32 (best_256, _mm256_or_si256 (_mm256_slli_epi32 (dist, 8), idx_hi));
+
+        idx_lo = _mm256_add_epi32 (idx_lo, step);
+        idx_hi = _mm256_add_epi32 (idx_hi, step);
+    }
+
+    best = _mm_min_epi32 (_mm256_extracti128_si256 (best_256, 0),
+                          _mm256_extracti128_si256 (best_256, 1));
+    best = _mm_min_epi32 (best, _mm_shuffle_epi32 (best, _MM_SHUFFLE (1, 0, 3, 2)));
+    best = _mm_min_epi32 (best, _mm_shuffle_epi32 (best, _MM_SHUFFLE (2, 3, 0, 1)));
+
+    return _mm_cvtsi128_si32 (best) & 0xff;
+}
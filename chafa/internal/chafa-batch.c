@@ -22,8 +22,69 @@
 #include <string.h>
 #include <glib.h>
 
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+# include <pthread.h>
+# include <sched.h>
+#endif
+
 #include "chafa.h"
 #include "internal/chafa-batch.h"
+#include "internal/chafa-private.h"
+
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+
+/* When a thread affinity policy is set, batches go to a persistent set of
+ * workers that are pinned to CPUs. There is one worker per thread, and
+ * batch N always goes to worker N modulo the number of workers, so the same
+ * rows end up on the same core from one call to the next. The workers bound
+ * the concurrency themselves, so they don't draw on the global thread count.
+ *
+ * The set is replaced when the policy or thread count changes, and shut
+ * down when the policy goes back to none or the library is unloaded. Each
+ * call holds a reference to the set it's using, so a set that's been
+ * replaced lives on until the calls using it are done. */
+
+typedef struct
+{
+    GFunc batch_func;
+    gpointer ctx;
+    gint n_pending;
+    GMutex mutex;
+    GCond cond;
+}
+PinnedJob;
+
+typedef struct
+{
+    PinnedJob *job;
+    ChafaBatchInfo *batch;
+}
+PinnedTask;
+
+typedef struct
+{
+    GAsyncQueue *queue;
+    GThread *thread;
+    gint index;
+}
+PinnedWorker;
+
+typedef struct
+{
+    PinnedWorker *workers;
+    gint n_workers;
+    gint generation;
+    gint refs;
+}
+PinnedWorkerSet;
+
+G_LOCK_DEFINE_STATIC (pinned_workers);
+static PinnedWorkerSet *pinned_workers;
+
+/* Pushed to a worker's queue to make it exit */
+static PinnedTask quit_task;
+
+#endif
 
 static gint chafa_batch_n_threads_global;
 
@@ -73,10 +134,169 @@ deallocate_threads (gint n_threads)
     g_atomic_int_add (&chafa_batch_n_threads_global, -n_threads);
 }
 
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+
+static void
+pin_worker (PinnedWorker *worker)
+{
+    cpu_set_t set;
+    gint cpu;
+
+    cpu = chafa_get_thread_affinity_cpu (worker->index, NULL);
+    if (cpu < 0)
+        return;
+
+    /* If the CPU isn't available, we keep running wherever we are */
+    CPU_ZERO (&set);
+    CPU_SET (cpu, &set);
+    pthread_setaffinity_np (pthread_self (), sizeof (set), &set);
+}
+
+static gpointer
+pinned_worker_thread (gpointer data)
+{
+    PinnedWorker *worker = data;
+
+    pin_worker (worker);
+
+    for (;;)
+    {
+        PinnedTask *task = g_async_queue_pop (worker->queue);
+        PinnedJob *job;
+
+        if (task == &quit_task)
+            break;
+
+        job = task->job;
+        job->batch_func (task->batch, job->ctx);
+
+        g_mutex_lock (&job->mutex);
+        if (--job->n_pending == 0)
+            g_cond_signal (&job->cond);
+        g_mutex_unlock (&job->mutex);
+    }
+
+    return NULL;
+}
+
+static PinnedWorkerSet *
+worker_set_new (gint n_workers, gint generation)
+{
+    PinnedWorkerSet *worker_set;
+    gint i;
+
+    worker_set = g_new0 (PinnedWorkerSet, 1);
+    worker_set->workers = g_new0 (PinnedWorker, n_workers);
+    worker_set->n_workers = n_workers;
+    worker_set->generation = generation;
+    worker_set->refs = 1;
+
+    for (i = 0; i < n_workers; i++)
+    {
+        PinnedWorker *worker = &worker_set->workers [i];
+
+        worker->queue = g_async_queue_new ();
+        worker->index = i;
+        worker->thread = g_thread_new ("chafa-worker", pinned_worker_thread, worker);
+    }
+
+    return worker_set;
+}
+
+/* Any tasks still queued are finished before the workers see the quit task */
+static void
+worker_set_unref (PinnedWorkerSet *worker_set)
+{
+    gint i;
+
+    if (!worker_set || !g_atomic_int_dec_and_test (&worker_set->refs))
+        return;
+
+    for (i = 0; i < worker_set->n_workers; i++)
+        g_async_queue_push (worker_set->workers [i].queue, &quit_task);
+
+    for (i = 0; i < worker_set->n_workers; i++)
+    {
+        g_thread_join (worker_set->workers [i].thread);
+        g_async_queue_unref (worker_set->workers [i].queue);
+    }
+
+    g_free (worker_set->workers);
+    g_free (worker_set);
+}
+
+/* Returns a reference to the current worker set, replacing it first if it
+ * was made for a different policy or thread count */
+static PinnedWorkerSet *
+get_worker_set (gint n_workers)
+{
+    PinnedWorkerSet *old_set = NULL;
+    PinnedWorkerSet *worker_set;
+    gint generation;
+
+    G_LOCK (pinned_workers);
+
+    chafa_get_thread_affinity_cpu (0, &generation);
+
+    if (pinned_workers
+        && (pinned_workers->generation != generation
+            || pinned_workers->n_workers != n_workers))
+    {
+        old_set = pinned_workers;
+        pinned_workers = NULL;
+    }
+
+    if (!pinned_workers)
+        pinned_workers = worker_set_new (n_workers, generation);
+
+    worker_set = pinned_workers;
+    g_atomic_int_inc (&worker_set->refs);
+
+    G_UNLOCK (pinned_workers);
+
+    worker_set_unref (old_set);
+    return worker_set;
+}
+
+#endif
+
+/* Shuts down the pinned workers, if any. Calls in progress keep the
+ * workers they're using until they finish. */
+void
+chafa_batch_reset_workers (void)
+{
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+    PinnedWorkerSet *worker_set;
+
+    G_LOCK (pinned_workers);
+    worker_set = pinned_workers;
+    pinned_workers = NULL;
+    G_UNLOCK (pinned_workers);
+
+    worker_set_unref (worker_set);
+#endif
+}
+
+#if defined (HAVE_PTHREAD_SETAFFINITY_NP) && defined (__GNUC__)
+
+__attribute__ ((destructor)) static void
+shut_down_workers (void)
+{
+    chafa_batch_reset_workers ();
+}
+
+#endif
+
 void
 chafa_process_batches (gpointer ctx, GFunc batch_func, GFunc post_func, gint n_rows, gint n_batches, gint batch_unit)
 {
     GThreadPool *thread_pool = NULL;
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+    PinnedWorkerSet *worker_set = NULL;
+    PinnedJob job;
+    PinnedTask *tasks = NULL;
+#endif
+    gboolean use_pinned = FALSE;
     ChafaBatchInfo *batches;
     gint max_threads;
     gint n_threads;
@@ -93,7 +313,22 @@ chafa_process_batches (gpointer ctx, GFunc batch_func, GFunc post_func, gint n_r
         return;
 
     max_threads = chafa_get_n_actual_threads ();
-    n_threads = allocate_threads (max_threads, n_batches);
+
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+    if (max_threads >= 2 && chafa_get_thread_affinity_policy () != CHAFA_THREAD_AFFINITY_NONE)
+    {
+        use_pinned = TRUE;
+        worker_set = get_worker_set (max_threads);
+        job.batch_func = batch_func;
+        job.ctx = ctx;
+        job.n_pending = 0;
+        g_mutex_init (&job.mutex);
+        g_cond_init (&job.cond);
+        tasks = g_new (PinnedTask, n_batches);
+    }
+#endif
+
+    n_threads = use_pinned ? 0 : allocate_threads (max_threads, n_batches);
 
     n_units = (n_rows + batch_unit - 1) / batch_unit;
     units_per_batch = (gfloat) n_units / (gfloat) n_batches;
@@ -101,7 +336,7 @@ chafa_process_batches (gpointer ctx, GFunc batch_func, GFunc post_func, gint n_r
 
     batches = g_new0 (ChafaBatchInfo, n_batches);
 
-    if (n_threads >= 2)
+    if (n_threads >= 2 && !use_pinned)
     {
         thread_pool = g_thread_pool_new (batch_func,
                                          (gpointer) ctx,
@@ -147,7 +382,22 @@ chafa_process_batches (gpointer ctx, GFunc batch_func, GFunc post_func, gint n_r
         g_printerr ("Batch %d: %04d rows\n", i, batch->n_rows);
 #endif
 
-        if (n_threads >= 2)
+        if (use_pinned)
+        {
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+            PinnedTask *task = &tasks [i - 1];
+
+            task->job = &job;
+            task->batch = batch;
+
+            g_mutex_lock (&job.mutex);
+            job.n_pending++;
+            g_mutex_unlock (&job.mutex);
+
+            g_async_queue_push (worker_set->workers [(i - 1) % worker_set->n_workers].queue, task);
+#endif
+        }
+        else if (n_threads >= 2)
         {
             g_thread_pool_push (thread_pool, batch, NULL);
         }
@@ -159,7 +409,21 @@ chafa_process_batches (gpointer ctx, GFunc batch_func, GFunc post_func, gint n_r
         unit_ofs [0] = unit_ofs [1];
     }
 
-    if (n_threads >= 2)
+    if (use_pinned)
+    {
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+        g_mutex_lock (&job.mutex);
+        while (job.n_pending > 0)
+            g_cond_wait (&job.cond, &job.mutex);
+        g_mutex_unlock (&job.mutex);
+
+        g_mutex_clear (&job.mutex);
+        g_cond_clear (&job.cond);
+        g_free (tasks);
+        worker_set_unref (worker_set);
+#endif
+    }
+    else if (n_threads >= 2)
     {
         /* Wait for threads to finish */
         g_thread_pool_free (thread_pool, FALSE, TRUE);
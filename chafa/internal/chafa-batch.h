@@ -36,6 +36,7 @@ ChafaBatchInfo;
 
 void chafa_process_batches (gpointer ctx, GFunc batch_func, GFunc post_func,
                             gint n_rows, gint n_batches, gint batch_unit);
+void chafa_batch_reset_workers (void);
 
 G_END_DECLS
 
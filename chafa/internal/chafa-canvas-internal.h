@@ -24,6 +24,8 @@
 #include "chafa.h"
 #include "internal/chafa-private.h"
 #include "internal/chafa-pixops.h"
+#include "internal/chafa-viewport.h"
+#include "internal/chafa-work-cell.h"
 
 G_BEGIN_DECLS
 
@@ -36,6 +38,24 @@ struct ChafaCanvasCell
     guint32 bg_color;
 };
 
+/* Symbol usage recorded over successive draws, for adaptive symbol search.
+ * Index 0 is for narrow symbols, index 1 for wide ones. */
+typedef struct
+{
+    gint n_frames;
+
+    /* Whether the current frame searches the hot symbols only */
+    guint use_hot : 1;
+
+    /* Number of times each symbol was picked, halved on every refresh */
+    guint32 *counts [2];
+
+    /* Indexes of symbols with nonzero counts, in symbol map order */
+    gint *hot [2];
+    gint n_hot [2];
+}
+ChafaSymbolUsage;
+
 struct ChafaCanvas
 {
     gint refs;
@@ -43,6 +63,10 @@ struct ChafaCanvas
     gint width_pixels, height_pixels;
     ChafaPixel *pixels;
     ChafaCanvasCell *cells;
+
+    /* Maximum alpha of each cell's pixels. Only valid while pixels is. */
+    guint8 *cell_max_alpha;
+
     guint have_alpha : 1;
     guint needs_clear : 1;
 
@@ -56,9 +80,25 @@ struct ChafaCanvas
      * yields better results in palettized modes, especially 16/8) */
     guint use_quantized_error : 1;
 
+    /* Whether to pick each symbol's pens from the palette directly,
+     * minimizing the quantized error, instead of quantizing its mean
+     * colors (small fixed palettes and the exhaustive search only) */
+    guint use_pen_pair_search : 1;
+
+    /* Whether to skip the symbol search for cells that are entirely below
+     * the alpha threshold; FALSE if using FG only, since the symbol is then
+     * drawn regardless */
+    guint cull_transparent_cells : 1;
+
     ChafaColorPair default_colors;
     guint work_factor_int;
 
+    /* Pen colors for the pen pair search, in the canvas color space, and
+     * their squared norms. The BG pens are the first n_pens [BG] FG pens. */
+    ChafaColor pens [CHAFA_WORK_CELL_N_PENS_MAX];
+    gint pen_norms [CHAFA_WORK_CELL_N_PENS_MAX];
+    gint n_pens [2];
+
     /* Character to use in cells where fg color == bg color. Typically
      * space, but could be something else depending on the symbol map. */
     gunichar blank_char;
@@ -82,6 +122,13 @@ struct ChafaCanvas
      * canvas. In this case, it is stored here. */
     ChafaPlacement *placement;
 
+    /* Tile cache for panning over a zoomed image. NULL unless a viewport
+     * source has been set. */
+    ChafaViewport *viewport;
+
+    /* Persists across draws. Only used if adaptive symbols are enabled. */
+    ChafaSymbolUsage symbol_usage;
+
     /* Our palettes. Kind of a big structure, so they go last. */
     ChafaPalette fg_palette;
     ChafaPalette bg_palette;
@@ -37,6 +37,14 @@ typedef struct
     /* For direct-color mode */
     ChafaColor cur_fg_direct;
     ChafaColor cur_bg_direct;
+
+    /* Lossy color merging. Colors closer than the threshold to the ones
+     * in effect will be replaced by the latter. Symbols may be swapped for
+     * their inverses (gunichar -> gunichar) if that lets us keep the current
+     * colors. */
+    guint merge_colors : 1;
+    gint merge_dist_sq;
+    GHashTable *inverse_chars;
 }
 PrintCtx;
 
@@ -53,6 +61,178 @@ threshold_alpha (ChafaColor col, gint alpha_threshold)
     return col;
 }
 
+static void
+init_color_merging (PrintCtx *ctx)
+{
+    ChafaCanvas *canvas = ctx->canvas;
+    const ChafaSymbolMap *symbol_map = &canvas->config.symbol_map;
+    GHashTable *bitmap_to_char;
+    gfloat max_dist;
+    gint i;
+
+    /* Without attribute reuse, every cell gets its own SGR sequence anyway */
+    if (canvas->config.color_merge_threshold <= 0.0f
+        || !(canvas->config.optimizations & CHAFA_OPTIMIZATION_REUSE_ATTRIBUTES))
+        return;
+
+    /* The 16- and 8-color palettes are too coarse for this to make sense */
+    if (canvas->config.canvas_mode != CHAFA_CANVAS_MODE_TRUECOLOR
+        && canvas->config.canvas_mode != CHAFA_CANVAS_MODE_INDEXED_256
+        && canvas->config.canvas_mode != CHAFA_CANVAS_MODE_INDEXED_240)
+        return;
+
+    max_dist = canvas->config.color_merge_threshold * 255.0f;
+    ctx->merge_colors = TRUE;
+    ctx->merge_dist_sq = max_dist * max_dist;
+
+    /* The background isn't ours to set in FG-only mode, so we can't swap */
+    if (canvas->config.fg_only_enabled)
+        return;
+
+    bitmap_to_char = g_hash_table_new (g_int64_hash, g_int64_equal);
+    ctx->inverse_chars = g_hash_table_new (NULL, NULL);
+
+    for (i = 0; i < symbol_map->n_symbols; i++)
+    {
+        g_hash_table_insert (bitmap_to_char, &symbol_map->symbols [i].bitmap,
+                             GUINT_TO_POINTER (symbol_map->symbols [i].c));
+    }
+
+    for (i = 0; i < symbol_map->n_symbols; i++)
+    {
+        guint64 inverse_bitmap = ~symbol_map->symbols [i].bitmap;
+        gpointer inverse_char;
+
+        inverse_char = g_hash_table_lookup (bitmap_to_char, &inverse_bitmap);
+        if (inverse_char)
+            g_hash_table_insert (ctx->inverse_chars,
+                                 GUINT_TO_POINTER (symbol_map->symbols [i].c),
+                                 inverse_char);
+    }
+
+    g_hash_table_destroy (bitmap_to_char);
+}
+
+static void
+deinit_color_merging (PrintCtx *ctx)
+{
+    if (ctx->inverse_chars)
+        g_hash_table_destroy (ctx->inverse_chars);
+}
+
+static gboolean
+colors_are_near (PrintCtx *ctx, const ChafaColor *a, const ChafaColor *b)
+{
+    return chafa_color_diff_fast (a, b) <= ctx->merge_dist_sq;
+}
+
+/* Decides whether to print a cell's symbol inverted, with swapped colors.
+ * Returns the inverse symbol if doing so will match more of the colors in
+ * effect, and 0 otherwise. */
+static gunichar
+pick_inverse_char (PrintCtx *ctx, gunichar c,
+                   const ChafaColor *fg, const ChafaColor *bg,
+                   const ChafaColor *cur_fg, const ChafaColor *cur_bg)
+{
+    gint n_near, n_near_swapped;
+
+    if (!ctx->inverse_chars)
+        return 0;
+
+    n_near = (colors_are_near (ctx, fg, cur_fg) ? 1 : 0)
+        + (colors_are_near (ctx, bg, cur_bg) ? 1 : 0);
+    n_near_swapped = (colors_are_near (ctx, bg, cur_fg) ? 1 : 0)
+        + (colors_are_near (ctx, fg, cur_bg) ? 1 : 0);
+
+    if (n_near_swapped <= n_near)
+        return 0;
+
+    return GPOINTER_TO_UINT (g_hash_table_lookup (ctx->inverse_chars, GUINT_TO_POINTER (c)));
+}
+
+static gunichar
+merge_colors_direct (PrintCtx *ctx, gunichar c, ChafaColor *fg, ChafaColor *bg)
+{
+    gboolean have_fg, have_bg;
+
+    /* A pending inversion will be reset anyway */
+    if (ctx->cur_inverted)
+        return c;
+
+    have_fg = fg->ch [3] != 0 && ctx->cur_fg_direct.ch [3] != 0;
+    have_bg = bg->ch [3] != 0 && ctx->cur_bg_direct.ch [3] != 0;
+
+    if (have_fg && have_bg)
+    {
+        gunichar inverse_c = pick_inverse_char (ctx, c, fg, bg,
+                                                &ctx->cur_fg_direct, &ctx->cur_bg_direct);
+        if (inverse_c)
+        {
+            ChafaColor t = *fg;
+
+            *fg = *bg;
+            *bg = t;
+            c = inverse_c;
+        }
+    }
+
+    if (have_fg && colors_are_near (ctx, fg, &ctx->cur_fg_direct))
+        *fg = ctx->cur_fg_direct;
+    if (have_bg && colors_are_near (ctx, bg, &ctx->cur_bg_direct))
+        *bg = ctx->cur_bg_direct;
+
+    return c;
+}
+
+static const ChafaColor *
+get_merge_color_256 (PrintCtx *ctx, guint32 index)
+{
+    /* Transparency and default colors can't be merged */
+    if (index > 255)
+        return NULL;
+
+    return chafa_palette_get_color (&ctx->canvas->fg_palette,
+                                    ctx->canvas->config.color_space, index);
+}
+
+static gunichar
+merge_colors_256 (PrintCtx *ctx, gunichar c, guint32 *fg, guint32 *bg)
+{
+    const ChafaColor *fg_col, *bg_col, *cur_fg_col, *cur_bg_col;
+
+    if (ctx->cur_inverted)
+        return c;
+
+    fg_col = get_merge_color_256 (ctx, *fg);
+    bg_col = get_merge_color_256 (ctx, *bg);
+    cur_fg_col = get_merge_color_256 (ctx, ctx->cur_fg);
+    cur_bg_col = get_merge_color_256 (ctx, ctx->cur_bg);
+
+    if (fg_col && bg_col && cur_fg_col && cur_bg_col)
+    {
+        gunichar inverse_c = pick_inverse_char (ctx, c, fg_col, bg_col,
+                                                cur_fg_col, cur_bg_col);
+        if (inverse_c)
+        {
+            const ChafaColor *t_col = fg_col;
+            guint32 t = *fg;
+
+            *fg = *bg;
+            *bg = t;
+            fg_col = bg_col;
+            bg_col = t_col;
+            c = inverse_c;
+        }
+    }
+
+    if (fg_col && cur_fg_col && colors_are_near (ctx, fg_col, cur_fg_col))
+        *fg = ctx->cur_fg;
+    if (bg_col && cur_bg_col && colors_are_near (ctx, bg_col, cur_bg_col))
+        *bg = ctx->cur_bg;
+
+    return c;
+}
+
 G_GNUC_WARN_UNUSED_RESULT static gchar *
 flush_chars (PrintCtx *ctx, gchar *out)
 {
@@ -221,9 +401,10 @@ emit_ansi_truecolor (PrintCtx *ctx, gchar *out, gint i, gint i_max)
     {
         ChafaCanvasCell *cell = &ctx->canvas->cells [i];
         ChafaColor fg, bg;
+        gunichar c = cell->c;
 
         /* Wide symbols have a zero code point in the rightmost cell */
-        if (cell->c == 0)
+        if (c == 0)
             continue;
 
         chafa_unpack_color (cell->fg_color, &fg);
@@ -231,6 +412,9 @@ emit_ansi_truecolor (PrintCtx *ctx, gchar *out, gint i, gint i_max)
         chafa_unpack_color (cell->bg_color, &bg);
         bg = threshold_alpha (bg, ctx->canvas->config.alpha_threshold);
 
+        if (ctx->merge_colors)
+            c = merge_colors_direct (ctx, c, &fg, &bg);
+
         if (fg.ch [3] == 0 && bg.ch [3] != 0)
             out = emit_attributes_truecolor (ctx, out, bg, fg, TRUE);
         else
@@ -244,7 +428,7 @@ emit_ansi_truecolor (PrintCtx *ctx, gchar *out, gint i, gint i_max)
         }
         else
         {
-            out = queue_char (ctx, out, cell->c);
+            out = queue_char (ctx, out, c);
         }
     }
 
@@ -349,14 +533,18 @@ emit_ansi_256 (PrintCtx *ctx, gchar *out, gint i, gint i_max)
     {
         ChafaCanvasCell *cell = &ctx->canvas->cells [i];
         guint32 fg, bg;
+        gunichar c = cell->c;
 
         /* Wide symbols have a zero code point in the rightmost cell */
-        if (cell->c == 0)
+        if (c == 0)
             continue;
 
         fg = cell->fg_color;
         bg = cell->bg_color;
 
+        if (ctx->merge_colors)
+            c = merge_colors_256 (ctx, c, &fg, &bg);
+
         if (fg == CHAFA_PALETTE_INDEX_TRANSPARENT && bg != CHAFA_PALETTE_INDEX_TRANSPARENT)
             out = emit_attributes_256 (ctx, out, bg, fg, TRUE);
         else
@@ -370,7 +558,7 @@ emit_ansi_256 (PrintCtx *ctx, gchar *out, gint i, gint i_max)
         }
         else
         {
-            out = queue_char (ctx, out, cell->c);
+            out = queue_char (ctx, out, c);
         }
     }
 
@@ -740,6 +928,7 @@ build_ansi_gstring (ChafaCanvas *canvas, ChafaTermInfo *ti)
 
     ctx.canvas = canvas;
     ctx.term_info = ti;
+    init_color_merging (&ctx);
 
     for (i = 0; i < canvas->config.height; i++)
     {
@@ -759,6 +948,7 @@ build_ansi_gstring (ChafaCanvas *canvas, ChafaTermInfo *ti)
         gs->len = out - gs->str;
     }
 
+    deinit_color_merging (&ctx);
     return gs;
 }
 
@@ -772,6 +962,7 @@ build_ansi_gstring_array (ChafaCanvas *canvas, ChafaTermInfo *ti,
 
     ctx.canvas = canvas;
     ctx.term_info = ti;
+    init_color_merging (&ctx);
 
     array = g_new (GString *, canvas->config.height + 1);
 
@@ -793,6 +984,8 @@ build_ansi_gstring_array (ChafaCanvas *canvas, ChafaTermInfo *ti,
     array [canvas->config.height] = NULL;
     *array_out = array;
 
+    deinit_color_merging (&ctx);
+
     if (array_len_out)
         *array_len_out = canvas->config.height;
 }
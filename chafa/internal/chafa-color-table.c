@@ -27,6 +27,7 @@
 
 #include "internal/chafa-color-table.h"
 #include "internal/chafa-pca.h"
+#include "internal/chafa-private.h"
 
 #define CHAFA_COLOR_TABLE_ENABLE_PROFILING 0
 #define DEBUG_PEN_CHOICE(x)
@@ -39,6 +40,16 @@
 #define FIXED_MUL 32
 #define FIXED_MUL_F ((gfloat) (FIXED_MUL))
 
+/* Palettes up to these sizes are searched exhaustively when SIMD is
+ * available. This is exact, and faster than the PCA search. Past 128
+ * entries, SSE 4.1 is only marginally faster than PCA. */
+#define SSE41_SEARCH_MAX_ENTRIES 128
+#define AVX2_SEARCH_MAX_ENTRIES CHAFA_COLOR_TABLE_MAX_ENTRIES
+
+/* Channel value for SoA padding. Its distance to any real color is larger
+ * than the largest real distance, and the sum of squares fits in 32 bits. */
+#define SOA_PADDING 1024
+
 #if CHAFA_COLOR_TABLE_ENABLE_PROFILING
 
 # define profile_counter_inc(x) g_atomic_int_inc ((gint *) &(x))
@@ -238,10 +249,38 @@ refine_pen_choice (const ChafaColorTable *color_table, guint want_color, const g
     return TRUE;
 }
 
+static void
+gen_soa (ChafaColorTable *color_table)
+{
+    gint i;
+
+    color_table->n_soa = ((color_table->n_entries + CHAFA_COLOR_TABLE_SOA_ALIGN - 1)
+                          / CHAFA_COLOR_TABLE_SOA_ALIGN) * CHAFA_COLOR_TABLE_SOA_ALIGN;
+
+    for (i = 0; i < color_table->n_soa; i++)
+    {
+        if (i < color_table->n_entries)
+        {
+            guint32 col = color_table->pens [color_table->entries [i].pen];
+
+            color_table->soa [0] [i] = col & 0xff;
+            color_table->soa [1] [i] = (col >> 8) & 0xff;
+            color_table->soa [2] [i] = (col >> 16) & 0xff;
+        }
+        else
+        {
+            color_table->soa [0] [i] = SOA_PADDING;
+            color_table->soa [1] [i] = SOA_PADDING;
+            color_table->soa [2] [i] = SOA_PADDING;
+        }
+    }
+}
+
 void
 chafa_color_table_init (ChafaColorTable *color_table)
 {
     color_table->n_entries = 0;
+    color_table->n_soa = 0;
     color_table->is_sorted = TRUE;
 
     memset (color_table->pens, 0xff, sizeof (color_table->pens));
@@ -309,11 +348,14 @@ chafa_color_table_sort (ChafaColorTable *color_table)
     do_pca (color_table);
 
     qsort (color_table->entries, color_table->n_entries, sizeof (ChafaColorTableEntry), compare_entries);
+    gen_soa (color_table);
     color_table->is_sorted = TRUE;
 }
 
+/* Approximate search. Projects the color onto the palette's two principal
+ * components and scans outwards from the closest entry along the first. */
 gint
-chafa_color_table_find_nearest_pen (const ChafaColorTable *color_table, guint32 want_color)
+chafa_color_table_find_nearest_pen_pca (const ChafaColorTable *color_table, guint32 want_color)
 {
     gint64 best_diff = G_MAXINT64;
     gint best_pen = 0;
@@ -342,7 +384,8 @@ chafa_color_table_find_nearest_pen (const ChafaColorTable *color_table, guint32
             j = n;
     }
 
-    m = j;
+    /* The color may project past the last entry */
+    m = MIN (j, color_table->n_entries - 1);
 
     /* Left scan for closer match */
 
@@ -388,3 +431,52 @@ chafa_color_table_find_nearest_pen (const ChafaColorTable *color_table, guint32
 
     return color_table->entries [best_pen].pen;
 }
+
+/* Whether chafa_color_table_find_nearest_pen () uses the exhaustive search,
+ * and so always finds a closest pen. Otherwise it falls back to PCA. */
+gboolean
+chafa_color_table_have_exact_search (const ChafaColorTable *color_table)
+{
+#ifdef HAVE_AVX2_INTRINSICS
+    if (color_table->n_entries <= AVX2_SEARCH_MAX_ENTRIES && chafa_have_avx2 ())
+        return TRUE;
+#endif
+
+#ifdef HAVE_SSE41_INTRINSICS
+    if (color_table->n_entries <= SSE41_SEARCH_MAX_ENTRIES && chafa_have_sse41 ())
+        return TRUE;
+#endif
+
+    return FALSE;
+}
+
+gint
+chafa_color_table_find_nearest_pen (const ChafaColorTable *color_table, guint32 want_color)
+{
+    g_assert (color_table->n_entries > 0);
+    g_assert (color_table->is_sorted);
+
+#ifdef HAVE_AVX2_INTRINSICS
+    if (color_table->n_entries <= AVX2_SEARCH_MAX_ENTRIES && chafa_have_avx2 ())
+    {
+        return color_table->entries [chafa_find_nearest_color_avx2 (color_table->soa [0],
+                                                                    color_table->soa [1],
+                                                                    color_table->soa [2],
+                                                                    color_table->n_soa,
+                                                                    want_color)].pen;
+    }
+#endif
+
+#ifdef HAVE_SSE41_INTRINSICS
+    if (color_table->n_entries <= SSE41_SEARCH_MAX_ENTRIES && chafa_have_sse41 ())
+    {
+        return color_table->entries [chafa_find_nearest_color_sse41 (color_table->soa [0],
+                                                                     color_table->soa [1],
+                                                                     color_table->soa [2],
+                                                                     color_table->n_soa,
+                                                                     want_color)].pen;
+    }
+#endif
+
+    return chafa_color_table_find_nearest_pen_pca (color_table, want_color);
+}
@@ -25,6 +25,7 @@
 G_BEGIN_DECLS
 
 #define CHAFA_COLOR_TABLE_MAX_ENTRIES 256
+#define CHAFA_COLOR_TABLE_SOA_ALIGN 16
 
 typedef struct
 {
@@ -47,6 +48,12 @@ typedef struct
     ChafaVec3i32 average;
 
     gint eigen_mul [2];
+
+    /* Channels of the sorted entries as separate planes, for the vectorized
+     * brute-force search. Padded to a multiple of CHAFA_COLOR_TABLE_SOA_ALIGN
+     * with colors that are further away than any real one. */
+    gint16 soa [3] [CHAFA_COLOR_TABLE_MAX_ENTRIES];
+    gint n_soa;
 }
 ChafaColorTable;
 
@@ -57,7 +64,9 @@ guint32    chafa_color_table_get_pen_color    (const ChafaColorTable *color_tabl
 void       chafa_color_table_set_pen_color    (ChafaColorTable *color_table, gint pen, guint32 color);
 
 void       chafa_color_table_sort             (ChafaColorTable *color_table);
+gboolean   chafa_color_table_have_exact_search (const ChafaColorTable *color_table);
 gint       chafa_color_table_find_nearest_pen (const ChafaColorTable *color_table, guint32 color);
+gint       chafa_color_table_find_nearest_pen_pca (const ChafaColorTable *color_table, guint32 color);
 
 G_END_DECLS
 
@@ -543,3 +543,160 @@ chafa_indexed_image_draw_pixels (ChafaIndexedImage *indexed_image,
     smol_scale_destroy (ctx.scale_ctx);
     g_free (ctx.scaled_data);
 }
+
+/* Finds the palette entries the source uses, and gives each of them a pen,
+ * with the pixels outside the placement using entry n_src_colors. Returns
+ * FALSE if there aren't enough pens, or an index is out of range. */
+static gboolean
+map_src_colors (ChafaIndexedImage *indexed_image, ChafaColorSpace color_space,
+                const guint8 *src_indices, const guint32 *src_colors, gint n_src_colors,
+                gint src_width, gint src_height, gint src_rowstride,
+                gboolean have_padding, guint8 *map_out)
+{
+    ChafaPalette *palette = &indexed_image->palette;
+    ChafaColor pens [256];
+    ChafaColor bg;
+    gboolean used [257] = { FALSE };
+    gint n_pens = 0;
+    gint i, x, y;
+
+    for (y = 0; y < src_height; y++)
+    {
+        const guint8 *row = src_indices + y * src_rowstride;
+
+        for (x = 0; x < src_width; x++)
+            used [row [x]] = TRUE;
+    }
+
+    for (i = n_src_colors; i < 256; i++)
+    {
+        if (used [i])
+            return FALSE;
+    }
+
+    used [n_src_colors] = have_padding;
+    map_out [n_src_colors] = chafa_palette_get_transparent_index (palette);
+
+    bg = *chafa_palette_get_color (palette, CHAFA_COLOR_SPACE_RGB, CHAFA_PALETTE_INDEX_BG);
+
+    for (i = 0; i <= n_src_colors; i++)
+    {
+        ChafaColor col = { { 0 } };
+        gint alpha, j;
+
+        if (!used [i])
+            continue;
+
+        /* Padding is fully transparent */
+        if (i < n_src_colors)
+            chafa_unpack_color (src_colors [i], &col);
+
+        if (col.ch [3] < chafa_palette_get_alpha_threshold (palette))
+        {
+            map_out [i] = chafa_palette_get_transparent_index (palette);
+            continue;
+        }
+
+        /* Composite on the BG color, like post_scale_row () */
+        alpha = col.ch [3];
+        for (j = 0; j < 3; j++)
+            col.ch [j] = (col.ch [j] * alpha + bg.ch [j] * (255 - alpha)) / 255;
+        col.ch [3] = 0xff;
+
+        for (j = 0; j < n_pens; j++)
+        {
+            if (chafa_color8_to_u32 (pens [j]) == chafa_color8_to_u32 (col))
+                break;
+        }
+
+        if (j == n_pens)
+        {
+            if (n_pens == chafa_palette_get_transparent_index (palette))
+                return FALSE;
+            pens [n_pens++] = col;
+        }
+
+        map_out [i] = j;
+    }
+
+    chafa_palette_set_colors (palette, pens, n_pens, color_space);
+    return TRUE;
+}
+
+/* Draws an image that already has a palette, reusing its colors and indices
+ * instead of generating a palette and quantizing. This is only possible if
+ * the image is placed unscaled, so no pixels are blended. The colors are
+ * exact, so there is nothing to dither either.
+ *
+ * Returns FALSE if the image can't be drawn this way, in which case
+ * chafa_indexed_image_draw_pixels () must be used instead. */
+gboolean
+chafa_indexed_image_draw_indices (ChafaIndexedImage *indexed_image,
+                                  ChafaColorSpace color_space,
+                                  const guint8 *src_indices,
+                                  const guint32 *src_colors, gint n_src_colors,
+                                  gint src_width, gint src_height, gint src_rowstride,
+                                  gint dest_width, gint dest_height,
+                                  ChafaAlign halign, ChafaAlign valign,
+                                  ChafaTuck tuck)
+{
+    gint placement_x, placement_y;
+    gint placement_width, placement_height;
+    guint8 map [257];
+    guint8 pad_index;
+    gint x, y;
+
+    g_return_val_if_fail (dest_width == indexed_image->width, FALSE);
+    g_return_val_if_fail (dest_height <= indexed_image->height, FALSE);
+    g_return_val_if_fail (n_src_colors > 0 && n_src_colors <= 256, FALSE);
+
+    if (chafa_palette_get_type (&indexed_image->palette) != CHAFA_PALETTE_TYPE_DYNAMIC_256)
+        return FALSE;
+
+    chafa_tuck_and_align (src_width, src_height,
+                          dest_width, dest_height,
+                          halign, valign,
+                          tuck,
+                          &placement_x, &placement_y,
+                          &placement_width, &placement_height);
+
+    if (placement_width != src_width || placement_height != src_height
+        || placement_x < 0 || placement_x + src_width > dest_width
+        || placement_y < 0 || placement_y + src_height > dest_height)
+        return FALSE;
+
+    if (!map_src_colors (indexed_image, color_space,
+                         src_indices, src_colors, n_src_colors,
+                         src_width, src_height, src_rowstride,
+                         src_width < dest_width || src_height < dest_height,
+                         map))
+        return FALSE;
+
+    pad_index = map [n_src_colors];
+
+    for (y = 0; y < dest_height; y++)
+    {
+        guint8 *dest_row = indexed_image->pixels + y * indexed_image->width;
+        const guint8 *src_row;
+
+        if (y < placement_y || y >= placement_y + src_height)
+        {
+            memset (dest_row, pad_index, dest_width);
+            continue;
+        }
+
+        src_row = src_indices + (y - placement_y) * src_rowstride;
+
+        memset (dest_row, pad_index, placement_x);
+        for (x = 0; x < src_width; x++)
+            dest_row [placement_x + x] = map [src_row [x]];
+        memset (dest_row + placement_x + src_width, pad_index,
+                dest_width - placement_x - src_width);
+    }
+
+    memset (indexed_image->pixels + indexed_image->width * dest_height,
+            chafa_palette_get_transparent_index (&indexed_image->palette),
+            indexed_image->width * (indexed_image->height - dest_height));
+
+    return TRUE;
+}
@@ -48,6 +48,14 @@ void chafa_indexed_image_draw_pixels (ChafaIndexedImage *indexed_image,
                                       ChafaAlign halign, ChafaAlign valign,
                                       ChafaTuck tuck,
                                       gfloat quality);
+gboolean chafa_indexed_image_draw_indices (ChafaIndexedImage *indexed_image,
+                                           ChafaColorSpace color_space,
+                                           const guint8 *src_indices,
+                                           const guint32 *src_colors, gint n_src_colors,
+                                           gint src_width, gint src_height, gint src_rowstride,
+                                           gint dest_width, gint dest_height,
+                                           ChafaAlign halign, ChafaAlign valign,
+                                           ChafaTuck tuck);
 
 G_END_DECLS
 
@@ -113,14 +113,23 @@ typedef struct
 DrawCtx;
 
 ChafaIterm2Renderer *
-chafa_iterm2_renderer_new (gint width, gint height)
+chafa_iterm2_renderer_new (gint width, gint height, gboolean keep_payload)
 {
     ChafaIterm2Renderer *iterm2_renderer;
 
-    iterm2_renderer = g_new (ChafaIterm2Renderer, 1);
+    iterm2_renderer = g_new0 (ChafaIterm2Renderer, 1);
     iterm2_renderer->width = width;
     iterm2_renderer->height = height;
-    iterm2_renderer->rgba_image = g_malloc (width * height * sizeof (guint32));
+    iterm2_renderer->keep_payload = keep_payload ? TRUE : FALSE;
+    iterm2_renderer->rgba_image = g_try_malloc ((gsize) width * height * sizeof (guint32));
+
+    /* With terminal-side scaling, the size comes from the source image and
+     * can be large */
+    if (!iterm2_renderer->rgba_image)
+    {
+        g_free (iterm2_renderer);
+        iterm2_renderer = NULL;
+    }
 
     return iterm2_renderer;
 }
@@ -128,6 +137,8 @@ chafa_iterm2_renderer_new (gint width, gint height)
 void
 chafa_iterm2_renderer_destroy (ChafaIterm2Renderer *iterm2_renderer)
 {
+    if (iterm2_renderer->payload)
+        g_string_free (iterm2_renderer->payload, TRUE);
     g_free (iterm2_renderer->rgba_image);
     g_free (iterm2_renderer);
 }
@@ -164,6 +175,12 @@ chafa_iterm2_renderer_draw_all_pixels (ChafaIterm2Renderer *iterm2_renderer, Cha
     if (src_width == 0 || src_height == 0)
         return;
 
+    if (iterm2_renderer->payload)
+    {
+        g_string_free (iterm2_renderer->payload, TRUE);
+        iterm2_renderer->payload = NULL;
+    }
+
     flatten_alpha = bg_color.ch [3] == 0;
     bg_color.ch [3] = 0xff;
     chafa_color8_store_to_rgba8 (bg_color, bg_color_rgba);
@@ -232,16 +249,16 @@ generate_tag (ChafaBase64 *base64, GString *gs,
     encode_tag (base64, gs, &tag);
 }
 
-void
-chafa_iterm2_renderer_build_ansi (ChafaIterm2Renderer *iterm2_renderer, ChafaTermInfo *term_info, GString *out_str, gint width_cells, gint height_cells)
+static GString *
+build_payload (ChafaIterm2Renderer *iterm2_renderer)
 {
-    gchar seq [CHAFA_TERM_SEQ_LENGTH_MAX + 1];
+    GString *out_str;
     ChafaBase64 base64;
     guint32 u32;
     guint16 u16;
 
-    *chafa_term_info_emit_begin_iterm2_image (term_info, seq, width_cells, height_cells) = '\0';
-    g_string_append (out_str, seq);
+    out_str = g_string_sized_new (((gsize) iterm2_renderer->width * iterm2_renderer->height
+                                   * sizeof (guint32) + 256) * 4 / 3 + 4);
 
     chafa_base64_init (&base64);
 
@@ -303,6 +320,32 @@ chafa_iterm2_renderer_build_ansi (ChafaIterm2Renderer *iterm2_renderer, ChafaTer
     chafa_base64_encode_end (&base64, out_str);
     chafa_base64_deinit (&base64);
 
+    return out_str;
+}
+
+void
+chafa_iterm2_renderer_build_ansi (ChafaIterm2Renderer *iterm2_renderer, ChafaTermInfo *term_info, GString *out_str, gint width_cells, gint height_cells)
+{
+    gchar seq [CHAFA_TERM_SEQ_LENGTH_MAX + 1];
+    GString *payload;
+
+    /* The protocol can't refer back to an earlier image, so showing it at
+     * another size means sending it again. The encoding is reused, though. */
+    payload = iterm2_renderer->payload;
+    if (!payload)
+        payload = build_payload (iterm2_renderer);
+
+    *chafa_term_info_emit_begin_iterm2_image (term_info, seq, width_cells, height_cells) = '\0';
+    g_string_append (out_str, seq);
+
+    g_string_append_len (out_str, payload->str, payload->len);
+
     *chafa_term_info_emit_end_iterm2_image (term_info, seq) = '\0';
     g_string_append (out_str, seq);
+
+    /* Without terminal scaling, the image is only ever sent once */
+    if (iterm2_renderer->keep_payload)
+        iterm2_renderer->payload = payload;
+    else if (payload != iterm2_renderer->payload)
+        g_string_free (payload, TRUE);
 }
@@ -28,10 +28,15 @@ typedef struct
 {
     gint width, height;
     gpointer rgba_image;
+
+    /* Encoded image. With terminal scaling, it's kept so it can be sent
+     * again at another size. */
+    GString *payload;
+    guint keep_payload : 1;
 }
 ChafaIterm2Renderer;
 
-ChafaIterm2Renderer *chafa_iterm2_renderer_new (gint width, gint height);
+ChafaIterm2Renderer *chafa_iterm2_renderer_new (gint width, gint height, gboolean keep_payload);
 void chafa_iterm2_renderer_destroy (ChafaIterm2Renderer *iterm2_renderer);
 
 void chafa_iterm2_renderer_draw_all_pixels (ChafaIterm2Renderer *iterm2_renderer, ChafaPixelType src_pixel_type,
@@ -19,6 +19,7 @@
 
 #include "config.h"
 
+#include <string.h>  /* memcpy, strlen */
 #include "chafa.h"
 #include "smolscale/smolscale.h"
 #include "internal/chafa-base64.h"
@@ -31,6 +32,16 @@
 #include "internal/chafa-pixops.h"
 #include "internal/chafa-string-util.h"
 
+#ifdef G_OS_UNIX
+# include <errno.h>
+# include <fcntl.h>
+# include <unistd.h>
+# if defined(HAVE_SHM_OPEN) && defined(HAVE_MMAP)
+#  include <sys/mman.h>
+#  define USE_SHM 1
+# endif
+#endif
+
 typedef struct
 {
     ChafaKittyRenderer *kitty_renderer;
@@ -287,27 +298,247 @@ build_image_chunks (ChafaKittyRenderer *kitty_renderer, ChafaPassthroughEncoder
     end_passthrough (ptenc);
 }
 
+/* Local transports. The image is written where the terminal can read it,
+ * and the terminal is responsible for removing it afterwards. */
+
+#ifdef G_OS_UNIX
+
+static gboolean
+write_all (gint fd, const guint8 *data, gsize len)
+{
+    while (len > 0)
+    {
+        gssize n = write (fd, data, len);
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return FALSE;
+        }
+
+        data += n;
+        len -= n;
+    }
+
+    return TRUE;
+}
+
+static gchar *
+store_in_temp_file (ChafaKittyRenderer *kitty_renderer)
+{
+    gsize len = (gsize) kitty_renderer->width * kitty_renderer->height * sizeof (guint32);
+    gchar *path;
+    gint fd;
+
+    /* Kitty refuses to delete files whose names lack this string */
+    fd = g_file_open_tmp ("tty-graphics-protocol-XXXXXX", &path, NULL);
+    if (fd < 0)
+        return NULL;
+
+    if (!write_all (fd, kitty_renderer->rgba_image, len))
+    {
+        unlink (path);
+        g_free (path);
+        path = NULL;
+    }
+
+    close (fd);
+    return path;
+}
+
+#endif
+
+#ifdef USE_SHM
+
+static gchar *
+store_in_shm (ChafaKittyRenderer *kitty_renderer)
+{
+    gsize len = (gsize) kitty_renderer->width * kitty_renderer->height * sizeof (guint32);
+    gchar *name = NULL;
+    gpointer data;
+    gint fd = -1;
+    gint i;
+
+    for (i = 0; i < 8 && fd < 0; i++)
+    {
+        g_free (name);
+        name = g_strdup_printf ("/tty-graphics-protocol-%d-%08x",
+                                (gint) getpid (), g_random_int ());
+        fd = shm_open (name, O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0 && errno != EEXIST)
+            break;
+    }
+
+    if (fd < 0)
+    {
+        g_free (name);
+        return NULL;
+    }
+
+    /* Not all platforms allow write () on shared memory objects */
+    data = MAP_FAILED;
+    if (ftruncate (fd, len) == 0)
+        data = mmap (NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close (fd);
+
+    if (data == MAP_FAILED)
+    {
+        shm_unlink (name);
+        g_free (name);
+        return NULL;
+    }
+
+    memcpy (data, kitty_renderer->rgba_image, len);
+    munmap (data, len);
+    return name;
+}
+
+#endif
+
+/* Returns the name to send in place of the pixels, or NULL if the image
+ * should be sent directly. That's also the fallback if the terminal lacks
+ * the sequence for the transport, or if storing the image failed. */
+static gchar *
+store_image (ChafaKittyRenderer *kitty_renderer, ChafaTermInfo *term_info,
+             ChafaKittyTransport transport,
+             ChafaTermSeq temp_file_seq, ChafaTermSeq shm_seq)
+{
+    if (transport == CHAFA_KITTY_TRANSPORT_TEMP_FILE
+        && chafa_term_info_have_seq (term_info, temp_file_seq))
+    {
+#ifdef G_OS_UNIX
+        return store_in_temp_file (kitty_renderer);
+#endif
+    }
+    else if (transport == CHAFA_KITTY_TRANSPORT_SHARED_MEMORY
+             && chafa_term_info_have_seq (term_info, shm_seq))
+    {
+#ifdef USE_SHM
+        return store_in_shm (kitty_renderer);
+#endif
+    }
+
+    return NULL;
+}
+
+static void
+build_image_name (ChafaPassthroughEncoder *ptenc, const gchar *name)
+{
+    gchar seq [CHAFA_TERM_SEQ_LENGTH_MAX + 1];
+
+    encode_chunk (ptenc->out, (const guint8 *) name, (const guint8 *) name + strlen (name));
+
+    *chafa_term_info_emit_end_kitty_image_chunk (ptenc->term_info, seq) = '\0';
+    chafa_passthrough_encoder_append (ptenc, seq);
+    chafa_passthrough_encoder_reset (ptenc);
+    end_passthrough (ptenc);
+}
+
+static gboolean
+have_transmit_seqs (ChafaTermInfo *term_info)
+{
+    return chafa_term_info_have_seq (term_info, CHAFA_TERM_SEQ_BEGIN_KITTY_TRANSMIT_IMAGE_V1)
+        && chafa_term_info_have_seq (term_info, CHAFA_TERM_SEQ_PLACE_KITTY_IMAGE_V1);
+}
+
+/* Sends the image and displays it. If image_id is positive and the terminal
+ * supports it, the image is stored under that ID and placed separately, so
+ * it can be placed again later without being sent again. */
 static void
 build_immediate (ChafaKittyRenderer *kitty_renderer, ChafaTermInfo *term_info, GString *out_str,
-                 gint width_cells, gint height_cells)
+                 gint width_cells, gint height_cells, gint image_id,
+                 ChafaKittyTransport transport)
 {
     ChafaPassthroughEncoder ptenc;
     gchar seq [CHAFA_TERM_SEQ_LENGTH_MAX + 1];
+    gboolean transmit_only;
+    gchar *name;
 
     chafa_passthrough_encoder_begin (&ptenc, CHAFA_PASSTHROUGH_NONE, term_info, out_str);
 
-    *chafa_term_info_emit_begin_kitty_immediate_image_v1 (term_info, seq,
-                                                          32,
-                                                          kitty_renderer->width,
-                                                          kitty_renderer->height,
-                                                          width_cells,
-                                                          height_cells) = '\0';
+    transmit_only = image_id > 0 && have_transmit_seqs (term_info);
+
+    if (transmit_only)
+        name = store_image (kitty_renderer, term_info, transport,
+                            CHAFA_TERM_SEQ_BEGIN_KITTY_TRANSMIT_TEMP_FILE_IMAGE_V1,
+                            CHAFA_TERM_SEQ_BEGIN_KITTY_TRANSMIT_SHM_IMAGE_V1);
+    else
+        name = store_image (kitty_renderer, term_info, transport,
+                            CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_TEMP_FILE_IMAGE_V1,
+                            CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_SHM_IMAGE_V1);
+
+    if (transmit_only && name && transport == CHAFA_KITTY_TRANSPORT_TEMP_FILE)
+    {
+        *chafa_term_info_emit_begin_kitty_transmit_temp_file_image_v1 (term_info, seq,
+                                                                       32,
+                                                                       kitty_renderer->width,
+                                                                       kitty_renderer->height,
+                                                                       image_id) = '\0';
+    }
+    else if (transmit_only && name)
+    {
+        *chafa_term_info_emit_begin_kitty_transmit_shm_image_v1 (term_info, seq,
+                                                                 32,
+                                                                 kitty_renderer->width,
+                                                                 kitty_renderer->height,
+                                                                 image_id) = '\0';
+    }
+    else if (transmit_only)
+    {
+        *chafa_term_info_emit_begin_kitty_transmit_image_v1 (term_info, seq,
+                                                             32,
+                                                             kitty_renderer->width,
+                                                             kitty_renderer->height,
+                                                             image_id) = '\0';
+    }
+    else if (name && transport == CHAFA_KITTY_TRANSPORT_TEMP_FILE)
+    {
+        *chafa_term_info_emit_begin_kitty_immediate_temp_file_image_v1 (term_info, seq,
+                                                                        32,
+                                                                        kitty_renderer->width,
+                                                                        kitty_renderer->height,
+                                                                        width_cells,
+                                                                        height_cells) = '\0';
+    }
+    else if (name)
+    {
+        *chafa_term_info_emit_begin_kitty_immediate_shm_image_v1 (term_info, seq,
+                                                                  32,
+                                                                  kitty_renderer->width,
+                                                                  kitty_renderer->height,
+                                                                  width_cells,
+                                                                  height_cells) = '\0';
+    }
+    else
+    {
+        *chafa_term_info_emit_begin_kitty_immediate_image_v1 (term_info, seq,
+                                                              32,
+                                                              kitty_renderer->width,
+                                                              kitty_renderer->height,
+                                                              width_cells,
+                                                              height_cells) = '\0';
+    }
+
     chafa_passthrough_encoder_append (&ptenc, seq);
     chafa_passthrough_encoder_flush (&ptenc);
 
-    build_image_chunks (kitty_renderer, &ptenc);
+    if (name)
+        build_image_name (&ptenc, name);
+    else
+        build_image_chunks (kitty_renderer, &ptenc);
 
     chafa_passthrough_encoder_end (&ptenc);
+    g_free (name);
+
+    if (transmit_only)
+    {
+        *chafa_term_info_emit_place_kitty_image_v1 (term_info, seq,
+                                                    image_id,
+                                                    width_cells,
+                                                    height_cells) = '\0';
+        g_string_append (out_str, seq);
+    }
 }
 
 static gboolean
@@ -418,56 +649,147 @@ build_unicode_placement (ChafaTermInfo *term_info,
 static void
 build_unicode_virtual (ChafaKittyRenderer *kitty_renderer, ChafaTermInfo *term_info, GString *out_str,
                        gint width_cells, gint height_cells, gint placement_id,
-                       ChafaPassthrough passthrough)
+                       ChafaPassthrough passthrough, ChafaKittyTransport transport)
 {
     ChafaPassthroughEncoder ptenc;
     gchar seq [CHAFA_TERM_SEQ_LENGTH_MAX + 1];
+    gchar *name;
 
     chafa_passthrough_encoder_begin (&ptenc, passthrough, term_info, out_str);
 
-    *chafa_term_info_emit_begin_kitty_immediate_virt_image_v1 (term_info, seq,
-                                                               32,
-                                                               kitty_renderer->width,
-                                                               kitty_renderer->height,
-                                                               width_cells,
-                                                               height_cells,
-                                                               placement_id) = '\0';
-    chafa_passthrough_encoder_append (&ptenc, seq);
-    chafa_passthrough_encoder_reset (&ptenc);
-    end_passthrough (&ptenc);
+    name = store_image (kitty_renderer, term_info, transport,
+                        CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_VIRT_TEMP_FILE_IMAGE_V1,
+                        CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_VIRT_SHM_IMAGE_V1);
 
-    build_image_chunks (kitty_renderer, &ptenc);
+    if (name)
+    {
+        /* The name is short, so it goes in the same packet as the header */
+        if (transport == CHAFA_KITTY_TRANSPORT_TEMP_FILE)
+            *chafa_term_info_emit_begin_kitty_immediate_virt_temp_file_image_v1 (term_info, seq,
+                                                                                 32,
+                                                                                 kitty_renderer->width,
+                                                                                 kitty_renderer->height,
+                                                                                 width_cells,
+                                                                                 height_cells,
+                                                                                 placement_id) = '\0';
+        else
+            *chafa_term_info_emit_begin_kitty_immediate_virt_shm_image_v1 (term_info, seq,
+                                                                           32,
+                                                                           kitty_renderer->width,
+                                                                           kitty_renderer->height,
+                                                                           width_cells,
+                                                                           height_cells,
+                                                                           placement_id) = '\0';
+        chafa_passthrough_encoder_append (&ptenc, seq);
+        build_image_name (&ptenc, name);
+        g_free (name);
+    }
+    else
+    {
+        *chafa_term_info_emit_begin_kitty_immediate_virt_image_v1 (term_info, seq,
+                                                                   32,
+                                                                   kitty_renderer->width,
+                                                                   kitty_renderer->height,
+                                                                   width_cells,
+                                                                   height_cells,
+                                                                   placement_id) = '\0';
+        chafa_passthrough_encoder_append (&ptenc, seq);
+        chafa_passthrough_encoder_reset (&ptenc);
+        end_passthrough (&ptenc);
+
+        build_image_chunks (kitty_renderer, &ptenc);
+
+        end_passthrough (&ptenc);
+    }
 
-    end_passthrough (&ptenc);
     chafa_passthrough_encoder_end (&ptenc);
 
     build_unicode_placement (term_info, out_str, width_cells, height_cells,
                              placement_id, passthrough);
 }
 
+/* Virtual placements encode the ID in a 256-color index */
+static gint
+get_virt_image_id (gint placement_id)
+{
+    /* Make IDs in the first <256 range predictable, but as the range
+     * cycles we add one to skip over every ID==0 */
+    if (placement_id < 1)
+        placement_id = 1;
+    else if (placement_id > 255)
+        placement_id = 1 + (placement_id % 255);
+
+    return placement_id;
+}
+
 void
 chafa_kitty_renderer_build_ansi (ChafaKittyRenderer *kitty_renderer,
                                ChafaTermInfo *term_info, GString *out_str,
                                gint width_cells, gint height_cells,
                                gint placement_id,
-                               ChafaPassthrough passthrough)
+                               ChafaPassthrough passthrough,
+                               ChafaKittyTransport transport,
+                               gboolean keep_image)
 {
     if (passthrough == CHAFA_PASSTHROUGH_NONE)
     {
         build_immediate (kitty_renderer, term_info, out_str,
-                         width_cells, height_cells);
+                         width_cells, height_cells,
+                         keep_image ? placement_id : -1,
+                         transport);
     }
     else
     {
-        /* Make IDs in the first <256 range predictable, but as the range
-         * cycles we add one to skip over every ID==0 */
-        if (placement_id < 1)
-            placement_id = 1;
-        else if (placement_id > 255)
-            placement_id = 1 + (placement_id % 255);
-
         build_unicode_virtual (kitty_renderer, term_info, out_str,
                                width_cells, height_cells,
-                               placement_id, passthrough);
+                               get_virt_image_id (placement_id), passthrough, transport);
+    }
+}
+
+/* Places an image that was previously sent with keep_image set. Returns
+ * FALSE if that isn't possible, in which case it must be sent again. */
+gboolean
+chafa_kitty_renderer_build_placement (ChafaKittyRenderer *kitty_renderer,
+                                      ChafaTermInfo *term_info, GString *out_str,
+                                      gint width_cells, gint height_cells,
+                                      gint placement_id,
+                                      ChafaPassthrough passthrough)
+{
+    ChafaPassthroughEncoder ptenc;
+    gchar seq [CHAFA_TERM_SEQ_LENGTH_MAX + 1];
+
+    g_return_val_if_fail (kitty_renderer != NULL, FALSE);
+
+    if (passthrough == CHAFA_PASSTHROUGH_NONE)
+    {
+        if (placement_id < 1 || !have_transmit_seqs (term_info))
+            return FALSE;
+
+        *chafa_term_info_emit_place_kitty_image_v1 (term_info, seq,
+                                                    placement_id,
+                                                    width_cells,
+                                                    height_cells) = '\0';
+        g_string_append (out_str, seq);
+        return TRUE;
     }
+
+    if (!chafa_term_info_have_seq (term_info, CHAFA_TERM_SEQ_PLACE_KITTY_VIRT_IMAGE_V1))
+        return FALSE;
+
+    placement_id = get_virt_image_id (placement_id);
+
+    chafa_passthrough_encoder_begin (&ptenc, passthrough, term_info, out_str);
+
+    *chafa_term_info_emit_place_kitty_virt_image_v1 (term_info, seq,
+                                                     placement_id,
+                                                     width_cells,
+                                                     height_cells) = '\0';
+    chafa_passthrough_encoder_append (&ptenc, seq);
+    chafa_passthrough_encoder_reset (&ptenc);
+    end_passthrough (&ptenc);
+    chafa_passthrough_encoder_end (&ptenc);
+
+    build_unicode_placement (term_info, out_str, width_cells, height_cells,
+                             placement_id, passthrough);
+    return TRUE;
 }
@@ -952,6 +952,33 @@ chafa_palette_generate (ChafaPalette *palette_out, gconstpointer pixels, gint n_
     }
 }
 
+/* Like chafa_palette_generate (), but with the colors given up front, e.g.
+ * from a source image that has a palette of its own */
+void
+chafa_palette_set_colors (ChafaPalette *palette, const ChafaColor *colors, gint n_colors,
+                          ChafaColorSpace color_space)
+{
+    gint i;
+
+    g_return_if_fail (palette->type == CHAFA_PALETTE_TYPE_DYNAMIC_256);
+    g_return_if_fail (n_colors >= 0 && n_colors <= palette->transparent_index);
+
+    for (i = 0; i < n_colors; i++)
+    {
+        palette->colors [i].col [CHAFA_COLOR_SPACE_RGB] = colors [i];
+        palette->colors [i].col [CHAFA_COLOR_SPACE_RGB].ch [3] = 0xff;
+    }
+
+    palette->n_colors = n_colors;
+    gen_table (palette, CHAFA_COLOR_SPACE_RGB);
+
+    if (color_space == CHAFA_COLOR_SPACE_DIN99D)
+    {
+        gen_din99d_color_space (palette);
+        gen_table (palette, CHAFA_COLOR_SPACE_DIN99D);
+    }
+}
+
 gint
 chafa_palette_lookup_nearest (const ChafaPalette *palette, ChafaColorSpace color_space,
                               const ChafaColor *color, ChafaColorCandidates *candidates)
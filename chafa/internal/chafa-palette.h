@@ -58,6 +58,8 @@ void chafa_palette_deinit (ChafaPalette *palette);
 void chafa_palette_copy (const ChafaPalette *src, ChafaPalette *dest);
 void chafa_palette_generate (ChafaPalette *palette_out, gconstpointer pixels, gint n_pixels,
                              ChafaColorSpace color_space, gfloat quality);
+void chafa_palette_set_colors (ChafaPalette *palette, const ChafaColor *colors, gint n_colors,
+                               ChafaColorSpace color_space);
 
 ChafaPaletteType chafa_palette_get_type (const ChafaPalette *palette);
 
@@ -66,6 +66,19 @@ typedef struct
     ChafaPixel *dest_pixels;
     gint dest_width, dest_height;
 
+    /* Maximum alpha of each symbol cell in dest_pixels, row-major. May be
+     * NULL. */
+    guint8 *cell_max_alpha;
+
+    /* Size of the scaled image and the offset of dest_pixels into it. When
+     * preparing a region, the destination is a window into a larger virtual
+     * image. Otherwise these are the same as the dest dimensions and zero. */
+    gint virt_width, virt_height;
+    gint x_ofs, y_ofs;
+
+    /* Set for regions of an image at its original size */
+    gboolean is_unscaled_region;
+
     const ChafaPalette *palette;
     const ChafaDither *dither;
     ChafaColorSpace color_space;
@@ -299,7 +312,8 @@ convert_rgb_to_din99d (ChafaPixel *pixels, gint width, gint dest_y, gint n_rows)
 }
 
 static void
-simple_dither (const ChafaDither *dither, ChafaPixel *pixels, gint width, gint dest_y, gint n_rows)
+simple_dither (const ChafaDither *dither, ChafaPixel *pixels, gint width, gint dest_y, gint n_rows,
+               gint x_ofs, gint y_ofs)
 {
     ChafaPixel *pixel = pixels + dest_y * width;
     ChafaPixel *pixel_max = pixel + n_rows * width;
@@ -309,7 +323,7 @@ simple_dither (const ChafaDither *dither, ChafaPixel *pixels, gint width, gint d
     {
         for (x = 0; x < width; x++)
         {
-            pixel->col = chafa_dither_color (dither, pixel->col, x, y);
+            pixel->col = chafa_dither_color (dither, pixel->col, x + x_ofs, y + y_ofs);
             pixel++;
         }
     }
@@ -420,7 +434,8 @@ fs_dither (const ChafaDither *dither, const ChafaPalette *palette,
 
 static void
 dither_and_convert_rgb_to_din99d (const ChafaDither *dither,
-                                  ChafaPixel *pixels, gint width, gint dest_y, gint n_rows)
+                                  ChafaPixel *pixels, gint width, gint dest_y, gint n_rows,
+                                  gint x_ofs, gint y_ofs)
 {
     ChafaPixel *pixel = pixels + dest_y * width;
     ChafaPixel *pixel_max = pixel + n_rows * width;
@@ -430,7 +445,7 @@ dither_and_convert_rgb_to_din99d (const ChafaDither *dither,
     {
         for (x = 0; x < width; x++)
         {
-            pixel->col = chafa_dither_color (dither, pixel->col, x, y);
+            pixel->col = chafa_dither_color (dither, pixel->col, x + x_ofs, y + y_ofs);
             chafa_color_rgb_to_din99d (&pixel->col, &pixel->col);
             pixel++;
         }
@@ -484,7 +499,8 @@ prepare_pixels_1_worker_nearest (ChafaBatchInfo *batch, PrepareContext *prep_ctx
     ChafaPixel *pixel;
     gint dest_y;
     gint px, py;
-    gint x_inc, y_inc;
+    gint64 x_inc, y_inc;
+    gint n_cols;
     gint alpha_sum = 0;
     const guint8 *data;
     gint n_rows;
@@ -499,22 +515,42 @@ prepare_pixels_1_worker_nearest (ChafaBatchInfo *batch, PrepareContext *prep_ctx
     n_rows = batch->n_rows;
     rowstride = prep_ctx->src_rowstride;
 
-    x_inc = (prep_ctx->src_width * FIXED_MULT) / (prep_ctx->dest_width);
-    y_inc = (prep_ctx->src_height * FIXED_MULT) / (prep_ctx->dest_height);
+    x_inc = ((gint64) prep_ctx->src_width * FIXED_MULT) / (prep_ctx->virt_width);
+    y_inc = ((gint64) prep_ctx->src_height * FIXED_MULT) / (prep_ctx->virt_height);
+
+    /* A region may extend past the right or bottom edge of the virtual image.
+     * Pixels out there are cleared, like Smolscale does outside the placement. */
+    n_cols = CLAMP (prep_ctx->virt_width - prep_ctx->x_ofs, 0, prep_ctx->dest_width);
 
     pixel = prep_ctx->dest_pixels + dest_y * prep_ctx->dest_width;
 
     for (py = dest_y; py < dest_y + n_rows; py++)
     {
         const guint8 *data_row_p;
+        gint vy = py + prep_ctx->y_ofs;
 
-        data_row_p = data + ((py * y_inc) / FIXED_MULT) * rowstride;
+        if (vy >= prep_ctx->virt_height)
+        {
+            memset (pixel, 0, prep_ctx->dest_width * sizeof (ChafaPixel));
+            pixel += prep_ctx->dest_width;
+            alpha_sum += 0xff;
+            continue;
+        }
+
+        data_row_p = data + ((vy * y_inc) / FIXED_MULT) * rowstride;
 
-        for (px = 0; px < prep_ctx->dest_width; px++)
+        for (px = 0; px < n_cols; px++)
         {
-            const guint8 *data_p = data_row_p + ((px * x_inc) / FIXED_MULT) * 4;
+            const guint8 *data_p = data_row_p + (((px + prep_ctx->x_ofs) * x_inc) / FIXED_MULT) * 4;
             prepare_pixels_1_inner (ret, prep_ctx, data_p, pixel++, &alpha_sum);
         }
+
+        if (n_cols < prep_ctx->dest_width)
+        {
+            memset (pixel, 0, (prep_ctx->dest_width - n_cols) * sizeof (ChafaPixel));
+            pixel += prep_ctx->dest_width - n_cols;
+            alpha_sum += 0xff;
+        }
     }
 
     if (alpha_sum > 0)
@@ -579,7 +615,10 @@ prepare_pixels_pass_1 (PrepareContext *prep_ctx)
      * - Figure out if we have alpha transparency
      */
 
-    batch_func = (GFunc) ((prep_ctx->work_factor_int < 3
+    /* Unscaled regions are a plain copy too. Smolscale only has an exact
+     * copy path when the source and destination sizes match, and clipping
+     * would otherwise cost us a round trip through linear RGB. */
+    batch_func = (GFunc) (((prep_ctx->work_factor_int < 3 || prep_ctx->is_unscaled_region)
                            && prep_ctx->src_pixel_type == CHAFA_PIXEL_RGBA8_UNASSOCIATED)
                           ? prepare_pixels_1_worker_nearest
                           : prepare_pixels_1_worker_smooth);
@@ -632,6 +671,28 @@ composite_alpha_on_bg (ChafaColor bg_color,
     }
 }
 
+/* Batches must start and end on cell boundaries */
+static void
+calc_cell_max_alpha (const ChafaPixel *pixels, gint width, gint first_row, gint n_rows,
+                     guint8 *cell_max_alpha)
+{
+    gint n_cols = width / CHAFA_SYMBOL_WIDTH_PIXELS;
+    gint x, y;
+
+    for (y = first_row; y < first_row + n_rows; y++)
+    {
+        const ChafaPixel *row = pixels + y * width;
+        guint8 *out = cell_max_alpha + (y / CHAFA_SYMBOL_HEIGHT_PIXELS) * n_cols;
+
+        if (y % CHAFA_SYMBOL_HEIGHT_PIXELS == 0)
+            memset (out, 0, n_cols);
+
+        for (x = 0; x < width; x++)
+            out [x / CHAFA_SYMBOL_WIDTH_PIXELS] = MAX (out [x / CHAFA_SYMBOL_WIDTH_PIXELS],
+                                                       row [x].col.ch [3]);
+    }
+}
+
 static void
 prepare_pixels_2_worker (ChafaBatchInfo *batch, PrepareContext *prep_ctx)
 {
@@ -643,10 +704,18 @@ prepare_pixels_2_worker (ChafaBatchInfo *batch, PrepareContext *prep_ctx)
                        batch->first_row, batch->n_rows);
 
     if (prep_ctx->have_alpha_int)
+    {
         composite_alpha_on_bg (prep_ctx->bg_color_rgb,
                                prep_ctx->dest_pixels, prep_ctx->dest_width,
                                batch->first_row, batch->n_rows);
 
+        /* Nothing after this touches alpha */
+        if (prep_ctx->cell_max_alpha)
+            calc_cell_max_alpha (prep_ctx->dest_pixels, prep_ctx->dest_width,
+                                 batch->first_row, batch->n_rows,
+                                 prep_ctx->cell_max_alpha);
+    }
+
     if (prep_ctx->color_space == CHAFA_COLOR_SPACE_DIN99D)
     {
         if (prep_ctx->dither->mode == CHAFA_DITHER_MODE_ORDERED
@@ -656,7 +725,9 @@ prepare_pixels_2_worker (ChafaBatchInfo *batch, PrepareContext *prep_ctx)
                                               prep_ctx->dest_pixels,
                                               prep_ctx->dest_width,
                                               batch->first_row,
-                                              batch->n_rows);
+                                              batch->n_rows,
+                                              prep_ctx->x_ofs,
+                                              prep_ctx->y_ofs);
         }
         else if (prep_ctx->dither->mode == CHAFA_DITHER_MODE_DIFFUSION)
         {
@@ -682,7 +753,9 @@ prepare_pixels_2_worker (ChafaBatchInfo *batch, PrepareContext *prep_ctx)
                        prep_ctx->dest_pixels,
                        prep_ctx->dest_width,
                        batch->first_row,
-                       batch->n_rows);
+                       batch->n_rows,
+                       prep_ctx->x_ofs,
+                       prep_ctx->y_ofs);
     }
     else if (prep_ctx->dither->mode == CHAFA_DITHER_MODE_DIFFUSION)
     {
@@ -721,10 +794,16 @@ prepare_pixels_pass_2 (PrepareContext *prep_ctx)
      * -----------
      *
      * - Normalization (optional)
+     * - Alpha compositing and per-cell max alpha (optional)
      * - Dithering (optional)
      * - Color space conversion; DIN99d (optional)
      */
 
+    if (prep_ctx->cell_max_alpha && !prep_ctx->have_alpha_int)
+        memset (prep_ctx->cell_max_alpha, 0xff,
+                (prep_ctx->dest_width / CHAFA_SYMBOL_WIDTH_PIXELS)
+                * (prep_ctx->dest_height / CHAFA_SYMBOL_HEIGHT_PIXELS));
+
     if (!need_pass_2 (prep_ctx))
         return;
 
@@ -739,6 +818,10 @@ prepare_pixels_pass_2 (PrepareContext *prep_ctx)
         batch_unit = 1 << prep_ctx->dither->grain_height_shift;
     }
 
+    /* Cells must not straddle batches. Grains are at most one cell high. */
+    if (prep_ctx->cell_max_alpha)
+        batch_unit = MAX (batch_unit, CHAFA_SYMBOL_HEIGHT_PIXELS);
+
     chafa_process_batches (prep_ctx,
                            (GFunc) prepare_pixels_2_worker,
                            NULL,  /* _post */
@@ -747,6 +830,81 @@ prepare_pixels_pass_2 (PrepareContext *prep_ctx)
                            batch_unit);
 }
 
+static void
+prepare_pixel_data (PrepareContext *prep_ctx,
+                    const ChafaPalette *palette,
+                    const ChafaDither *dither,
+                    ChafaColorSpace color_space,
+                    gboolean preprocessing_enabled,
+                    gint work_factor,
+                    ChafaPixelType src_pixel_type,
+                    gconstpointer src_pixels,
+                    gint src_width,
+                    gint src_height,
+                    gint src_rowstride,
+                    ChafaPixel *dest_pixels,
+                    gint dest_width,
+                    gint dest_height,
+                    guint8 *cell_max_alpha,
+                    gint placement_x,
+                    gint placement_y,
+                    gint placement_width,
+                    gint placement_height)
+{
+    prep_ctx->palette = palette;
+    prep_ctx->dither = dither;
+    prep_ctx->color_space = color_space;
+    prep_ctx->preprocessing_enabled = preprocessing_enabled;
+    prep_ctx->work_factor_int = work_factor;
+
+    prep_ctx->palette_type = chafa_palette_get_type (palette);
+    prep_ctx->bg_color_rgb = *chafa_palette_get_color (palette,
+                                                       CHAFA_COLOR_SPACE_RGB,
+                                                       CHAFA_PALETTE_INDEX_BG);
+
+    prep_ctx->src_pixel_type = src_pixel_type;
+    prep_ctx->src_pixels = src_pixels;
+    prep_ctx->src_width = src_width;
+    prep_ctx->src_height = src_height;
+    prep_ctx->src_rowstride = src_rowstride;
+
+    prep_ctx->dest_pixels = dest_pixels;
+    prep_ctx->dest_width = dest_width;
+    prep_ctx->dest_height = dest_height;
+    prep_ctx->cell_max_alpha = cell_max_alpha;
+
+    prep_ctx->scale_ctx = smol_scale_new_full (/* Source */
+                                               prep_ctx->src_pixels,
+                                               (SmolPixelType) prep_ctx->src_pixel_type,
+                                               prep_ctx->src_width,
+                                               prep_ctx->src_height,
+                                               prep_ctx->src_rowstride,
+                                               /* Fill */
+                                               NULL,
+                                               SMOL_PIXEL_RGBA8_UNASSOCIATED,
+                                               /* Destination */
+                                               NULL,
+                                               SMOL_PIXEL_RGBA8_UNASSOCIATED,  /* FIXME: Premul */
+                                               prep_ctx->dest_width,
+                                               prep_ctx->dest_height,
+                                               prep_ctx->dest_width * sizeof (guint32),
+                                               /* Placement */
+                                               placement_x * SMOL_SUBPIXEL_MUL,
+                                               placement_y * SMOL_SUBPIXEL_MUL,
+                                               placement_width * SMOL_SUBPIXEL_MUL,
+                                               placement_height * SMOL_SUBPIXEL_MUL,
+                                               /* Extra args */
+                                               SMOL_COMPOSITE_SRC_CLEAR_DEST,
+                                               SMOL_NO_FLAGS,
+                                               NULL,
+                                               prep_ctx);
+
+    prepare_pixels_pass_1 (prep_ctx);
+    prepare_pixels_pass_2 (prep_ctx);
+
+    smol_scale_destroy (prep_ctx->scale_ctx);
+}
+
 void
 chafa_prepare_pixel_data_for_symbols (const ChafaPalette *palette,
                                       const ChafaDither *dither,
@@ -761,6 +919,7 @@ chafa_prepare_pixel_data_for_symbols (const ChafaPalette *palette,
                                       ChafaPixel *dest_pixels,
                                       gint dest_width,
                                       gint dest_height,
+                                      guint8 *cell_max_alpha,
                                       gint cell_width,
                                       gint cell_height,
                                       ChafaAlign halign,
@@ -803,57 +962,61 @@ chafa_prepare_pixel_data_for_symbols (const ChafaPalette *palette,
     placement_width = (placement_width / cell_width) * CHAFA_SYMBOL_WIDTH_PIXELS,
     placement_height = (placement_height / cell_height) * CHAFA_SYMBOL_HEIGHT_PIXELS,
 
-    prep_ctx.palette = palette;
-    prep_ctx.dither = dither;
-    prep_ctx.color_space = color_space;
-    prep_ctx.preprocessing_enabled = preprocessing_enabled;
-    prep_ctx.work_factor_int = work_factor;
-
-    prep_ctx.palette_type = chafa_palette_get_type (palette);
-    prep_ctx.bg_color_rgb = *chafa_palette_get_color (palette,
-                                                      CHAFA_COLOR_SPACE_RGB,
-                                                      CHAFA_PALETTE_INDEX_BG);
-
-    prep_ctx.src_pixel_type = src_pixel_type;
-    prep_ctx.src_pixels = src_pixels;
-    prep_ctx.src_width = src_width;
-    prep_ctx.src_height = src_height;
-    prep_ctx.src_rowstride = src_rowstride;
-
-    prep_ctx.dest_pixels = dest_pixels;
-    prep_ctx.dest_width = dest_width;
-    prep_ctx.dest_height = dest_height;
-
-    prep_ctx.scale_ctx = smol_scale_new_full (/* Source */
-                                              prep_ctx.src_pixels,
-                                              (SmolPixelType) prep_ctx.src_pixel_type,
-                                              prep_ctx.src_width,
-                                              prep_ctx.src_height,
-                                              prep_ctx.src_rowstride,
-                                              /* Fill */
-                                              NULL,
-                                              SMOL_PIXEL_RGBA8_UNASSOCIATED,
-                                              /* Destination */
-                                              NULL,
-                                              SMOL_PIXEL_RGBA8_UNASSOCIATED,  /* FIXME: Premul */
-                                              prep_ctx.dest_width,
-                                              prep_ctx.dest_height,
-                                              prep_ctx.dest_width * sizeof (guint32),
-                                              /* Placement */
-                                              placement_x * SMOL_SUBPIXEL_MUL,
-                                              placement_y * SMOL_SUBPIXEL_MUL,
-                                              placement_width * SMOL_SUBPIXEL_MUL,
-                                              placement_height * SMOL_SUBPIXEL_MUL,
-                                              /* Extra args */
-                                              SMOL_COMPOSITE_SRC_CLEAR_DEST,
-                                              SMOL_NO_FLAGS,
-                                              NULL,
-                                              &prep_ctx);
-
-    prepare_pixels_pass_1 (&prep_ctx);
-    prepare_pixels_pass_2 (&prep_ctx);
-
-    smol_scale_destroy (prep_ctx.scale_ctx);
+    /* The nearest-neighbor path always stretches to the full destination */
+    prep_ctx.virt_width = dest_width;
+    prep_ctx.virt_height = dest_height;
+
+    prepare_pixel_data (&prep_ctx, palette, dither, color_space,
+                        preprocessing_enabled, work_factor,
+                        src_pixel_type, src_pixels,
+                        src_width, src_height, src_rowstride,
+                        dest_pixels, dest_width, dest_height,
+                        cell_max_alpha,
+                        placement_x, placement_y,
+                        placement_width, placement_height);
+}
+
+/* Prepares a dest_width x dest_height window at (x_ofs, y_ofs) into the
+ * source image stretched to virt_width x virt_height. All dimensions are in
+ * symbol matrix pixels. Ordered dithering is anchored to the virtual image,
+ * so adjacent regions line up; normalization and error diffusion are still
+ * local to each region. */
+void
+chafa_prepare_pixel_data_for_symbols_region (const ChafaPalette *palette,
+                                             const ChafaDither *dither,
+                                             ChafaColorSpace color_space,
+                                             gboolean preprocessing_enabled,
+                                             gint work_factor,
+                                             ChafaPixelType src_pixel_type,
+                                             gconstpointer src_pixels,
+                                             gint src_width,
+                                             gint src_height,
+                                             gint src_rowstride,
+                                             ChafaPixel *dest_pixels,
+                                             gint dest_width,
+                                             gint dest_height,
+                                             guint8 *cell_max_alpha,
+                                             gint virt_width,
+                                             gint virt_height,
+                                             gint x_ofs,
+                                             gint y_ofs)
+{
+    PrepareContext prep_ctx = { 0 };
+
+    prep_ctx.virt_width = virt_width;
+    prep_ctx.virt_height = virt_height;
+    prep_ctx.x_ofs = x_ofs;
+    prep_ctx.y_ofs = y_ofs;
+    prep_ctx.is_unscaled_region = (virt_width == src_width && virt_height == src_height);
+
+    prepare_pixel_data (&prep_ctx, palette, dither, color_space,
+                        preprocessing_enabled, work_factor,
+                        src_pixel_type, src_pixels,
+                        src_width, src_height, src_rowstride,
+                        dest_pixels, dest_width, dest_height,
+                        cell_max_alpha,
+                        -x_ofs, -y_ofs,
+                        virt_width, virt_height);
 }
 
 void
@@ -38,12 +38,32 @@ void chafa_prepare_pixel_data_for_symbols (const ChafaPalette *palette,
                                            ChafaPixel *dest_pixels,
                                            gint dest_width,
                                            gint dest_height,
+                                           guint8 *cell_max_alpha,
                                            gint cell_width,
                                            gint cell_height,
                                            ChafaAlign halign,
                                            ChafaAlign valign,
                                            ChafaTuck tuck);
 
+void chafa_prepare_pixel_data_for_symbols_region (const ChafaPalette *palette,
+                                                  const ChafaDither *dither,
+                                                  ChafaColorSpace color_space,
+                                                  gboolean preprocessing_enabled,
+                                                  gint work_factor,
+                                                  ChafaPixelType src_pixel_type,
+                                                  gconstpointer src_pixels,
+                                                  gint src_width,
+                                                  gint src_height,
+                                                  gint src_rowstride,
+                                                  ChafaPixel *dest_pixels,
+                                                  gint dest_width,
+                                                  gint dest_height,
+                                                  guint8 *cell_max_alpha,
+                                                  gint virt_width,
+                                                  gint virt_height,
+                                                  gint x_ofs,
+                                                  gint y_ofs);
+
 void chafa_sort_pixel_index_by_channel (guint8 *index,
                                         const ChafaPixel *pixels, gint n_pixels,
                                         gint ch);
@@ -117,6 +117,12 @@ struct ChafaCanvasConfig
     guint fg_only_enabled : 1;
     ChafaOptimizations optimizations;
     ChafaPassthrough passthrough;
+    gfloat color_merge_threshold;  /* 0.0 = lossless output */
+    ChafaKittyTransport kitty_transport;
+    guint terminal_scaling_enabled : 1;
+    gint terminal_scaling_max_width;  /* 0 = no limit */
+    gint terminal_scaling_max_height;
+    guint adaptive_symbols_enabled : 1;
 };
 
 /* Frame */
@@ -129,6 +135,14 @@ struct ChafaFrame
 
     gpointer data;
 
+    /* Optional palette indices for the same pixels, and the palette they
+     * refer to as packed ARGB. Renderers that can use them directly may
+     * skip quantization. */
+    guint8 *indices;
+    gint index_rowstride;
+    guint32 *index_colors;
+    gint n_index_colors;
+
     guint data_is_owned : 1;
 };
 
@@ -170,6 +184,7 @@ gboolean chafa_have_mmx (void) G_GNUC_PURE;
 gboolean chafa_have_sse41 (void) G_GNUC_PURE;
 gboolean chafa_have_popcnt (void) G_GNUC_PURE;
 gboolean chafa_have_avx2 (void) G_GNUC_PURE;
+gint chafa_get_thread_affinity_cpu (gint worker_index, gint *generation_out);
 
 void chafa_symbol_map_init (ChafaSymbolMap *symbol_map);
 void chafa_symbol_map_deinit (ChafaSymbolMap *symbol_map);
@@ -211,6 +226,8 @@ void chafa_extract_cell_mean_colors_mmx (const ChafaPixel *pixels, ChafaColorAcc
 
 #ifdef HAVE_SSE41_INTRINSICS
 gint chafa_calc_cell_error_sse41 (const ChafaPixel *pixels, const ChafaColorPair *color_pair, const guint8 *cov);
+gint chafa_find_nearest_color_sse41 (const gint16 *ch0, const gint16 *ch1, const gint16 *ch2,
+                                     gint n, guint32 color);
 #endif
 
 #ifdef HAVE_AVX2_INTRINSICS
@@ -219,6 +236,8 @@ gint chafa_calc_cell_error_avx2 (const ChafaPixel *pixels, const ChafaColorPair
 void chafa_extract_cell_mean_colors_avx2 (const ChafaPixel *pixels, ChafaColorAccum *accums_out,
                                           const guint32 *sym_mask_u32);
 void chafa_color_accum_div_scalar_avx2 (ChafaColorAccum *accum, guint16 divisor);
+gint chafa_find_nearest_color_avx2 (const gint16 *ch0, const gint16 *ch1, const gint16 *ch2,
+                                    gint n, guint32 color);
 #endif
 
 #ifdef HAVE_WASM_SIMD
@@ -49,6 +49,12 @@ typedef struct
 {
     SixelData *data;
     ChafaBitfield filter_bits;
+
+    /* Occupancy summary for the band. The pens that appear anywhere in it,
+     * and the span of columns holding non-transparent pixels. The span is
+     * empty (first_x < 0) if the band is fully transparent. */
+    guint32 pen_bits [256 / 32];
+    gint first_x, last_x;
 }
 SixelRow;
 
@@ -111,6 +117,34 @@ chafa_sixel_renderer_draw_all_pixels (ChafaSixelRenderer *sixel_renderer, ChafaP
                                      quality);
 }
 
+/* Uses the source palette as-is if possible. Returns FALSE otherwise, and
+ * the pixels must be drawn with chafa_sixel_renderer_draw_all_pixels (). */
+gboolean
+chafa_sixel_renderer_draw_indexed_pixels (ChafaSixelRenderer *sixel_renderer,
+                                          const guint8 *src_indices,
+                                          const guint32 *src_colors, gint n_src_colors,
+                                          gint src_width, gint src_height,
+                                          gint src_rowstride,
+                                          ChafaAlign halign, ChafaAlign valign,
+                                          ChafaTuck tuck)
+{
+    g_return_val_if_fail (sixel_renderer != NULL, FALSE);
+    g_return_val_if_fail (src_indices != NULL, FALSE);
+    g_return_val_if_fail (src_colors != NULL, FALSE);
+
+    if (src_width == 0 || src_height == 0)
+        return FALSE;
+
+    return chafa_indexed_image_draw_indices (sixel_renderer->image,
+                                             sixel_renderer->color_space,
+                                             src_indices,
+                                             src_colors, n_src_colors,
+                                             src_width, src_height, src_rowstride,
+                                             sixel_renderer->width, sixel_renderer->height,
+                                             halign, valign,
+                                             tuck);
+}
+
 #define FILTER_BANK_WIDTH 64
 
 static void
@@ -125,12 +159,37 @@ filter_get (const SixelRow *srow, guint8 pen, gint bank)
     return chafa_bitfield_get_bit (&srow->filter_bits, bank * 256 + (gint) pen);
 }
 
+static gboolean
+band_has_pen (const SixelRow *srow, guint8 pen)
+{
+    return (srow->pen_bits [pen / 32] >> (pen % 32)) & 1U;
+}
+
+static guint64
+expand_pen (guint8 pen)
+{
+    guint64 expanded_pen;
+
+    /* Assign pen value to each of lower six bytes */
+    expanded_pen = pen;
+    expanded_pen |= expanded_pen << 8;
+    expanded_pen |= expanded_pen << 16;
+    expanded_pen |= expanded_pen << 16;
+
+    return expanded_pen;
+}
+
 static void
-fetch_sixel_row (SixelRow *srow, const guint8 *pixels, gint width)
+fetch_sixel_row (SixelRow *srow, const guint8 *pixels, gint width, guint8 transparent_pen)
 {
     const guint8 *pixels_end, *p;
     SixelData *sdata = srow->data;
-    gint x;
+    guint64 expanded_transparent = expand_pen (transparent_pen);
+    gint n_banks = (width + FILTER_BANK_WIDTH - 1) / FILTER_BANK_WIDTH;
+    gint x, i, j;
+
+    srow->first_x = -1;
+    srow->last_x = -1;
 
     /* The ordering of output bytes is 351240; this is the inverse of
      * 140325. see sixel_data_do_schar(). */
@@ -166,8 +225,25 @@ fetch_sixel_row (SixelRow *srow, const guint8 *pixels, gint width)
         d |= (guint64) *p << (4 * 8);
 
         (sdata++)->d = d;
+
+        if (d != expanded_transparent)
+        {
+            if (srow->first_x < 0)
+                srow->first_x = x;
+            srow->last_x = x;
+        }
+    }
+
+    /* A pen is in the band if it's in any of its banks */
+
+    memset (srow->pen_bits, 0, sizeof (srow->pen_bits));
+
+    for (i = 0; i < n_banks; i++)
+    {
+        for (j = 0; j < 256 / 32; j++)
+            srow->pen_bits [j] |= srow->filter_bits.bits [i * (256 / 32) + j];
     }
-} 
+}
 
 static gchar
 sixel_data_to_schar (const SixelData *sdata, guint64 expanded_pen)
@@ -242,10 +318,33 @@ format_pen (guint8 pen, gchar *p)
     return chafa_format_dec_u8 (p, pen);
 }
 
+static gchar *
+format_pen_reps (guint8 pen, gchar rep_schar, gint n_reps, gchar *p,
+                 gboolean *need_cr, gboolean *need_pen)
+{
+    if (*need_cr)
+    {
+        *(p++) = '$';
+        *need_cr = FALSE;
+    }
+    if (*need_pen)
+    {
+        p = format_pen (pen, p);
+        *need_pen = FALSE;
+    }
+
+    return format_schar_reps (rep_schar, n_reps, p);
+}
+
 /* force_full_width is a workaround for a bug in mlterm; we need to
  * draw the entire first row even if the rightmost pixels are transparent,
  * otherwise the first row with non-transparent pixels will have
- * garbage rendered in it */
+ * garbage rendered in it.
+ *
+ * Pens that don't appear in the band are skipped without scanning, and
+ * only the span of non-transparent columns is scanned for the rest. A
+ * fully transparent band produces no output at all, leaving just the
+ * GNL. */
 static gchar *
 build_sixel_row_ansi (const ChafaSixelRenderer *scanvas, const SixelRow *srow, gchar *p, gboolean force_full_width)
 {
@@ -254,6 +353,13 @@ build_sixel_row_ansi (const ChafaSixelRenderer *scanvas, const SixelRow *srow, g
     gboolean need_cr_next = FALSE;
     const SixelData *sdata = srow->data;
     gint width = scanvas->width;
+    gint span_begin, span_end;
+
+    if (srow->first_x < 0 && !force_full_width)
+        return p;
+
+    span_begin = MAX (srow->first_x, 0);
+    span_end = srow->last_x + 1;
 
     do
     {
@@ -266,38 +372,29 @@ build_sixel_row_ansi (const ChafaSixelRenderer *scanvas, const SixelRow *srow, g
         if (pen == chafa_palette_get_transparent_index (&scanvas->image->palette))
             continue;
 
-        /* Assign pen value to each of lower six bytes */
-        expanded_pen = pen;
-        expanded_pen |= expanded_pen << 8;
-        expanded_pen |= expanded_pen << 16;
-        expanded_pen |= expanded_pen << 16;
+        /* If we're forcing full width, the first pen must be emitted even
+         * if it's not present */
+        if (!force_full_width && !band_has_pen (srow, pen))
+            continue;
+
+        expanded_pen = expand_pen (pen);
 
-        rep_schar = 0;
-        n_reps = 0;
+        /* Columns outside the span are blank for every pen */
+        rep_schar = span_begin > 0 ? '?' : 0;
+        n_reps = span_begin;
 
-        for (i = 0; i < width; )
+        for (i = span_begin; i < span_end; )
         {
-            gint step = MIN (FILTER_BANK_WIDTH, width - i);
+            gint step = MIN (FILTER_BANK_WIDTH - i % FILTER_BANK_WIDTH, span_end - i);
             gchar schar;
 
-            /* Skip over FILTER_BANK_WIDTH sixels at once if possible */
+            /* Skip over up to FILTER_BANK_WIDTH sixels at once if possible */
 
             if (!filter_get (srow, pen, i / FILTER_BANK_WIDTH))
             {
                 if (rep_schar != '?' && rep_schar != 0)
                 {
-                    if (need_cr)
-                    {
-                        *(p++) = '$';
-                        need_cr = FALSE;
-                    }
-                    if (need_pen)
-                    {
-                        p = format_pen (pen, p);
-                        need_pen = FALSE;
-                    }
-
-                    p = format_schar_reps (rep_schar, n_reps, p);
+                    p = format_pen_reps (pen, rep_schar, n_reps, p, &need_cr, &need_pen);
                     need_cr_next = TRUE;
                     n_reps = 0;
                 }
@@ -325,18 +422,7 @@ build_sixel_row_ansi (const ChafaSixelRenderer *scanvas, const SixelRow *srow, g
                 }
                 else
                 {
-                    if (need_cr)
-                    {
-                        *(p++) = '$';
-                        need_cr = FALSE;
-                    }
-                    if (need_pen)
-                    {
-                        p = format_pen (pen, p);
-                        need_pen = FALSE;
-                    }
-
-                    p = format_schar_reps (rep_schar, n_reps, p);
+                    p = format_pen_reps (pen, rep_schar, n_reps, p, &need_cr, &need_pen);
                     need_cr_next = TRUE;
 
                     rep_schar = schar;
@@ -345,20 +431,22 @@ build_sixel_row_ansi (const ChafaSixelRenderer *scanvas, const SixelRow *srow, g
             }
         }
 
-        if (rep_schar != '?' || force_full_width)
+        if (span_end < width)
         {
-            if (need_cr)
+            if (rep_schar != '?' && rep_schar != 0)
             {
-                *(p++) = '$';
-                need_cr = FALSE;
-            }
-            if (need_pen)
-            {
-                p = format_pen (pen, p);
-                need_pen = FALSE;
+                p = format_pen_reps (pen, rep_schar, n_reps, p, &need_cr, &need_pen);
+                need_cr_next = TRUE;
+                n_reps = 0;
             }
 
-            p = format_schar_reps (rep_schar, n_reps, p);
+            rep_schar = '?';
+            n_reps += width - span_end;
+        }
+
+        if (rep_schar != '?' || force_full_width)
+        {
+            p = format_pen_reps (pen, rep_schar, n_reps, p, &need_cr, &need_pen);
             need_cr_next = TRUE;
 
             /* Only need to do this for a single pen */
@@ -394,7 +482,8 @@ build_sixel_row_worker (ChafaBatchInfo *batch, const BuildSixelsCtx *ctx)
         fetch_sixel_row (&srow,
                          ctx->sixel_renderer->image->pixels
                          + ctx->sixel_renderer->image->width * (batch->first_row + i * SIXEL_CELL_HEIGHT),
-                         ctx->sixel_renderer->image->width);
+                         ctx->sixel_renderer->image->width,
+                         chafa_palette_get_transparent_index (&ctx->sixel_renderer->image->palette));
         p = build_sixel_row_ansi (ctx->sixel_renderer, &srow, p,
                                   (is_global_first_row) || (is_global_last_row)
                                   ? TRUE : FALSE);
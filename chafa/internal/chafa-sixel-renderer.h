@@ -45,6 +45,13 @@ void chafa_sixel_renderer_draw_all_pixels (ChafaSixelRenderer *sixel_renderer,
                                            ChafaAlign halign, ChafaAlign valign,
                                            ChafaTuck tuck,
                                            gfloat quality);
+gboolean chafa_sixel_renderer_draw_indexed_pixels (ChafaSixelRenderer *sixel_renderer,
+                                                   const guint8 *src_indices,
+                                                   const guint32 *src_colors, gint n_src_colors,
+                                                   gint src_width, gint src_height,
+                                                   gint src_rowstride,
+                                                   ChafaAlign halign, ChafaAlign valign,
+                                                   ChafaTuck tuck);
 void chafa_sixel_renderer_build_ansi (ChafaSixelRenderer *sixel_renderer, ChafaTermInfo *term_info,
                                       GString *out_str, ChafaPassthrough passthrough);
 
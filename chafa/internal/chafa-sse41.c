@@ -49,3 +49,57 @@ chafa_calc_cell_error_sse41 (const ChafaPixel *pixels, const ChafaColorPair *col
     return _mm_extract_epi32 (err, 0) + _mm_extract_epi32 (err, 1)
         + _mm_extract_epi32 (err, 2) + _mm_extract_epi32 (err, 3);
 }
+
+/* Brute-force search for the closest color in a palette split into channel
+ * planes. n must be a multiple of 8 and no greater than 256. Returns the
+ * index of the closest entry; ties go to the lowest index.
+ *
+ * Each distance is packed with its index as (distance << 8) | index, so a
+ * plain minimum finds both and breaks ties. */
+gint
+chafa_find_nearest_color_sse41 (const gint16 *ch0, const gint16 *ch1, const gint16 *ch2,
+                                gint n, guint32 color)
+{
+    __m128i want0, want1, want2, zero, step;
+    __m128i best, idx_lo, idx_hi;
+    gint i;
+
+    want0 = _mm_set1_epi16 (color & 0xff);
+    want1 = _mm_set1_epi16 ((color >> 8) & 0xff);
+    want2 = _mm_set1_epi16 ((color >> 16) & 0xff);
+    zero = _mm_setzero_si128 ();
+    step = _mm_set1_epi32 (8);
+
+    best = _mm_set1_epi32 (G_MAXINT32);
+    idx_lo = _mm_setr_epi32 (0, 1, 2, 3);
+    idx_hi = _mm_setr_epi32 (4, 5, 6, 7);
+
+    for (i = 0; i < n; i += 8)
+    {
+        __m128i d0, d1, d2, t, u, dist;
+
+        d0 = _mm_sub_epi16 (_mm_loadu_si128 ((const __m128i *) (ch0 + i)), want0);
+        d1 = _mm_sub_epi16 (_mm_loadu_si128 ((const __m128i *) (ch1 + i)), want1);
+        d2 = _mm_sub_epi16 (_mm_loadu_si128 ((const __m128i *) (ch2 + i)), want2);
+
+        /* Pairing up the channels lets pmaddwd square and sum them */
+
+        t = _mm_unpacklo_epi16 (d0, d1);
+        u = _mm_unpacklo_epi16 (d2, zero);
+        dist = _mm_add_epi32 (_mm_madd_epi16 (t, t), _mm_madd_epi16 (u, u));
+        best = _mm_min_epi32 (best, _mm_or_si128 (_mm_slli_epi32 (dist, 8), idx_lo));
+
+        t = _mm_unpackhi_epi16 (d0, d1);
+        u = _mm_unpackhi_epi16 (d2, zero);
+        dist = _mm_add_epi32 (_mm_madd_epi16 (t, t), _mm_madd_epi16 (u, u));
+        best = _mm_min_epi32 (best, _mm_or_si128 (_mm_slli_epi32 (dist, 8), idx_hi));
+
+        idx_lo = _mm_add_epi32 (idx_lo, step);
+        idx_hi = _mm_add_epi32 (idx_hi, step);
+    }
+
+    best = _mm_min_epi32 (best, _mm_shuffle_epi32 (best, _MM_SHUFFLE (1, 0, 3, 2)));
+    best = _mm_min_epi32 (best, _mm_shuffle_epi32 (best, _MM_SHUFFLE (2, 3, 0, 1)));
+
+    return _mm_cvtsi128_si32 (best) & 0xff;
+}
@@ -40,6 +40,24 @@
  * limited by a similar constant in chafa-symbol-map.c */
 #define N_CANDIDATES_MAX 8
 
+/* Adaptive symbol search: Number of frames to search in full while
+ * recording symbol usage, and the interval between full refresh frames
+ * after that */
+#define USAGE_LEARN_FRAMES 4
+#define USAGE_REFRESH_FRAMES 32
+
+/* If the best hot symbol's error exceeds this, the cell is searched in
+ * full. It corresponds to an RMS difference of 24 in each of three
+ * channels. */
+#define USAGE_ERROR_GUARD (CHAFA_SYMBOL_N_PIXELS * 3 * 24 * 24)
+
+typedef struct
+{
+    ChafaCanvas *canvas;
+    ChafaSymbolUsage *usage;
+}
+CellBuildCtx;
+
 typedef struct
 {
     ChafaColorPair colors;
@@ -68,24 +86,46 @@ transparent_cell_color (ChafaCanvasMode canvas_mode)
     }
 }
 
+/* The SIMD error kernels include alpha, while the plain one doesn't. Error
+ * calculated from moments must match whichever one is in use. */
+static gint
+get_n_error_channels (void)
+{
+#ifdef HAVE_WASM_SIMD
+    return 4;
+#elif defined(HAVE_AVX2_INTRINSICS)
+    return chafa_have_avx2 () ? 4 : 3;
+#elif defined(HAVE_SSE41_INTRINSICS)
+    return chafa_have_sse41 () ? 4 : 3;
+#else
+    return 3;
+#endif
+}
+
+/* If moments is non-NULL, it must hold the symbol's moments as returned
+ * by chafa_work_cell_get_moments_for_symbol () */
 static void
-eval_symbol_colors (ChafaCanvas *canvas, ChafaWorkCell *wcell, const ChafaSymbol *sym, SymbolEval *eval)
+eval_symbol_colors (ChafaCanvas *canvas, ChafaWorkCell *wcell, const ChafaSymbol *sym,
+                    const ChafaColorMoments *moments, SymbolEval *eval)
 {
-    if (canvas->config.color_extractor == CHAFA_COLOR_EXTRACTOR_AVERAGE)
-        chafa_work_cell_get_mean_colors_for_symbol (wcell, sym, &eval->colors);
-    else
+    if (canvas->config.color_extractor != CHAFA_COLOR_EXTRACTOR_AVERAGE)
         chafa_work_cell_get_median_colors_for_symbol (wcell, sym, &eval->colors);
+    else if (moments)
+        chafa_color_moments_get_mean_colors (moments, sym, &eval->colors);
+    else
+        chafa_work_cell_get_mean_colors_for_symbol (wcell, sym, &eval->colors);
 }
 
 static void
 eval_symbol_colors_wide (ChafaCanvas *canvas, ChafaWorkCell *wcell_a, ChafaWorkCell *wcell_b,
                          const ChafaSymbol *sym_a, const ChafaSymbol *sym_b,
+                         const ChafaColorMoments *moments_a, const ChafaColorMoments *moments_b,
                          SymbolEval2 *eval)
 {
     SymbolEval part_eval [2];
 
-    eval_symbol_colors (canvas, wcell_a, sym_a, &part_eval [0]);
-    eval_symbol_colors (canvas, wcell_b, sym_b, &part_eval [1]);
+    eval_symbol_colors (canvas, wcell_a, sym_a, moments_a, &part_eval [0]);
+    eval_symbol_colors (canvas, wcell_b, sym_b, moments_b, &part_eval [1]);
 
     eval->colors.colors [CHAFA_COLOR_PAIR_FG]
         = chafa_color_average_2 (part_eval [0].colors.colors [CHAFA_COLOR_PAIR_FG],
@@ -117,7 +157,8 @@ eval_symbol_error (const ChafaWorkCell *wcell,
                    const ChafaSymbol *sym, SymbolEval *eval,
                    const ChafaPalette *fg_palette,
                    const ChafaPalette *bg_palette,
-                   ChafaColorSpace color_space)
+                   ChafaColorSpace color_space,
+                   const ChafaColorMoments *moments)
 {
     const guint8 *covp = (guint8 *) &sym->coverage [0];
     ChafaColorPair pair;
@@ -148,6 +189,13 @@ eval_symbol_error (const ChafaWorkCell *wcell,
         pair = eval->colors;
     }
 
+    if (moments)
+    {
+        eval->error = chafa_color_moments_calc_error (moments, sym, &pair,
+                                                      get_n_error_channels ());
+        return;
+    }
+
 #ifdef HAVE_WASM_SIMD
     error = chafa_calc_cell_error_wasm_simd (wcell->pixels, &pair, sym->mask_u32);
 #elif defined(HAVE_AVX2_INTRINSICS)
@@ -172,7 +220,9 @@ eval_symbol_error_wide (const ChafaWorkCell *wcell_a, const ChafaWorkCell *wcell
                         const ChafaSymbol2 *sym, SymbolEval2 *wide_eval,
                         const ChafaPalette *fg_palette,
                         const ChafaPalette *bg_palette,
-                        ChafaColorSpace color_space)
+                        ChafaColorSpace color_space,
+                        const ChafaColorMoments *moments_a,
+                        const ChafaColorMoments *moments_b)
 {
     SymbolEval eval [2];
 
@@ -180,41 +230,100 @@ eval_symbol_error_wide (const ChafaWorkCell *wcell_a, const ChafaWorkCell *wcell
     eval [1].colors = wide_eval->colors;
 
     eval_symbol_error (wcell_a, &sym->sym [0], &eval [0],
-                       fg_palette, bg_palette, color_space);
+                       fg_palette, bg_palette, color_space, moments_a);
     eval_symbol_error (wcell_b, &sym->sym [1], &eval [1],
-                       fg_palette, bg_palette, color_space);
+                       fg_palette, bg_palette, color_space, moments_b);
 
     wide_eval->error [0] = eval [0].error;
     wide_eval->error [1] = eval [1].error;
 }
 
+/* Cells with pixels below the alpha threshold are left to the palette
+ * lookup, which maps their low-alpha mean colors to the transparent pen */
+static gboolean
+can_search_pen_pairs (ChafaCanvas *canvas, ChafaWorkCell *wcell)
+{
+    return canvas->use_pen_pair_search
+        && chafa_work_cell_get_min_alpha (wcell) >= canvas->config.alpha_threshold;
+}
+
+static const ChafaCellPens *
+get_cell_pens (ChafaCanvas *canvas, ChafaWorkCell *wcell)
+{
+    return chafa_work_cell_get_pens (wcell, canvas->pens, canvas->pen_norms,
+                                     canvas->n_pens, get_n_error_channels ());
+}
+
+/* Picks the pens for each side of the symbol that minimize its error. The
+ * error of one side doesn't depend on the other side's pen, so they can be
+ * picked independently. An empty side keeps its mean color. */
+static void
+eval_symbol_pens (ChafaCanvas *canvas, ChafaWorkCell *wcell, const ChafaSymbol *sym,
+                  SymbolEval *eval)
+{
+    gint fg_sums [3];
+    gint pens [2];
+
+    if (sym->bg_weight == 0 || sym->fg_weight == 0)
+        eval_symbol_colors (canvas, wcell, sym, NULL, eval);
+
+    chafa_work_cell_get_fg_sums_for_symbol (wcell, sym, fg_sums);
+    eval->error = chafa_cell_pens_find_best (get_cell_pens (canvas, wcell),
+                                             canvas->pens, canvas->pen_norms,
+                                             fg_sums, sym->fg_weight, pens);
+
+    if (sym->bg_weight > 0)
+        eval->colors.colors [CHAFA_COLOR_PAIR_BG] = canvas->pens [pens [CHAFA_COLOR_PAIR_BG]];
+    if (sym->fg_weight > 0)
+        eval->colors.colors [CHAFA_COLOR_PAIR_FG] = canvas->pens [pens [CHAFA_COLOR_PAIR_FG]];
+}
+
+/* With use_moments, the symbol is evaluated from the cell's moments
+ * instead of its pixels. This pays off when many symbols are evaluated
+ * for the same cell. The result is the same either way. */
 static void
 eval_symbol (ChafaCanvas *canvas, ChafaWorkCell *wcell, gint sym_index,
+             gboolean use_moments,
              gint *best_sym_index_out, SymbolEval *best_eval_inout)
 {
     const ChafaSymbol *sym;
+    ChafaColorMoments moments_buf [2];
+    const ChafaColorMoments *moments = NULL;
+    gboolean use_pens;
     SymbolEval eval;
 
     sym = &canvas->config.symbol_map.symbols [sym_index];
+    use_pens = can_search_pen_pairs (canvas, wcell);
+
+    if (use_moments && !use_pens)
+    {
+        chafa_work_cell_get_moments_for_symbol (wcell, sym, moments_buf);
+        moments = moments_buf;
+    }
 
     if (canvas->config.fg_only_enabled)
     {
         eval.colors = canvas->default_colors;
     }
-    else
+    else if (!use_pens)
     {
-        eval_symbol_colors (canvas, wcell, sym, &eval);
+        eval_symbol_colors (canvas, wcell, sym, moments, &eval);
     }
 
-    if (canvas->use_quantized_error)
+    if (use_pens)
+    {
+        eval_symbol_pens (canvas, wcell, sym, &eval);
+    }
+    else if (canvas->use_quantized_error)
     {
         eval_symbol_error (wcell, sym, &eval, &canvas->fg_palette,
-                           &canvas->bg_palette, canvas->config.color_space);
+                           &canvas->bg_palette, canvas->config.color_space,
+                           moments);
     }
     else
     {
         eval_symbol_error (wcell, sym, &eval, NULL, NULL,
-                           canvas->config.color_space);
+                           canvas->config.color_space, moments);
     }
 
     if (eval.error < best_eval_inout->error)
@@ -224,35 +333,99 @@ eval_symbol (ChafaCanvas *canvas, ChafaWorkCell *wcell, gint sym_index,
     }
 }
 
+/* Both halves of a wide symbol share the pens, so they're picked for the
+ * pair of cells */
+static void
+eval_symbol_pens_wide (ChafaCanvas *canvas, ChafaWorkCell *wcell_a, ChafaWorkCell *wcell_b,
+                       const ChafaSymbol2 *sym2, SymbolEval2 *eval)
+{
+    const ChafaCellPens *cell_pens_a, *cell_pens_b;
+    ChafaCellPens cell_pens;
+    gint fg_sums [2] [3], wide_fg_sums [3];
+    gint n_pixels [2];
+    gint pens [2];
+    gint i;
+
+    n_pixels [CHAFA_COLOR_PAIR_BG] = sym2->sym [0].bg_weight + sym2->sym [1].bg_weight;
+    n_pixels [CHAFA_COLOR_PAIR_FG] = sym2->sym [0].fg_weight + sym2->sym [1].fg_weight;
+
+    if (n_pixels [CHAFA_COLOR_PAIR_BG] == 0 || n_pixels [CHAFA_COLOR_PAIR_FG] == 0)
+        eval_symbol_colors_wide (canvas, wcell_a, wcell_b, &sym2->sym [0], &sym2->sym [1],
+                                 NULL, NULL, eval);
+
+    cell_pens_a = get_cell_pens (canvas, wcell_a);
+    cell_pens_b = get_cell_pens (canvas, wcell_b);
+    chafa_cell_pens_init_wide (&cell_pens, cell_pens_a, cell_pens_b, canvas->n_pens);
+
+    chafa_work_cell_get_fg_sums_for_symbol (wcell_a, &sym2->sym [0], fg_sums [0]);
+    chafa_work_cell_get_fg_sums_for_symbol (wcell_b, &sym2->sym [1], fg_sums [1]);
+
+    for (i = 0; i < 3; i++)
+        wide_fg_sums [i] = fg_sums [0] [i] + fg_sums [1] [i];
+
+    chafa_cell_pens_find_best (&cell_pens, canvas->pens, canvas->pen_norms,
+                               wide_fg_sums, n_pixels [CHAFA_COLOR_PAIR_FG], pens);
+
+    for (i = 0; i < 2; i++)
+    {
+        if (n_pixels [i] > 0)
+            eval->colors.colors [i] = canvas->pens [pens [i]];
+    }
+
+    eval->error [0] = chafa_cell_pens_calc_error (cell_pens_a, canvas->pens, canvas->pen_norms,
+                                                  fg_sums [0], sym2->sym [0].fg_weight, pens);
+    eval->error [1] = chafa_cell_pens_calc_error (cell_pens_b, canvas->pens, canvas->pen_norms,
+                                                  fg_sums [1], sym2->sym [1].fg_weight, pens);
+}
+
 static void
 eval_symbol_wide (ChafaCanvas *canvas, ChafaWorkCell *wcell_a, ChafaWorkCell *wcell_b,
-                  gint sym_index, gint *best_sym_index_out, SymbolEval2 *best_eval_inout)
+                  gint sym_index, gboolean use_moments,
+                  gint *best_sym_index_out, SymbolEval2 *best_eval_inout)
 {
     const ChafaSymbol2 *sym2;
+    ChafaColorMoments moments_buf [2] [2];
+    const ChafaColorMoments *moments [2] = { NULL, NULL };
+    gboolean use_pens;
     SymbolEval2 eval;
 
     sym2 = &canvas->config.symbol_map.symbols2 [sym_index];
+    use_pens = can_search_pen_pairs (canvas, wcell_a) && can_search_pen_pairs (canvas, wcell_b);
+
+    if (use_moments && !use_pens)
+    {
+        chafa_work_cell_get_moments_for_symbol (wcell_a, &sym2->sym [0], moments_buf [0]);
+        chafa_work_cell_get_moments_for_symbol (wcell_b, &sym2->sym [1], moments_buf [1]);
+        moments [0] = moments_buf [0];
+        moments [1] = moments_buf [1];
+    }
 
     if (canvas->config.fg_only_enabled)
     {
         eval.colors = canvas->default_colors;
     }
-    else
+    else if (!use_pens)
     {
         eval_symbol_colors_wide (canvas, wcell_a, wcell_b,
                                  &sym2->sym [0],
                                  &sym2->sym [1],
+                                 moments [0], moments [1],
                                  &eval);
     }
 
-    if (canvas->use_quantized_error)
+    if (use_pens)
+    {
+        eval_symbol_pens_wide (canvas, wcell_a, wcell_b, sym2, &eval);
+    }
+    else if (canvas->use_quantized_error)
     {
         eval_symbol_error_wide (wcell_a, wcell_b,
                                 sym2,
                                 &eval,
                                 &canvas->fg_palette,
                                 &canvas->bg_palette,
-                                canvas->config.color_space);
+                                canvas->config.color_space,
+                                moments [0], moments [1]);
     }
     else
     {
@@ -261,7 +434,8 @@ eval_symbol_wide (ChafaCanvas *canvas, ChafaWorkCell *wcell_a, ChafaWorkCell *wc
                                 &eval,
                                 NULL,
                                 NULL,
-                                canvas->config.color_space);
+                                canvas->config.color_space,
+                                moments [0], moments [1]);
     }
 
     if (eval.error [0] + eval.error [1] < best_eval_inout->error [0] + best_eval_inout->error [1])
@@ -273,6 +447,8 @@ eval_symbol_wide (ChafaCanvas *canvas, ChafaWorkCell *wcell_a, ChafaWorkCell *wc
 
 static void
 pick_symbol_and_colors_slow (ChafaCanvas *canvas,
+                             const ChafaSymbolUsage *usage,
+                             guint32 *counts,
                              ChafaWorkCell *wcell,
                              gunichar *sym_out,
                              ChafaColorPair *color_pair_out,
@@ -282,19 +458,34 @@ pick_symbol_and_colors_slow (ChafaCanvas *canvas,
     gint best_symbol = -1;
     gint i;
 
-    /* Find best symbol. All symbols are candidates. */
-
     best_eval.error = SYMBOL_ERROR_MAX;
 
-    for (i = 0; canvas->config.symbol_map.symbols [i].c != 0; i++)
-        eval_symbol (canvas, wcell, i, &best_symbol, &best_eval);
+    if (usage && usage->use_hot)
+    {
+        /* Try the symbols the content has been using first. They're in
+         * symbol map order, so ties are broken like in a full search. */
+
+        for (i = 0; i < usage->n_hot [0]; i++)
+            eval_symbol (canvas, wcell, usage->hot [0] [i], TRUE, &best_symbol, &best_eval);
+    }
+
+    if (best_eval.error > USAGE_ERROR_GUARD || best_symbol < 0)
+    {
+        /* Find best symbol. All symbols are candidates. */
+
+        for (i = 0; canvas->config.symbol_map.symbols [i].c != 0; i++)
+            eval_symbol (canvas, wcell, i, TRUE, &best_symbol, &best_eval);
+    }
+
+    if (counts)
+        counts [best_symbol]++;
 
     /* Output */
 
     g_assert (best_symbol >= 0);
 
     if (canvas->extract_colors && canvas->config.fg_only_enabled)
-        eval_symbol_colors (canvas, wcell, &canvas->config.symbol_map.symbols [best_symbol], &best_eval);
+        eval_symbol_colors (canvas, wcell, &canvas->config.symbol_map.symbols [best_symbol], NULL, &best_eval);
 
     *sym_out = canvas->config.symbol_map.symbols [best_symbol].c;
     *color_pair_out = best_eval.colors;
@@ -305,6 +496,8 @@ pick_symbol_and_colors_slow (ChafaCanvas *canvas,
 
 static void
 pick_symbol_and_colors_wide_slow (ChafaCanvas *canvas,
+                                  const ChafaSymbolUsage *usage,
+                                  guint32 *counts,
                                   ChafaWorkCell *wcell_a,
                                   ChafaWorkCell *wcell_b,
                                   gunichar *sym_out,
@@ -316,12 +509,26 @@ pick_symbol_and_colors_wide_slow (ChafaCanvas *canvas,
     gint best_symbol = -1;
     gint i;
 
-    /* Find best symbol. All symbols are candidates. */
-
     best_eval.error [0] = best_eval.error [1] = SYMBOL_ERROR_MAX;
 
-    for (i = 0; canvas->config.symbol_map.symbols2 [i].sym [0].c != 0; i++)
-        eval_symbol_wide (canvas, wcell_a, wcell_b, i, &best_symbol, &best_eval);
+    if (usage && usage->use_hot)
+    {
+        for (i = 0; i < usage->n_hot [1]; i++)
+            eval_symbol_wide (canvas, wcell_a, wcell_b, usage->hot [1] [i], TRUE,
+                              &best_symbol, &best_eval);
+    }
+
+    if (best_eval.error [0] + best_eval.error [1] > USAGE_ERROR_GUARD * 2
+        || best_symbol < 0)
+    {
+        /* Find best symbol. All symbols are candidates. */
+
+        for (i = 0; canvas->config.symbol_map.symbols2 [i].sym [0].c != 0; i++)
+            eval_symbol_wide (canvas, wcell_a, wcell_b, i, TRUE, &best_symbol, &best_eval);
+    }
+
+    if (counts)
+        counts [best_symbol]++;
 
     /* Output */
 
@@ -331,6 +538,7 @@ pick_symbol_and_colors_wide_slow (ChafaCanvas *canvas,
         eval_symbol_colors_wide (canvas, wcell_a, wcell_b,
                                  &canvas->config.symbol_map.symbols2 [best_symbol].sym [0],
                                  &canvas->config.symbol_map.symbols2 [best_symbol].sym [1],
+                                 NULL, NULL,
                                  &best_eval);
 
     *sym_out = canvas->config.symbol_map.symbols2 [best_symbol].sym [0].c;
@@ -384,14 +592,14 @@ pick_symbol_and_colors_fast (ChafaCanvas *canvas,
     best_eval.error = SYMBOL_ERROR_MAX;
 
     for (i = 0; i < n_candidates; i++)
-        eval_symbol (canvas, wcell, candidates [i].symbol_index, &best_symbol, &best_eval);
+        eval_symbol (canvas, wcell, candidates [i].symbol_index, FALSE, &best_symbol, &best_eval);
 
     /* Output */
 
     g_assert (best_symbol >= 0);
 
     if (canvas->extract_colors && canvas->config.fg_only_enabled)
-        eval_symbol_colors (canvas, wcell, &canvas->config.symbol_map.symbols [best_symbol], &best_eval);
+        eval_symbol_colors (canvas, wcell, &canvas->config.symbol_map.symbols [best_symbol], NULL, &best_eval);
 
     *sym_out = canvas->config.symbol_map.symbols [best_symbol].c;
     *color_pair_out = best_eval.colors;
@@ -452,7 +660,7 @@ pick_symbol_and_colors_wide_fast (ChafaCanvas *canvas,
     best_eval.error [0] = best_eval.error [1] = SYMBOL_ERROR_MAX;
 
     for (i = 0; i < n_candidates; i++)
-        eval_symbol_wide (canvas, wcell_a, wcell_b, candidates [i].symbol_index,
+        eval_symbol_wide (canvas, wcell_a, wcell_b, candidates [i].symbol_index, FALSE,
                           &best_symbol, &best_eval);
 
     /* Output */
@@ -463,6 +671,7 @@ pick_symbol_and_colors_wide_fast (ChafaCanvas *canvas,
         eval_symbol_colors_wide (canvas, wcell_a, wcell_b,
                                  &canvas->config.symbol_map.symbols2 [best_symbol].sym [0],
                                  &canvas->config.symbol_map.symbols2 [best_symbol].sym [1],
+                                 NULL, NULL,
                                  &best_eval);
 
     *sym_out = canvas->config.symbol_map.symbols2 [best_symbol].sym [0].c;
@@ -731,8 +940,35 @@ update_cell_colors (ChafaCanvas *canvas, ChafaCanvasCell *cell_out,
         cell_out->bg_color = transparent_cell_color (canvas->config.canvas_mode);
 }
 
+/* With fewer BG than FG pens, as in 16/8 mode, no symbol can fill a cell
+ * with one of the FG-only pens. The solid char can, though (see
+ * quantize_colors_for_cell_16_8 ()), so check if that does better. */
+static void
+pick_solid_pen (ChafaCanvas *canvas, ChafaWorkCell *wcell, gunichar *sym_inout,
+                ChafaColorPair *color_pair_inout, gint *error_inout)
+{
+    gint pen, error;
+
+    if (!canvas->solid_char
+        || canvas->n_pens [CHAFA_COLOR_PAIR_BG] == canvas->n_pens [CHAFA_COLOR_PAIR_FG]
+        || !can_search_pen_pairs (canvas, wcell))
+        return;
+
+    pen = chafa_cell_pens_find_best_solid (get_cell_pens (canvas, wcell), &error);
+    if (error >= *error_inout)
+        return;
+
+    *sym_inout = canvas->solid_char;
+    color_pair_inout->colors [CHAFA_COLOR_PAIR_FG] = canvas->pens [pen];
+    color_pair_inout->colors [CHAFA_COLOR_PAIR_BG] = canvas->pens [pen];
+    *error_inout = error;
+}
+
+/* If usage is non-NULL, the symbol search is adapted to it, and the picks
+ * are added to counts */
 static gint
-update_cell (ChafaCanvas *canvas, ChafaWorkCell *work_cell, ChafaCanvasCell *cell_out)
+update_cell (ChafaCanvas *canvas, const ChafaSymbolUsage *usage, guint32 *counts,
+             ChafaWorkCell *work_cell, ChafaCanvasCell *cell_out)
 {
     gunichar sym = 0;
     ChafaColorPair color_pair;
@@ -742,10 +978,12 @@ update_cell (ChafaCanvas *canvas, ChafaWorkCell *work_cell, ChafaCanvasCell *cel
         return SYMBOL_ERROR_MAX;
 
     if (canvas->work_factor_int >= 8)
-        pick_symbol_and_colors_slow (canvas, work_cell, &sym, &color_pair, &sym_error);
+        pick_symbol_and_colors_slow (canvas, usage, counts, work_cell, &sym, &color_pair, &sym_error);
     else
         pick_symbol_and_colors_fast (canvas, work_cell, &sym, &color_pair, &sym_error);
 
+    pick_solid_pen (canvas, work_cell, &sym, &color_pair, &sym_error);
+
     cell_out->c = sym;
     update_cell_colors (canvas, cell_out, &color_pair);
 
@@ -755,8 +993,46 @@ update_cell (ChafaCanvas *canvas, ChafaWorkCell *work_cell, ChafaCanvasCell *cel
     return sym_error;
 }
 
+/* Cells that are entirely below the alpha threshold end up featureless
+ * and transparent whatever the symbol, so the search is skipped. They get
+ * the state a uniform cell would get from it, and are filled and blanked
+ * like any other featureless cell. */
+static gboolean
+is_transparent_cell (ChafaCanvas *canvas, gint cx, gint cy)
+{
+    gint max_alpha;
+
+    if (!canvas->cull_transparent_cells)
+        return FALSE;
+
+    max_alpha = canvas->cell_max_alpha [cy * canvas->config.width + cx];
+
+    /* Truecolor cells keep their colors' alpha, and the printer treats
+     * blank cells differently from ones with two transparent colors. Only
+     * entirely clear cells are sure to be uniform. */
+    if (canvas->config.canvas_mode == CHAFA_CANVAS_MODE_TRUECOLOR)
+        return max_alpha == 0 && canvas->config.alpha_threshold > 0;
+
+    return max_alpha < canvas->config.alpha_threshold;
+}
+
+static gint
+update_transparent_cell (ChafaCanvas *canvas, ChafaWorkCell *work_cell, ChafaCanvasCell *cell_out)
+{
+    ChafaColorPair color_pair;
+
+    chafa_work_cell_calc_mean_color (work_cell, &color_pair.colors [CHAFA_COLOR_PAIR_BG]);
+    color_pair.colors [CHAFA_COLOR_PAIR_FG] = color_pair.colors [CHAFA_COLOR_PAIR_BG];
+
+    cell_out->c = ' ';
+    update_cell_colors (canvas, cell_out, &color_pair);
+
+    return 0;
+}
+
 static void
-update_cells_wide (ChafaCanvas *canvas, ChafaWorkCell *work_cell_a, ChafaWorkCell *work_cell_b,
+update_cells_wide (ChafaCanvas *canvas, const ChafaSymbolUsage *usage, guint32 *counts,
+                   ChafaWorkCell *work_cell_a, ChafaWorkCell *work_cell_b,
                    ChafaCanvasCell *cell_a_out, ChafaCanvasCell *cell_b_out,
                    gint *error_a_out, gint *error_b_out)
 {
@@ -769,7 +1045,9 @@ update_cells_wide (ChafaCanvas *canvas, ChafaWorkCell *work_cell_a, ChafaWorkCel
         return;
 
     if (canvas->work_factor_int >= 8)
-        pick_symbol_and_colors_wide_slow (canvas, work_cell_a, work_cell_b,
+        pick_symbol_and_colors_wide_slow (canvas, usage,
+                                          counts ? counts + canvas->config.symbol_map.n_symbols : NULL,
+                                          work_cell_a, work_cell_b,
                                           &sym, &color_pair,
                                           error_a_out, error_b_out);
     else
@@ -798,11 +1076,12 @@ update_cells_wide (ChafaCanvas *canvas, ChafaWorkCell *work_cell_a, ChafaWorkCel
 #define buf_cell_index(i) (((i) + N_BUF_CELLS * 64) % N_BUF_CELLS)
 
 static void
-update_cells_row (ChafaCanvas *canvas, gint row)
+update_cells_row (ChafaCanvas *canvas, const ChafaSymbolUsage *usage, guint32 *counts, gint row)
 {
     ChafaCanvasCell *cells;
     ChafaWorkCell work_cells [N_BUF_CELLS];
     gint cell_errors [N_BUF_CELLS];
+    gboolean is_transparent, prev_is_transparent = FALSE;
     gint cx, cy;
 
     cells = &canvas->cells [row * canvas->config.width];
@@ -819,22 +1098,27 @@ update_cells_row (ChafaCanvas *canvas, gint row)
         cells [cx].c = ' ';
 
         chafa_work_cell_init (wcell, canvas->pixels, canvas->width_pixels, cx, cy);
-        cell_errors [buf_index] = update_cell (canvas, wcell, &cells [cx]);
+        is_transparent = is_transparent_cell (canvas, cx, cy);
 
-        /* Try wide symbol */
+        if (is_transparent)
+            cell_errors [buf_index] = update_transparent_cell (canvas, wcell, &cells [cx]);
+        else
+            cell_errors [buf_index] = update_cell (canvas, usage, counts, wcell, &cells [cx]);
+
+        /* Try wide symbol. Transparent cells are left blank. */
 
         /* FIXME: If we're overlapping the rightmost half of a wide symbol,
          * try to revert it to two regular symbols and overwrite the rightmost
          * one. */
 
-        if (cx >= 1 && cells [cx - 1].c != 0)
+        if (cx >= 1 && cells [cx - 1].c != 0 && !is_transparent && !prev_is_transparent)
         {
             gint wide_buf_index [2];
 
             wide_buf_index [0] = buf_cell_index (cx - 1);
             wide_buf_index [1] = buf_index;
 
-            update_cells_wide (canvas,
+            update_cells_wide (canvas, usage, counts,
                                &work_cells [wide_buf_index [0]],
                                &work_cells [wide_buf_index [1]],
                                &wide_cells [0],
@@ -894,31 +1178,149 @@ update_cells_row (ChafaCanvas *canvas, gint row)
                     cells [cx].fg_color = CHAFA_PALETTE_INDEX_FG;
             }
         }
+
+        prev_is_transparent = is_transparent;
     }
 }
 
+static gint
+get_n_usage_counts (ChafaCanvas *canvas)
+{
+    return canvas->config.symbol_map.n_symbols + canvas->config.symbol_map.n_symbols2;
+}
+
 static void
-cell_build_worker (ChafaBatchInfo *batch, ChafaCanvas *canvas)
+cell_build_worker (ChafaBatchInfo *batch, CellBuildCtx *ctx)
 {
+    guint32 *counts = NULL;
     gint i;
 
+    /* Each batch counts symbols on its own; they're merged in the post pass */
+    if (ctx->usage)
+        counts = g_new0 (guint32, get_n_usage_counts (ctx->canvas) + 1);
+
     for (i = 0; i < batch->n_rows; i++)
     {
-        update_cells_row (canvas, batch->first_row + i);
+        update_cells_row (ctx->canvas, ctx->usage, counts, batch->first_row + i);
     }
+
+    batch->ret_p = counts;
+}
+
+static void
+cell_build_post (ChafaBatchInfo *batch, CellBuildCtx *ctx)
+{
+    guint32 *counts = batch->ret_p;
+    gint n_symbols = ctx->canvas->config.symbol_map.n_symbols;
+    gint i;
+
+    if (!counts)
+        return;
+
+    for (i = 0; i < n_symbols; i++)
+        ctx->usage->counts [0] [i] += counts [i];
+    for (i = 0; i < ctx->canvas->config.symbol_map.n_symbols2; i++)
+        ctx->usage->counts [1] [i] += counts [n_symbols + i];
+
+    g_free (counts);
 }
 
+/* Pass usage to adapt the symbol search to it and record the symbols picked */
 static void
-update_cells (ChafaCanvas *canvas)
+update_cells (ChafaCanvas *canvas, ChafaSymbolUsage *usage)
 {
-    chafa_process_batches (canvas,
+    CellBuildCtx ctx;
+
+    ctx.canvas = canvas;
+    ctx.usage = usage;
+
+    chafa_process_batches (&ctx,
                            (GFunc) cell_build_worker,
-                           NULL,  /* _post */
+                           (GFunc) cell_build_post,
                            canvas->config.height,
                            chafa_get_n_actual_threads (),
                            1);
 }
 
+static void
+rebuild_hot_symbols (ChafaSymbolUsage *usage, gint n, gint set)
+{
+    gint i;
+
+    usage->n_hot [set] = 0;
+
+    for (i = 0; i < n; i++)
+    {
+        if (usage->counts [set] [i] > 0)
+            usage->hot [set] [usage->n_hot [set]++] = i;
+    }
+}
+
+/* Decides whether the next frame can use the hot symbols only. Symbol
+ * usage is learned over the first frames, and refreshed with a full
+ * search at regular intervals, so symbols that fall out of use are
+ * eventually dropped and new ones are picked up. */
+static void
+begin_usage_frame (ChafaCanvas *canvas, ChafaSymbolUsage *usage)
+{
+    gint n [2];
+    gint i, set;
+
+    n [0] = canvas->config.symbol_map.n_symbols;
+    n [1] = canvas->config.symbol_map.n_symbols2;
+
+    if (!usage->counts [0])
+    {
+        for (set = 0; set < 2; set++)
+        {
+            usage->counts [set] = g_new0 (guint32, n [set] + 1);
+            usage->hot [set] = g_new (gint, n [set] + 1);
+        }
+    }
+
+    if (usage->n_frames < USAGE_LEARN_FRAMES)
+    {
+        usage->use_hot = FALSE;
+    }
+    else if (usage->n_frames % USAGE_REFRESH_FRAMES == 0)
+    {
+        for (set = 0; set < 2; set++)
+        {
+            for (i = 0; i < n [set]; i++)
+                usage->counts [set] [i] >>= 1;
+        }
+
+        usage->use_hot = FALSE;
+    }
+    else
+    {
+        usage->use_hot = usage->n_hot [0] > 0;
+    }
+}
+
+static void
+end_usage_frame (ChafaCanvas *canvas, ChafaSymbolUsage *usage)
+{
+    usage->n_frames++;
+
+    rebuild_hot_symbols (usage, canvas->config.symbol_map.n_symbols, 0);
+    rebuild_hot_symbols (usage, canvas->config.symbol_map.n_symbols2, 1);
+}
+
+void
+chafa_symbol_renderer_clear_usage (ChafaSymbolUsage *usage)
+{
+    gint set;
+
+    for (set = 0; set < 2; set++)
+    {
+        g_free (usage->counts [set]);
+        g_free (usage->hot [set]);
+    }
+
+    memset (usage, 0, sizeof (*usage));
+}
+
 ChafaSymbolRenderer *
 chafa_symbol_renderer_new (ChafaCanvas *canvas,
 			   gint x, gint y,
@@ -957,11 +1359,19 @@ chafa_symbol_renderer_draw_all_pixels (ChafaSymbolRenderer *renderer,
      * We really shouldn't need this much temporary memory in the first place;
      * it'd be possible to process the image in cell_height strips and hand
      * each strip off to the update_cells() pass independently. The pipelining
-     * would improve throughput too. */
+     * would improve throughput too.
+     *
+     * Storing the pixels cell-major (64 contiguous pixels per cell) so work
+     * cells could reference them in place was tried and measured slower:
+     * Scattering rows into cells costs more in the first pass than the
+     * row-major gather in chafa_work_cell_init() does, and the gather's eight
+     * sequential row streams prefetch at least as well as a single one. */
 
     canvas->pixels = g_try_new (ChafaPixel, (gsize) canvas->width_pixels * canvas->height_pixels);
     if (canvas->pixels)
     {
+	canvas->cell_max_alpha = g_new (guint8, canvas->config.width * canvas->config.height);
+
 	chafa_prepare_pixel_data_for_symbols (&canvas->fg_palette, &canvas->dither,
 					      canvas->config.color_space,
 					      canvas->config.preprocessing_enabled,
@@ -972,6 +1382,7 @@ chafa_symbol_renderer_draw_all_pixels (ChafaSymbolRenderer *renderer,
 					      src_rowstride,
 					      canvas->pixels,
 					      canvas->width_pixels, canvas->height_pixels,
+					      canvas->cell_max_alpha,
 					      canvas->config.cell_width,
 					      canvas->config.cell_height,
 					      halign, valign,
@@ -980,11 +1391,24 @@ chafa_symbol_renderer_draw_all_pixels (ChafaSymbolRenderer *renderer,
 	if (canvas->config.alpha_threshold == 0)
 	    canvas->have_alpha = FALSE;
 
-	update_cells (canvas);
+	/* Only the exhaustive search benefits from adapting to the content */
+	if (canvas->config.adaptive_symbols_enabled && canvas->work_factor_int >= 8)
+	{
+	    begin_usage_frame (canvas, &canvas->symbol_usage);
+	    update_cells (canvas, &canvas->symbol_usage);
+	    end_usage_frame (canvas, &canvas->symbol_usage);
+	}
+	else
+	{
+	    update_cells (canvas, NULL);
+	}
+
 	canvas->needs_clear = FALSE;
 
 	g_free (canvas->pixels);
 	canvas->pixels = NULL;
+	g_free (canvas->cell_max_alpha);
+	canvas->cell_max_alpha = NULL;
     }
     else
     {
@@ -994,3 +1418,52 @@ chafa_symbol_renderer_draw_all_pixels (ChafaSymbolRenderer *renderer,
 #endif
     }
 }
+
+/* Renders the canvas as a window at (x_ofs, y_ofs) into the source image
+ * stretched to virt_width x virt_height cells. Each call is independent of
+ * the others, so windows can be rendered in any order and pieced together. */
+void
+chafa_symbol_renderer_draw_region (ChafaSymbolRenderer *renderer,
+                                   ChafaPixelType src_pixel_type,
+                                   gconstpointer src_pixels,
+                                   gint src_width, gint src_height, gint src_rowstride,
+                                   gint virt_width, gint virt_height,
+                                   gint x_ofs, gint y_ofs)
+{
+    ChafaCanvas *canvas;
+
+    canvas = renderer->canvas;
+
+    canvas->pixels = g_try_new (ChafaPixel, (gsize) canvas->width_pixels * canvas->height_pixels);
+    if (!canvas->pixels)
+        return;
+
+    canvas->cell_max_alpha = g_new (guint8, canvas->config.width * canvas->config.height);
+
+    chafa_prepare_pixel_data_for_symbols_region (&canvas->fg_palette, &canvas->dither,
+                                                 canvas->config.color_space,
+                                                 canvas->config.preprocessing_enabled,
+                                                 canvas->work_factor_int,
+                                                 src_pixel_type,
+                                                 src_pixels,
+                                                 src_width, src_height,
+                                                 src_rowstride,
+                                                 canvas->pixels,
+                                                 canvas->width_pixels, canvas->height_pixels,
+                                                 canvas->cell_max_alpha,
+                                                 virt_width * CHAFA_SYMBOL_WIDTH_PIXELS,
+                                                 virt_height * CHAFA_SYMBOL_HEIGHT_PIXELS,
+                                                 x_ofs * CHAFA_SYMBOL_WIDTH_PIXELS,
+                                                 y_ofs * CHAFA_SYMBOL_HEIGHT_PIXELS);
+
+    if (canvas->config.alpha_threshold == 0)
+        canvas->have_alpha = FALSE;
+
+    update_cells (canvas, NULL);
+    canvas->needs_clear = FALSE;
+
+    g_free (canvas->pixels);
+    canvas->pixels = NULL;
+    g_free (canvas->cell_max_alpha);
+    canvas->cell_max_alpha = NULL;
+}
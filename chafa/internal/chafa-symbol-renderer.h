@@ -21,6 +21,7 @@
 #define __CHAFA_SYMBOL_RENDERER_H__
 
 #include "chafa.h"
+#include "internal/chafa-canvas-internal.h"
 
 G_BEGIN_DECLS
 
@@ -45,6 +46,14 @@ void chafa_symbol_renderer_draw_all_pixels (ChafaSymbolRenderer *symbol_renderer
 					    ChafaAlign halign, ChafaAlign valign,
 					    ChafaTuck tuck,
 					    gfloat quality);
+void chafa_symbol_renderer_draw_region (ChafaSymbolRenderer *symbol_renderer,
+                                        ChafaPixelType src_pixel_type,
+                                        gconstpointer src_pixels,
+                                        gint src_width, gint src_height, gint src_rowstride,
+                                        gint virt_width, gint virt_height,
+                                        gint x_ofs, gint y_ofs);
+
+void chafa_symbol_renderer_clear_usage (ChafaSymbolUsage *usage);
 
 G_END_DECLS
 
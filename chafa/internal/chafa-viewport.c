@@ -0,0 +1,265 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* Copyright (C) 2026 Hans Petter Jansson
+ *
+ * This file is part of Chafa, a program that shows pictures on text terminals.
+ *
+ * Chafa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Chafa is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Chafa.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "config.h"
+
+#include <string.h>
+#include <glib.h>
+#include "chafa.h"
+#include "internal/chafa-canvas-internal.h"
+#include "internal/chafa-symbol-renderer.h"
+#include "internal/chafa-viewport.h"
+
+/* A viewport shows a canvas-sized window into an image zoomed to a fixed
+ * size in cells. The zoomed image is divided into a grid of tiles that are
+ * rendered on demand and kept around, so panning only has to render the
+ * tiles that scroll into view. Each tile is rendered independently of its
+ * neighbors, which makes the result independent of the panning history.
+ *
+ * The tiles are rendered on a private tile-sized canvas with the same
+ * configuration as the one we're drawing to. */
+
+/* Keep at least this many tiles around, even if the viewport is small */
+#define N_TILES_CACHED_MIN 64
+
+struct ChafaViewport
+{
+    ChafaCanvas *canvas;
+
+    ChafaCanvas *tile_canvas;
+    ChafaSymbolRenderer *tile_renderer;
+
+    ChafaPixelType src_pixel_type;
+    gconstpointer src_pixels;
+    gint src_width, src_height;
+    gint src_rowstride;
+
+    gint zoom_width, zoom_height;
+    gint n_tiles_x, n_tiles_y;
+
+    /* n_tiles_x * n_tiles_y, row-major. NULL where not rendered yet. */
+    ChafaCanvasCell **tiles;
+    gint n_tiles_cached;
+    gint n_tiles_cached_max;
+    gint n_tiles_rendered;
+
+    gint x, y;
+};
+
+static ChafaCanvas *
+new_tile_canvas (ChafaCanvas *canvas)
+{
+    ChafaCanvasConfig *config;
+    ChafaCanvas *tile_canvas;
+
+    config = chafa_canvas_config_copy (&canvas->config);
+    chafa_canvas_config_set_geometry (config,
+                                      CHAFA_VIEWPORT_TILE_WIDTH,
+                                      CHAFA_VIEWPORT_TILE_HEIGHT);
+    tile_canvas = chafa_canvas_new (config);
+    chafa_canvas_config_unref (config);
+
+    return tile_canvas;
+}
+
+static ChafaCanvasCell *
+get_tile (ChafaViewport *viewport, gint tx, gint ty)
+{
+    ChafaCanvasCell **tile_p = &viewport->tiles [ty * viewport->n_tiles_x + tx];
+
+    if (!*tile_p)
+    {
+        chafa_symbol_renderer_draw_region (viewport->tile_renderer,
+                                           viewport->src_pixel_type,
+                                           viewport->src_pixels,
+                                           viewport->src_width,
+                                           viewport->src_height,
+                                           viewport->src_rowstride,
+                                           viewport->zoom_width,
+                                           viewport->zoom_height,
+                                           tx * CHAFA_VIEWPORT_TILE_WIDTH,
+                                           ty * CHAFA_VIEWPORT_TILE_HEIGHT);
+
+        *tile_p = g_memdup (viewport->tile_canvas->cells,
+                            CHAFA_VIEWPORT_TILE_WIDTH * CHAFA_VIEWPORT_TILE_HEIGHT
+                            * sizeof (ChafaCanvasCell));
+        viewport->n_tiles_cached++;
+        viewport->n_tiles_rendered++;
+    }
+
+    return *tile_p;
+}
+
+/* Drops tiles more than a viewport's extent away from the visible ones */
+static void
+evict_tiles (ChafaViewport *viewport, gint tx0, gint ty0, gint tx1, gint ty1)
+{
+    gint margin_x = tx1 - tx0 + 1;
+    gint margin_y = ty1 - ty0 + 1;
+    gint tx, ty;
+
+    if (viewport->n_tiles_cached <= viewport->n_tiles_cached_max)
+        return;
+
+    for (ty = 0; ty < viewport->n_tiles_y; ty++)
+    {
+        for (tx = 0; tx < viewport->n_tiles_x; tx++)
+        {
+            ChafaCanvasCell **tile_p = &viewport->tiles [ty * viewport->n_tiles_x + tx];
+
+            if (!*tile_p
+                || (tx >= tx0 - margin_x && tx <= tx1 + margin_x
+                    && ty >= ty0 - margin_y && ty <= ty1 + margin_y))
+                continue;
+
+            g_free (*tile_p);
+            *tile_p = NULL;
+            viewport->n_tiles_cached--;
+        }
+    }
+}
+
+ChafaViewport *
+chafa_viewport_new (ChafaCanvas *canvas,
+                    ChafaPixelType src_pixel_type,
+                    gconstpointer src_pixels,
+                    gint src_width, gint src_height, gint src_rowstride,
+                    gint zoom_width, gint zoom_height)
+{
+    ChafaViewport *viewport;
+    gint n_view_tiles;
+
+    viewport = g_new0 (ChafaViewport, 1);
+    viewport->canvas = canvas;
+
+    viewport->tile_canvas = new_tile_canvas (canvas);
+    viewport->tile_renderer = chafa_symbol_renderer_new (viewport->tile_canvas, 0, 0,
+                                                         CHAFA_VIEWPORT_TILE_WIDTH,
+                                                         CHAFA_VIEWPORT_TILE_HEIGHT);
+
+    viewport->src_pixel_type = src_pixel_type;
+    viewport->src_pixels = src_pixels;
+    viewport->src_width = src_width;
+    viewport->src_height = src_height;
+    viewport->src_rowstride = src_rowstride;
+
+    viewport->zoom_width = zoom_width;
+    viewport->zoom_height = zoom_height;
+
+    /* If the zoomed image is smaller than the canvas, the tiles past its
+     * edges will be transparent. */
+    viewport->n_tiles_x = (MAX (zoom_width, canvas->config.width)
+                           + CHAFA_VIEWPORT_TILE_WIDTH - 1) / CHAFA_VIEWPORT_TILE_WIDTH;
+    viewport->n_tiles_y = (MAX (zoom_height, canvas->config.height)
+                           + CHAFA_VIEWPORT_TILE_HEIGHT - 1) / CHAFA_VIEWPORT_TILE_HEIGHT;
+    viewport->tiles = g_new0 (ChafaCanvasCell *, (gsize) viewport->n_tiles_x * viewport->n_tiles_y);
+
+    /* Worst case number of tiles touched by the viewport, plus a border */
+    n_view_tiles = (canvas->config.width / CHAFA_VIEWPORT_TILE_WIDTH + 2)
+        * (canvas->config.height / CHAFA_VIEWPORT_TILE_HEIGHT + 2);
+    viewport->n_tiles_cached_max = MAX (n_view_tiles * 4, N_TILES_CACHED_MIN);
+
+    viewport->x = -1;
+    viewport->y = -1;
+
+    return viewport;
+}
+
+void
+chafa_viewport_destroy (ChafaViewport *viewport)
+{
+    gint i;
+
+    for (i = 0; i < viewport->n_tiles_x * viewport->n_tiles_y; i++)
+        g_free (viewport->tiles [i]);
+
+    g_free (viewport->tiles);
+    chafa_symbol_renderer_destroy (viewport->tile_renderer);
+    chafa_canvas_unref (viewport->tile_canvas);
+    g_free (viewport);
+}
+
+void
+chafa_viewport_move (ChafaViewport *viewport, gint x, gint y)
+{
+    ChafaCanvas *canvas = viewport->canvas;
+    gint width = canvas->config.width;
+    gint height = canvas->config.height;
+    gint tx0, ty0, tx1, ty1;
+    gint cx, cy;
+
+    x = CLAMP (x, 0, MAX (viewport->zoom_width - width, 0));
+    y = CLAMP (y, 0, MAX (viewport->zoom_height - height, 0));
+
+    tx0 = x / CHAFA_VIEWPORT_TILE_WIDTH;
+    ty0 = y / CHAFA_VIEWPORT_TILE_HEIGHT;
+    tx1 = (x + width - 1) / CHAFA_VIEWPORT_TILE_WIDTH;
+    ty1 = (y + height - 1) / CHAFA_VIEWPORT_TILE_HEIGHT;
+
+    /* Copy from the tiles one tile-wide run at a time */
+
+    for (cy = 0; cy < height; cy++)
+    {
+        gint vy = y + cy;
+        gint ty = vy / CHAFA_VIEWPORT_TILE_HEIGHT;
+        ChafaCanvasCell *cells_out = &canvas->cells [cy * width];
+
+        for (cx = 0; cx < width; )
+        {
+            gint vx = x + cx;
+            gint tx = vx / CHAFA_VIEWPORT_TILE_WIDTH;
+            gint ofs = vx % CHAFA_VIEWPORT_TILE_WIDTH;
+            gint n = MIN (CHAFA_VIEWPORT_TILE_WIDTH - ofs, width - cx);
+            const ChafaCanvasCell *tile = get_tile (viewport, tx, ty);
+
+            memcpy (&cells_out [cx],
+                    &tile [(vy % CHAFA_VIEWPORT_TILE_HEIGHT) * CHAFA_VIEWPORT_TILE_WIDTH + ofs],
+                    n * sizeof (ChafaCanvasCell));
+            cx += n;
+        }
+
+        /* The edges may cut through wide symbols. Blank out the halves
+         * that are left, since they can't be printed on their own. */
+        if (cells_out [0].c == 0)
+            cells_out [0].c = canvas->blank_char;
+        if (cells_out [width - 1].c != 0 && g_unichar_iswide (cells_out [width - 1].c))
+            cells_out [width - 1].c = canvas->blank_char;
+    }
+
+    canvas->needs_clear = FALSE;
+    viewport->x = x;
+    viewport->y = y;
+
+    evict_tiles (viewport, tx0, ty0, tx1, ty1);
+}
+
+void
+chafa_viewport_get_position (ChafaViewport *viewport, gint *x_out, gint *y_out)
+{
+    if (x_out)
+        *x_out = viewport->x;
+    if (y_out)
+        *y_out = viewport->y;
+}
+
+gint
+chafa_viewport_get_n_tiles_rendered (ChafaViewport *viewport)
+{
+    return viewport->n_tiles_rendered;
+}
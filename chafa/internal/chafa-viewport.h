@@ -0,0 +1,47 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* Copyright (C) 2026 Hans Petter Jansson
+ *
+ * This file is part of Chafa, a program that shows pictures on text terminals.
+ *
+ * Chafa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Chafa is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Chafa.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef __CHAFA_VIEWPORT_H__
+#define __CHAFA_VIEWPORT_H__
+
+#include <glib.h>
+#include "chafa.h"
+
+G_BEGIN_DECLS
+
+/* Viewport tile size in cells */
+#define CHAFA_VIEWPORT_TILE_WIDTH 32
+#define CHAFA_VIEWPORT_TILE_HEIGHT 16
+
+typedef struct ChafaViewport ChafaViewport;
+
+ChafaViewport *chafa_viewport_new (ChafaCanvas *canvas,
+                                   ChafaPixelType src_pixel_type,
+                                   gconstpointer src_pixels,
+                                   gint src_width, gint src_height, gint src_rowstride,
+                                   gint zoom_width, gint zoom_height);
+void chafa_viewport_destroy (ChafaViewport *viewport);
+
+void chafa_viewport_move (ChafaViewport *viewport, gint x, gint y);
+void chafa_viewport_get_position (ChafaViewport *viewport, gint *x_out, gint *y_out);
+gint chafa_viewport_get_n_tiles_rendered (ChafaViewport *viewport);
+
+G_END_DECLS
+
+#endif /* __CHAFA_VIEWPORT_H__ */
@@ -147,6 +147,396 @@ chafa_work_cell_to_bitmap (const ChafaWorkCell *wcell, const ChafaColorPair *col
     return bitmap;
 }
 
+/* Builds the moments of every subset of each four-pixel run. Subsets are
+ * indexed by a bitmap nibble, so the run's first pixel is the MSB. Each
+ * subset is a smaller one plus the pixel for its highest bit. */
+static void
+work_cell_build_run_moments (ChafaWorkCell *wcell)
+{
+    gint run, bit, mask, ch;
+
+    for (run = 0; run < CHAFA_WORK_CELL_N_RUNS; run++)
+    {
+        ChafaColorMoments *m = wcell->run_moments [run];
+
+        memset (&m [0], 0, sizeof (m [0]));
+
+        for (bit = 0; bit < 4; bit++)
+        {
+            const ChafaPixel *pixel = &wcell->pixels [run * 4 + 3 - bit];
+
+            for (mask = 1 << bit; mask < 2 << bit; mask++)
+            {
+                const ChafaColorMoments *rest = &m [mask - (1 << bit)];
+
+                for (ch = 0; ch < 4; ch++)
+                {
+                    gint32 v = pixel->col.ch [ch];
+
+                    m [mask].sum [ch] = rest->sum [ch] + v;
+                    m [mask].sum_sq [ch] = rest->sum_sq [ch] + v * v;
+                }
+            }
+        }
+    }
+
+    memset (&wcell->total_moments, 0, sizeof (wcell->total_moments));
+
+    for (run = 0; run < CHAFA_WORK_CELL_N_RUNS; run++)
+    {
+        for (ch = 0; ch < 4; ch++)
+        {
+            wcell->total_moments.sum [ch] += wcell->run_moments [run] [0xf].sum [ch];
+            wcell->total_moments.sum_sq [ch] += wcell->run_moments [run] [0xf].sum_sq [ch];
+        }
+    }
+
+    wcell->have_run_moments = TRUE;
+}
+
+/* Gets the moments of the symbol's background and foreground pixels,
+ * indexed by CHAFA_COLOR_PAIR_BG and CHAFA_COLOR_PAIR_FG. After the first
+ * call, this costs a few table lookups instead of a pass over the pixels. */
+void
+chafa_work_cell_get_moments_for_symbol (ChafaWorkCell *wcell, const ChafaSymbol *sym,
+                                        ChafaColorMoments *moments_out)
+{
+    ChafaColorMoments fg = { { 0 }, { 0 } };
+    guint64 bitmap = sym->bitmap;
+    gint run, ch;
+
+    if (!wcell->have_run_moments)
+        work_cell_build_run_moments (wcell);
+
+    /* Last run first, so the nibble is always in the low bits */
+    for (run = CHAFA_WORK_CELL_N_RUNS - 1; run >= 0; run--)
+    {
+        const ChafaColorMoments *m = &wcell->run_moments [run] [bitmap & 0xf];
+
+        for (ch = 0; ch < 4; ch++)
+        {
+            fg.sum [ch] += m->sum [ch];
+            fg.sum_sq [ch] += m->sum_sq [ch];
+        }
+
+        bitmap >>= 4;
+    }
+
+    for (ch = 0; ch < 4; ch++)
+    {
+        moments_out [CHAFA_COLOR_PAIR_BG].sum [ch] = wcell->total_moments.sum [ch] - fg.sum [ch];
+        moments_out [CHAFA_COLOR_PAIR_BG].sum_sq [ch] = wcell->total_moments.sum_sq [ch] - fg.sum_sq [ch];
+    }
+
+    moments_out [CHAFA_COLOR_PAIR_FG] = fg;
+}
+
+/* Same result as chafa_work_cell_get_mean_colors_for_symbol () */
+void
+chafa_color_moments_get_mean_colors (const ChafaColorMoments *moments, const ChafaSymbol *sym,
+                                     ChafaColorPair *color_pair_out)
+{
+    ChafaColorAccum accums [2];
+    gint i, ch;
+
+    for (i = 0; i < 2; i++)
+    {
+        for (ch = 0; ch < 4; ch++)
+            accums [i].ch [ch] = moments [i].sum [ch];
+    }
+
+    if (sym->fg_weight > 1)
+        chafa_color_accum_div_scalar (&accums [CHAFA_COLOR_PAIR_FG], sym->fg_weight);
+
+    if (sym->bg_weight > 1)
+        chafa_color_accum_div_scalar (&accums [CHAFA_COLOR_PAIR_BG], sym->bg_weight);
+
+    accum_to_color (&accums [CHAFA_COLOR_PAIR_BG], &color_pair_out->colors [CHAFA_COLOR_PAIR_BG]);
+    accum_to_color (&accums [CHAFA_COLOR_PAIR_FG], &color_pair_out->colors [CHAFA_COLOR_PAIR_FG]);
+}
+
+/* Sum of squared differences between the pixels and the color pair, over
+ * the first n_channels channels. For each side of the symbol, that's
+ * sum (x^2) - 2 * c * sum (x) + n * c^2, which is exact in integers for
+ * any c. */
+gint
+chafa_color_moments_calc_error (const ChafaColorMoments *moments, const ChafaSymbol *sym,
+                                const ChafaColorPair *color_pair, gint n_channels)
+{
+    const gint n [2] = { sym->bg_weight, sym->fg_weight };
+    gint error = 0;
+    gint i, ch;
+
+    for (i = 0; i < 2; i++)
+    {
+        const ChafaColor *col = &color_pair->colors [i];
+
+        for (ch = 0; ch < n_channels; ch++)
+        {
+            gint c = col->ch [ch];
+
+            error += moments [i].sum_sq [ch]
+                - 2 * c * moments [i].sum [ch]
+                + n [i] * c * c;
+        }
+    }
+
+    return error;
+}
+
+/* Lowest alpha in the cell */
+gint
+chafa_work_cell_get_min_alpha (ChafaWorkCell *wcell)
+{
+    gint i;
+
+    if (wcell->min_alpha >= 0)
+        return wcell->min_alpha;
+
+    wcell->min_alpha = 0xff;
+
+    for (i = 0; i < CHAFA_SYMBOL_N_PIXELS; i++)
+        wcell->min_alpha = MIN (wcell->min_alpha, wcell->pixels [i].col.ch [3]);
+
+    return wcell->min_alpha;
+}
+
+/* Sums of the color channels over the pixels covered by the symbol. This
+ * is all the pen search needs, so the sums of squares are left out. */
+void
+chafa_work_cell_get_fg_sums_for_symbol (ChafaWorkCell *wcell, const ChafaSymbol *sym,
+                                        gint *sums_out)
+{
+    guint64 bitmap = sym->bitmap;
+    gint run;
+
+    if (!wcell->have_run_moments)
+        work_cell_build_run_moments (wcell);
+
+    sums_out [0] = sums_out [1] = sums_out [2] = 0;
+
+    /* Last run first, so the nibble is always in the low bits */
+    for (run = CHAFA_WORK_CELL_N_RUNS - 1; run >= 0; run--)
+    {
+        const gint32 *m = wcell->run_moments [run] [bitmap & 0xf].sum;
+
+        sums_out [0] += m [0];
+        sums_out [1] += m [1];
+        sums_out [2] += m [2];
+        bitmap >>= 4;
+    }
+}
+
+/* Finds the pens that could be nearest some point in the box from lo to hi.
+ * None can be nearer than the pen whose farthest point in the box is the
+ * nearest, so pens whose nearest point in the box is farther than that
+ * are left out. */
+static void
+find_candidate_pens (const gint *lo, const gint *hi, const ChafaColor *pens, gint n_pens,
+                     guint8 *candidates_out, gint *n_candidates_out)
+{
+    gint min_dist [CHAFA_WORK_CELL_N_PENS_MAX];
+    gint max_dist_limit = G_MAXINT;
+    gint n_candidates = 0;
+    gint i, ch;
+
+    for (i = 0; i < n_pens; i++)
+    {
+        gint max_dist = 0;
+
+        min_dist [i] = 0;
+
+        for (ch = 0; ch < 3; ch++)
+        {
+            gint c = pens [i].ch [ch];
+            gint d;
+
+            d = c < lo [ch] ? lo [ch] - c : c > hi [ch] ? c - hi [ch] : 0;
+            min_dist [i] += d * d;
+            d = MAX (c - lo [ch], hi [ch] - c);
+            max_dist += d * d;
+        }
+
+        max_dist_limit = MIN (max_dist_limit, max_dist);
+    }
+
+    for (i = 0; i < n_pens; i++)
+    {
+        if (min_dist [i] <= max_dist_limit)
+            candidates_out [n_candidates++] = i;
+    }
+
+    *n_candidates_out = n_candidates;
+}
+
+/* The error of pen c over n pixels x is sum (x^2) - 2 * c * sum (x)
+ * + n * |c|^2. The first term, summed over both sides of a symbol, is the
+ * same for any symbol, and since the pens are all opaque, so is the part
+ * from any channels past the color ones. That goes in base_error. The
+ * rest is in errors, for each pen over the whole cell.
+ *
+ * The mean of any set of pixels is inside their bounding box, so only the
+ * pens that could be nearest a point in it are candidates. pen_norms holds
+ * the |c|^2, over the color channels only, and n_pens the number of BG and
+ * FG pens, with the BG pens coming first. */
+const ChafaCellPens *
+chafa_work_cell_get_pens (ChafaWorkCell *wcell, const ChafaColor *pens,
+                          const gint *pen_norms, const gint *n_pens, gint n_channels)
+{
+    gint sum [4] = { 0, 0, 0, 0 };
+    gint lo [3] = { 255, 255, 255 }, hi [3] = { 0, 0, 0 };
+    gint i, ch;
+
+    if (wcell->have_pens)
+        return &wcell->pens;
+
+    wcell->pens.base_error = 0;
+
+    for (i = 0; i < CHAFA_SYMBOL_N_PIXELS; i++)
+    {
+        const guint8 *x = wcell->pixels [i].col.ch;
+
+        for (ch = 0; ch < n_channels; ch++)
+        {
+            sum [ch] += x [ch];
+            wcell->pens.base_error += x [ch] * x [ch];
+        }
+
+        for (ch = 0; ch < 3; ch++)
+        {
+            lo [ch] = MIN (lo [ch], x [ch]);
+            hi [ch] = MAX (hi [ch], x [ch]);
+        }
+    }
+
+    for (ch = 3; ch < n_channels; ch++)
+    {
+        gint c = pens [0].ch [ch];
+
+        wcell->pens.base_error += (CHAFA_SYMBOL_N_PIXELS * c - 2 * sum [ch]) * c;
+    }
+
+    for (i = 0; i < n_pens [CHAFA_COLOR_PAIR_FG]; i++)
+    {
+        const guint8 *c = pens [i].ch;
+
+        wcell->pens.errors [i] = CHAFA_SYMBOL_N_PIXELS * pen_norms [i]
+            - 2 * (c [0] * sum [0] + c [1] * sum [1] + c [2] * sum [2]);
+    }
+
+    for (i = 0; i < 2; i++)
+        find_candidate_pens (lo, hi, pens, n_pens [i],
+                             wcell->pens.candidates [i], &wcell->pens.n_candidates [i]);
+
+    wcell->have_pens = TRUE;
+    return &wcell->pens;
+}
+
+/* For a pair of cells, every pen is a candidate */
+void
+chafa_cell_pens_init_wide (ChafaCellPens *cell_pens, const ChafaCellPens *cell_pens_a,
+                           const ChafaCellPens *cell_pens_b, const gint *n_pens)
+{
+    gint i, j;
+
+    cell_pens->base_error = cell_pens_a->base_error + cell_pens_b->base_error;
+
+    for (i = 0; i < n_pens [CHAFA_COLOR_PAIR_FG]; i++)
+        cell_pens->errors [i] = cell_pens_a->errors [i] + cell_pens_b->errors [i];
+
+    for (i = 0; i < 2; i++)
+    {
+        for (j = 0; j < n_pens [i]; j++)
+            cell_pens->candidates [i] [j] = j;
+
+        cell_pens->n_candidates [i] = n_pens [i];
+    }
+}
+
+/* A pen's FG error (as above) over the n_fg_pixels with sums fg_sums, less
+ * the sums of squares. Its BG error is what's left of its error over the
+ * whole cell. */
+static inline gint
+calc_fg_pen_error (const ChafaColor *pens, const gint *pen_norms, const gint *fg_sums,
+                   gint n_fg_pixels, gint pen)
+{
+    const guint8 *c = pens [pen].ch;
+
+    return n_fg_pixels * pen_norms [pen]
+        - 2 * (c [0] * fg_sums [0] + c [1] * fg_sums [1] + c [2] * fg_sums [2]);
+}
+
+/* Finds the BG and FG pens giving a symbol the lowest error, which are
+ * just the candidates nearest the exact mean of each side. Returns the
+ * error. */
+gint
+chafa_cell_pens_find_best (const ChafaCellPens *cell_pens, const ChafaColor *pens,
+                           const gint *pen_norms, const gint *fg_sums, gint n_fg_pixels,
+                           gint *pens_out)
+{
+    gint best_error [2] = { G_MAXINT, G_MAXINT };
+    gint i, j;
+
+    pens_out [0] = pens_out [1] = 0;
+
+    for (i = 0; i < 2; i++)
+    {
+        for (j = 0; j < cell_pens->n_candidates [i]; j++)
+        {
+            gint pen = cell_pens->candidates [i] [j];
+            gint error;
+
+            error = calc_fg_pen_error (pens, pen_norms, fg_sums, n_fg_pixels, pen);
+            if (i == CHAFA_COLOR_PAIR_BG)
+                error = cell_pens->errors [pen] - error;
+
+            if (error < best_error [i])
+            {
+                pens_out [i] = pen;
+                best_error [i] = error;
+            }
+        }
+    }
+
+    return cell_pens->base_error + best_error [0] + best_error [1];
+}
+
+/* Error of a symbol with the given pens */
+gint
+chafa_cell_pens_calc_error (const ChafaCellPens *cell_pens, const ChafaColor *pens,
+                            const gint *pen_norms, const gint *fg_sums, gint n_fg_pixels,
+                            const gint *pens_in)
+{
+    gint bg_pen = pens_in [CHAFA_COLOR_PAIR_BG], fg_pen = pens_in [CHAFA_COLOR_PAIR_FG];
+
+    return cell_pens->base_error
+        + cell_pens->errors [bg_pen]
+        - calc_fg_pen_error (pens, pen_norms, fg_sums, n_fg_pixels, bg_pen)
+        + calc_fg_pen_error (pens, pen_norms, fg_sums, n_fg_pixels, fg_pen);
+}
+
+/* Finds the FG pen giving the lowest error over the whole cell */
+gint
+chafa_cell_pens_find_best_solid (const ChafaCellPens *cell_pens, gint *error_out)
+{
+    gint best_pen = 0, best_error = G_MAXINT;
+    gint i;
+
+    for (i = 0; i < cell_pens->n_candidates [CHAFA_COLOR_PAIR_FG]; i++)
+    {
+        gint pen = cell_pens->candidates [CHAFA_COLOR_PAIR_FG] [i];
+
+        if (cell_pens->errors [pen] < best_error)
+        {
+            best_pen = pen;
+            best_error = cell_pens->errors [pen];
+        }
+    }
+
+    *error_out = cell_pens->base_error + best_error;
+    return best_pen;
+}
+
 /* Get cell's pixels sorted by a specific channel. Sorts on demand and caches
  * the results. */
 static const guint8 *
@@ -172,6 +562,9 @@ chafa_work_cell_init (ChafaWorkCell *wcell, const ChafaPixel *src_image,
             sizeof (wcell->have_pixels_sorted_by_channel));
     fetch_canvas_pixel_block (src_image, src_width, wcell->pixels, cx, cy);
     wcell->dominant_channel = -1;
+    wcell->have_run_moments = FALSE;
+    wcell->have_pens = FALSE;
+    wcell->min_alpha = -1;
 }
 
 static gint
@@ -24,12 +24,55 @@ G_BEGIN_DECLS
 
 typedef struct ChafaWorkCell ChafaWorkCell;
 
+/* Per-channel sums and sums of squares over a set of pixels */
+typedef struct
+{
+    gint32 sum [4];
+    gint32 sum_sq [4];
+}
+ChafaColorMoments;
+
+#define CHAFA_WORK_CELL_N_RUNS (CHAFA_SYMBOL_N_PIXELS / 4)
+
+/* Largest palette the pen search is used with */
+#define CHAFA_WORK_CELL_N_PENS_MAX 16
+
+/* Pens for a set of pixels: The part of their error that's the same for
+ * any pens, each pen's error over all of them less that part, and the BG
+ * and FG pens that could be nearest the mean of any subset of them.
+ *
+ * There's no image of pixels pre-mapped to their nearest pens. The best
+ * pen for a side of a symbol is the one nearest the side's mean, which
+ * the pixels' nearest pens don't tell, so matching symbols against such
+ * an image would change the output. The per-cell tables get the same
+ * savings without that. */
+typedef struct
+{
+    gint base_error;
+    gint errors [CHAFA_WORK_CELL_N_PENS_MAX];
+    guint8 candidates [2] [CHAFA_WORK_CELL_N_PENS_MAX];
+    gint n_candidates [2];
+}
+ChafaCellPens;
+
 struct ChafaWorkCell
 {
     ChafaPixel pixels [CHAFA_SYMBOL_N_PIXELS];
     guint8 pixels_sorted_index [4] [CHAFA_SYMBOL_N_PIXELS];
     guint8 have_pixels_sorted_by_channel [4];
     gint dominant_channel;
+
+    /* Moments of every subset of each run of four pixels, indexed by the
+     * run's nibble in a symbol bitmap. Built on demand. */
+    ChafaColorMoments run_moments [CHAFA_WORK_CELL_N_RUNS] [16];
+    ChafaColorMoments total_moments;
+    gboolean have_run_moments;
+
+    /* The pens for the one set of them the cell is rendered with. Built
+     * on demand. */
+    ChafaCellPens pens;
+    gboolean have_pens;
+    gint min_alpha;
 };
 
 /* Currently unused */
@@ -51,6 +94,29 @@ void chafa_work_cell_get_contrasting_color_pair (ChafaWorkCell *wcell, ChafaColo
 void chafa_work_cell_calc_mean_color (const ChafaWorkCell *wcell, ChafaColor *color_out);
 guint64 chafa_work_cell_to_bitmap (const ChafaWorkCell *wcell, const ChafaColorPair *color_pair);
 
+void chafa_work_cell_get_moments_for_symbol (ChafaWorkCell *wcell, const ChafaSymbol *sym,
+                                             ChafaColorMoments *moments_out);
+void chafa_color_moments_get_mean_colors (const ChafaColorMoments *moments, const ChafaSymbol *sym,
+                                          ChafaColorPair *color_pair_out);
+gint chafa_color_moments_calc_error (const ChafaColorMoments *moments, const ChafaSymbol *sym,
+                                     const ChafaColorPair *color_pair, gint n_channels);
+gint chafa_work_cell_get_min_alpha (ChafaWorkCell *wcell);
+void chafa_work_cell_get_fg_sums_for_symbol (ChafaWorkCell *wcell, const ChafaSymbol *sym,
+                                             gint *sums_out);
+const ChafaCellPens *chafa_work_cell_get_pens (ChafaWorkCell *wcell, const ChafaColor *pens,
+                                               const gint *pen_norms, const gint *n_pens,
+                                               gint n_channels);
+
+void chafa_cell_pens_init_wide (ChafaCellPens *cell_pens, const ChafaCellPens *cell_pens_a,
+                                const ChafaCellPens *cell_pens_b, const gint *n_pens);
+gint chafa_cell_pens_find_best (const ChafaCellPens *cell_pens, const ChafaColor *pens,
+                                const gint *pen_norms, const gint *fg_sums, gint n_fg_pixels,
+                                gint *pens_out);
+gint chafa_cell_pens_calc_error (const ChafaCellPens *cell_pens, const ChafaColor *pens,
+                                 const gint *pen_norms, const gint *fg_sums, gint n_fg_pixels,
+                                 const gint *pens_in);
+gint chafa_cell_pens_find_best_solid (const ChafaCellPens *cell_pens, gint *error_out);
+
 G_END_DECLS
 
 #endif /* __CHAFA_WORK_CELL_H__ */
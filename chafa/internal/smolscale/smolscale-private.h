@@ -405,6 +405,9 @@ const SmolImplementation *_smol_get_generic_implementation (void);
 #ifdef SMOL_WITH_AVX2
 const SmolImplementation *_smol_get_avx2_implementation (void);
 #endif
+#ifdef SMOL_WITH_SSE41
+const SmolImplementation *_smol_get_sse41_implementation (void);
+#endif
 
 #ifdef __cplusplus
 }
@@ -647,6 +647,22 @@ have_avx2 (void)
 
 #endif
 
+#ifdef SMOL_WITH_SSE41
+
+static SmolBool
+have_sse41 (void)
+{
+    __builtin_cpu_init ();
+
+    if (__builtin_cpu_supports ("sse4.1")
+        && __builtin_cpu_supports ("ssse3"))
+        return TRUE;
+
+    return FALSE;
+}
+
+#endif
+
 static SmolBool
 host_is_little_endian (void)
 {
@@ -930,8 +946,12 @@ get_implementations (SmolScaleCtx *scale_ctx, const void *color_pixel, SmolPixel
     if (!(scale_ctx->flags & SMOL_DISABLE_ACCELERATION))
     {
 #ifdef SMOL_WITH_AVX2
-        if (have_avx2 ())
+        if (have_avx2 () && !(scale_ctx->flags & SMOL_DISABLE_AVX2))
             implementations [i++] = _smol_get_avx2_implementation ();
+#endif
+#ifdef SMOL_WITH_SSE41
+        if (have_sse41 ())
+            implementations [i++] = _smol_get_sse41_implementation ();
 #endif
     }
 
@@ -24,7 +24,10 @@ typedef enum
 {
     SMOL_NO_FLAGS                   = 0,
     SMOL_DISABLE_ACCELERATION       = (1 << 0),
-    SMOL_DISABLE_SRGB_LINEARIZATION = (1 << 1)
+    SMOL_DISABLE_SRGB_LINEARIZATION = (1 << 1),
+
+    /* Use SSE4.1 and SSSE3 even if AVX2 is available */
+    SMOL_DISABLE_AVX2               = (1 << 2)
 }
 SmolFlags;
 
@@ -42,6 +42,9 @@
 /** Transparent colour */
 #define GIF_TRANSPARENT_COLOUR 0x00
 
+/** Transparency index for frames without transparency */
+#define GIF_NO_TRANSPARENCY 0xffffffffU
+
 /* GIF Flags */
 /* #define GIF_FRAME_COMBINE 1 */ /* Unused macro */
 #define GIF_FRAME_CLEAR 2
@@ -105,6 +108,11 @@ gif_initialise_sprite(gif_animation *gif,
         gif->width = max_width;
         gif->height = max_height;
 
+        /* Frames that covered the old area may not cover the new one */
+        for (unsigned int i = 1; i < gif->frame_count_partial; i++) {
+                gif->frames[i].keyframe = false;
+        }
+
         /* Invalidate our currently decoded image */
         gif->decoded_frame = GIF_INVALID_FRAME;
         return GIF_OK;
@@ -236,6 +244,56 @@ gif_initialise_frame_extensions(gif_animation *gif, const int frame)
 }
 
 
+/**
+ * Checks whether a frame's redraw rectangle covers the whole image
+ *
+ * \param gif The animation context
+ * \param frame The frame number
+ * \return true if the frame covers the image
+ */
+static bool gif_frame_covers_image(gif_animation *gif, unsigned int frame)
+{
+        const gif_frame *f = &gif->frames[frame];
+
+        return f->redraw_x == 0 && f->redraw_y == 0 &&
+               f->redraw_width >= gif->width &&
+               f->redraw_height >= gif->height;
+}
+
+
+/**
+ * Determines whether a frame can be decoded from a blank image
+ *
+ * A keyframe's decoded image does not depend on any previous frame. This is
+ * the case for the first frame, for opaque frames that cover the whole image,
+ * and for frames following a frame that clears the whole image to
+ * transparency.
+ *
+ * \param gif The animation context
+ * \param frame The frame number
+ * \return true if the frame is a keyframe
+ */
+static bool gif_frame_is_keyframe(gif_animation *gif, unsigned int frame)
+{
+        const gif_frame *prev;
+
+        if (frame == 0) {
+                return true;
+        }
+
+        if (!gif->frames[frame].transparency &&
+            gif_frame_covers_image(gif, frame)) {
+                return true;
+        }
+
+        prev = &gif->frames[frame - 1];
+        return prev->display &&
+               prev->disposal_method == GIF_FRAME_CLEAR &&
+               prev->transparency &&
+               gif_frame_covers_image(gif, frame - 1);
+}
+
+
 /**
  * Attempts to initialise the next frame
  *
@@ -314,6 +372,7 @@ static gif_result gif_initialise_frame(gif_animation *gif)
         gif->frames[frame].transparency = false;
         gif->frames[frame].frame_delay = 0;
         gif->frames[frame].redraw_required = false;
+        gif->frames[frame].keyframe = false;
 
         /* Invalidate any previous decoding we have of this frame */
         if (gif->decoded_frame == frame) {
@@ -461,6 +520,8 @@ static gif_result gif_initialise_frame(gif_animation *gif)
         gif->buffer_position = gif_data - gif->gif_data;
         gif->frame_count = frame + 1;
         gif->frames[frame].display = true;
+        gif->frames[frame].keyframe = !premature_eof &&
+                gif_frame_is_keyframe(gif, frame);
 
         /* Check if we've finished */
         if (gif_bytes < 1) {
@@ -573,6 +634,149 @@ static gif_result gif_error_from_lzw(lzw_result l_res)
 }
 
 
+static gif_result
+gif_internal_decode_frame(gif_animation *gif,
+                          unsigned int frame,
+                          bool clear_image);
+
+
+/**
+ * Brings the decoded image up to date with a frame
+ *
+ * Decodes the frames leading up to and including the given frame, starting
+ * from the currently decoded frame if it precedes it, or otherwise from the
+ * closest preceding keyframe.
+ *
+ * \param gif gif animation context.
+ * \param frame The frame number to end at.
+ * \return GIF_OK on success, or appropriate error code otherwise.
+ */
+static gif_result
+gif_decode_frames_to(gif_animation *gif, unsigned int frame)
+{
+        unsigned int start = frame;
+        gif_result return_value;
+
+        if ((int)frame == gif->decoded_frame) {
+                return GIF_OK;
+        }
+
+        while ((start > 0) &&
+               !gif->frames[start].keyframe &&
+               ((int)start - 1 != gif->decoded_frame)) {
+                start--;
+        }
+
+        for (; start <= frame; start++) {
+                return_value = gif_internal_decode_frame(gif, start, false);
+
+                /* Damaged frames are plotted as far as possible, as they
+                 * would be during sequential decoding. */
+                if ((return_value != GIF_OK) &&
+                    (return_value != GIF_INSUFFICIENT_FRAME_DATA) &&
+                    (return_value != GIF_FRAME_DATA_ERROR)) {
+                        return return_value;
+                }
+        }
+
+        return GIF_OK;
+}
+
+
+/**
+ * Prepares the image for plotting a frame
+ *
+ * Brings the image to the state the frame is to be plotted on: A clear image
+ * for keyframes, or otherwise the previous frame with its disposal method
+ * applied. If the previous frame is not the one currently decoded, it is
+ * decoded first, starting from the closest keyframe.
+ *
+ * This must be done before the frame's colour table is set up, since
+ * decoding other frames may overwrite it.
+ *
+ * \param gif gif animation context.
+ * \param frame The frame number to prepare for.
+ * \return GIF_OK on success, or appropriate error code otherwise.
+ */
+static gif_result
+gif_prepare_frame(gif_animation *gif, unsigned int frame)
+{
+        unsigned int *frame_data;
+        gif_result return_value;
+
+        /* If this frame doesn't follow the one we have decoded, and it
+         * depends on the previous frames, bring the image up to date
+         * starting from the closest keyframe.
+         */
+        if ((frame != 0) &&
+            !gif->frames[frame].keyframe &&
+            (gif->decoded_frame != (int)frame - 1)) {
+                return_value = gif_decode_frames_to(gif, frame - 1);
+                if (return_value != GIF_OK) {
+                        return return_value;
+                }
+        }
+
+        assert(gif->bitmap_callbacks.bitmap_get_buffer);
+        frame_data = (void *)gif->bitmap_callbacks.bitmap_get_buffer(gif->frame_image);
+        if (!frame_data) {
+                return GIF_INSUFFICIENT_MEMORY;
+        }
+
+        /* If this is a keyframe, we start from a clear image. Otherwise, if
+         * the previous frame's disposal method requires it, restore the
+         * background colour or the previous image.
+         */
+        if ((frame == 0) ||
+            gif->frames[frame].keyframe ||
+            (gif->decoded_frame == GIF_INVALID_FRAME)) {
+                memset((char*)frame_data,
+                       GIF_TRANSPARENT_COLOUR,
+                       gif->width * gif->height * sizeof(int));
+                /* The line below would fill the image with its background
+                 * color, but because GIFs support transparency we likely
+                 * wouldn't want to do that. */
+                /* memset((char*)frame_data, colour_table[gif->background_index], gif->width * gif->height * sizeof(int)); */
+        } else if (gif->frames[frame - 1].disposal_method == GIF_FRAME_CLEAR) {
+                return_value = gif_internal_decode_frame(gif,
+                                                         (frame - 1),
+                                                         true);
+                if (return_value != GIF_OK) {
+                        return return_value;
+                }
+        } else if (gif->frames[frame - 1].disposal_method == GIF_FRAME_RESTORE) {
+                /*
+                 * If the previous frame's disposal method requires we
+                 * restore the previous image, find the last image set
+                 * to "do not dispose" and get that frame data
+                 */
+                int last_undisposed_frame = frame - 2;
+                while ((last_undisposed_frame >= 0) &&
+                       (gif->frames[last_undisposed_frame].disposal_method == GIF_FRAME_RESTORE)) {
+                        last_undisposed_frame--;
+                }
+
+                /* If we don't find one, clear the frame data */
+                if (last_undisposed_frame == -1) {
+                        /* see notes above on transparency
+                         * vs. background color
+                         */
+                        memset((char*)frame_data,
+                               GIF_TRANSPARENT_COLOUR,
+                               gif->width * gif->height * sizeof(int));
+                } else {
+                        return_value = gif_decode_frames_to(gif, last_undisposed_frame);
+                        if (return_value != GIF_OK) {
+                                return return_value;
+                        }
+                }
+        }
+
+        gif->decoded_frame = frame;
+        return GIF_OK;
+}
+
+
 /**
  * decode a gif frame
  *
@@ -595,8 +799,7 @@ gif_internal_decode_frame(gif_animation *gif,
         unsigned int *frame_scanline;
         intmax_t save_buffer_position;
         unsigned int return_value = 0;
-        unsigned int x, y, decode_y, burst_bytes;
-        register unsigned char colour;
+        unsigned int x, y, decode_y, rows, row_length;
 
         /* If the GIF has no frame data, frame holders will not be allocated in
          * gif_initialise() */
@@ -633,6 +836,14 @@ gif_internal_decode_frame(gif_animation *gif,
                 return GIF_INSUFFICIENT_FRAME_DATA;
         }
 
+        /* Bring the image up to date, so we can plot this frame on it */
+        if (!clear_image) {
+                return_value = gif_prepare_frame(gif, frame);
+                if (return_value != GIF_OK) {
+                        return return_value;
+                }
+        }
+
         /* Save the buffer position */
         save_buffer_position = gif->buffer_position;
         gif->buffer_position = gif_data - gif->gif_data;
@@ -751,8 +962,6 @@ gif_internal_decode_frame(gif_animation *gif,
         /* If we are clearing the image we just clear, if not decode */
         if (!clear_image) {
                 lzw_result res;
-                const uint8_t *stack_base;
-                const uint8_t *stack_pos;
 
                 /* Ensure we have enough data for a 1-byte LZW code size +
                  * 1-byte gif trailer
@@ -770,75 +979,34 @@ gif_internal_decode_frame(gif_animation *gif,
                         goto gif_decode_frame_exit;
                 }
 
-                /* If the previous frame's disposal method requires we restore
-                 * the background colour or this is the first frame, clear
-                 * the frame data
-                 */
-                if ((frame == 0) || (gif->decoded_frame == GIF_INVALID_FRAME)) {
-                        memset((char*)frame_data,
-                               GIF_TRANSPARENT_COLOUR,
-                               gif->width * gif->height * sizeof(int));
-                        gif->decoded_frame = frame;
-                        /* The line below would fill the image with its
-                         * background color, but because GIFs support
-                         * transparency we likely wouldn't want to do that. */
-                        /* memset((char*)frame_data, colour_table[gif->background_index], gif->width * gif->height * sizeof(int)); */
-                } else if ((frame != 0) &&
-                           (gif->frames[frame - 1].disposal_method == GIF_FRAME_CLEAR)) {
-                        return_value = gif_internal_decode_frame(gif,
-                                                                 (frame - 1),
-                                                                 true);
-                        if (return_value != GIF_OK) {
-                                goto gif_decode_frame_exit;
-                        }
-
-                } else if ((frame != 0) &&
-                           (gif->frames[frame - 1].disposal_method == GIF_FRAME_RESTORE)) {
-                        /*
-                         * If the previous frame's disposal method requires we
-                         * restore the previous image, find the last image set
-                         * to "do not dispose" and get that frame data
-                         */
-                        int last_undisposed_frame = frame - 2;
-                        while ((last_undisposed_frame >= 0) &&
-                               (gif->frames[last_undisposed_frame].disposal_method == GIF_FRAME_RESTORE)) {
-                                last_undisposed_frame--;
-                        }
-
-                        /* If we don't find one, clear the frame data */
-                        if (last_undisposed_frame == -1) {
-                                /* see notes above on transparency
-                                 * vs. background color
-                                 */
-                                memset((char*)frame_data,
-                                       GIF_TRANSPARENT_COLOUR,
-                                       gif->width * gif->height * sizeof(int));
-                        } else {
-                                return_value = gif_internal_decode_frame(gif, last_undisposed_frame, false);
-                                if (return_value != GIF_OK) {
-                                        goto gif_decode_frame_exit;
-                                }
-                                /* Get this frame's data */
-                                assert(gif->bitmap_callbacks.bitmap_get_buffer);
-                                frame_data = (void *)gif->bitmap_callbacks.bitmap_get_buffer(gif->frame_image);
-                                if (!frame_data) {
-                                        return GIF_INSUFFICIENT_MEMORY;
-                                }
-                        }
-                }
-                gif->decoded_frame = frame;
                 gif->buffer_position = (gif_data - gif->gif_data) + 1;
 
                 /* Initialise the LZW decoding */
-                res = lzw_decode_init(gif->lzw_ctx, gif->gif_data,
+                res = lzw_decode_init_map(gif->lzw_ctx, gif->gif_data,
                                 gif->buffer_size, gif->buffer_position,
-                                gif_data[0], &stack_base, &stack_pos);
+                                gif_data[0],
+                                gif->frames[frame].transparency ?
+                                        gif->frames[frame].transparency_index :
+                                        GIF_NO_TRANSPARENCY,
+                                colour_table);
                 if (res != LZW_OK) {
-                        return gif_error_from_lzw(res);
+                        return_value = gif_error_from_lzw(res);
+                        goto gif_decode_frame_exit;
+                }
+
+                /* Decompress the data. Whole strings are written straight
+                 * to their destination. If the frame's rows are contiguous
+                 * in the image, we can decode the entire frame in one go.
+                 */
+                if (!interlace && (width == gif->width)) {
+                        rows = 1;
+                        row_length = width * height;
+                } else {
+                        rows = height;
+                        row_length = width;
                 }
 
-                /* Decompress the data */
-                for (y = 0; y < height; y++) {
+                for (y = 0; y < rows; y++) {
                         if (interlace) {
                                 decode_y = gif_interlaced_line(height, y) + offset_y;
                         } else {
@@ -846,39 +1014,23 @@ gif_internal_decode_frame(gif_animation *gif,
                         }
                         frame_scanline = frame_data + offset_x + (decode_y * gif->width);
 
-                        /* Rather than decoding pixel by pixel, we try to burst
-                         * out streams of data to remove the need for end-of
-                         * data checks every pixel.
-                         */
-                        x = width;
-                        while (x > 0) {
-                                burst_bytes = (stack_pos - stack_base);
-                                if (burst_bytes > 0) {
-                                        if (burst_bytes > x) {
-                                                burst_bytes = x;
-                                        }
-                                        x -= burst_bytes;
-                                        while (burst_bytes > 0) {
-                                                colour = *--stack_pos;
-                                                if (((gif->frames[frame].transparency) &&
-                                                     (colour != gif->frames[frame].transparency_index)) ||
-                                                    (!gif->frames[frame].transparency)) {
-                                                        *frame_scanline = colour_table[colour];
-                                                }
-                                                frame_scanline++;
-                                                burst_bytes--;
-                                        }
-                                } else {
-                                        res = lzw_decode(gif->lzw_ctx, &stack_pos);
-                                        if (res != LZW_OK) {
-                                                /* Unexpected end of frame, try to recover */
-                                                if (res == LZW_OK_EOD) {
-                                                        return_value = GIF_OK;
-                                                } else {
-                                                        return_value = gif_error_from_lzw(res);
-                                                }
-                                                goto gif_decode_frame_exit;
+                        x = 0;
+                        while (x < row_length) {
+                                uint32_t written;
+
+                                res = lzw_decode_map(gif->lzw_ctx,
+                                                frame_scanline + x,
+                                                row_length - x,
+                                                &written);
+                                x += written;
+                                if (res != LZW_OK) {
+                                        /* Unexpected end of frame, try to recover */
+                                        if (res == LZW_OK_EOD) {
+                                                return_value = GIF_OK;
+                                        } else {
+                                                return_value = gif_error_from_lzw(res);
                                         }
+                                        goto gif_decode_frame_exit;
                                 }
                         }
                 }
@@ -892,9 +1044,9 @@ gif_internal_decode_frame(gif_animation *gif,
                                                GIF_TRANSPARENT_COLOUR,
                                                width * 4);
                                 } else {
-                                        memset(frame_scanline,
-                                               colour_table[gif->background_index],
-                                               width * 4);
+                                        for (x = 0; x < width; x++) {
+                                                frame_scanline[x] = colour_table[gif->background_index];
+                                        }
                                 }
                         }
                 }
@@ -46,6 +46,8 @@ typedef struct gif_frame {
         bool virgin;
         /** whether the frame is totally opaque */
         bool opaque;
+        /** whether the frame can be decoded without the previous frames */
+        bool keyframe;
         /** whether a forcable screen redraw is required */
         bool redraw_required;
         /** how the previous frame should be disposed; affects plotting */
@@ -163,6 +165,10 @@ gif_result gif_initialise(gif_animation *gif, size_t size, const unsigned char *
 /**
  * Decodes a GIF frame.
  *
+ * Frames may be decoded in any order. If the frame does not follow the
+ * currently decoded frame, decoding restarts from the closest preceding
+ * keyframe, as recorded by gif_initialise().
+ *
  * @return Error return value. If a frame does not contain any image data,
  *		GIF_OK is returned and gif->current_error is set to
  *		GIF_FRAME_NO_DISPLAY
@@ -51,11 +51,16 @@ struct lzw_read_ctx {
  * the `last_value` from each entry, and move to the previous entry.
  * If the previous_entry's index is < the current clear_code, then it
  * is the last entry in the record.
+ *
+ * The `count` member holds the length of the complete record, so that
+ * a record can be written straight to its final position in an output
+ * buffer, back to front, without going through the output stack.
  */
 struct lzw_dictionary_entry {
 	uint8_t last_value;      /**< Last value for record ending at entry. */
 	uint8_t first_value;     /**< First value for entry's record. */
 	uint16_t previous_entry; /**< Offset in dictionary to previous entry. */
+	uint16_t count;          /**< Length of record ending at entry. */
 };
 
 /**
@@ -77,6 +82,12 @@ struct lzw_ctx {
 
 	uint32_t current_entry; /**< Next position in table to fill. */
 
+	uint32_t output_code; /**< Code whose record is partially output. */
+	uint32_t output_left; /**< Number of values of record left to output. */
+
+	uint32_t transparency_idx;   /**< Index to skip, or > 0xff for none. */
+	const uint32_t *colour_map;  /**< Index to pixel value mapping. */
+
 	/** Output value stack. */
 	uint8_t stack_base[1 << LZW_CODE_MAX];
 
@@ -217,16 +228,15 @@ static inline lzw_result lzw__next_code(
 /**
  * Clear LZW code dictionary.
  *
- * \param[in]  ctx            LZW reading context, updated.
- * \param[out] stack_pos_out  Returns current stack position.
+ * \param[in]  ctx       LZW reading context, updated.
+ * \param[out] code_out  Returns the first code after the clear code(s).
  * \return LZW_OK or error code.
  */
 static lzw_result lzw__clear_codes(
 		struct lzw_ctx *ctx,
-		const uint8_t ** const stack_pos_out)
+		uint32_t *code_out)
 {
 	uint32_t code;
-	uint8_t *stack_pos;
 
 	/* Reset dictionary building context */
 	ctx->current_code_size = ctx->initial_code_size + 1;
@@ -251,6 +261,31 @@ static lzw_result lzw__clear_codes(
 	ctx->previous_code = code;
 	ctx->previous_code_first = code;
 
+	*code_out = code;
+	return LZW_OK;
+}
+
+
+/**
+ * Clear LZW code dictionary, and put the first code on the output stack.
+ *
+ * \param[in]  ctx            LZW reading context, updated.
+ * \param[out] stack_pos_out  Returns current stack position.
+ * \return LZW_OK or error code.
+ */
+static lzw_result lzw__clear_codes_stack(
+		struct lzw_ctx *ctx,
+		const uint8_t ** const stack_pos_out)
+{
+	uint32_t code;
+	uint8_t *stack_pos;
+	lzw_result res;
+
+	res = lzw__clear_codes(ctx, &code);
+	if (res != LZW_OK) {
+		return res;
+	}
+
 	/* Reset the stack, and add first non-clear code added as first item. */
 	stack_pos = ctx->stack_base;
 	*stack_pos++ = code;
@@ -260,15 +295,21 @@ static lzw_result lzw__clear_codes(
 }
 
 
-/* Exported function, documented in lzw.h */
-lzw_result lzw_decode_init(
+/**
+ * Set up the input reading and initial dictionary for a new LZW stream.
+ *
+ * \param[in]  ctx                  The LZW decompression context.
+ * \param[in]  compressed_data      The compressed data.
+ * \param[in]  compressed_data_len  Byte length of compressed data.
+ * \param[in]  compressed_data_pos  Start position in data.
+ * \param[in]  code_size            The initial LZW code size to use.
+ */
+static void lzw__init(
 		struct lzw_ctx *ctx,
 		const uint8_t *compressed_data,
 		uint64_t compressed_data_len,
 		uint64_t compressed_data_pos,
-		uint8_t code_size,
-		const uint8_t ** const stack_base_out,
-		const uint8_t ** const stack_pos_out)
+		uint8_t code_size)
 {
 	struct lzw_dictionary_entry *table = ctx->table;
 
@@ -286,14 +327,64 @@ lzw_result lzw_decode_init(
 	ctx->clear_code = (1 << code_size) + 0;
 	ctx->eoi_code   = (1 << code_size) + 1;
 
+	ctx->output_code = 0;
+	ctx->output_left = 0;
+
 	/* Initialise the standard dictionary entries */
 	for (uint32_t i = 0; i < ctx->clear_code; ++i) {
 		table[i].first_value = i;
 		table[i].last_value  = i;
+		table[i].count       = 1;
 	}
+}
+
+
+/* Exported function, documented in lzw.h */
+lzw_result lzw_decode_init(
+		struct lzw_ctx *ctx,
+		const uint8_t *compressed_data,
+		uint64_t compressed_data_len,
+		uint64_t compressed_data_pos,
+		uint8_t code_size,
+		const uint8_t ** const stack_base_out,
+		const uint8_t ** const stack_pos_out)
+{
+	lzw__init(ctx, compressed_data, compressed_data_len,
+			compressed_data_pos, code_size);
 
 	*stack_base_out = ctx->stack_base;
-	return lzw__clear_codes(ctx, stack_pos_out);
+	return lzw__clear_codes_stack(ctx, stack_pos_out);
+}
+
+
+/* Exported function, documented in lzw.h */
+lzw_result lzw_decode_init_map(
+		struct lzw_ctx *ctx,
+		const uint8_t *compressed_data,
+		uint64_t compressed_data_len,
+		uint64_t compressed_data_pos,
+		uint8_t code_size,
+		uint32_t transparency_idx,
+		const uint32_t *colour_map)
+{
+	lzw_result res;
+	uint32_t code;
+
+	lzw__init(ctx, compressed_data, compressed_data_len,
+			compressed_data_pos, code_size);
+
+	ctx->transparency_idx = transparency_idx;
+	ctx->colour_map = colour_map;
+
+	res = lzw__clear_codes(ctx, &code);
+	if (res != LZW_OK) {
+		return res;
+	}
+
+	/* The first code is output by the first lzw_decode_map() call. */
+	ctx->output_code = code;
+	ctx->output_left = 1;
+	return LZW_OK;
 }
 
 
@@ -319,7 +410,7 @@ lzw_result lzw_decode(struct lzw_ctx *ctx,
 	/* Handle the new code */
 	if (code_new == clear_code) {
 		/* Got Clear code */
-		return lzw__clear_codes(ctx, stack_pos_out);
+		return lzw__clear_codes_stack(ctx, stack_pos_out);
 
 	} else if (code_new == ctx->eoi_code) {
 		/* Got End of Information code */
@@ -350,6 +441,7 @@ lzw_result lzw_decode(struct lzw_ctx *ctx,
 		entry->last_value     = last_value;
 		entry->first_value    = ctx->previous_code_first;
 		entry->previous_entry = ctx->previous_code;
+		entry->count          = table[ctx->previous_code].count + 1;
 		ctx->current_entry++;
 	}
 
@@ -379,3 +471,177 @@ lzw_result lzw_decode(struct lzw_ctx *ctx,
 	*stack_pos_out = stack_pos;
 	return LZW_OK;
 }
+
+
+/**
+ * Read the next code and update the dictionary with it.
+ *
+ * Unlike lzw_decode(), this adds the new dictionary entry before the
+ * code's record is output, so the record for the returned code is always
+ * complete in the dictionary, including for the "code not in table" case.
+ *
+ * \param[in]  ctx       LZW reading context, updated.
+ * \param[out] code_out  Returns the code whose record should be output.
+ * \return LZW_OK on success, or appropriate error code otherwise.
+ */
+static inline lzw_result lzw__decode_code(
+		struct lzw_ctx *ctx,
+		uint32_t *code_out)
+{
+	lzw_result res;
+	uint32_t code_new;
+	uint32_t current_entry = ctx->current_entry;
+	struct lzw_dictionary_entry * const table = ctx->table;
+
+	/* Get a new code from the input */
+	res = lzw__next_code(&ctx->input, ctx->current_code_size, &code_new);
+	if (res != LZW_OK) {
+		return res;
+	}
+
+	if (code_new == ctx->clear_code) {
+		/* Got Clear code */
+		return lzw__clear_codes(ctx, code_out);
+
+	} else if (code_new == ctx->eoi_code) {
+		/* Got End of Information code */
+		return LZW_EOI_CODE;
+
+	} else if (code_new > current_entry) {
+		/* Code is invalid */
+		return LZW_BAD_CODE;
+
+	} else if (code_new >= 1 << LZW_CODE_MAX) {
+		/* Don't access out of bound */
+		return LZW_BAD_CODE;
+	}
+
+	/* Add to the dictionary, only if there's space */
+	if (current_entry < (1 << LZW_CODE_MAX)) {
+		struct lzw_dictionary_entry *entry = table + current_entry;
+		entry->last_value     = (code_new < current_entry) ?
+				table[code_new].first_value :
+				ctx->previous_code_first;
+		entry->first_value    = ctx->previous_code_first;
+		entry->previous_entry = ctx->previous_code;
+		entry->count          = table[ctx->previous_code].count + 1;
+		ctx->current_entry++;
+	}
+
+	/* Ensure code size is increased, if needed. */
+	if (current_entry == ctx->current_code_size_max) {
+		if (ctx->current_code_size < LZW_CODE_MAX) {
+			ctx->current_code_size++;
+			ctx->current_code_size_max =
+					(1 << ctx->current_code_size) - 1;
+		}
+	}
+
+	/* Store details of this code as "previous code" to the context. */
+	ctx->previous_code_first = table[code_new].first_value;
+	ctx->previous_code = code_new;
+
+	*code_out = code_new;
+	return LZW_OK;
+}
+
+
+/**
+ * Write (part of) a code's record to the output, mapping values to pixels.
+ *
+ * The record is written back to front, directly into its final position.
+ * If there isn't room for what's left of the record, as much of it as fits
+ * is written, and the remainder is kept in the context for the next call.
+ *
+ * \param[in]  ctx            LZW reading context, updated.
+ * \param[in]  output         Output buffer.
+ * \param[in]  output_length  Length of output buffer, in pixels.
+ * \param[in]  output_used    Number of pixels already in output buffer.
+ * \param[in]  code           Code whose record is to be written.
+ * \param[in]  left           Number of values left to write from the
+ *                            start of the record.
+ * \return Number of pixels written.
+ */
+static inline uint32_t lzw__write_map(
+		struct lzw_ctx *ctx,
+		uint32_t *output,
+		uint32_t output_length,
+		uint32_t output_used,
+		uint32_t code,
+		uint32_t left)
+{
+	const struct lzw_dictionary_entry * const table = ctx->table;
+	const uint32_t * const colour_map = ctx->colour_map;
+	const uint32_t transparency_idx = ctx->transparency_idx;
+	uint32_t space = output_length - output_used;
+	uint32_t count = left;
+	uint32_t *pos;
+
+	if (count > space) {
+		left = count - space;
+		count = space;
+	} else {
+		left = 0;
+	}
+
+	ctx->output_code = code;
+	ctx->output_left = left;
+
+	/* Skip over the values we don't have space for this time */
+	for (uint32_t i = left; i != 0; i--) {
+		code = table[code].previous_entry;
+	}
+
+	pos = output + output_used + count;
+
+	if (transparency_idx > 0xff) {
+		for (uint32_t i = count; i != 0; i--) {
+			const struct lzw_dictionary_entry *entry = table + code;
+			*--pos = colour_map[entry->last_value];
+			code = entry->previous_entry;
+		}
+	} else {
+		for (uint32_t i = count; i != 0; i--) {
+			const struct lzw_dictionary_entry *entry = table + code;
+			--pos;
+			if (entry->last_value != transparency_idx) {
+				*pos = colour_map[entry->last_value];
+			}
+			code = entry->previous_entry;
+		}
+	}
+
+	return count;
+}
+
+
+/* Exported function, documented in lzw.h */
+lzw_result lzw_decode_map(struct lzw_ctx *ctx,
+		uint32_t *output,
+		uint32_t output_length,
+		uint32_t *output_written)
+{
+	uint32_t output_used = 0;
+
+	/* First finish off any record left over from the previous call */
+	if (ctx->output_left != 0) {
+		output_used += lzw__write_map(ctx, output, output_length,
+				output_used, ctx->output_code,
+				ctx->output_left);
+	}
+
+	while (output_used < output_length) {
+		uint32_t code;
+		lzw_result res = lzw__decode_code(ctx, &code);
+		if (res != LZW_OK) {
+			*output_written = output_used;
+			return res;
+		}
+
+		output_used += lzw__write_map(ctx, output, output_length,
+				output_used, code, ctx->table[code].count);
+	}
+
+	*output_written = output_used;
+	return LZW_OK;
+}
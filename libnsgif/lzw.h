@@ -102,4 +102,57 @@ lzw_result lzw_decode(
 		const uint8_t ** const stack_pos_out);
 
 
+/**
+ * Initialise an LZW decompression context for decoding to pixels.
+ *
+ * Use lzw_decode_map() to decode from a context initialised with this.
+ * Caller retains ownership of `colour_map`, which must remain valid for
+ * as long as the context is used for decoding.
+ *
+ * \param[in]  ctx                  The LZW decompression context to initialise.
+ * \param[in]  compressed_data      The compressed data.
+ * \param[in]  compressed_data_len  Byte length of compressed data.
+ * \param[in]  compressed_data_pos  Start position in data.  Must be position
+ *                                  of a size byte at sub-block start.
+ * \param[in]  code_size            The initial LZW code size to use.
+ * \param[in]  transparency_idx     Index of values to skip when writing
+ *                                  output, or > 0xff to write all values.
+ * \param[in]  colour_map           Mapping from decoded values to pixels.
+ *                                  Must have 256 entries.
+ * \return LZW_OK on success, or appropriate error code otherwise.
+ */
+lzw_result lzw_decode_init_map(
+		struct lzw_ctx *ctx,
+		const uint8_t *compressed_data,
+		uint64_t compressed_data_len,
+		uint64_t compressed_data_pos,
+		uint8_t code_size,
+		uint32_t transparency_idx,
+		const uint32_t *colour_map);
+
+/**
+ * Decode LZW data straight into a pixel buffer.
+ *
+ * Each code's complete record is written directly to its final position,
+ * using the record lengths kept in the dictionary, and its values are
+ * mapped to pixels through the context's colour map.  Pixels matching the
+ * transparency index are skipped, leaving the existing output untouched.
+ *
+ * Records that don't fit in the output are continued on the next call, so
+ * the output can be supplied in pieces, e.g. one row at a time.
+ *
+ * \param[in]  ctx             LZW reading context, updated.
+ * \param[in]  output          Output buffer to write pixels to.
+ * \param[in]  output_length   Length of output buffer, in pixels.
+ * \param[out] output_written  Returns number of pixels written.  This may
+ *                             be less than `output_length` on error.
+ * \return LZW_OK on success, or appropriate error code otherwise.
+ */
+lzw_result lzw_decode_map(
+		struct lzw_ctx *ctx,
+		uint32_t *output,
+		uint32_t output_length,
+		uint32_t *output_written);
+
+
 #endif
@@ -0,0 +1,253 @@
+#include "config.h"
+
+#include <chafa.h>
+#include "internal/chafa-canvas-internal.h"
+
+/* The source is the size of the canvas in pixels, so the output can be
+ * compared to it directly */
+#define WIDTH_CELLS 32
+#define HEIGHT_CELLS 16
+#define SRC_WIDTH (WIDTH_CELLS * CHAFA_SYMBOL_WIDTH_PIXELS)
+#define SRC_HEIGHT (HEIGHT_CELLS * CHAFA_SYMBOL_HEIGHT_PIXELS)
+
+/* Enough to get past the first refresh. The content changes character
+ * halfway through, so symbols that weren't in use at first become
+ * necessary. */
+#define N_FRAMES 48
+#define N_FRAMES_FIRST_SCENE 20
+
+/* A gradient with a disc moving over it, then diagonal stripes with a
+ * moving checkerboard patch */
+static void
+gen_frame (guint8 *pixels, gint frame_n)
+{
+    guint8 *p = pixels;
+    gint cx, cy;
+    gint x, y;
+
+    cx = (frame_n * 5) % SRC_WIDTH;
+    cy = SRC_HEIGHT / 2 + (frame_n % 7) * 3;
+
+    for (y = 0; y < SRC_HEIGHT; y++)
+    {
+        for (x = 0; x < SRC_WIDTH; x++)
+        {
+            gint r, g, b;
+
+            if (frame_n < N_FRAMES_FIRST_SCENE)
+            {
+                gint dx = x - cx, dy = y - cy;
+
+                r = x;
+                g = y * 2;
+                b = 0x40;
+
+                if (dx * dx + dy * dy < 30 * 30)
+                    r = g = b = 0xf0;
+            }
+            else if (x >= cx && x < cx + 48 && y >= 32 && y < 96)
+            {
+                r = g = b = ((x ^ y) & 2) ? 0xff : 0x00;
+            }
+            else
+            {
+                r = ((x + y + frame_n) / 6) % 2 ? 0xc0 : 0x20;
+                g = 0x80;
+                b = 0xff - r;
+            }
+
+            *(p++) = r;
+            *(p++) = g;
+            *(p++) = b;
+            *(p++) = 0xff;
+        }
+    }
+}
+
+static ChafaCanvasConfig *
+create_config (gfloat work_factor, gboolean adaptive)
+{
+    ChafaCanvasConfig *config;
+    ChafaSymbolMap *symbol_map;
+
+    symbol_map = chafa_symbol_map_new ();
+    chafa_symbol_map_apply_selectors (symbol_map, "all-wide", NULL);
+
+    config = chafa_canvas_config_new ();
+    chafa_canvas_config_set_geometry (config, WIDTH_CELLS, HEIGHT_CELLS);
+    chafa_canvas_config_set_canvas_mode (config, CHAFA_CANVAS_MODE_TRUECOLOR);
+    chafa_canvas_config_set_color_space (config, CHAFA_COLOR_SPACE_RGB);
+    chafa_canvas_config_set_dither_mode (config, CHAFA_DITHER_MODE_NONE);
+    chafa_canvas_config_set_preprocessing_enabled (config, FALSE);
+    chafa_canvas_config_set_symbol_map (config, symbol_map);
+    chafa_canvas_config_set_work_factor (config, work_factor);
+    chafa_canvas_config_set_adaptive_symbols_enabled (config, adaptive);
+
+    chafa_symbol_map_unref (symbol_map);
+    return config;
+}
+
+static guint64
+lookup_bitmap (ChafaCanvas *canvas, gunichar c)
+{
+    const ChafaSymbol *symbols = canvas->config.symbol_map.symbols;
+    gint i;
+
+    for (i = 0; symbols [i].c != 0; i++)
+    {
+        if (symbols [i].c == c)
+            return symbols [i].bitmap;
+    }
+
+    /* Not a symbol, e.g. the blank char. All background. */
+    return 0;
+}
+
+/* Squared error of the canvas' symbols and colors against the source */
+static gint64
+calc_canvas_error (ChafaCanvas *canvas, const guint8 *pixels)
+{
+    gint64 error = 0;
+    gint cx, cy, i, ch;
+
+    for (cy = 0; cy < HEIGHT_CELLS; cy++)
+    {
+        for (cx = 0; cx < WIDTH_CELLS; cx++)
+        {
+            guint64 bitmap;
+            gint colors [2];
+
+            bitmap = lookup_bitmap (canvas, chafa_canvas_get_char_at (canvas, cx, cy));
+            chafa_canvas_get_colors_at (canvas, cx, cy, &colors [1], &colors [0]);
+
+            for (i = 0; i < CHAFA_SYMBOL_N_PIXELS; i++)
+            {
+                gint x = cx * CHAFA_SYMBOL_WIDTH_PIXELS + i % CHAFA_SYMBOL_WIDTH_PIXELS;
+                gint y = cy * CHAFA_SYMBOL_HEIGHT_PIXELS + i / CHAFA_SYMBOL_WIDTH_PIXELS;
+                const guint8 *p = pixels + (y * SRC_WIDTH + x) * 4;
+                gint col = colors [(bitmap >> (63 - i)) & 1];
+
+                for (ch = 0; ch < 3; ch++)
+                {
+                    gint d = (gint) p [ch] - ((col >> (16 - ch * 8)) & 0xff);
+                    error += d * d;
+                }
+            }
+        }
+    }
+
+    return error;
+}
+
+static void
+render_frame (ChafaCanvas *canvas, const guint8 *pixels)
+{
+    chafa_canvas_draw_all_pixels (canvas, CHAFA_PIXEL_RGBA8_UNASSOCIATED,
+                                  pixels, SRC_WIDTH, SRC_HEIGHT, SRC_WIDTH * 4);
+}
+
+/* The adaptive search must stay close to the full search in every frame,
+ * and must actually narrow it down */
+static void
+quality_test (void)
+{
+    ChafaCanvasConfig *config_full, *config_adaptive;
+    ChafaCanvas *canvas_adaptive;
+    guint8 *pixels;
+    gint64 total_error_full = 0, total_error_adaptive = 0;
+    gint frame_n;
+
+    config_full = create_config (1.0f, FALSE);
+    config_adaptive = create_config (1.0f, TRUE);
+    canvas_adaptive = chafa_canvas_new (config_adaptive);
+    pixels = g_malloc (SRC_WIDTH * SRC_HEIGHT * 4);
+
+    for (frame_n = 0; frame_n < N_FRAMES; frame_n++)
+    {
+        ChafaCanvas *canvas_full;
+        gint64 error_full, error_adaptive;
+
+        gen_frame (pixels, frame_n);
+
+        canvas_full = chafa_canvas_new (config_full);
+        render_frame (canvas_full, pixels);
+        render_frame (canvas_adaptive, pixels);
+
+        error_full = calc_canvas_error (canvas_full, pixels);
+        error_adaptive = calc_canvas_error (canvas_adaptive, pixels);
+
+        /* Identical while learning */
+        if (frame_n < 4)
+            g_assert_cmpint (error_adaptive, ==, error_full);
+
+        g_assert_cmpint (error_adaptive, <=, error_full + error_full / 20);
+
+        total_error_full += error_full;
+        total_error_adaptive += error_adaptive;
+
+        chafa_canvas_unref (canvas_full);
+    }
+
+    g_assert_cmpint (total_error_adaptive, <=, total_error_full + total_error_full / 50);
+
+    g_assert_cmpint (canvas_adaptive->symbol_usage.n_hot [0], >, 0);
+    g_assert_cmpint (canvas_adaptive->symbol_usage.n_hot [0], <,
+                     canvas_adaptive->config.symbol_map.n_symbols / 2);
+
+    g_free (pixels);
+    chafa_canvas_unref (canvas_adaptive);
+    chafa_canvas_config_unref (config_adaptive);
+    chafa_canvas_config_unref (config_full);
+}
+
+/* The fast path already works from a short list of candidates, and is left
+ * alone */
+static void
+fast_path_test (void)
+{
+    ChafaCanvasConfig *config_full, *config_adaptive;
+    ChafaCanvas *canvas_full, *canvas_adaptive;
+    guint8 *pixels;
+    gint frame_n;
+
+    config_full = create_config (0.5f, FALSE);
+    config_adaptive = create_config (0.5f, TRUE);
+    canvas_full = chafa_canvas_new (config_full);
+    canvas_adaptive = chafa_canvas_new (config_adaptive);
+    pixels = g_malloc (SRC_WIDTH * SRC_HEIGHT * 4);
+
+    for (frame_n = 0; frame_n < 8; frame_n++)
+    {
+        gchar *str_full, *str_adaptive;
+
+        gen_frame (pixels, frame_n * 4);
+        render_frame (canvas_full, pixels);
+        render_frame (canvas_adaptive, pixels);
+
+        str_full = g_string_free (chafa_canvas_print (canvas_full, NULL), FALSE);
+        str_adaptive = g_string_free (chafa_canvas_print (canvas_adaptive, NULL), FALSE);
+        g_assert_cmpstr (str_adaptive, ==, str_full);
+
+        g_free (str_full);
+        g_free (str_adaptive);
+    }
+
+    g_assert_null (canvas_adaptive->symbol_usage.counts [0]);
+
+    g_free (pixels);
+    chafa_canvas_unref (canvas_adaptive);
+    chafa_canvas_unref (canvas_full);
+    chafa_canvas_config_unref (config_adaptive);
+    chafa_canvas_config_unref (config_full);
+}
+
+int
+main (int argc, char *argv [])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/adaptive-symbols/quality", quality_test);
+    g_test_add_func ("/adaptive-symbols/fast-path", fast_path_test);
+
+    return g_test_run ();
+}
@@ -0,0 +1,551 @@
+#include "config.h"
+
+#include <chafa.h>
+#include <string.h>
+#include "chicle-bmp-loader.h"
+#include "loader-test-util.h"
+
+#define WIDTH 13
+#define HEIGHT 7
+
+#define BI_RGB 0
+#define BI_RLE8 1
+#define BI_RLE4 2
+#define BI_BITFIELDS 3
+#define BI_ALPHABITFIELDS 6
+
+typedef struct
+{
+    const gchar *name;
+    gint bpp;
+    gint compression;
+    gint header_size;
+    gboolean top_down;
+    guint32 masks [4];
+    gboolean zero_copy;
+}
+Variant;
+
+static const Variant variants [] =
+{
+    { "1-bit", 1, BI_RGB, 40, FALSE, { 0 }, FALSE },
+    { "1-bit-top-down", 1, BI_RGB, 40, TRUE, { 0 }, FALSE },
+    { "4-bit", 4, BI_RGB, 40, FALSE, { 0 }, FALSE },
+    { "8-bit", 8, BI_RGB, 40, FALSE, { 0 }, FALSE },
+    { "8-bit-top-down", 8, BI_RGB, 40, TRUE, { 0 }, FALSE },
+    { "16-bit-555", 16, BI_RGB, 40, FALSE, { 0x7c00, 0x03e0, 0x001f, 0 }, FALSE },
+    { "16-bit-565", 16, BI_BITFIELDS, 40, FALSE, { 0xf800, 0x07e0, 0x001f, 0 }, FALSE },
+    { "16-bit-4444", 16, BI_ALPHABITFIELDS, 40, TRUE, { 0x0f00, 0x00f0, 0x000f, 0xf000 }, FALSE },
+    { "24-bit", 24, BI_RGB, 40, FALSE, { 0 }, FALSE },
+    { "24-bit-top-down", 24, BI_RGB, 40, TRUE, { 0 }, TRUE },
+    { "32-bit-rgb", 32, BI_RGB, 40, TRUE, { 0x00ff0000, 0x0000ff00, 0x000000ff, 0 }, FALSE },
+    { "32-bit-bgra", 32, BI_BITFIELDS, 108, FALSE,
+      { 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000 }, FALSE },
+    { "32-bit-bgra-top-down", 32, BI_BITFIELDS, 108, TRUE,
+      { 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000 }, TRUE },
+    { "32-bit-rgba", 32, BI_BITFIELDS, 124, TRUE,
+      { 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000 }, FALSE },
+    { "32-bit-wide-mask", 32, BI_BITFIELDS, 40, FALSE,
+      { 0xffffffc0, 0x00000038, 0x00000007, 0 }, FALSE }
+};
+
+static void
+put_u16 (GByteArray *array, guint16 v)
+{
+    guint8 b [2] = { v & 0xff, v >> 8 };
+
+    g_byte_array_append (array, b, 2);
+}
+
+static void
+put_u32 (GByteArray *array, guint32 v)
+{
+    guint8 b [4] = { v & 0xff, (v >> 8) & 0xff, (v >> 16) & 0xff, v >> 24 };
+
+    g_byte_array_append (array, b, 4);
+}
+
+static GByteArray *
+begin_bmp (gint header_size, gint width, gint height, gint bpp, gint compression,
+           const guint32 *masks, const guint32 *palette, gint n_colors)
+{
+    GByteArray *array;
+    gint data_ofs;
+    gint i;
+
+    data_ofs = 14 + header_size + n_colors * 4;
+    if (header_size == 40 && (compression == BI_BITFIELDS || compression == BI_ALPHABITFIELDS))
+        data_ofs += compression == BI_ALPHABITFIELDS ? 16 : 12;
+
+    array = g_byte_array_new ();
+
+    /* BITMAPFILEHEADER; the file size is filled in later */
+    g_byte_array_append (array, (const guint8 *) "BM", 2);
+    put_u32 (array, 0);
+    put_u32 (array, 0);
+    put_u32 (array, data_ofs);
+
+    /* BITMAPINFOHEADER */
+    put_u32 (array, header_size);
+    put_u32 (array, width);
+    put_u32 (array, height);
+    put_u16 (array, 1);
+    put_u16 (array, bpp);
+    put_u32 (array, compression);
+    put_u32 (array, 0);
+    put_u32 (array, 2835);
+    put_u32 (array, 2835);
+    put_u32 (array, n_colors);
+    put_u32 (array, 0);
+
+    if (header_size > 40)
+    {
+        /* BITMAPV4HEADER or BITMAPV5HEADER. The masks are followed by the
+         * color space, which is ignored. */
+        for (i = 0; i < 4; i++)
+            put_u32 (array, masks [i]);
+        for (i = 56; i < header_size; i += 4)
+            put_u32 (array, 0);
+    }
+    else if (compression == BI_BITFIELDS || compression == BI_ALPHABITFIELDS)
+    {
+        for (i = 0; i < (compression == BI_ALPHABITFIELDS ? 4 : 3); i++)
+            put_u32 (array, masks [i]);
+    }
+
+    for (i = 0; i < n_colors; i++)
+        put_u32 (array, palette [i] & 0x00ffffff);
+
+    g_assert_cmpint (array->len, ==, data_ofs);
+    return array;
+}
+
+static void
+end_bmp (GByteArray *array)
+{
+    array->data [2] = array->len & 0xff;
+    array->data [3] = (array->len >> 8) & 0xff;
+    array->data [4] = (array->len >> 16) & 0xff;
+    array->data [5] = array->len >> 24;
+}
+
+static guint8
+extract_channel (guint32 v, guint32 mask, guint8 def)
+{
+    gint shift = 0;
+
+    if (!mask)
+        return def;
+
+    while (!((mask >> shift) & 1))
+        shift++;
+
+    mask >>= shift;
+    return ((guint64) ((v >> shift) & mask) * 255 + mask / 2) / mask;
+}
+
+/* Generates random pixels and their expected RGBA8 values. For paletted
+ * images, the values are indices. */
+static GByteArray *
+encode (const Variant *variant, GRand *rand, guint32 *values, guint8 *expected)
+{
+    GByteArray *array;
+    guint32 palette [256];
+    gint n_colors = 0;
+    gint rowstride;
+    gint x, y, i;
+
+    if (variant->bpp <= 8)
+    {
+        n_colors = 1 << variant->bpp;
+        for (i = 0; i < n_colors; i++)
+            palette [i] = g_rand_int (rand) & 0x00ffffff;
+    }
+
+    array = begin_bmp (variant->header_size, WIDTH, variant->top_down ? -HEIGHT : HEIGHT,
+                       variant->bpp, variant->compression, variant->masks, palette, n_colors);
+
+    for (i = 0; i < WIDTH * HEIGHT; i++)
+    {
+        guint8 *e = expected + i * 4;
+        guint32 v;
+
+        if (variant->bpp <= 8)
+        {
+            v = g_rand_int_range (rand, 0, n_colors);
+            e [0] = palette [v] >> 16;
+            e [1] = palette [v] >> 8;
+            e [2] = palette [v];
+            e [3] = 0xff;
+        }
+        else if (variant->bpp == 24)
+        {
+            v = g_rand_int (rand) & 0x00ffffff;
+            e [0] = v >> 16;
+            e [1] = v >> 8;
+            e [2] = v;
+            e [3] = 0xff;
+        }
+        else
+        {
+            v = g_rand_int (rand);
+            if (variant->bpp == 16)
+                v &= 0xffff;
+
+            e [0] = extract_channel (v, variant->masks [0], 0);
+            e [1] = extract_channel (v, variant->masks [1], 0);
+            e [2] = extract_channel (v, variant->masks [2], 0);
+            e [3] = extract_channel (v, variant->masks [3], 0xff);
+        }
+
+        values [i] = v;
+    }
+
+    rowstride = ((WIDTH * variant->bpp + 31) / 32) * 4;
+
+    for (y = 0; y < HEIGHT; y++)
+    {
+        gint src_y = variant->top_down ? y : HEIGHT - 1 - y;
+        guint8 row [WIDTH * 4];
+
+        memset (row, 0, sizeof (row));
+
+        for (x = 0; x < WIDTH; x++)
+        {
+            guint32 v = values [src_y * WIDTH + x];
+
+            switch (variant->bpp)
+            {
+                case 1:
+                    row [x / 8] |= v << (7 - (x % 8));
+                    break;
+                case 4:
+                    row [x / 2] |= v << ((x & 1) ? 0 : 4);
+                    break;
+                case 8:
+                    row [x] = v;
+                    break;
+                case 16:
+                    row [x * 2] = v;
+                    row [x * 2 + 1] = v >> 8;
+                    break;
+                case 24:
+                    row [x * 3] = v;
+                    row [x * 3 + 1] = v >> 8;
+                    row [x * 3 + 2] = v >> 16;
+                    break;
+                case 32:
+                    row [x * 4] = v;
+                    row [x * 4 + 1] = v >> 8;
+                    row [x * 4 + 2] = v >> 16;
+                    row [x * 4 + 3] = v >> 24;
+                    break;
+            }
+        }
+
+        g_byte_array_append (array, row, rowstride);
+    }
+
+    end_bmp (array);
+    return array;
+}
+
+static gpointer
+new_loader (ChicleFileMapping *mapping, G_GNUC_UNUSED gpointer user_data)
+{
+    return chicle_bmp_loader_new_from_mapping (mapping);
+}
+
+static ChicleBmpLoader *
+load (GByteArray *array, ChicleFileMapping **mapping_out, gchar **path_out)
+{
+    return loader_test_load ("bmp-loader-test-XXXXXX.bmp", array->data, array->len,
+                             new_loader, NULL, mapping_out, path_out);
+}
+
+static void
+unload (ChicleBmpLoader *loader, gchar *path)
+{
+    loader_test_unload (loader, (GDestroyNotify) chicle_bmp_loader_destroy, path);
+}
+
+static void
+get_pixel (const guint8 *pixels, ChafaPixelType pixel_type, gint rowstride,
+           gint x, gint y, guint8 *out)
+{
+    const guint8 *p = pixels + y * rowstride;
+
+    switch (pixel_type)
+    {
+        case CHAFA_PIXEL_BGR8:
+            p += x * 3;
+            out [0] = p [2];
+            out [1] = p [1];
+            out [2] = p [0];
+            out [3] = 0xff;
+            break;
+        case CHAFA_PIXEL_BGRA8_UNASSOCIATED:
+            p += x * 4;
+            out [0] = p [2];
+            out [1] = p [1];
+            out [2] = p [0];
+            out [3] = p [3];
+            break;
+        case CHAFA_PIXEL_RGBA8_UNASSOCIATED:
+            memcpy (out, p + x * 4, 4);
+            break;
+        default:
+            g_assert_not_reached ();
+    }
+}
+
+static void
+check_variant (gconstpointer data)
+{
+    const Variant *variant = data;
+    ChicleFileMapping *mapping;
+    ChicleBmpLoader *loader;
+    ChafaPixelType pixel_type;
+    const guint8 *pixels, *indices, *file_data;
+    const guint32 *colors;
+    gsize file_len;
+    gint width, height, rowstride, n_colors;
+    guint32 values [WIDTH * HEIGHT];
+    guint8 expected [WIDTH * HEIGHT * 4];
+    GByteArray *array;
+    GRand *rand;
+    gchar *path;
+    gint x, y;
+
+    rand = g_rand_new_with_seed (variant->bpp * 1000 + variant->compression * 10 + variant->top_down);
+    array = encode (variant, rand, values, expected);
+
+    loader = load (array, &mapping, &path);
+    g_assert (loader != NULL);
+
+    pixels = chicle_bmp_loader_get_frame_data (loader, &pixel_type, &width, &height, &rowstride);
+    g_assert_cmpint (width, ==, WIDTH);
+    g_assert_cmpint (height, ==, HEIGHT);
+
+    file_data = chicle_file_mapping_get_data (mapping, &file_len);
+    g_assert_cmpint (pixels >= file_data && pixels < file_data + file_len, ==, variant->zero_copy);
+
+    for (y = 0; y < HEIGHT; y++)
+    {
+        for (x = 0; x < WIDTH; x++)
+        {
+            guint8 got [4];
+
+            get_pixel (pixels, pixel_type, rowstride, x, y, got);
+            g_assert_cmpmem (got, 4, expected + (y * WIDTH + x) * 4, 4);
+        }
+    }
+
+    indices = chicle_bmp_loader_get_frame_indices (loader, &colors, &n_colors, &rowstride);
+
+    if (variant->bpp > 8)
+    {
+        g_assert_null (indices);
+    }
+    else
+    {
+        g_assert_nonnull (indices);
+        g_assert_cmpint (n_colors, ==, 1 << variant->bpp);
+
+        /* Uncompressed top-down 8-bit indices come straight from the mapping */
+        g_assert_cmpint (indices >= file_data && indices < file_data + file_len, ==,
+                         variant->bpp == 8 && variant->top_down);
+
+        for (y = 0; y < HEIGHT; y++)
+        {
+            for (x = 0; x < WIDTH; x++)
+            {
+                guint32 c = colors [indices [y * rowstride + x]];
+                const guint8 *e = expected + (y * WIDTH + x) * 4;
+
+                g_assert_cmpint (indices [y * rowstride + x], ==, values [y * WIDTH + x]);
+                g_assert_cmphex (c, ==, (0xffU << 24) | (e [0] << 16) | (e [1] << 8) | e [2]);
+            }
+        }
+    }
+
+    unload (loader, path);
+    g_byte_array_free (array, TRUE);
+    g_rand_free (rand);
+}
+
+static void
+check_rle (gint bpp, gint compression, gint width, gint height,
+           const guint8 *stream, gint stream_len, gint n_palette_colors,
+           const guint8 *expected_indices, gint expected_n_colors)
+{
+    ChicleBmpLoader *loader;
+    ChafaPixelType pixel_type;
+    const guint8 *pixels, *indices;
+    const guint32 *colors;
+    guint32 palette [16];
+    gint rowstride, n_colors;
+    GByteArray *array;
+    gchar *path;
+    gint i;
+
+    for (i = 0; i < n_palette_colors; i++)
+        palette [i] = 0x102030 * (i + 1);
+
+    array = begin_bmp (40, width, height, bpp, compression, NULL, palette, n_palette_colors);
+    g_byte_array_append (array, stream, stream_len);
+    end_bmp (array);
+
+    loader = load (array, NULL, &path);
+    g_assert (loader != NULL);
+
+    indices = chicle_bmp_loader_get_frame_indices (loader, &colors, &n_colors, &rowstride);
+    g_assert_nonnull (indices);
+    g_assert_cmpint (n_colors, ==, expected_n_colors);
+    g_assert_cmpint (rowstride, ==, width);
+    g_assert_cmpmem (indices, width * height, expected_indices, width * height);
+
+    /* Skipped pixels are transparent */
+    g_assert_cmphex (colors [n_palette_colors], ==, 0);
+
+    pixels = chicle_bmp_loader_get_frame_data (loader, &pixel_type, NULL, NULL, &rowstride);
+    g_assert_cmpint (pixel_type, ==, CHAFA_PIXEL_RGBA8_UNASSOCIATED);
+
+    for (i = 0; i < width * height; i++)
+    {
+        guint32 c = colors [expected_indices [i]];
+        guint8 expected [4] = { c >> 16, c >> 8, c, c >> 24 };
+
+        g_assert_cmpmem (pixels + (i / width) * rowstride + (i % width) * 4, 4, expected, 4);
+    }
+
+    unload (loader, path);
+    g_byte_array_free (array, TRUE);
+}
+
+static void
+rle8_test (void)
+{
+    /* Bottom row: a run, then an absolute run that goes past the edge.
+     * The middle row is skipped by a delta, and the top row is partially
+     * filled before the end of the bitmap. */
+    static const guint8 stream [] =
+    {
+        0x03, 0x01, 0x00, 0x03, 0x02, 0x03, 0x01, 0x00, 0x00, 0x00,
+        0x00, 0x02, 0x02, 0x01, 0x02, 0x00, 0x00, 0x01
+    };
+    static const guint8 expected [] =
+    {
+        4, 4, 0, 0, 4,
+        4, 4, 4, 4, 4,
+        1, 1, 1, 2, 3
+    };
+
+    check_rle (8, BI_RLE8, 5, 3, stream, sizeof (stream), 4, expected, 5);
+}
+
+static void
+rle4_test (void)
+{
+    /* Nibbles alternate in runs. The top row ends early. */
+    static const guint8 stream [] =
+    {
+        0x05, 0x12, 0x00, 0x00, 0x00, 0x03, 0x21, 0x00, 0x00, 0x01
+    };
+    static const guint8 expected [] =
+    {
+        2, 1, 0, 3, 3,
+        1, 2, 1, 2, 1
+    };
+
+    check_rle (4, BI_RLE4, 5, 2, stream, sizeof (stream), 3, expected, 4);
+}
+
+static gboolean
+try_load (GByteArray *array)
+{
+    ChicleBmpLoader *loader;
+    gchar *path;
+    gboolean result;
+
+    loader = load (array, NULL, &path);
+    result = loader != NULL;
+
+    unload (loader, path);
+    g_byte_array_free (array, TRUE);
+    return result;
+}
+
+static GByteArray *
+make_24_bit (gint width, gint height, gint compression, gint n_rows)
+{
+    GByteArray *array;
+    gint i;
+
+    array = begin_bmp (40, width, height, 24, compression, NULL, NULL, 0);
+    for (i = 0; i < n_rows * ((width * 3 + 3) & ~3); i++)
+        g_byte_array_append (array, (const guint8 *) "\x55", 1);
+    end_bmp (array);
+
+    return array;
+}
+
+static void
+bad_test (void)
+{
+    GByteArray *array;
+
+    /* Sanity check */
+    g_assert_true (try_load (make_24_bit (3, 2, BI_RGB, 2)));
+
+    /* Truncated raster */
+    g_assert_false (try_load (make_24_bit (3, 2, BI_RGB, 1)));
+
+    /* Bad dimensions */
+    g_assert_false (try_load (make_24_bit (0, 2, BI_RGB, 2)));
+    g_assert_false (try_load (make_24_bit (3, 0, BI_RGB, 2)));
+    g_assert_false (try_load (make_24_bit (-3, 2, BI_RGB, 2)));
+    g_assert_false (try_load (make_24_bit (1 << 20, 1 << 20, BI_RGB, 0)));
+
+    /* OS/2 header */
+    array = make_24_bit (3, 2, BI_RGB, 2);
+    array->data [14] = 12;
+    g_assert_false (try_load (array));
+
+    /* Compression that doesn't fit the depth */
+    g_assert_false (try_load (make_24_bit (3, 2, BI_RLE8, 2)));
+    g_assert_false (try_load (make_24_bit (3, 2, 4 /* BI_JPEG */, 2)));
+
+    /* Top-down RLE isn't allowed */
+    array = begin_bmp (40, 2, -2, 8, BI_RLE8, NULL, (const guint32 [2]) { 0 }, 2);
+    g_byte_array_append (array, (const guint8 *) "\x00\x01", 2);
+    end_bmp (array);
+    g_assert_false (try_load (array));
+
+    /* Bad magic */
+    array = make_24_bit (3, 2, BI_RGB, 2);
+    array->data [0] = 'X';
+    g_assert_false (try_load (array));
+}
+
+int
+main (int argc, char *argv [])
+{
+    guint i;
+
+    g_test_init (&argc, &argv, NULL);
+
+    for (i = 0; i < G_N_ELEMENTS (variants); i++)
+    {
+        gchar *name = g_strdup_printf ("/bmp-loader/%s", variants [i].name);
+
+        g_test_add_data_func (name, &variants [i], check_variant);
+        g_free (name);
+    }
+
+    g_test_add_func ("/bmp-loader/rle8", rle8_test);
+    g_test_add_func ("/bmp-loader/rle4", rle4_test);
+    g_test_add_func ("/bmp-loader/bad", bad_test);
+
+    return g_test_run ();
+}
@@ -0,0 +1,438 @@
+#include "config.h"
+
+#include <chafa.h>
+#include "internal/chafa-canvas-internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WIDTH_CELLS 40
+#define HEIGHT_CELLS 20
+#define WIDTH_PIXELS 320
+#define HEIGHT_PIXELS 160
+
+/* Colors as shown by the terminal. Indexed colors have bit 24 set. */
+#define INDEXED_COLOR 0x1000000
+#define DEFAULT_COLOR -1
+
+typedef struct
+{
+    gunichar c;
+    gint32 fg, bg;
+}
+PrintedCell;
+
+static const gfloat merge_thresholds [] = { 0.0f, 0.01f, 0.02f, 0.05f, 0.1f, 0.2f };
+
+/* Smooth gradients with some noise and a few hard edges, roughly what
+ * a photo looks like at this resolution. */
+static guint8 *
+gen_photo_like_image (void)
+{
+    guint8 *pixels, *p;
+    GRand *rand;
+    gint x, y;
+
+    rand = g_rand_new_with_seed (1234);
+    pixels = p = g_malloc (WIDTH_PIXELS * HEIGHT_PIXELS * 4);
+
+    for (y = 0; y < HEIGHT_PIXELS; y++)
+    {
+        for (x = 0; x < WIDTH_PIXELS; x++)
+        {
+            gint dx = x - WIDTH_PIXELS / 2, dy = (y - HEIGHT_PIXELS / 2) * 2;
+            gint base [3], i;
+
+            base [0] = x * 255 / WIDTH_PIXELS;
+            base [1] = y * 255 / HEIGHT_PIXELS;
+            base [2] = 96;
+
+            if (dx * dx + dy * dy < 60 * 60)
+            {
+                base [0] = 255 - base [0];
+                base [2] = 224;
+            }
+
+            for (i = 0; i < 3; i++)
+                *(p++) = CLAMP (base [i] + g_rand_int_range (rand, -8, 9), 0, 255);
+            *(p++) = 0xff;
+        }
+    }
+
+    g_rand_free (rand);
+    return pixels;
+}
+
+static ChafaCanvas *
+create_canvas (ChafaCanvasMode canvas_mode, gfloat merge_threshold, const guint8 *pixels)
+{
+    ChafaCanvasConfig *config;
+    ChafaCanvas *canvas;
+
+    config = chafa_canvas_config_new ();
+    chafa_canvas_config_set_geometry (config, WIDTH_CELLS, HEIGHT_CELLS);
+    chafa_canvas_config_set_canvas_mode (config, canvas_mode);
+    if (merge_threshold > 0.0f)
+        chafa_canvas_config_set_color_merge_threshold (config, merge_threshold);
+
+    canvas = chafa_canvas_new (config);
+    chafa_canvas_draw_all_pixels (canvas, CHAFA_PIXEL_RGBA8_UNASSOCIATED,
+                                  pixels, WIDTH_PIXELS, HEIGHT_PIXELS, WIDTH_PIXELS * 4);
+
+    chafa_canvas_config_unref (config);
+    return canvas;
+}
+
+static ChafaTermInfo *
+create_term_info (void)
+{
+    gchar *envp [] = { "TERM=xterm-256color", "COLORTERM=truecolor", NULL };
+
+    return chafa_term_db_detect (chafa_term_db_get_default (), envp);
+}
+
+static const gchar *
+parse_sgr (const gchar *p, gint32 *fg, gint32 *bg, gboolean *inverted)
+{
+    gint params [16];
+    gint n_params = 0, i;
+
+    params [0] = 0;
+
+    for ( ; *p == ';' || g_ascii_isdigit (*p); p++)
+    {
+        if (*p == ';')
+        {
+            g_assert (n_params < 15);
+            params [++n_params] = 0;
+        }
+        else
+        {
+            params [n_params] = params [n_params] * 10 + (*p - '0');
+        }
+    }
+
+    g_assert (*p == 'm');
+    n_params++;
+
+    for (i = 0; i < n_params; i++)
+    {
+        gint32 *target = params [i] == 38 ? fg : params [i] == 48 ? bg : NULL;
+
+        if (params [i] == 0)
+        {
+            *fg = *bg = DEFAULT_COLOR;
+            *inverted = FALSE;
+        }
+        else if (params [i] == 7)
+        {
+            *inverted = TRUE;
+        }
+        else if (params [i] == 39)
+        {
+            *fg = DEFAULT_COLOR;
+        }
+        else if (params [i] == 49)
+        {
+            *bg = DEFAULT_COLOR;
+        }
+        else if (target && params [i + 1] == 2)
+        {
+            *target = (params [i + 2] << 16) | (params [i + 3] << 8) | params [i + 4];
+            i += 4;
+        }
+        else if (target && params [i + 1] == 5)
+        {
+            *target = INDEXED_COLOR | params [i + 2];
+            i += 2;
+        }
+        else
+        {
+            g_printerr ("Unexpected SGR parameter %d.\n", params [i]);
+            g_assert_not_reached ();
+        }
+    }
+
+    return p + 1;
+}
+
+/* Replays the output like a terminal would, recording the symbol and
+ * colors of each cell. */
+static PrintedCell *
+parse_output (const gchar *str)
+{
+    PrintedCell *cells;
+    gint32 fg = DEFAULT_COLOR, bg = DEFAULT_COLOR;
+    gboolean inverted = FALSE;
+    gunichar last_c = 0;
+    const gchar *p = str;
+    gint x = 0, y = 0;
+
+    cells = g_new0 (PrintedCell, WIDTH_CELLS * HEIGHT_CELLS);
+
+    while (*p)
+    {
+        gint n_reps = 1;
+        gint i;
+
+        if (*p == '\n')
+        {
+            g_assert (x == WIDTH_CELLS);
+            x = 0;
+            y++;
+            p++;
+            continue;
+        }
+
+        if (*p == '\033')
+        {
+            const gchar *q;
+
+            g_assert (p [1] == '[');
+            p += 2;
+
+            for (q = p; *q == ';' || g_ascii_isdigit (*q); q++)
+                ;
+
+            if (*q != 'b')
+            {
+                p = parse_sgr (p, &fg, &bg, &inverted);
+                continue;
+            }
+
+            /* REP */
+            n_reps = atoi (p);
+            p = q + 1;
+        }
+        else
+        {
+            last_c = g_utf8_get_char (p);
+            p = g_utf8_next_char (p);
+        }
+
+        for (i = 0; i < n_reps; i++)
+        {
+            g_assert (x < WIDTH_CELLS && y < HEIGHT_CELLS);
+
+            cells [y * WIDTH_CELLS + x].c = last_c;
+            cells [y * WIDTH_CELLS + x].fg = inverted ? bg : fg;
+            cells [y * WIDTH_CELLS + x].bg = inverted ? fg : bg;
+            x++;
+        }
+    }
+
+    g_assert (x == WIDTH_CELLS && y == HEIGHT_CELLS - 1);
+    return cells;
+}
+
+static void
+get_rgb (ChafaCanvas *canvas, gint32 color, gint *rgb_out)
+{
+    g_assert (color != DEFAULT_COLOR);
+
+    if (color & INDEXED_COLOR)
+    {
+        const ChafaColor *col;
+
+        col = chafa_palette_get_color (&canvas->fg_palette, canvas->config.color_space,
+                                       color & 0xff);
+        rgb_out [0] = col->ch [0];
+        rgb_out [1] = col->ch [1];
+        rgb_out [2] = col->ch [2];
+    }
+    else
+    {
+        rgb_out [0] = (color >> 16) & 0xff;
+        rgb_out [1] = (color >> 8) & 0xff;
+        rgb_out [2] = color & 0xff;
+    }
+}
+
+static gint
+color_dist_sq (ChafaCanvas *canvas, gint32 a, gint32 b)
+{
+    gint rgb_a [3], rgb_b [3];
+    gint i, d = 0;
+
+    get_rgb (canvas, a, rgb_a);
+    get_rgb (canvas, b, rgb_b);
+
+    for (i = 0; i < 3; i++)
+        d += (rgb_a [i] - rgb_b [i]) * (rgb_a [i] - rgb_b [i]);
+
+    return d;
+}
+
+static guint64
+get_symbol_bitmap (ChafaCanvas *canvas, gunichar c)
+{
+    const ChafaSymbolMap *symbol_map = &canvas->config.symbol_map;
+    gint i;
+
+    for (i = 0; i < symbol_map->n_symbols; i++)
+    {
+        if (symbol_map->symbols [i].c == c)
+            return symbol_map->symbols [i].bitmap;
+    }
+
+    g_assert_not_reached ();
+    return 0;
+}
+
+static gint32
+get_cell_color (ChafaCanvas *canvas, guint32 color)
+{
+    if (canvas->config.canvas_mode == CHAFA_CANVAS_MODE_TRUECOLOR)
+        return color & 0xffffff;
+
+    return INDEXED_COLOR | color;
+}
+
+/* Compares the printed cells with the canvas, verifying that no color is
+ * off by more than the threshold. Returns the number of inverted cells. */
+static gint
+check_max_error (ChafaCanvas *canvas, const PrintedCell *printed, gfloat merge_threshold)
+{
+    gfloat max_dist = merge_threshold * 255.0f;
+    gint max_dist_sq = max_dist * max_dist;
+    gint n_inverted = 0;
+    gint i;
+
+    for (i = 0; i < WIDTH_CELLS * HEIGHT_CELLS; i++)
+    {
+        const ChafaCanvasCell *cell = &canvas->cells [i];
+        const PrintedCell *pc = &printed [i];
+        gint32 fg = get_cell_color (canvas, cell->fg_color);
+        gint32 bg = get_cell_color (canvas, cell->bg_color);
+
+        if (pc->c != cell->c)
+        {
+            /* Must be the exact inverse, with colors swapped */
+            g_assert (get_symbol_bitmap (canvas, pc->c) == ~get_symbol_bitmap (canvas, cell->c));
+            fg = get_cell_color (canvas, cell->bg_color);
+            bg = get_cell_color (canvas, cell->fg_color);
+            n_inverted++;
+        }
+
+        g_assert_cmpint (color_dist_sq (canvas, pc->fg, fg), <=, max_dist_sq);
+        g_assert_cmpint (color_dist_sq (canvas, pc->bg, bg), <=, max_dist_sq);
+    }
+
+    return n_inverted;
+}
+
+static void
+merge_max_error_test_mode (ChafaCanvasMode canvas_mode)
+{
+    ChafaTermInfo *term_info;
+    guint8 *pixels;
+    gint n_inverted = 0;
+    guint i;
+
+    term_info = create_term_info ();
+    pixels = gen_photo_like_image ();
+
+    for (i = 0; i < G_N_ELEMENTS (merge_thresholds); i++)
+    {
+        ChafaCanvas *canvas;
+        PrintedCell *printed;
+        GString *gs;
+
+        canvas = create_canvas (canvas_mode, merge_thresholds [i], pixels);
+        gs = chafa_canvas_print (canvas, term_info);
+
+        printed = parse_output (gs->str);
+        n_inverted += check_max_error (canvas, printed, merge_thresholds [i]);
+
+        /* No inversions in lossless mode */
+        if (i == 0)
+            g_assert_cmpint (n_inverted, ==, 0);
+
+        g_free (printed);
+        g_string_free (gs, TRUE);
+        chafa_canvas_unref (canvas);
+    }
+
+    /* Make sure the inverse symbol path got some exercise */
+    g_assert_cmpint (n_inverted, >, 0);
+
+    g_free (pixels);
+    chafa_term_info_unref (term_info);
+}
+
+static void
+merge_max_error_truecolor_test (void)
+{
+    merge_max_error_test_mode (CHAFA_CANVAS_MODE_TRUECOLOR);
+}
+
+static void
+merge_max_error_256_test (void)
+{
+    merge_max_error_test_mode (CHAFA_CANVAS_MODE_INDEXED_256);
+}
+
+static void
+merge_bytes_test_mode (ChafaCanvasMode canvas_mode, const gchar *mode_name)
+{
+    ChafaTermInfo *term_info;
+    guint8 *pixels;
+    gsize lossless_len = 0, prev_len = G_MAXSIZE;
+    guint i;
+
+    term_info = create_term_info ();
+    pixels = gen_photo_like_image ();
+
+    for (i = 0; i < G_N_ELEMENTS (merge_thresholds); i++)
+    {
+        ChafaCanvas *canvas;
+        GString *gs;
+
+        canvas = create_canvas (canvas_mode, merge_thresholds [i], pixels);
+        gs = chafa_canvas_print (canvas, term_info);
+
+        g_test_minimized_result ((gdouble) gs->len / (WIDTH_CELLS * HEIGHT_CELLS),
+                                 "%s, threshold %.2f: %.1f bytes per cell",
+                                 mode_name, merge_thresholds [i],
+                                 (gdouble) gs->len / (WIDTH_CELLS * HEIGHT_CELLS));
+
+        if (i == 0)
+            lossless_len = gs->len;
+
+        /* A higher threshold should never make things worse here */
+        g_assert_cmpuint (gs->len, <=, prev_len);
+        prev_len = gs->len;
+
+        /* A threshold of 0.05 is barely noticeable, so it should pull
+         * its weight. Palette colors are too far apart for this to hold
+         * in indexed modes. */
+        if (canvas_mode == CHAFA_CANVAS_MODE_TRUECOLOR
+            && merge_thresholds [i] == 0.05f)
+            g_assert_cmpuint (gs->len, <, lossless_len * 3 / 4);
+
+        g_string_free (gs, TRUE);
+        chafa_canvas_unref (canvas);
+    }
+
+    g_free (pixels);
+    chafa_term_info_unref (term_info);
+}
+
+static void
+merge_bytes_test (void)
+{
+    merge_bytes_test_mode (CHAFA_CANVAS_MODE_TRUECOLOR, "truecolor");
+    merge_bytes_test_mode (CHAFA_CANVAS_MODE_INDEXED_256, "256 colors");
+}
+
+int
+main (int argc, char *argv [])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/canvas-printer/merge/max-error/truecolor", merge_max_error_truecolor_test);
+    g_test_add_func ("/canvas-printer/merge/max-error/256", merge_max_error_256_test);
+    g_test_add_func ("/canvas-printer/merge/bytes", merge_bytes_test);
+
+    return g_test_run ();
+}
@@ -0,0 +1,392 @@
+#include "config.h"
+
+#include <chafa.h>
+#include "internal/chafa-canvas-internal.h"
+#include <stdio.h>
+#include <string.h>
+
+/* The source is 1:1 with the symbol matrix at zoom 80x40 */
+#define SRC_WIDTH 640
+#define SRC_HEIGHT 320
+#define ZOOM_WIDTH 80
+#define ZOOM_HEIGHT 40
+
+#define VIEW_WIDTH 20
+#define VIEW_HEIGHT 10
+
+#define WIDE_GLYPH 0x4e00
+
+typedef struct
+{
+    gint x, y;
+}
+Position;
+
+/* A pan around the image, mixing single-cell steps, jumps and positions
+ * that need clamping. */
+static const Position pan_path [] =
+{
+    { 0, 0 }, { 1, 0 }, { 2, 0 }, { 2, 1 }, { 13, 7 }, { 31, 15 }, { 32, 16 },
+    { 33, 17 }, { 45, 22 }, { 60, 30 }, { 59, 30 }, { 100, 100 }, { 7, 29 },
+    { -5, 3 }, { 0, 0 }
+};
+
+static guint8 *
+gen_image (void)
+{
+    guint8 *pixels, *p;
+    GRand *rand;
+    gint x, y;
+
+    rand = g_rand_new_with_seed (4321);
+    pixels = p = g_malloc (SRC_WIDTH * SRC_HEIGHT * 4);
+
+    for (y = 0; y < SRC_HEIGHT; y++)
+    {
+        for (x = 0; x < SRC_WIDTH; x++)
+        {
+            gint base [3], i;
+
+            base [0] = x * 255 / SRC_WIDTH;
+            base [1] = y * 255 / SRC_HEIGHT;
+            base [2] = ((x / 24 + y / 16) & 1) ? 40 : 200;
+
+            for (i = 0; i < 3; i++)
+                *(p++) = CLAMP (base [i] + g_rand_int_range (rand, -24, 25), 0, 255);
+            *(p++) = 0xff;
+        }
+    }
+
+    g_rand_free (rand);
+    return pixels;
+}
+
+static ChafaCanvas *
+new_canvas (ChafaCanvasMode canvas_mode, ChafaDitherMode dither_mode,
+            gfloat work_factor, gint width, gint height)
+{
+    ChafaCanvasConfig *config;
+    ChafaSymbolMap *symbol_map;
+    ChafaCanvas *canvas;
+
+    /* Wide symbols may pair up across tile boundaries in a full render */
+    symbol_map = chafa_symbol_map_new ();
+    chafa_symbol_map_add_by_tags (symbol_map,
+                                  CHAFA_SYMBOL_TAG_BLOCK
+                                  | CHAFA_SYMBOL_TAG_BORDER
+                                  | CHAFA_SYMBOL_TAG_SPACE);
+
+    config = chafa_canvas_config_new ();
+    chafa_canvas_config_set_geometry (config, width, height);
+    chafa_canvas_config_set_canvas_mode (config, canvas_mode);
+    chafa_canvas_config_set_dither_mode (config, dither_mode);
+    chafa_canvas_config_set_work_factor (config, work_factor);
+    chafa_canvas_config_set_symbol_map (config, symbol_map);
+
+    canvas = chafa_canvas_new (config);
+
+    chafa_canvas_config_unref (config);
+    chafa_symbol_map_unref (symbol_map);
+    return canvas;
+}
+
+/* The foreground color of a blank cell is copied from its left neighbor
+ * to save on control sequences, so it depends on where the row starts. */
+static void
+assert_cells_equal (ChafaCanvas *a, ChafaCanvas *b, gboolean ignore_blank_fg)
+{
+    gint x, y;
+
+    for (y = 0; y < VIEW_HEIGHT; y++)
+    {
+        for (x = 0; x < VIEW_WIDTH; x++)
+        {
+            const ChafaCanvasCell *cell_a = &a->cells [y * VIEW_WIDTH + x];
+            const ChafaCanvasCell *cell_b = &b->cells [y * VIEW_WIDTH + x];
+
+            if (cell_a->c != cell_b->c
+                || cell_a->bg_color != cell_b->bg_color
+                || (cell_a->fg_color != cell_b->fg_color
+                    && !(ignore_blank_fg && cell_a->c == ' ')))
+            {
+                g_printerr ("Cell (%d, %d): got U+%04x %08x/%08x, expected U+%04x %08x/%08x\n",
+                            x, y,
+                            cell_a->c, cell_a->fg_color, cell_a->bg_color,
+                            cell_b->c, cell_b->fg_color, cell_b->bg_color);
+                g_assert_not_reached ();
+            }
+        }
+    }
+}
+
+static void
+check_crop (const guint8 *src, ChafaCanvasMode canvas_mode, gfloat work_factor)
+{
+    ChafaCanvas *view_canvas;
+    guint i;
+
+    view_canvas = new_canvas (canvas_mode, CHAFA_DITHER_MODE_NONE, work_factor,
+                              VIEW_WIDTH, VIEW_HEIGHT);
+    chafa_canvas_set_viewport_source (view_canvas, CHAFA_PIXEL_RGBA8_UNASSOCIATED,
+                                      src, SRC_WIDTH, SRC_HEIGHT, SRC_WIDTH * 4,
+                                      ZOOM_WIDTH, ZOOM_HEIGHT);
+
+    for (i = 0; i < G_N_ELEMENTS (pan_path); i++)
+    {
+        ChafaCanvas *crop_canvas;
+        gint x, y;
+
+        chafa_canvas_set_viewport (view_canvas, pan_path [i].x, pan_path [i].y);
+        chafa_viewport_get_position (view_canvas->viewport, &x, &y);
+
+        g_assert_cmpint (x, ==, CLAMP (pan_path [i].x, 0, ZOOM_WIDTH - VIEW_WIDTH));
+        g_assert_cmpint (y, ==, CLAMP (pan_path [i].y, 0, ZOOM_HEIGHT - VIEW_HEIGHT));
+
+        crop_canvas = new_canvas (canvas_mode, CHAFA_DITHER_MODE_NONE, work_factor,
+                                  VIEW_WIDTH, VIEW_HEIGHT);
+        chafa_canvas_draw_all_pixels (crop_canvas, CHAFA_PIXEL_RGBA8_UNASSOCIATED,
+                                      src + (y * CHAFA_SYMBOL_HEIGHT_PIXELS * SRC_WIDTH
+                                             + x * CHAFA_SYMBOL_WIDTH_PIXELS) * 4,
+                                      VIEW_WIDTH * CHAFA_SYMBOL_WIDTH_PIXELS,
+                                      VIEW_HEIGHT * CHAFA_SYMBOL_HEIGHT_PIXELS,
+                                      SRC_WIDTH * 4);
+
+        assert_cells_equal (view_canvas, crop_canvas, TRUE);
+        chafa_canvas_unref (crop_canvas);
+    }
+
+    chafa_canvas_unref (view_canvas);
+}
+
+static void
+crop_test (void)
+{
+    guint8 *src = gen_image ();
+
+    /* Nearest neighbor and Smolscale paths */
+    check_crop (src, CHAFA_CANVAS_MODE_TRUECOLOR, 0.1f);
+    check_crop (src, CHAFA_CANVAS_MODE_TRUECOLOR, 0.5f);
+    check_crop (src, CHAFA_CANVAS_MODE_INDEXED_256, 0.5f);
+
+    g_free (src);
+}
+
+static void
+check_history (const guint8 *src, ChafaCanvasMode canvas_mode,
+               gint zoom_width, gint zoom_height)
+{
+    ChafaCanvas *view_canvas;
+    guint i;
+
+    view_canvas = new_canvas (canvas_mode, CHAFA_DITHER_MODE_ORDERED, 0.5f,
+                              VIEW_WIDTH, VIEW_HEIGHT);
+    chafa_canvas_set_viewport_source (view_canvas, CHAFA_PIXEL_RGBA8_UNASSOCIATED,
+                                      src, SRC_WIDTH, SRC_HEIGHT, SRC_WIDTH * 4,
+                                      zoom_width, zoom_height);
+
+    for (i = 0; i < G_N_ELEMENTS (pan_path); i++)
+    {
+        ChafaCanvas *cold_canvas;
+
+        chafa_canvas_set_viewport (view_canvas, pan_path [i].x, pan_path [i].y);
+
+        cold_canvas = new_canvas (canvas_mode, CHAFA_DITHER_MODE_ORDERED, 0.5f,
+                                  VIEW_WIDTH, VIEW_HEIGHT);
+        chafa_canvas_set_viewport_source (cold_canvas, CHAFA_PIXEL_RGBA8_UNASSOCIATED,
+                                          src, SRC_WIDTH, SRC_HEIGHT, SRC_WIDTH * 4,
+                                          zoom_width, zoom_height);
+        chafa_canvas_set_viewport (cold_canvas, pan_path [i].x, pan_path [i].y);
+
+        assert_cells_equal (view_canvas, cold_canvas, FALSE);
+        chafa_canvas_unref (cold_canvas);
+    }
+
+    chafa_canvas_unref (view_canvas);
+}
+
+static void
+history_test (void)
+{
+    guint8 *src = gen_image ();
+
+    /* Panned views must not depend on what was shown before, also when
+     * scaling and dithering. The last zoom is smaller than the view. */
+    check_history (src, CHAFA_CANVAS_MODE_INDEXED_256, 57, 29);
+    check_history (src, CHAFA_CANVAS_MODE_INDEXED_16, 123, 61);
+    check_history (src, CHAFA_CANVAS_MODE_TRUECOLOR, 15, 7);
+
+    g_free (src);
+}
+
+static void
+incremental_test (void)
+{
+    ChafaCanvas *canvas;
+    ChafaViewport *viewport;
+    guint8 *src = gen_image ();
+
+    canvas = new_canvas (CHAFA_CANVAS_MODE_TRUECOLOR, CHAFA_DITHER_MODE_NONE, 0.5f,
+                         VIEW_WIDTH, VIEW_HEIGHT);
+    chafa_canvas_set_viewport_source (canvas, CHAFA_PIXEL_RGBA8_UNASSOCIATED,
+                                      src, SRC_WIDTH, SRC_HEIGHT, SRC_WIDTH * 4,
+                                      ZOOM_WIDTH, ZOOM_HEIGHT);
+    viewport = canvas->viewport;
+
+    /* Within the first tile */
+    chafa_canvas_set_viewport (canvas, 0, 0);
+    g_assert_cmpint (chafa_viewport_get_n_tiles_rendered (viewport), ==, 1);
+    chafa_canvas_set_viewport (canvas, 12, 6);
+    g_assert_cmpint (chafa_viewport_get_n_tiles_rendered (viewport), ==, 1);
+
+    /* One cell to the right exposes the next tile column */
+    chafa_canvas_set_viewport (canvas, 13, 6);
+    g_assert_cmpint (chafa_viewport_get_n_tiles_rendered (viewport), ==, 2);
+
+    /* One cell down exposes the next tile row */
+    chafa_canvas_set_viewport (canvas, 13, 7);
+    g_assert_cmpint (chafa_viewport_get_n_tiles_rendered (viewport), ==, 4);
+
+    /* Going back is free */
+    chafa_canvas_set_viewport (canvas, 0, 0);
+    chafa_canvas_set_viewport (canvas, 13, 7);
+    g_assert_cmpint (chafa_viewport_get_n_tiles_rendered (viewport), ==, 4);
+
+    /* Drawing pixels drops the viewport */
+    chafa_canvas_draw_all_pixels (canvas, CHAFA_PIXEL_RGBA8_UNASSOCIATED,
+                                  src, SRC_WIDTH, SRC_HEIGHT, SRC_WIDTH * 4);
+    g_assert (canvas->viewport == NULL);
+
+    chafa_canvas_unref (canvas);
+    g_free (src);
+}
+
+/* A triangle in the left half of every two cells. Only a wide symbol can
+ * show it, given spaces as the only narrow symbol. */
+static gboolean
+in_wide_shape (gint x, gint y)
+{
+    x %= CHAFA_SYMBOL_WIDTH_PIXELS * 2;
+    y %= CHAFA_SYMBOL_HEIGHT_PIXELS;
+
+    return x < CHAFA_SYMBOL_WIDTH_PIXELS && x < y;
+}
+
+static guint8 *
+gen_wide_image (void)
+{
+    guint8 *pixels, *p;
+    gint x, y;
+
+    pixels = p = g_malloc (SRC_WIDTH * SRC_HEIGHT * 4);
+
+    for (y = 0; y < SRC_HEIGHT; y++)
+    {
+        for (x = 0; x < SRC_WIDTH; x++)
+        {
+            guint8 v = in_wide_shape (x, y) ? 0xff : 0x00;
+
+            *(p++) = v;
+            *(p++) = v;
+            *(p++) = v;
+            *(p++) = 0xff;
+        }
+    }
+
+    return pixels;
+}
+
+static ChafaCanvas *
+new_wide_canvas (void)
+{
+    guint8 pixels [CHAFA_SYMBOL_N_PIXELS * 2 * 4];
+    ChafaCanvasConfig *config;
+    ChafaSymbolMap *symbol_map;
+    ChafaCanvas *canvas;
+    gint i;
+
+    /* Glyph coverage is taken from the alpha channel */
+    for (i = 0; i < CHAFA_SYMBOL_N_PIXELS * 2; i++)
+    {
+        pixels [i * 4] = pixels [i * 4 + 1] = pixels [i * 4 + 2] = 0xff;
+        pixels [i * 4 + 3] = in_wide_shape (i % (CHAFA_SYMBOL_WIDTH_PIXELS * 2),
+                                            i / (CHAFA_SYMBOL_WIDTH_PIXELS * 2)) ? 0xff : 0x00;
+    }
+
+    symbol_map = chafa_symbol_map_new ();
+    chafa_symbol_map_add_glyph (symbol_map, WIDE_GLYPH, CHAFA_PIXEL_RGBA8_UNASSOCIATED,
+                                pixels, CHAFA_SYMBOL_WIDTH_PIXELS * 2, CHAFA_SYMBOL_HEIGHT_PIXELS,
+                                CHAFA_SYMBOL_WIDTH_PIXELS * 2 * 4);
+    chafa_symbol_map_add_by_range (symbol_map, WIDE_GLYPH, WIDE_GLYPH);
+    chafa_symbol_map_add_by_tags (symbol_map, CHAFA_SYMBOL_TAG_SPACE);
+
+    config = chafa_canvas_config_new ();
+    chafa_canvas_config_set_geometry (config, VIEW_WIDTH, VIEW_HEIGHT);
+    chafa_canvas_config_set_canvas_mode (config, CHAFA_CANVAS_MODE_TRUECOLOR);
+    chafa_canvas_config_set_symbol_map (config, symbol_map);
+
+    canvas = chafa_canvas_new (config);
+
+    chafa_canvas_config_unref (config);
+    chafa_symbol_map_unref (symbol_map);
+    return canvas;
+}
+
+/* Panning one cell at a time cuts through wide symbols at both edges. The
+ * halves that are left must not make it into the canvas. */
+static void
+wide_test (void)
+{
+    ChafaCanvas *canvas;
+    guint8 *src = gen_wide_image ();
+    gint n_cut = 0;
+    gint x, y;
+
+    canvas = new_wide_canvas ();
+    chafa_canvas_set_viewport_source (canvas, CHAFA_PIXEL_RGBA8_UNASSOCIATED,
+                                      src, SRC_WIDTH, SRC_HEIGHT, SRC_WIDTH * 4,
+                                      ZOOM_WIDTH, ZOOM_HEIGHT);
+
+    for (x = 0; x < 8; x++)
+    {
+        chafa_canvas_set_viewport (canvas, x, 0);
+
+        for (y = 0; y < VIEW_HEIGHT; y++)
+        {
+            const ChafaCanvasCell *row = &canvas->cells [y * VIEW_WIDTH];
+            gint i;
+
+            g_assert_cmpuint (row [0].c, !=, 0);
+            g_assert (!g_unichar_iswide (row [VIEW_WIDTH - 1].c));
+
+            for (i = 1; i < VIEW_WIDTH; i++)
+            {
+                if (row [i].c == 0)
+                    g_assert_cmpuint (row [i - 1].c, ==, WIDE_GLYPH);
+                else if (row [i - 1].c == WIDE_GLYPH)
+                    g_assert_not_reached ();
+            }
+
+            /* The next step cuts this one in half */
+            if (row [0].c == WIDE_GLYPH)
+                n_cut++;
+        }
+    }
+
+    g_assert_cmpint (n_cut, >, 0);
+
+    chafa_canvas_unref (canvas);
+    g_free (src);
+}
+
+int
+main (int argc, char *argv [])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/canvas-viewport/crop", crop_test);
+    g_test_add_func ("/canvas-viewport/history", history_test);
+    g_test_add_func ("/canvas-viewport/incremental", incremental_test);
+    g_test_add_func ("/canvas-viewport/wide", wide_test);
+
+    return g_test_run ();
+}
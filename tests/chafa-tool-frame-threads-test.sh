@@ -0,0 +1,55 @@
+#!/bin/sh
+
+[ "x${srcdir}" = "x" ] && srcdir="."
+. "${srcdir}/chafa-tool-test-common.sh"
+
+# Rendering frames concurrently must not change the output or its order.
+
+seq_out=$(mktemp)
+par_out=$(mktemp)
+seq_err=$(mktemp)
+par_err=$(mktemp)
+cache=$(mktemp -d)
+trap 'rm -rf "$seq_out" "$par_out" "$seq_err" "$par_err" "$cache"' EXIT
+
+check_same () {
+    term="$1"
+    shift
+
+    # Kitty placement IDs are persisted; start from the same one every time
+    cmd="env -i TERM=$term XDG_CACHE_HOME=$cache $tool -d 0 --speed max --dump-frame-bytes $*"
+    echo "$cmd" >&2
+
+    rm -rf "$cache/chafa"
+    $cmd --frame-threads 1 >"$seq_out" 2>"$seq_err" || exit 1
+
+    for n in 2 3 8; do
+        rm -rf "$cache/chafa"
+        $cmd --frame-threads $n >"$par_out" 2>"$par_err" || exit 1
+        cmp "$seq_out" "$par_out" || exit 1
+        cmp "$seq_err" "$par_err" || exit 1
+    done
+}
+
+for anim in anim.gif anim-disposal.gif anim-local-cmaps.gif; do
+    file="${top_srcdir}/tests/data/good/$anim"
+
+    check_same xterm-256color -f symbols "$file"
+    check_same xterm-256color -f symbols -s 8x4 "$file"
+    check_same xterm-256color -f symbols --relative on --align mid,mid "$file"
+    check_same xterm-kitty -f kitty "$file"
+    check_same xterm-kitty -f kitty --passthrough tmux "$file"
+    check_same xterm-256color -f sixels "$file"
+done
+
+# Several files, with a still in between
+check_same xterm-256color -f symbols \
+    "${top_srcdir}/tests/data/good/anim.gif" \
+    "${top_srcdir}/tests/data/good/card-32c-alpha.png" \
+    "${top_srcdir}/tests/data/good/anim-disposal.gif"
+
+# Invalid values
+sh -c "$tool --frame-threads 0 ${top_srcdir}/tests/data/good/anim.gif >/dev/null 2>&1"
+[ $? -eq 2 ] || exit 1
+
+exit 0
@@ -0,0 +1,62 @@
+#!/bin/sh
+
+[ "x${srcdir}" = "x" ] && srcdir="."
+. "${srcdir}/chafa-tool-test-common.sh"
+
+# The frame sizes reported by --dump-frame-bytes don't depend on how fast the
+# output is consumed, so we can check the rate control against them.
+
+anim="${top_srcdir}/tests/data/good/anim-disposal.gif"
+
+dump_frame_bytes () {
+    cmd="$tool --dump-frame-bytes -f symbol -c full -s 60x30 -d 0 $1 $anim"
+    echo "$cmd" >&2
+    sh -c "$cmd 2>&1 >/dev/null" || exit $?
+}
+
+# Verify that the emitted bytes stay within budget. Frames are allowed to
+# overshoot individually, since we only learn a frame's size after rendering
+# it, but the excess must be paid back by dropping later frames. That
+# limits the total to the budget plus one frame.
+check_budget () {
+    echo "$2" | awk -v budget="$1" '
+        / bytes,/ { n_bytes = $3 + 0; total += n_bytes; if (n_bytes > max) max = n_bytes }
+        / bytes,/ && $6 + 0 > 0 { degraded++ }
+        /dropped/ { degraded++ }
+        /^frame/ { n++ }
+        END {
+            if (n < 1 || total > budget * n + max || degraded < 1) {
+                printf ("budget %d: %d frames, %d bytes total\n", budget, n, total);
+                exit 1
+            }
+        }' >&2 || exit 1
+}
+
+# Unconstrained output is left alone
+out=$(dump_frame_bytes "--speed max")
+echo "$out" | grep -q "dropped" && exit 1
+echo "$out" | grep -v -q "level 0$" && exit 1
+
+# A generous budget changes nothing
+[ "x$(dump_frame_bytes "--speed max --frame-bytes-budget 1M")" = "x$out" ] || exit 1
+
+# Tight budgets lower quality, then drop frames
+for budget in 20000 4000 500; do
+    check_budget $budget "$(dump_frame_bytes "--speed max --frame-bytes-budget $budget")"
+done
+
+# Bandwidth is divided among frames according to frame rate
+check_budget 4096 "$(dump_frame_bytes "--speed 100fps --max-bandwidth 400k")"
+
+# Frames without a delay still get a share of the bandwidth
+[ "x$(dump_frame_bytes "--speed max --max-bandwidth 1G")" = "x$out" ] || exit 1
+
+# Bad values
+sh -c "$tool --max-bandwidth fast $anim >/dev/null 2>&1"
+[ $? -eq 2 ] || exit 1
+sh -c "$tool --frame-bytes-budget -1 $anim >/dev/null 2>&1"
+[ $? -eq 2 ] || exit 1
+sh -c "$tool --max-bandwidth 0 $anim >/dev/null 2>&1"
+[ $? -eq 2 ] || exit 1
+
+exit 0
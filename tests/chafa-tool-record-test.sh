@@ -0,0 +1,53 @@
+#!/bin/sh
+
+[ "x${srcdir}" = "x" ] && srcdir="."
+. "${srcdir}/chafa-tool-test-common.sh"
+
+# A replay must reproduce the live output exactly, without touching the
+# original files.
+
+anim="${top_srcdir}/tests/data/good/anim-disposal.gif"
+still="${top_srcdir}/tests/data/good/card-32c-alpha.png"
+
+rec=$(mktemp)
+live=$(mktemp)
+replay=$(mktemp)
+trap 'rm -f "$rec" "$live" "$replay"' EXIT
+
+check_replay () {
+    term="$1"
+    shift
+
+    cmd="env -i TERM=$term $tool -d 0 --speed max $*"
+    echo "$cmd" >&2
+
+    $cmd --record "$rec" "$anim" /nonexistent "$still" >"$live" 2>/dev/null
+    [ $? -eq 1 ] || exit 1
+    $cmd --replay "$rec" >"$replay"
+    [ $? -eq 1 ] || exit 1
+    cmp "$live" "$replay" || exit 1
+
+    # Also from a pipe
+    $cmd --replay - <"$rec" >"$replay"
+    cmp "$live" "$replay" || exit 1
+
+    # Delta coding should save something
+    [ $(wc -c <"$rec") -lt $(wc -c <"$live") ] || exit 1
+}
+
+check_replay xterm-256color -f symbols
+check_replay xterm-256color -f symbols --label on --relative on
+check_replay xterm-kitty -f kitty
+check_replay xterm-256color -f sixels
+
+# Not a recording
+sh -c "$tool --replay $still >/dev/null 2>&1"
+[ $? -eq 2 ] || exit 1
+
+# Conflicting options
+sh -c "$tool --record $rec --replay $rec >/dev/null 2>&1"
+[ $? -eq 2 ] || exit 1
+sh -c "$tool --record $rec --grid 2x2 $still >/dev/null 2>&1"
+[ $? -eq 2 ] || exit 1
+
+exit 0
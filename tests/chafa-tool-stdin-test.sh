@@ -0,0 +1,50 @@
+#!/bin/sh
+
+[ "x${srcdir}" = "x" ] && srcdir="."
+. "${srcdir}/chafa-tool-test-common.sh"
+
+# Images read from stdin must come out exactly like the same images read
+# from a path, whether stdin is a file, a pipe, or a pipe that stalls for a
+# while after the first few bytes. Also check a stream large enough to
+# have been spilled to disk in the past.
+
+dir="${top_srcdir}/tests/data/good"
+tmp_dir="$(mktemp -d)"
+trap 'rm -rf "$tmp_dir"' EXIT
+
+# PNG decoders stop at the IEND chunk, so the padding is ignored
+big="$tmp_dir/big.png"
+{ cat "$dir/card-32c-noalpha.png"; head -c 12000000 /dev/zero; } > "$big"
+
+render () {
+    env -i TERM=xterm-256color $tool -f symbol -c full -s 40x20 --animate no "$@"
+}
+
+for file in "$dir"/*.gif "$dir"/*.png "$dir"/*.xwd "$big"; do
+    echo "$file" >&2
+    render "$file" > "$tmp_dir/expected" || exit 1
+
+    render - < "$file" > "$tmp_dir/got" || exit 1
+    cmp -s "$tmp_dir/expected" "$tmp_dir/got" || { echo "Redirect differs" >&2; exit 1; }
+
+    cat "$file" | render - > "$tmp_dir/got" || exit 1
+    cmp -s "$tmp_dir/expected" "$tmp_dir/got" || { echo "Pipe differs" >&2; exit 1; }
+
+done
+
+for file in "$dir/card-32c-noalpha.png" "$dir/anim-disposal.gif" "$big"; do
+    echo "$file (stalled)" >&2
+    render "$file" > "$tmp_dir/expected" || exit 1
+
+    { head -c 16 "$file"; sleep 1; tail -c +17 "$file"; } | render - > "$tmp_dir/got" || exit 1
+    cmp -s "$tmp_dir/expected" "$tmp_dir/got" || { echo "Stalled pipe differs" >&2; exit 1; }
+done
+
+# Empty input is an error
+printf '' | render - >/dev/null 2>&1 && exit 1
+
+# A failing read is reported as such, not taken for the end of the stream
+err=$(render - < "$dir" 2>&1 >/dev/null) && exit 1
+echo "$err" | grep -q "Could not read input stream" || exit 1
+
+exit 0
@@ -0,0 +1,77 @@
+#!/bin/sh
+
+[ "x${srcdir}" = "x" ] && srcdir="."
+. "${srcdir}/chafa-tool-test-common.sh"
+
+# Animation frames are wrapped in synchronized update sequences (DEC mode
+# 2026), and the next frame is rendered while the previous one is still
+# being written. Check that each frame arrives whole and in order on a pipe,
+# also when the reader is slow to start.
+#
+# We clear the environment so an outer multiplexer won't affect detection.
+
+anim="${top_srcdir}/tests/data/good/anim-disposal.gif"
+frames_file="$(mktemp)"
+trap 'rm -f "$frames_file"' EXIT
+
+run_anim () {
+    cmd="env -i TERM=$1 $tool --dump-frame-bytes -f symbol -c full -s 40x20 -d 0 --speed max $anim"
+    echo "$cmd" >&2
+    sh -c "$cmd 2>$frames_file | { sleep 1; cat; }" || exit $?
+}
+
+# Expects one synchronized update per frame, with no nesting and nothing
+# but the final epilogue outside of them. All frames must be complete,
+# i.e. have the same number of rows.
+check_frames () {
+    n_frames=$(grep -c "bytes," "$frames_file")
+
+    echo "$1" | awk -v n_frames="$n_frames" '
+        function fail(msg) { print msg; failed = 1; exit 1 }
+        BEGIN { begin_seq = "\033\\[\\?2026h"; end_seq = "\033\\[\\?2026l" }
+        {
+            line = $0
+            for (;;)
+            {
+                b = match (line, begin_seq); b_pos = RSTART
+                e = match (line, end_seq); e_pos = RSTART
+
+                if (!b && !e)
+                    break
+
+                if (b && (!e || b_pos < e_pos))
+                {
+                    if (in_frame) fail("nested begin")
+                    if (!n && NR > 1) fail("output before first frame")
+                    in_frame = 1; rows = 1
+                    line = substr (line, b_pos + 8)
+                }
+                else
+                {
+                    if (!in_frame) fail("end without begin")
+                    if (n && rows != first_rows) fail("frame " n ": " rows " rows")
+                    if (!n) first_rows = rows
+                    in_frame = 0; n++
+                    line = substr (line, e_pos + 8)
+                }
+            }
+
+            if (in_frame) rows++
+        }
+        END {
+            if (failed) exit 1
+            if (in_frame) fail("unterminated frame")
+            if (n != n_frames || n < 2) fail("got " n " frames, expected " n_frames)
+        }' >&2 || exit 1
+}
+
+check_frames "$(run_anim xterm-kitty)"
+
+# Terminals without support get plain frames
+run_anim vt220 | grep -q "$(printf '\033')\[?2026" && exit 1
+
+# Stills are left alone
+sh -c "env -i TERM=xterm-kitty $tool -f symbol ${top_srcdir}/tests/data/good/card-32c-noalpha.png" \
+    | grep -q "$(printf '\033')\[?2026" && exit 1
+
+exit 0
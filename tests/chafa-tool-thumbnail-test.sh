@@ -0,0 +1,46 @@
+#!/bin/sh
+
+[ "x${srcdir}" = "x" ] && srcdir="."
+. "${srcdir}/chafa-tool-test-common.sh"
+
+# The thumbnail.* fixtures are solid red 640x480 images with an embedded
+# 160x120 thumbnail that's solid blue. Grid cells that are small enough
+# should be rendered from the thumbnail, while bigger canvases must use
+# the full image.
+#
+# We clear the environment so an outer multiplexer won't affect detection.
+
+# Prints "red" or "blue" depending on which truecolor pen dominates
+get_color () {
+    cmd="env -i TERM=xterm-256color $tool -f symbol -c full $1"
+    echo "$cmd" >&2
+    sh -c "$cmd" | grep -o '[34]8;2;[0-9]*;[0-9]*;[0-9]*' | awk -F';' '
+        $3 > 200 && $5 < 50 { red++ }
+        $5 > 200 && $3 < 50 { blue++ }
+        END { if (red > blue) print "red"; else if (blue > red) print "blue" }'
+}
+
+check_color () {
+    result="$(get_color "$1")"
+    if [ "x$result" != "x$2" ]; then
+        echo "Expected $2, got '$result'." >&2
+        exit 1
+    fi
+}
+
+extensions="$(get_supported_loaders)"
+
+for ext in jpeg tiff heif; do
+    case " $extensions " in
+        *" $ext "*) ;;
+        *) continue ;;
+    esac
+
+    file="${top_srcdir}/tests/data/good/thumbnail.$ext"
+
+    check_color "-s 40x20 --grid 4 $file $file" blue
+    check_color "-s 40x20 --grid 1 $file" red
+    check_color "-s 10x5 $file" red
+done
+
+exit 0
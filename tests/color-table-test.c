@@ -0,0 +1,146 @@
+#include "config.h"
+
+#include <chafa.h>
+#include "internal/chafa-private.h"
+#include "internal/chafa-color-table.h"
+
+#define N_LOOKUPS 20000
+
+static const gint table_sizes [] =
+{
+    1, 2, 7, 8, 9, 15, 16, 17, 31, 64, 100, 128, 129, 200, 255, 256
+};
+
+static gint
+color_dist (guint32 a, guint32 b)
+{
+    gint d0 = (gint) (a & 0xff) - (gint) (b & 0xff);
+    gint d1 = (gint) ((a >> 8) & 0xff) - (gint) ((b >> 8) & 0xff);
+    gint d2 = (gint) ((a >> 16) & 0xff) - (gint) ((b >> 16) & 0xff);
+
+    return d0 * d0 + d1 * d1 + d2 * d2;
+}
+
+/* Lowest entry index with the smallest distance */
+static gint
+find_nearest_entry_exhaustive (const ChafaColorTable *color_table, guint32 color)
+{
+    gint best_dist = G_MAXINT;
+    gint best_i = 0;
+    gint i;
+
+    for (i = 0; i < color_table->n_entries; i++)
+    {
+        gint d = color_dist (color_table->pens [color_table->entries [i].pen], color);
+
+        if (d < best_dist)
+        {
+            best_dist = d;
+            best_i = i;
+        }
+    }
+
+    return best_i;
+}
+
+/* Spread the pens out over the table, and use a few duplicate colors so
+ * ties get exercised. */
+static void
+fill_table (ChafaColorTable *color_table, GRand *rand, gint n_pens)
+{
+    gint i;
+
+    chafa_color_table_init (color_table);
+
+    for (i = 0; i < n_pens; i++)
+    {
+        gint pen = (i * 7 + n_pens) % CHAFA_COLOR_TABLE_MAX_ENTRIES;
+        guint32 color;
+
+        if (i > 0 && g_rand_int_range (rand, 0, 8) == 0)
+            color = chafa_color_table_get_pen_color (color_table,
+                                                     ((i - 1) * 7 + n_pens) % CHAFA_COLOR_TABLE_MAX_ENTRIES);
+        else
+            color = g_rand_int (rand) & 0xffffff;
+
+        chafa_color_table_set_pen_color (color_table, pen, color);
+    }
+
+    chafa_color_table_sort (color_table);
+    g_assert_cmpint (color_table->n_entries, ==, n_pens);
+}
+
+static void
+lookup_test (void)
+{
+    static ChafaColorTable color_table;
+    GRand *rand;
+    guint i;
+
+    chafa_init ();
+    rand = g_rand_new_with_seed (1234);
+
+    for (i = 0; i < G_N_ELEMENTS (table_sizes); i++)
+    {
+        gint n_misses = 0;
+        gint j;
+
+        fill_table (&color_table, rand, table_sizes [i]);
+
+        for (j = 0; j < N_LOOKUPS; j++)
+        {
+            guint32 color = g_rand_int (rand) & 0xffffff;
+            gint best_i = find_nearest_entry_exhaustive (&color_table, color);
+            guint32 best_color = color_table.pens [color_table.entries [best_i].pen];
+            gint pen, pca_pen;
+
+            /* The vectorized search is exact and prefers the lowest index */
+#ifdef HAVE_SSE41_INTRINSICS
+            if (chafa_have_sse41 ())
+                g_assert_cmpint (chafa_find_nearest_color_sse41 (color_table.soa [0],
+                                                                 color_table.soa [1],
+                                                                 color_table.soa [2],
+                                                                 color_table.n_soa,
+                                                                 color), ==, best_i);
+#endif
+#ifdef HAVE_AVX2_INTRINSICS
+            if (chafa_have_avx2 ())
+                g_assert_cmpint (chafa_find_nearest_color_avx2 (color_table.soa [0],
+                                                                color_table.soa [1],
+                                                                color_table.soa [2],
+                                                                color_table.n_soa,
+                                                                color), ==, best_i);
+#endif
+
+            /* The exhaustive search must find a closest color. Without it,
+             * e.g. on non-x86 hosts or with big tables and only SSE 4.1,
+             * we get the PCA search. */
+            pen = chafa_color_table_find_nearest_pen (&color_table, color);
+            pca_pen = chafa_color_table_find_nearest_pen_pca (&color_table, color);
+
+            if (chafa_color_table_have_exact_search (&color_table))
+                g_assert_cmpint (color_dist (color_table.pens [pen], color), ==,
+                                 color_dist (best_color, color));
+            else
+                g_assert_cmpint (pen, ==, pca_pen);
+
+            if (color_dist (color_table.pens [pca_pen], color) > color_dist (best_color, color))
+                n_misses++;
+        }
+
+        g_test_message ("%d pens: PCA search missed %d of %d", table_sizes [i], n_misses, N_LOOKUPS);
+        chafa_color_table_deinit (&color_table);
+    }
+
+    g_rand_free (rand);
+}
+
+int
+main (int argc, char *argv [])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/color-table/lookup", lookup_test);
+
+    return g_test_run ();
+}
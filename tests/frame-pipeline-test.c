@@ -0,0 +1,224 @@
+#include "config.h"
+
+#include <chafa.h>
+#include "chicle-frame-pipeline.h"
+
+#ifdef G_OS_UNIX
+# include <time.h>
+#endif
+
+#define WIDTH_CELLS 120
+#define HEIGHT_CELLS 60
+#define SRC_WIDTH 480
+#define SRC_HEIGHT 480
+
+#define N_SLOTS 4
+#define N_FRAMES 10
+
+/* Noise, so every cell needs a full symbol search */
+static ChafaPlacement *
+new_placement (gint seed)
+{
+    ChafaFrame *frame;
+    ChafaImage *image;
+    ChafaPlacement *placement;
+    guint8 *pixels;
+    GRand *rand;
+    gint i;
+
+    rand = g_rand_new_with_seed (seed);
+    pixels = g_malloc (SRC_WIDTH * SRC_HEIGHT * 4);
+
+    for (i = 0; i < SRC_WIDTH * SRC_HEIGHT * 4; i++)
+        pixels [i] = (i % 4 == 3) ? 0xff : g_rand_int_range (rand, 0, 256);
+
+    /* The frame keeps its own copy, so the pipeline can draw it later */
+    frame = chafa_frame_new (pixels, CHAFA_PIXEL_RGBA8_UNASSOCIATED,
+                             SRC_WIDTH, SRC_HEIGHT, SRC_WIDTH * 4);
+    image = chafa_image_new ();
+    chafa_image_set_frame (image, frame);
+    placement = chafa_placement_new (image, -1);
+
+    chafa_image_unref (image);
+    chafa_frame_unref (frame);
+    g_free (pixels);
+    g_rand_free (rand);
+    return placement;
+}
+
+static ChafaCanvasConfig *
+new_config (void)
+{
+    ChafaCanvasConfig *config;
+
+    config = chafa_canvas_config_new ();
+    chafa_canvas_config_set_geometry (config, WIDTH_CELLS, HEIGHT_CELLS);
+    chafa_canvas_config_set_canvas_mode (config, CHAFA_CANVAS_MODE_TRUECOLOR);
+    chafa_canvas_config_set_work_factor (config, 1.0);
+    return config;
+}
+
+static ChafaTermInfo *
+create_term_info (void)
+{
+    gchar *envp [] = { "TERM=xterm-256color", "COLORTERM=truecolor", NULL };
+
+    return chafa_term_db_detect (chafa_term_db_get_default (), envp);
+}
+
+static GString **
+draw_directly (ChafaTermInfo *term_info, gint seed)
+{
+    ChafaCanvasConfig *config;
+    ChafaPlacement *placement;
+    ChafaCanvas *canvas;
+    GString **gsa;
+
+    config = new_config ();
+    placement = new_placement (seed);
+    canvas = chafa_canvas_new (config);
+    chafa_canvas_set_placement (canvas, placement);
+    chafa_canvas_print_rows (canvas, term_info, &gsa, NULL);
+
+    chafa_canvas_unref (canvas);
+    chafa_placement_unref (placement);
+    chafa_canvas_config_unref (config);
+    return gsa;
+}
+
+static void
+check_output (GString **gsa, GString **expected)
+{
+    gint i;
+
+    for (i = 0; gsa [i] && expected [i]; i++)
+        g_assert_cmpstr (gsa [i]->str, ==, expected [i]->str);
+
+    g_assert (gsa [i] == NULL && expected [i] == NULL);
+}
+
+/* Frames come back in order and the same as when drawn one at a time */
+static void
+order_test (void)
+{
+    ChafaTermInfo *term_info;
+    ChicleFramePipeline *pipeline;
+    GString **expected [N_FRAMES];
+    gint n_pushed = 0, n_popped = 0;
+    gint i;
+
+    term_info = create_term_info ();
+
+    for (i = 0; i < N_FRAMES; i++)
+        expected [i] = draw_directly (term_info, i);
+
+    pipeline = chicle_frame_pipeline_new (term_info, N_SLOTS, NULL);
+
+    while (n_popped < N_FRAMES)
+    {
+        gpointer user_data;
+        GString **gsa;
+
+        while (n_pushed < N_FRAMES && !chicle_frame_pipeline_is_full (pipeline))
+        {
+            chicle_frame_pipeline_push (pipeline, new_config (), new_placement (n_pushed),
+                                        GINT_TO_POINTER (n_pushed));
+            n_pushed++;
+        }
+
+        gsa = chicle_frame_pipeline_pop (pipeline, &user_data);
+        g_assert (gsa != NULL);
+        g_assert_cmpint (GPOINTER_TO_INT (user_data), ==, n_popped);
+        check_output (gsa, expected [n_popped]);
+
+        chafa_free_gstring_array (gsa);
+        n_popped++;
+    }
+
+    g_assert (chicle_frame_pipeline_pop (pipeline, NULL) == NULL);
+
+    chicle_frame_pipeline_destroy (pipeline);
+
+    for (i = 0; i < N_FRAMES; i++)
+        chafa_free_gstring_array (expected [i]);
+    chafa_term_info_unref (term_info);
+}
+
+#if defined (G_OS_UNIX) && defined (CLOCK_THREAD_CPUTIME_ID) && defined (CLOCK_PROCESS_CPUTIME_ID)
+
+static gdouble
+get_cpu_time_s (clockid_t clock_id)
+{
+    struct timespec ts;
+
+    g_assert (clock_gettime (clock_id, &ts) == 0);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* The frames are drawn by the workers, several at a time. Row parallelism
+ * in libchafa is turned off, so any overlap comes from the pipeline. */
+static void
+parallel_test (void)
+{
+    ChafaTermInfo *term_info;
+    ChicleFramePipeline *pipeline;
+    ChafaPlacement *placements [N_SLOTS];
+    gdouble direct_s, caller_s, process_s, wall_s;
+    gdouble t0, p0;
+    gint64 w0;
+    gint i;
+
+    chafa_set_n_threads (1);
+    term_info = create_term_info ();
+
+    /* What drawing one frame costs the calling thread */
+    t0 = get_cpu_time_s (CLOCK_THREAD_CPUTIME_ID);
+    chafa_free_gstring_array (draw_directly (term_info, 0));
+    direct_s = get_cpu_time_s (CLOCK_THREAD_CPUTIME_ID) - t0;
+
+    for (i = 0; i < N_SLOTS; i++)
+        placements [i] = new_placement (i);
+
+    pipeline = chicle_frame_pipeline_new (term_info, N_SLOTS, NULL);
+
+    t0 = get_cpu_time_s (CLOCK_THREAD_CPUTIME_ID);
+    p0 = get_cpu_time_s (CLOCK_PROCESS_CPUTIME_ID);
+    w0 = g_get_monotonic_time ();
+
+    for (i = 0; i < N_SLOTS; i++)
+        chicle_frame_pipeline_push (pipeline, new_config (), placements [i], NULL);
+    for (i = 0; i < N_SLOTS; i++)
+        chafa_free_gstring_array (chicle_frame_pipeline_pop (pipeline, NULL));
+
+    caller_s = get_cpu_time_s (CLOCK_THREAD_CPUTIME_ID) - t0;
+    process_s = get_cpu_time_s (CLOCK_PROCESS_CPUTIME_ID) - p0;
+    wall_s = (g_get_monotonic_time () - w0) / 1e6;
+
+    chicle_frame_pipeline_destroy (pipeline);
+
+    /* None of the drawing happened on the calling thread */
+    g_assert_cmpfloat (caller_s, <, direct_s / 4.0);
+    g_assert_cmpfloat (process_s, >, direct_s * N_SLOTS / 2.0);
+
+    /* With several CPUs, the workers overlap */
+    if (g_get_num_processors () >= 2)
+        g_assert_cmpfloat (process_s, >, wall_s * 1.3);
+
+    chafa_term_info_unref (term_info);
+    chafa_set_n_threads (-1);
+}
+
+#endif
+
+int
+main (int argc, char *argv [])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/frame-pipeline/order", order_test);
+#if defined (G_OS_UNIX) && defined (CLOCK_THREAD_CPUTIME_ID) && defined (CLOCK_PROCESS_CPUTIME_ID)
+    g_test_add_func ("/frame-pipeline/parallel", parallel_test);
+#endif
+
+    return g_test_run ();
+}
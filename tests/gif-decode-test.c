@@ -0,0 +1,204 @@
+#include "config.h"
+
+#include <glib.h>
+#include <libnsgif.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Reference checksums (32-bit FNV-1a) of the composited RGBA image after
+ * each frame. The expected values for anim-disposal.gif and anim-lzw-dict.gif
+ * come from an independent compositor working on the unencoded frames. */
+
+typedef struct
+{
+    const gchar *file_name;
+    guint width, height;
+    guint n_frames;
+    guint32 checksums [16];
+}
+GifReference;
+
+static const GifReference gif_references [] =
+{
+    { "anim.gif", 32, 32, 4,
+      { 0x1d17b87b, 0x65023cb5, 0xb683d186, 0xd7d66ac1 } },
+    { "anim-local-cmaps.gif", 32, 32, 4,
+      { 0x3dc757a3, 0x21878c4f, 0xe7497f8a, 0x89b37a56 } },
+    { "anim-disposal.gif", 64, 48, 9,
+      { 0xb3787fc5, 0x4921b05b, 0x919ca9b2, 0xe8a0f5a8, 0xfc8c30c0,
+        0x874ba2c5, 0xc491b165, 0x8d5d781c, 0x6eaf2eec } },
+    { "anim-lzw-dict.gif", 128, 96, 4,
+      { 0xef8d1160, 0x78b535fa, 0x093629d0, 0x897928c5 } },
+    { "noise-32x32.gif", 32, 32, 1,
+      { 0x7611148d } },
+    { "pixel.gif", 1, 1, 1,
+      { 0x288e5515 } }
+};
+
+static void *
+bitmap_create (int width, int height)
+{
+    return g_malloc0 ((gsize) width * height * 4);
+}
+
+static void
+bitmap_destroy (void *bitmap)
+{
+    g_free (bitmap);
+}
+
+static unsigned char *
+bitmap_get_buffer (void *bitmap)
+{
+    return bitmap;
+}
+
+static guint32
+checksum_image (const gif_animation *gif)
+{
+    const guint8 *p = gif->frame_image;
+    gsize len = (gsize) gif->width * gif->height * 4;
+    guint32 h = 2166136261U;
+    gsize i;
+
+    for (i = 0; i < len; i++)
+    {
+        h ^= p [i];
+        h *= 16777619U;
+    }
+
+    return h;
+}
+
+static gchar *
+load_file (const gchar *file_name, gsize *len_out)
+{
+    const gchar *top_srcdir;
+    gchar *path;
+    gchar *data;
+
+    top_srcdir = g_getenv ("top_srcdir");
+    if (!top_srcdir)
+        top_srcdir = "..";
+
+    path = g_build_filename (top_srcdir, "tests", "data", "good", file_name, NULL);
+    if (!g_file_get_contents (path, &data, len_out, NULL))
+    {
+        g_printerr ("Could not read '%s'.\n", path);
+        g_assert_not_reached ();
+    }
+
+    g_free (path);
+    return data;
+}
+
+static void
+open_gif (gif_animation *gif, const GifReference *ref, const guint8 *data, gsize len)
+{
+    gif_bitmap_callback_vt bitmap_callbacks =
+    {
+        bitmap_create,
+        bitmap_destroy,
+        bitmap_get_buffer,
+        NULL,
+        NULL,
+        NULL
+    };
+    gif_result code;
+
+    gif_create (gif, &bitmap_callbacks);
+
+    do
+    {
+        code = gif_initialise (gif, len, data);
+    }
+    while (code == GIF_WORKING);
+
+    g_assert (code == GIF_OK);
+    g_assert (gif->frame_count == ref->n_frames);
+    g_assert (gif->width == ref->width);
+    g_assert (gif->height == ref->height);
+    g_assert (gif->frames [0].keyframe);
+}
+
+static void
+check_frame (gif_animation *gif, const GifReference *ref, guint frame)
+{
+    guint32 checksum;
+
+    g_assert (gif_decode_frame (gif, frame) == GIF_OK);
+    checksum = checksum_image (gif);
+
+    if (checksum != ref->checksums [frame])
+    {
+        g_printerr ("%s frame %u: got %08x, expected %08x\n",
+                    ref->file_name, frame, checksum, ref->checksums [frame]);
+        g_assert_not_reached ();
+    }
+}
+
+static void
+decode_sequential_test (void)
+{
+    guint i, j, pass;
+
+    for (i = 0; i < G_N_ELEMENTS (gif_references); i++)
+    {
+        const GifReference *ref = &gif_references [i];
+        gif_animation gif;
+        gchar *data;
+        gsize len;
+
+        data = load_file (ref->file_name, &len);
+        open_gif (&gif, ref, (const guint8 *) data, len);
+
+        /* Two passes, so we loop back to the start like an animation */
+        for (pass = 0; pass < 2; pass++)
+        {
+            for (j = 0; j < ref->n_frames; j++)
+                check_frame (&gif, ref, j);
+        }
+
+        gif_finalise (&gif);
+        g_free (data);
+    }
+}
+
+static void
+decode_seek_test (void)
+{
+    guint i, j;
+
+    for (i = 0; i < G_N_ELEMENTS (gif_references); i++)
+    {
+        const GifReference *ref = &gif_references [i];
+        gif_animation gif;
+        gchar *data;
+        gsize len;
+
+        data = load_file (ref->file_name, &len);
+        open_gif (&gif, ref, (const guint8 *) data, len);
+
+        /* Backwards */
+        for (j = ref->n_frames; j > 0; j--)
+            check_frame (&gif, ref, j - 1);
+
+        /* Scattered; 7 is coprime with all the frame counts */
+        for (j = 0; j < ref->n_frames * 2; j++)
+            check_frame (&gif, ref, (j * 7 + 3) % ref->n_frames);
+
+        gif_finalise (&gif);
+        g_free (data);
+    }
+}
+
+int
+main (int argc, char *argv [])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/gif-decode/sequential", decode_sequential_test);
+    g_test_add_func ("/gif-decode/seek", decode_seek_test);
+
+    return g_test_run ();
+}
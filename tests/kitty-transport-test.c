@@ -0,0 +1,273 @@
+#include "config.h"
+
+#include <chafa.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#ifdef G_OS_UNIX
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/stat.h>
+# if defined(HAVE_SHM_OPEN) && defined(HAVE_MMAP)
+#  include <sys/mman.h>
+#  define TEST_SHM 1
+# endif
+#endif
+
+/* 10x5 cells of 8x16 pixels; the source is the same size, so it's
+ * copied verbatim */
+#define WIDTH_CELLS 10
+#define HEIGHT_CELLS 5
+#define CELL_WIDTH 8
+#define CELL_HEIGHT 16
+#define WIDTH_PIXELS (WIDTH_CELLS * CELL_WIDTH)
+#define HEIGHT_PIXELS (HEIGHT_CELLS * CELL_HEIGHT)
+#define N_BYTES (WIDTH_PIXELS * HEIGHT_PIXELS * 4)
+
+static guint8 *
+gen_image (void)
+{
+    guint8 *pixels, *p;
+    gint x, y;
+
+    pixels = p = g_malloc (N_BYTES);
+
+    for (y = 0; y < HEIGHT_PIXELS; y++)
+    {
+        for (x = 0; x < WIDTH_PIXELS; x++)
+        {
+            *(p++) = x * 3;
+            *(p++) = y * 3;
+            *(p++) = (x ^ y) & 0xff;
+            *(p++) = 0xff;
+        }
+    }
+
+    return pixels;
+}
+
+static ChafaTermInfo *
+create_term_info (void)
+{
+    gchar *envp [] = { "TERM=xterm-kitty", NULL };
+
+    return chafa_term_db_detect (chafa_term_db_get_default (), envp);
+}
+
+static GString *
+print_image (ChafaTermInfo *term_info, const guint8 *pixels,
+             ChafaKittyTransport transport, ChafaPassthrough passthrough)
+{
+    ChafaCanvasConfig *config;
+    ChafaCanvas *canvas;
+    GString *gs;
+
+    config = chafa_canvas_config_new ();
+    chafa_canvas_config_set_pixel_mode (config, CHAFA_PIXEL_MODE_KITTY);
+    chafa_canvas_config_set_geometry (config, WIDTH_CELLS, HEIGHT_CELLS);
+    chafa_canvas_config_set_cell_geometry (config, CELL_WIDTH, CELL_HEIGHT);
+    chafa_canvas_config_set_passthrough (config, passthrough);
+    chafa_canvas_config_set_kitty_transport (config, transport);
+    g_assert_cmpint (chafa_canvas_config_get_kitty_transport (config), ==, transport);
+
+    canvas = chafa_canvas_new (config);
+    chafa_canvas_draw_all_pixels (canvas, CHAFA_PIXEL_RGBA8_UNASSOCIATED,
+                                  pixels, WIDTH_PIXELS, HEIGHT_PIXELS, WIDTH_PIXELS * 4);
+    gs = chafa_canvas_print (canvas, term_info);
+
+    chafa_canvas_unref (canvas);
+    chafa_canvas_config_unref (config);
+    return gs;
+}
+
+/* Returns the name following the header that contains @key. Passthrough
+ * escaping doesn't touch base64, so this works for wrapped sequences too. */
+static gchar *
+get_name (const gchar *out, const gchar *key)
+{
+    const gchar *p;
+    gchar *b64, *name;
+    guchar *data;
+    gsize len;
+
+    p = strstr (out, key);
+    g_assert (p != NULL);
+    p = strchr (p, ';');
+    g_assert (p != NULL);
+    p++;
+
+    b64 = g_strndup (p, strspn (p, "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                   "abcdefghijklmnopqrstuvwxyz0123456789+/="));
+    data = g_base64_decode (b64, &len);
+    name = g_strndup ((const gchar *) data, len);
+
+    g_free (data);
+    g_free (b64);
+    return name;
+}
+
+static void
+assert_pixels_equal (const guint8 *data, gsize len, const guint8 *expected)
+{
+    g_assert_cmpuint (len, ==, N_BYTES);
+    g_assert (memcmp (data, expected, N_BYTES) == 0);
+}
+
+#ifdef G_OS_UNIX
+
+static void
+check_temp_file (ChafaTermInfo *term_info, const guint8 *pixels, ChafaPassthrough passthrough)
+{
+    GString *gs;
+    gchar *path, *data;
+    gsize len;
+
+    gs = print_image (term_info, pixels, CHAFA_KITTY_TRANSPORT_TEMP_FILE, passthrough);
+
+    /* No pixels inline */
+    g_assert (strstr (gs->str, "m=1") == NULL);
+    g_assert (passthrough == CHAFA_PASSTHROUGH_NONE || strstr (gs->str, "U=1") != NULL);
+
+    path = get_name (gs->str, "t=t,");
+    g_assert (g_path_is_absolute (path));
+    g_assert (strstr (path, "tty-graphics-protocol") != NULL);
+
+    /* The terminal is expected to delete the file after reading it */
+    g_assert (g_file_get_contents (path, &data, &len, NULL));
+    g_unlink (path);
+    assert_pixels_equal ((const guint8 *) data, len, pixels);
+
+    g_free (data);
+    g_free (path);
+    g_string_free (gs, TRUE);
+}
+
+#endif
+
+#ifdef TEST_SHM
+
+static void
+check_shm (ChafaTermInfo *term_info, const guint8 *pixels, ChafaPassthrough passthrough)
+{
+    GString *gs;
+    struct stat sbuf;
+    gpointer data;
+    gchar *name;
+    gint fd;
+
+    gs = print_image (term_info, pixels, CHAFA_KITTY_TRANSPORT_SHARED_MEMORY, passthrough);
+    g_assert (strstr (gs->str, "m=1") == NULL);
+
+    name = get_name (gs->str, "t=s,");
+    g_assert (name [0] == '/');
+
+    fd = shm_open (name, O_RDONLY, 0);
+    g_assert_cmpint (fd, >=, 0);
+    g_assert_cmpint (fstat (fd, &sbuf), ==, 0);
+
+    data = mmap (NULL, sbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    g_assert (data != MAP_FAILED);
+    assert_pixels_equal (data, sbuf.st_size, pixels);
+
+    munmap (data, sbuf.st_size);
+    close (fd);
+    shm_unlink (name);
+
+    g_free (name);
+    g_string_free (gs, TRUE);
+}
+
+#endif
+
+static ChafaTermInfo *
+create_tmux_term_info (void)
+{
+    ChafaTermInfo *term_info = create_term_info ();
+
+    chafa_term_info_set_seq (term_info, CHAFA_TERM_SEQ_BEGIN_TMUX_PASSTHROUGH, "\033Ptmux;", NULL);
+    chafa_term_info_set_seq (term_info, CHAFA_TERM_SEQ_END_TMUX_PASSTHROUGH, "\033\\", NULL);
+    return term_info;
+}
+
+static void
+temp_file_test (void)
+{
+#ifdef G_OS_UNIX
+    ChafaTermInfo *term_info;
+    guint8 *pixels = gen_image ();
+
+    term_info = create_term_info ();
+    check_temp_file (term_info, pixels, CHAFA_PASSTHROUGH_NONE);
+    chafa_term_info_unref (term_info);
+
+    term_info = create_tmux_term_info ();
+    check_temp_file (term_info, pixels, CHAFA_PASSTHROUGH_TMUX);
+    chafa_term_info_unref (term_info);
+
+    g_free (pixels);
+#else
+    g_test_skip ("Temporary file transport is Unix only");
+#endif
+}
+
+static void
+shm_test (void)
+{
+#ifdef TEST_SHM
+    ChafaTermInfo *term_info;
+    guint8 *pixels = gen_image ();
+
+    term_info = create_term_info ();
+    check_shm (term_info, pixels, CHAFA_PASSTHROUGH_NONE);
+    chafa_term_info_unref (term_info);
+
+    term_info = create_tmux_term_info ();
+    check_shm (term_info, pixels, CHAFA_PASSTHROUGH_TMUX);
+    chafa_term_info_unref (term_info);
+
+    g_free (pixels);
+#else
+    g_test_skip ("Shared memory transport not available");
+#endif
+}
+
+/* Without the sequences for the requested transport, the pixels must be
+ * sent inline exactly as with the direct transport */
+static void
+fallback_test (void)
+{
+    ChafaTermInfo *term_info;
+    GString *direct_gs, *gs;
+    guint8 *pixels = gen_image ();
+
+    term_info = create_term_info ();
+    chafa_term_info_set_seq (term_info, CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_TEMP_FILE_IMAGE_V1, NULL, NULL);
+    chafa_term_info_set_seq (term_info, CHAFA_TERM_SEQ_BEGIN_KITTY_IMMEDIATE_SHM_IMAGE_V1, NULL, NULL);
+
+    direct_gs = print_image (term_info, pixels, CHAFA_KITTY_TRANSPORT_DIRECT, CHAFA_PASSTHROUGH_NONE);
+    g_assert (strstr (direct_gs->str, "m=1") != NULL);
+
+    gs = print_image (term_info, pixels, CHAFA_KITTY_TRANSPORT_TEMP_FILE, CHAFA_PASSTHROUGH_NONE);
+    g_assert_cmpstr (gs->str, ==, direct_gs->str);
+    g_string_free (gs, TRUE);
+
+    gs = print_image (term_info, pixels, CHAFA_KITTY_TRANSPORT_SHARED_MEMORY, CHAFA_PASSTHROUGH_NONE);
+    g_assert_cmpstr (gs->str, ==, direct_gs->str);
+    g_string_free (gs, TRUE);
+
+    g_string_free (direct_gs, TRUE);
+    chafa_term_info_unref (term_info);
+    g_free (pixels);
+}
+
+int
+main (int argc, char *argv [])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/kitty-transport/temp-file", temp_file_test);
+    g_test_add_func ("/kitty-transport/shm", shm_test);
+    g_test_add_func ("/kitty-transport/fallback", fallback_test);
+
+    return g_test_run ();
+}
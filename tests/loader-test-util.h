@@ -0,0 +1,59 @@
+#ifndef __LOADER_TEST_UTIL_H__
+#define __LOADER_TEST_UTIL_H__
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include "chicle-file-mapping.h"
+
+#ifdef G_OS_UNIX
+# include <unistd.h>
+#endif
+
+/* Helpers shared by the loader tests. Each loader has its own constructor,
+ * so it's passed in as a callback. */
+
+typedef gpointer (*LoaderTestNewFunc) (ChicleFileMapping *mapping, gpointer user_data);
+
+/* Writes the data to a temporary file and opens it with new_func. If the
+ * loader fails, the mapping is freed and NULL is returned. Either way, the
+ * file stays around until loader_test_unload (). */
+static inline gpointer
+loader_test_load (const gchar *tmpl, gconstpointer data, gsize len,
+                  LoaderTestNewFunc new_func, gpointer user_data,
+                  ChicleFileMapping **mapping_out, gchar **path_out)
+{
+    ChicleFileMapping *mapping;
+    gpointer loader;
+    GError *error = NULL;
+    gint fd;
+
+    fd = g_file_open_tmp (tmpl, path_out, &error);
+    g_assert_no_error (error);
+    close (fd);
+
+    g_file_set_contents (*path_out, (const gchar *) data, len, &error);
+    g_assert_no_error (error);
+
+    mapping = chicle_file_mapping_new (*path_out);
+    loader = new_func (mapping, user_data);
+
+    if (!loader)
+        chicle_file_mapping_destroy (mapping);
+
+    if (mapping_out)
+        *mapping_out = loader ? mapping : NULL;
+
+    return loader;
+}
+
+static inline void
+loader_test_unload (gpointer loader, GDestroyNotify destroy_func, gchar *path)
+{
+    if (loader)
+        destroy_func (loader);
+    g_unlink (path);
+    g_free (path);
+}
+
+#endif /* __LOADER_TEST_UTIL_H__ */
@@ -0,0 +1,289 @@
+#include "config.h"
+
+#include <chafa.h>
+#include <string.h>
+#include "chicle-pnm-loader.h"
+#include "loader-test-util.h"
+
+#define WIDTH 13
+#define HEIGHT 7
+
+typedef struct
+{
+    const gchar *name;
+    gint type;
+    gint depth;
+    guint maxval;
+    const gchar *tupltype;
+    gboolean zero_copy;
+}
+Variant;
+
+static const Variant variants [] =
+{
+    { "pbm", 4, 1, 1, NULL, FALSE },
+    { "pgm-8", 5, 1, 255, NULL, FALSE },
+    { "pgm-4", 5, 1, 15, NULL, FALSE },
+    { "pgm-16", 5, 1, 65535, NULL, FALSE },
+    { "ppm-8", 6, 3, 255, NULL, TRUE },
+    { "ppm-6", 6, 3, 63, NULL, FALSE },
+    { "ppm-16", 6, 3, 1000, NULL, FALSE },
+    { "pam-bw", 7, 1, 1, "BLACKANDWHITE", FALSE },
+    { "pam-gray", 7, 1, 255, "GRAYSCALE", FALSE },
+    { "pam-gray-alpha", 7, 2, 255, "GRAYSCALE_ALPHA", FALSE },
+    { "pam-rgb", 7, 3, 255, "RGB", TRUE },
+    { "pam-rgba", 7, 4, 255, "RGB_ALPHA", TRUE },
+    { "pam-rgba-16", 7, 4, 4095, "RGB_ALPHA", FALSE },
+    { "pam-no-tupltype", 7, 3, 255, NULL, TRUE }
+};
+
+static guint *
+gen_samples (GRand *rand, const Variant *variant)
+{
+    guint *samples;
+    gint i;
+
+    samples = g_new (guint, WIDTH * HEIGHT * variant->depth);
+
+    for (i = 0; i < WIDTH * HEIGHT * variant->depth; i++)
+        samples [i] = g_rand_int_range (rand, 0, variant->maxval + 1);
+
+    return samples;
+}
+
+/* The comment checks that the header parser skips it */
+static GByteArray *
+encode (const Variant *variant, const guint *samples)
+{
+    GByteArray *array;
+    gchar *header;
+    gint x, y, i;
+
+    if (variant->type == 7)
+        header = g_strdup_printf ("P7\nWIDTH %d\nHEIGHT %d\nDEPTH %d\nMAXVAL %u\n%s%s%sENDHDR\n",
+                                  WIDTH, HEIGHT, variant->depth, variant->maxval,
+                                  variant->tupltype ? "TUPLTYPE " : "",
+                                  variant->tupltype ? variant->tupltype : "",
+                                  variant->tupltype ? "\n" : "");
+    else if (variant->type == 4)
+        header = g_strdup_printf ("P4\n# Comment\n%d %d\n", WIDTH, HEIGHT);
+    else
+        header = g_strdup_printf ("P%d\n# Comment\n%d %d\n%u\n",
+                                  variant->type, WIDTH, HEIGHT, variant->maxval);
+
+    array = g_byte_array_new ();
+    g_byte_array_append (array, (const guint8 *) header, strlen (header));
+    g_free (header);
+
+    for (y = 0; y < HEIGHT; y++)
+    {
+        if (variant->type == 4)
+        {
+            /* Rows are padded to whole bytes */
+            for (x = 0; x < WIDTH; x += 8)
+            {
+                guint8 byte = 0;
+
+                for (i = 0; i < 8 && x + i < WIDTH; i++)
+                    byte |= samples [y * WIDTH + x + i] << (7 - i);
+
+                g_byte_array_append (array, &byte, 1);
+            }
+
+            continue;
+        }
+
+        for (i = 0; i < WIDTH * variant->depth; i++)
+        {
+            guint v = samples [y * WIDTH * variant->depth + i];
+            guint8 bytes [2] = { v >> 8, v & 0xff };
+
+            if (variant->maxval > 255)
+                g_byte_array_append (array, bytes, 2);
+            else
+                g_byte_array_append (array, bytes + 1, 1);
+        }
+    }
+
+    return array;
+}
+
+static guint8
+scale (guint v, guint maxval)
+{
+    return (v * 255 + maxval / 2) / maxval;
+}
+
+static void
+get_expected_pixel (const Variant *variant, const guint *samples, gint i, guint8 *out)
+{
+    const guint *s = samples + i * variant->depth;
+
+    if (variant->type == 4)
+    {
+        /* PBM is 1 for black */
+        out [0] = out [1] = out [2] = s [0] ? 0 : 0xff;
+        out [3] = 0xff;
+    }
+    else if (variant->depth <= 2)
+    {
+        out [0] = out [1] = out [2] = scale (s [0], variant->maxval);
+        out [3] = variant->depth == 2 ? scale (s [1], variant->maxval) : 0xff;
+    }
+    else
+    {
+        out [0] = scale (s [0], variant->maxval);
+        out [1] = scale (s [1], variant->maxval);
+        out [2] = scale (s [2], variant->maxval);
+        out [3] = variant->depth == 4 ? scale (s [3], variant->maxval) : 0xff;
+    }
+}
+
+static gpointer
+new_loader (ChicleFileMapping *mapping, G_GNUC_UNUSED gpointer user_data)
+{
+    return chicle_pnm_loader_new_from_mapping (mapping);
+}
+
+static ChiclePnmLoader *
+load (GByteArray *array, ChicleFileMapping **mapping_out, gchar **path_out)
+{
+    return loader_test_load ("pnm-loader-test-XXXXXX.pnm", array->data, array->len,
+                             new_loader, NULL, mapping_out, path_out);
+}
+
+static void
+unload (ChiclePnmLoader *loader, gchar *path)
+{
+    loader_test_unload (loader, (GDestroyNotify) chicle_pnm_loader_destroy, path);
+}
+
+static void
+check_variant (gconstpointer data)
+{
+    const Variant *variant = data;
+    ChicleFileMapping *mapping;
+    ChiclePnmLoader *loader;
+    ChafaPixelType pixel_type;
+    const guint8 *pixels, *file_data;
+    gsize file_len;
+    gint width, height, rowstride;
+    GByteArray *array;
+    GRand *rand;
+    guint *samples;
+    gchar *path;
+    gint x, y;
+
+    rand = g_rand_new_with_seed (variant->type * 100000 + variant->maxval);
+    samples = gen_samples (rand, variant);
+    array = encode (variant, samples);
+
+    loader = load (array, &mapping, &path);
+    g_assert (loader != NULL);
+
+    pixels = chicle_pnm_loader_get_frame_data (loader, &pixel_type, &width, &height, &rowstride);
+    g_assert_cmpint (width, ==, WIDTH);
+    g_assert_cmpint (height, ==, HEIGHT);
+
+    /* 8-bit RGB(A) must come straight from the mapping */
+    file_data = chicle_file_mapping_get_data (mapping, &file_len);
+    g_assert_cmpint (pixels >= file_data && pixels < file_data + file_len, ==, variant->zero_copy);
+
+    for (y = 0; y < HEIGHT; y++)
+    {
+        for (x = 0; x < WIDTH; x++)
+        {
+            const guint8 *p = pixels + y * rowstride;
+            guint8 expected [4], got [4];
+
+            get_expected_pixel (variant, samples, y * WIDTH + x, expected);
+
+            if (pixel_type == CHAFA_PIXEL_RGB8)
+            {
+                memcpy (got, p + x * 3, 3);
+                got [3] = 0xff;
+            }
+            else
+            {
+                g_assert_cmpint (pixel_type, ==, CHAFA_PIXEL_RGBA8_UNASSOCIATED);
+                memcpy (got, p + x * 4, 4);
+            }
+
+            g_assert_cmpmem (got, 4, expected, 4);
+        }
+    }
+
+    unload (loader, path);
+    g_byte_array_free (array, TRUE);
+    g_free (samples);
+    g_rand_free (rand);
+}
+
+#define TRY_LOAD(s) try_load ((s), sizeof (s) - 1)
+
+static gboolean
+try_load (const gchar *str, gsize len)
+{
+    ChiclePnmLoader *loader;
+    GByteArray *array;
+    gchar *path;
+    gboolean result;
+
+    array = g_byte_array_new ();
+    g_byte_array_append (array, (const guint8 *) str, len);
+
+    loader = load (array, NULL, &path);
+    result = loader != NULL;
+
+    unload (loader, path);
+    g_byte_array_free (array, TRUE);
+    return result;
+}
+
+static void
+bad_test (void)
+{
+    /* Sanity check */
+    g_assert_true (TRY_LOAD ("P5 2 1 255 \x10\x20"));
+
+    /* Truncated raster */
+    g_assert_false (TRY_LOAD ("P5 2 1 255 \x10"));
+    g_assert_false (TRY_LOAD ("P4 9 2 \xff\xff\xff"));
+
+    /* Bad dimensions and maxvals */
+    g_assert_false (TRY_LOAD ("P5 0 1 255 \x10"));
+    g_assert_false (TRY_LOAD ("P5 1 1 0 \x10"));
+    g_assert_false (TRY_LOAD ("P5 1 1 65536 \x10\x10"));
+    g_assert_false (TRY_LOAD ("P5 99999999999 1 255 \x10"));
+
+    /* No whitespace after the header */
+    g_assert_false (TRY_LOAD ("P5 1 1 255"));
+
+    /* Plain (ASCII) formats aren't supported */
+    g_assert_false (TRY_LOAD ("P2 1 1 255 1"));
+
+    /* PAM depth out of range, missing ENDHDR and unknown keywords */
+    g_assert_false (TRY_LOAD ("P7\nWIDTH 1\nHEIGHT 1\nDEPTH 5\nMAXVAL 255\nENDHDR\n\x01\x02\x03\x04\x05"));
+    g_assert_false (TRY_LOAD ("P7\nWIDTH 1\nHEIGHT 1\nDEPTH 1\nMAXVAL 255\n\x01"));
+    g_assert_false (TRY_LOAD ("P7\nWIDTH 1\nHEIGHT 1\nDEPTH 1\nFOO 1\nMAXVAL 255\nENDHDR\n\x01"));
+}
+
+int
+main (int argc, char *argv [])
+{
+    guint i;
+
+    g_test_init (&argc, &argv, NULL);
+
+    for (i = 0; i < G_N_ELEMENTS (variants); i++)
+    {
+        gchar *name = g_strdup_printf ("/pnm-loader/%s", variants [i].name);
+
+        g_test_add_data_func (name, &variants [i], check_variant);
+        g_free (name);
+    }
+
+    g_test_add_func ("/pnm-loader/bad", bad_test);
+
+    return g_test_run ();
+}
@@ -0,0 +1,362 @@
+#include "config.h"
+
+#include <chafa.h>
+#include <string.h>
+#include "chicle-qoi-loader.h"
+#include "loader-test-util.h"
+
+#ifdef G_OS_UNIX
+# include <sys/resource.h>
+#endif
+
+/* The encoder and reference decoder are built into the loader */
+#define QOI_NO_STDIO
+#include "qoi.h"
+
+typedef struct
+{
+    gint width, height;
+    gint channels;
+}
+ImageSpec;
+
+static const ImageSpec exact_specs [] =
+{
+    { 1, 1, 4 }, { 37, 23, 4 }, { 256, 128, 4 }, { 255, 17, 3 }, { 3, 200, 3 }
+};
+
+/* Mixes noise, gradients, flat areas and repeating colors, so all the QOI
+ * ops get used */
+static guint8 *
+gen_pixels (gint width, gint height, gint channels, guint32 seed)
+{
+    guint8 *pixels, *p;
+    GRand *rand;
+    gint x, y, i;
+
+    rand = g_rand_new_with_seed (seed);
+    pixels = p = g_malloc (width * height * channels);
+
+    for (y = 0; y < height; y++)
+    {
+        for (x = 0; x < width; x++)
+        {
+            guint8 px [4];
+
+            switch ((x / 16 + y / 8) % 4)
+            {
+                case 0:
+                    for (i = 0; i < 4; i++)
+                        px [i] = g_rand_int_range (rand, 0, 256);
+                    break;
+                case 1:
+                    px [0] = x * 3;
+                    px [1] = y * 5;
+                    px [2] = x + y;
+                    px [3] = 255 - y;
+                    break;
+                case 2:
+                    px [0] = 40;
+                    px [1] = 80;
+                    px [2] = 120;
+                    px [3] = 255;
+                    break;
+                default:
+                    px [0] = (x % 3) * 100;
+                    px [1] = (y % 5) * 50;
+                    px [2] = 17;
+                    px [3] = (x % 2) ? 0 : 255;
+                    break;
+            }
+
+            memcpy (p, px, channels);
+            p += channels;
+        }
+    }
+
+    g_rand_free (rand);
+    return pixels;
+}
+
+static guint8 *
+encode (gint width, gint height, gint channels, gint *len_out)
+{
+    qoi_desc desc = { width, height, channels, QOI_SRGB };
+    guint8 *pixels, *data;
+
+    pixels = gen_pixels (width, height, channels, width * 1000 + height);
+    data = qoi_encode (pixels, &desc, len_out);
+    g_assert (data != NULL);
+
+    g_free (pixels);
+    return data;
+}
+
+typedef struct
+{
+    gint target_width, target_height;
+}
+TargetSize;
+
+static gpointer
+new_loader (ChicleFileMapping *mapping, gpointer user_data)
+{
+    TargetSize *target = user_data;
+
+    return chicle_qoi_loader_new_from_mapping (mapping, target->target_width, target->target_height);
+}
+
+static ChicleQoiLoader *
+load (const guint8 *data, gint len, gint target_width, gint target_height,
+      gchar **path_out)
+{
+    TargetSize target = { target_width, target_height };
+    ChicleQoiLoader *loader;
+
+    loader = loader_test_load ("qoi-loader-test-XXXXXX.qoi", data, len,
+                               new_loader, &target, NULL, path_out);
+    g_assert (loader != NULL);
+
+    return loader;
+}
+
+static void
+unload (ChicleQoiLoader *loader, gchar *path)
+{
+    loader_test_unload (loader, (GDestroyNotify) chicle_qoi_loader_destroy, path);
+}
+
+/* Without reduction, the output must match qoi_decode () exactly */
+static void
+check_exact (const guint8 *data, gint len, gint target_width, gint target_height)
+{
+    ChicleQoiLoader *loader;
+    ChafaPixelType pixel_type;
+    const guint8 *pixels;
+    guint8 *ref_pixels;
+    gint width, height, rowstride;
+    qoi_desc desc;
+    gchar *path;
+
+    ref_pixels = qoi_decode (data, len, &desc, 4);
+    g_assert (ref_pixels != NULL);
+
+    loader = load (data, len, target_width, target_height, &path);
+    pixels = chicle_qoi_loader_get_frame_data (loader, &pixel_type, &width, &height, &rowstride);
+
+    g_assert_cmpint (pixel_type, ==, CHAFA_PIXEL_RGBA8_UNASSOCIATED);
+    g_assert_cmpint (width, ==, desc.width);
+    g_assert_cmpint (height, ==, desc.height);
+    g_assert_cmpint (rowstride, ==, width * 4);
+    g_assert (memcmp (pixels, ref_pixels, width * height * 4) == 0);
+
+    unload (loader, path);
+    free (ref_pixels);
+}
+
+static void
+exact_test (void)
+{
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (exact_specs); i++)
+    {
+        const ImageSpec *spec = &exact_specs [i];
+        guint8 *data;
+        gint len;
+
+        data = encode (spec->width, spec->height, spec->channels, &len);
+
+        check_exact (data, len, 0, 0);
+        check_exact (data, len, spec->width, spec->height);
+        check_exact (data, len, spec->width * 2, spec->height / 2 + 1);
+
+        /* Truncated streams repeat the last pixel */
+        check_exact (data, MAX (len / 2, 22), 0, 0);
+
+        free (data);
+    }
+}
+
+/* Straightforward premultiplied box filter over the reference decode */
+static void
+check_reduced (gint width, gint height, gint target_width, gint target_height,
+               gint expected_factor)
+{
+    ChicleQoiLoader *loader;
+    ChafaPixelType pixel_type;
+    const guint8 *pixels;
+    guint8 *data, *ref_pixels;
+    gint dest_width, dest_height, rowstride;
+    gint image_width, image_height;
+    gint len, x, y;
+    qoi_desc desc;
+    gchar *path;
+
+    data = encode (width, height, 4, &len);
+    ref_pixels = qoi_decode (data, len, &desc, 4);
+
+    loader = load (data, len, target_width, target_height, &path);
+    pixels = chicle_qoi_loader_get_frame_data (loader, &pixel_type,
+                                               &dest_width, &dest_height, &rowstride);
+
+    g_assert_cmpint (pixel_type, ==, CHAFA_PIXEL_RGBA8_PREMULTIPLIED);
+    g_assert_cmpint (dest_width, ==, (width + expected_factor - 1) / expected_factor);
+    g_assert_cmpint (dest_height, ==, (height + expected_factor - 1) / expected_factor);
+    g_assert_cmpint (dest_width, >=, target_width);
+    g_assert_cmpint (dest_height, >=, target_height);
+
+    /* The layout still uses the full size */
+    chicle_qoi_loader_get_image_size (loader, &image_width, &image_height);
+    g_assert_cmpint (image_width, ==, width);
+    g_assert_cmpint (image_height, ==, height);
+
+    for (y = 0; y < dest_height; y++)
+    {
+        for (x = 0; x < dest_width; x++)
+        {
+            gdouble sum [4] = { 0 };
+            gint n = 0, sx, sy, i;
+
+            for (sy = y * expected_factor; sy < MIN ((y + 1) * expected_factor, height); sy++)
+            {
+                for (sx = x * expected_factor; sx < MIN ((x + 1) * expected_factor, width); sx++)
+                {
+                    const guint8 *src = ref_pixels + (sy * width + sx) * 4;
+
+                    for (i = 0; i < 3; i++)
+                        sum [i] += src [i] * src [3] / 255.0;
+                    sum [3] += src [3];
+                    n++;
+                }
+            }
+
+            for (i = 0; i < 4; i++)
+            {
+                gint expected = (gint) (sum [i] / n + 0.5);
+                gint got = pixels [y * rowstride + x * 4 + i];
+
+                g_assert_cmpint (ABS (got - expected), <=, 1);
+            }
+        }
+    }
+
+    unload (loader, path);
+    free (ref_pixels);
+    free (data);
+}
+
+static void
+reduced_test (void)
+{
+    check_reduced (200, 120, 50, 30, 4);
+
+    /* Partial blocks at the edges */
+    check_reduced (203, 121, 50, 30, 4);
+
+    /* The tighter dimension decides */
+    check_reduced (300, 100, 50, 30, 3);
+}
+
+#ifdef G_OS_UNIX
+
+#define BIG_SIZE 8192
+
+/* From the QOI spec; qoi.h only defines these for the implementation */
+#define OP_DIFF 0x40
+#define OP_RUN 0xc0
+
+static glong
+get_max_rss_kb (void)
+{
+    struct rusage usage;
+
+    getrusage (RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/* Writes a BIG_SIZE x BIG_SIZE stream of short runs directly, since
+ * encoding it would need the full image in memory */
+static guint8 *
+gen_big_stream (gint *len_out)
+{
+    GByteArray *array;
+    guint8 header [14] = { 'q', 'o', 'i', 'f' };
+    const guint8 padding [8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+    gint64 n_pixels = (gint64) BIG_SIZE * BIG_SIZE;
+    gint i;
+
+    for (i = 0; i < 2; i++)
+    {
+        header [4 + i * 4 + 2] = BIG_SIZE >> 8;
+        header [4 + i * 4 + 3] = BIG_SIZE & 0xff;
+    }
+    header [12] = 4;
+    header [13] = QOI_SRGB;
+
+    array = g_byte_array_new ();
+    g_byte_array_append (array, header, sizeof (header));
+
+    while (n_pixels > 0)
+    {
+        /* A diff followed by a run of up to 61 pixels */
+        guint8 ops [2];
+        gint n_run = MIN (n_pixels - 1, 61);
+
+        ops [0] = OP_DIFF | (3 << 4) | (2 << 2) | 1;
+        ops [1] = OP_RUN | (n_run - 1);
+        g_byte_array_append (array, ops, n_run > 0 ? 2 : 1);
+        n_pixels -= 1 + n_run;
+    }
+
+    g_byte_array_append (array, padding, sizeof (padding));
+
+    *len_out = array->len;
+    return g_byte_array_free (array, FALSE);
+}
+
+/* A full decode would need 256MiB. When reduced, peak memory should be in
+ * proportion to the output instead. */
+static void
+memory_test (void)
+{
+    ChicleQoiLoader *loader;
+    const guint8 *pixels;
+    gint width, height;
+    glong rss_before_kb, rss_after_kb;
+    guint8 *data;
+    gchar *path;
+    gint len;
+
+    data = gen_big_stream (&len);
+
+    rss_before_kb = get_max_rss_kb ();
+    loader = load (data, len, 512, 512, &path);
+    rss_after_kb = get_max_rss_kb ();
+
+    pixels = chicle_qoi_loader_get_frame_data (loader, NULL, &width, &height, NULL);
+    g_assert (pixels != NULL);
+    g_assert_cmpint (width, ==, 512);
+    g_assert_cmpint (height, ==, 512);
+    g_assert_cmpint (rss_after_kb - rss_before_kb, <, 32 * 1024);
+
+    unload (loader, path);
+    g_free (data);
+}
+
+#endif
+
+int
+main (int argc, char *argv [])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    /* Runs first, so the peak RSS isn't already inflated */
+#ifdef G_OS_UNIX
+    g_test_add_func ("/qoi-loader/memory", memory_test);
+#endif
+    g_test_add_func ("/qoi-loader/exact", exact_test);
+    g_test_add_func ("/qoi-loader/reduced", reduced_test);
+
+    return g_test_run ();
+}
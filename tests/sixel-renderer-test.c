@@ -0,0 +1,470 @@
+#include "config.h"
+
+#include <chafa.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* 10x6 cells of 8x12 pixels; the source is the same size, so it's
+ * copied verbatim */
+#define WIDTH_CELLS 10
+#define HEIGHT_CELLS 6
+#define CELL_WIDTH 8
+#define CELL_HEIGHT 12
+#define WIDTH_PIXELS (WIDTH_CELLS * CELL_WIDTH)
+#define HEIGHT_PIXELS (HEIGHT_CELLS * CELL_HEIGHT)
+#define N_BANDS (HEIGHT_PIXELS / 6)
+
+#define BORDER 20
+#define SQUARE 8
+
+static const guint8 colors [] [3] =
+{
+    { 0xff, 0x00, 0x00 }, { 0x00, 0xff, 0x00 }, { 0x00, 0x00, 0xff },
+    { 0xff, 0xff, 0x00 }, { 0x00, 0xff, 0xff }, { 0xff, 0xff, 0xff }
+};
+
+/* Sixel data decoded back into pixels, and the band strings it came from */
+typedef struct
+{
+    guint8 *pixels;
+    gchar **bands;
+    gint n_pens;
+}
+Decoded;
+
+/* A palette image, with the palette indices alongside the pixels */
+typedef struct
+{
+    guint8 *pixels;
+    guint8 *indices;
+    guint32 colors [G_N_ELEMENTS (colors) + 1];
+    gint width, height;
+}
+IndexedImage;
+
+static void
+set_pixel (guint8 *p, const guint8 *color, guint8 alpha)
+{
+    p [0] = color [0];
+    p [1] = color [1];
+    p [2] = color [2];
+    p [3] = alpha;
+}
+
+/* An opaque block with a transparent border wide enough to leave several
+ * bands and columns empty on every side */
+static guint8 *
+gen_transparent_border_image (void)
+{
+    guint8 *pixels;
+    gint x, y;
+
+    pixels = g_malloc0 (WIDTH_PIXELS * HEIGHT_PIXELS * 4);
+
+    for (y = BORDER; y < HEIGHT_PIXELS - BORDER; y++)
+    {
+        for (x = BORDER; x < WIDTH_PIXELS - BORDER; x++)
+            set_pixel (pixels + (y * WIDTH_PIXELS + x) * 4,
+                       colors [((x - BORDER) / 5) % G_N_ELEMENTS (colors)], 0xff);
+    }
+
+    return pixels;
+}
+
+/* Opaque squares in varying colors alternate with transparent ones, so
+ * every band has many short opaque and transparent runs */
+static guint8 *
+gen_checkerboard_image (gint square_width, gint square_height)
+{
+    guint8 *pixels;
+    gint x, y;
+
+    pixels = g_malloc0 (WIDTH_PIXELS * HEIGHT_PIXELS * 4);
+
+    for (y = 0; y < HEIGHT_PIXELS; y++)
+    {
+        for (x = 0; x < WIDTH_PIXELS; x++)
+        {
+            gint sx = x / square_width, sy = y / square_height;
+
+            if ((sx + sy) % 2)
+                continue;
+
+            set_pixel (pixels + (y * WIDTH_PIXELS + x) * 4,
+                       colors [(sx + sy * 3) % G_N_ELEMENTS (colors)], 0xff);
+        }
+    }
+
+    return pixels;
+}
+
+/* Diagonal stripes of varying width in all the colors, on a transparent
+ * background. Index 0 is transparent. */
+static void
+gen_indexed_image (gint width, gint height, IndexedImage *image_out)
+{
+    guint i;
+    gint x, y;
+
+    image_out->width = width;
+    image_out->height = height;
+    image_out->pixels = g_malloc (width * height * 4);
+    image_out->indices = g_malloc (width * height);
+
+    image_out->colors [0] = 0;
+    for (i = 0; i < G_N_ELEMENTS (colors); i++)
+        image_out->colors [i + 1] = 0xff000000 | (colors [i] [0] << 16)
+            | (colors [i] [1] << 8) | colors [i] [2];
+
+    for (y = 0; y < height; y++)
+    {
+        for (x = 0; x < width; x++)
+        {
+            gint index = ((x + y) / (1 + x % 3)) % (G_N_ELEMENTS (colors) + 1);
+
+            image_out->indices [y * width + x] = index;
+            if (index == 0)
+                set_pixel (image_out->pixels + (y * width + x) * 4, colors [0], 0);
+            else
+                set_pixel (image_out->pixels + (y * width + x) * 4, colors [index - 1], 0xff);
+        }
+    }
+}
+
+static void
+indexed_image_free (IndexedImage *image)
+{
+    g_free (image->pixels);
+    g_free (image->indices);
+}
+
+/* Prints the image placed on the canvas. If it's indexed, the indices are
+ * added to the frame. */
+static GString *
+print_placement (const guint8 *pixels, const IndexedImage *indexed,
+                 gint width, gint height, ChafaTuck tuck)
+{
+    gchar *envp [] = { "TERM=foot", NULL };
+    ChafaTermInfo *term_info;
+    ChafaCanvasConfig *config;
+    ChafaCanvas *canvas;
+    ChafaFrame *frame;
+    ChafaImage *image;
+    ChafaPlacement *placement;
+    GString *gs;
+
+    term_info = chafa_term_db_detect (chafa_term_db_get_default (), envp);
+
+    config = chafa_canvas_config_new ();
+    chafa_canvas_config_set_pixel_mode (config, CHAFA_PIXEL_MODE_SIXELS);
+    chafa_canvas_config_set_geometry (config, WIDTH_CELLS, HEIGHT_CELLS);
+    chafa_canvas_config_set_cell_geometry (config, CELL_WIDTH, CELL_HEIGHT);
+    chafa_canvas_config_set_dither_mode (config, CHAFA_DITHER_MODE_NONE);
+
+    frame = chafa_frame_new (pixels, CHAFA_PIXEL_RGBA8_UNASSOCIATED,
+                             width, height, width * 4);
+    if (indexed)
+        chafa_frame_set_indexed_pixels (frame, indexed->indices, width,
+                                        indexed->colors, G_N_ELEMENTS (indexed->colors));
+
+    image = chafa_image_new ();
+    chafa_image_set_frame (image, frame);
+    placement = chafa_placement_new (image, -1);
+    chafa_placement_set_tuck (placement, tuck);
+    chafa_placement_set_halign (placement, CHAFA_ALIGN_CENTER);
+    chafa_placement_set_valign (placement, CHAFA_ALIGN_CENTER);
+
+    canvas = chafa_canvas_new (config);
+    chafa_canvas_set_placement (canvas, placement);
+    gs = chafa_canvas_print (canvas, term_info);
+
+    chafa_canvas_unref (canvas);
+    chafa_placement_unref (placement);
+    chafa_image_unref (image);
+    chafa_frame_unref (frame);
+    chafa_canvas_config_unref (config);
+    chafa_term_info_unref (term_info);
+    return gs;
+}
+
+static GString *
+print_image (const guint8 *pixels)
+{
+    return print_placement (pixels, NULL, WIDTH_PIXELS, HEIGHT_PIXELS, CHAFA_TUCK_STRETCH);
+}
+
+static const gchar *
+parse_int (const gchar *p, gint *n_out)
+{
+    gchar *end;
+
+    *n_out = strtol (p, &end, 10);
+    g_assert (end != p);
+    return end;
+}
+
+/* Minimal decoder for the subset of sixel we emit. Unpainted pixels are
+ * left transparent. */
+static void
+decode_sixels (const gchar *out, Decoded *decoded)
+{
+    guint8 palette [256] [3] = { { 0 } };
+    const gchar *p, *data, *end;
+    gchar *data_str;
+    gint pen = -1, x = 0, band = 0;
+
+    decoded->n_pens = 0;
+
+    p = strchr (out, 'q');
+    g_assert (p != NULL);
+    p++;
+
+    /* Raster attributes */
+    g_assert (*p == '"');
+    while (*p && *p != '#')
+        p++;
+
+    /* Palette; the first pen selection has no color parameters */
+    for (;;)
+    {
+        gint n, r, g, b, mode;
+        const gchar *q;
+
+        g_assert (*p == '#');
+        q = parse_int (p + 1, &n);
+        if (*q != ';')
+            break;
+
+        q = parse_int (q + 1, &mode);
+        g_assert_cmpint (mode, ==, 2);
+        q = parse_int (q + 1, &r);
+        q = parse_int (q + 1, &g);
+        q = parse_int (q + 1, &b);
+
+        palette [n] [0] = (r * 255 + 50) / 100;
+        palette [n] [1] = (g * 255 + 50) / 100;
+        palette [n] [2] = (b * 255 + 50) / 100;
+        decoded->n_pens++;
+        p = q;
+    }
+
+    data = p;
+    end = strstr (data, "\033\\");
+    g_assert (end != NULL);
+
+    data_str = g_strndup (data, end - data);
+    decoded->bands = g_strsplit (data_str, "-", -1);
+    g_free (data_str);
+
+    decoded->pixels = g_malloc0 (WIDTH_PIXELS * HEIGHT_PIXELS * 4);
+
+    while (p < end)
+    {
+        gint n_reps = 1, i, j;
+        gchar c = *(p++);
+
+        if (c == '#')
+        {
+            p = parse_int (p, &pen);
+            continue;
+        }
+        else if (c == '$')
+        {
+            x = 0;
+            continue;
+        }
+        else if (c == '-')
+        {
+            x = 0;
+            band++;
+            continue;
+        }
+        else if (c == '!')
+        {
+            p = parse_int (p, &n_reps);
+            c = *(p++);
+        }
+
+        g_assert (c >= '?' && c <= '~');
+        g_assert (pen >= 0);
+        g_assert_cmpint (x + n_reps, <=, WIDTH_PIXELS);
+        g_assert_cmpint (band, <, N_BANDS);
+
+        for (i = 0; i < n_reps; i++, x++)
+        {
+            for (j = 0; j < 6; j++)
+            {
+                guint8 *px = decoded->pixels + ((band * 6 + j) * WIDTH_PIXELS + x) * 4;
+
+                if (!((c - '?') & (1 << j)))
+                    continue;
+
+                /* A pixel can only be painted once */
+                g_assert_cmpint (px [3], ==, 0);
+                set_pixel (px, palette [pen], 0xff);
+            }
+        }
+    }
+
+    g_assert_cmpint (band, ==, N_BANDS - 1);
+    g_assert_cmpuint (g_strv_length (decoded->bands), ==, N_BANDS);
+}
+
+static void
+decoded_free (Decoded *decoded)
+{
+    g_free (decoded->pixels);
+    g_strfreev (decoded->bands);
+}
+
+/* Every opaque pixel must come back in its color, and nothing else may
+ * be painted */
+static void
+check_roundtrip (const guint8 *pixels, Decoded *decoded)
+{
+    GString *gs;
+    gint i, j;
+
+    gs = print_image (pixels);
+    decode_sixels (gs->str, decoded);
+
+    for (i = 0; i < WIDTH_PIXELS * HEIGHT_PIXELS; i++)
+    {
+        const guint8 *src = pixels + i * 4;
+        const guint8 *dest = decoded->pixels + i * 4;
+
+        g_assert_cmpint (dest [3], ==, src [3]);
+        if (src [3] == 0)
+            continue;
+
+        for (j = 0; j < 3; j++)
+            g_assert_cmpint (ABS (dest [j] - src [j]), <=, 3);
+    }
+
+    g_string_free (gs, TRUE);
+}
+
+static void
+transparent_border_test (void)
+{
+    Decoded decoded;
+    guint8 *pixels;
+    gint i;
+
+    pixels = gen_transparent_border_image ();
+    check_roundtrip (pixels, &decoded);
+
+    for (i = 0; i < N_BANDS; i++)
+    {
+        const gchar *band = decoded.bands [i];
+
+        if (i == 0 || i == N_BANDS - 1)
+        {
+            /* First and last bands are always drawn in full, with a
+             * single pen */
+            g_assert (band [0] == '#');
+            g_assert (strchr (band, '$') == NULL);
+        }
+        else if ((i + 1) * 6 <= BORDER || i * 6 >= HEIGHT_PIXELS - BORDER)
+        {
+            /* Fully transparent bands collapse to a bare GNL */
+            g_assert_cmpstr (band, ==, "");
+        }
+        else
+        {
+            /* Leading transparent runs are kept, since sixel has no other
+             * way to position the first column; trailing ones are
+             * dropped */
+            g_assert (strstr (band, "!20?") != NULL);
+            g_assert (!g_str_has_suffix (band, "?"));
+        }
+    }
+
+    decoded_free (&decoded);
+    g_free (pixels);
+}
+
+static void
+checkerboard_test (void)
+{
+    static const gint square_sizes [] [2] =
+    {
+        { SQUARE, SQUARE }, { 1, 1 }, { 3, 5 }, { 13, 6 }, { 64, 7 }, { 65, 12 }
+    };
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (square_sizes); i++)
+    {
+        Decoded decoded;
+        guint8 *pixels;
+
+        pixels = gen_checkerboard_image (square_sizes [i] [0], square_sizes [i] [1]);
+        check_roundtrip (pixels, &decoded);
+
+        decoded_free (&decoded);
+        g_free (pixels);
+    }
+}
+
+/* Palette images must come out the same whether the source palette is
+ * passed through or a new one is generated */
+static void
+check_indexed (gint width, gint height, ChafaTuck tuck, gboolean expect_passthrough)
+{
+    IndexedImage image;
+    Decoded decoded [2];
+    GString *gs [2];
+    gint i;
+
+    gen_indexed_image (width, height, &image);
+
+    gs [0] = print_placement (image.pixels, NULL, width, height, tuck);
+    gs [1] = print_placement (image.pixels, &image, width, height, tuck);
+
+    for (i = 0; i < 2; i++)
+        decode_sixels (gs [i]->str, &decoded [i]);
+
+    for (i = 0; i < WIDTH_PIXELS * HEIGHT_PIXELS * 4; i++)
+    {
+        g_assert_cmpint (ABS (decoded [0].pixels [i] - decoded [1].pixels [i]), <=, 3);
+    }
+
+    /* The passed-through palette has exactly the opaque source colors */
+    if (expect_passthrough)
+        g_assert_cmpint (decoded [1].n_pens, ==, G_N_ELEMENTS (colors));
+    else
+        g_assert_cmpstr (gs [0]->str, ==, gs [1]->str);
+
+    for (i = 0; i < 2; i++)
+    {
+        decoded_free (&decoded [i]);
+        g_string_free (gs [i], TRUE);
+    }
+
+    indexed_image_free (&image);
+}
+
+static void
+indexed_test (void)
+{
+    /* Same size as the canvas */
+    check_indexed (WIDTH_PIXELS, HEIGHT_PIXELS, CHAFA_TUCK_STRETCH, TRUE);
+
+    /* Smaller, centered with transparent padding */
+    check_indexed (WIDTH_PIXELS - 13, HEIGHT_PIXELS - 21, CHAFA_TUCK_SHRINK_TO_FIT, TRUE);
+
+    /* Scaled, so the colors are blended and must be quantized */
+    check_indexed (WIDTH_PIXELS / 2, HEIGHT_PIXELS / 2, CHAFA_TUCK_STRETCH, FALSE);
+}
+
+int
+main (int argc, char *argv [])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/sixel-renderer/transparent-border", transparent_border_test);
+    g_test_add_func ("/sixel-renderer/checkerboard", checkerboard_test);
+    g_test_add_func ("/sixel-renderer/indexed", indexed_test);
+
+    return g_test_run ();
+}
@@ -0,0 +1,183 @@
+#include "config.h"
+
+#include <chafa.h>
+#include <string.h>
+#include "internal/smolscale/smolscale.h"
+
+/* Padding at the end of each row. Must be left alone by the scaler. */
+#define ROW_PADDING 13
+
+/* Source and destination sizes along one axis. Between them, they cover
+ * the one, copy, bilinear (up to two halvings) and box filters, with and
+ * without full SIMD batches and scalar tails. */
+static const guint dims [] [2] =
+{
+    { 1, 1 }, { 1, 6 }, { 2, 1 }, { 3, 7 }, { 7, 7 }, { 9, 4 },
+    { 16, 5 }, { 33, 8 }, { 64, 17 }, { 67, 9 }, { 100, 37 },
+    { 150, 131 }, { 131, 150 }, { 128, 3 }, { 600, 2 }, { 1000, 3 }
+};
+
+static gint
+get_pixel_size (SmolPixelType pixel_type)
+{
+    return pixel_type >= SMOL_PIXEL_RGB8 ? 3 : 4;
+}
+
+/* Returns the byte offset of alpha, or -1 if there is none */
+static gint
+get_alpha_index (SmolPixelType pixel_type)
+{
+    switch (pixel_type)
+    {
+        case SMOL_PIXEL_RGBA8_PREMULTIPLIED:
+        case SMOL_PIXEL_BGRA8_PREMULTIPLIED:
+        case SMOL_PIXEL_RGBA8_UNASSOCIATED:
+        case SMOL_PIXEL_BGRA8_UNASSOCIATED:
+            return 3;
+        case SMOL_PIXEL_ARGB8_PREMULTIPLIED:
+        case SMOL_PIXEL_ABGR8_PREMULTIPLIED:
+        case SMOL_PIXEL_ARGB8_UNASSOCIATED:
+        case SMOL_PIXEL_ABGR8_UNASSOCIATED:
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+/* Random pixels, with a mix of opaque, transparent and partially
+ * transparent ones. Premultiplied colors never exceed alpha. */
+static guint8 *
+gen_image (GRand *rand, SmolPixelType pixel_type, guint width, guint height,
+           guint rowstride)
+{
+    gint pixel_size = get_pixel_size (pixel_type);
+    gint alpha_index = get_alpha_index (pixel_type);
+    gboolean is_premul = pixel_type <= SMOL_PIXEL_ABGR8_PREMULTIPLIED;
+    guint8 *pixels;
+    guint x, y;
+    gint i;
+
+    pixels = g_malloc (rowstride * height);
+
+    for (y = 0; y < height; y++)
+    {
+        for (x = 0; x < width; x++)
+        {
+            guint8 *p = pixels + y * rowstride + x * pixel_size;
+            gint kind = g_rand_int_range (rand, 0, 4);
+            guint8 alpha;
+
+            alpha = kind == 0 ? 0 : kind == 1 ? 0xff : g_rand_int_range (rand, 0, 256);
+
+            for (i = 0; i < pixel_size; i++)
+            {
+                p [i] = g_rand_int_range (rand, 0, 256);
+                if (i == alpha_index)
+                    p [i] = alpha;
+                else if (alpha_index >= 0 && is_premul)
+                    p [i] = (p [i] * alpha) / 255;
+            }
+        }
+    }
+
+    return pixels;
+}
+
+static guint8 *
+scale_image (const guint8 *src, SmolPixelType src_type,
+             guint src_width, guint src_height, guint src_rowstride,
+             SmolPixelType dest_type, guint dest_width, guint dest_height,
+             guint dest_rowstride, SmolFlags flags)
+{
+    guint8 *dest;
+
+    dest = g_malloc (dest_rowstride * dest_height);
+    memset (dest, 0x5a, dest_rowstride * dest_height);
+
+    smol_scale_simple (src, src_type, src_width, src_height, src_rowstride,
+                       dest, dest_type, dest_width, dest_height, dest_rowstride,
+                       flags);
+    return dest;
+}
+
+static void
+check_scale (GRand *rand, SmolPixelType src_type, SmolPixelType dest_type,
+             const guint *hdim, const guint *vdim, SmolFlags base_flags)
+{
+    guint src_rowstride = hdim [0] * get_pixel_size (src_type) + ROW_PADDING;
+    guint dest_rowstride = hdim [1] * get_pixel_size (dest_type) + ROW_PADDING;
+    guint8 *src, *ref, *dest;
+
+    src = gen_image (rand, src_type, hdim [0], vdim [0], src_rowstride);
+
+    /* The generic implementation is the reference. With AVX2 disabled,
+     * SSE4.1 is used where available, falling back to generic. */
+
+    ref = scale_image (src, src_type, hdim [0], vdim [0], src_rowstride,
+                       dest_type, hdim [1], vdim [1], dest_rowstride,
+                       base_flags | SMOL_DISABLE_ACCELERATION);
+    dest = scale_image (src, src_type, hdim [0], vdim [0], src_rowstride,
+                        dest_type, hdim [1], vdim [1], dest_rowstride,
+                        base_flags | SMOL_DISABLE_AVX2);
+
+    if (memcmp (dest, ref, dest_rowstride * vdim [1]))
+    {
+        g_test_message ("Mismatch: %d -> %d, %ux%u -> %ux%u",
+                        src_type, dest_type, hdim [0], vdim [0],
+                        hdim [1], vdim [1]);
+        g_test_fail ();
+    }
+
+    g_free (dest);
+    g_free (ref);
+    g_free (src);
+}
+
+static void
+check_all_pixel_types (SmolFlags base_flags)
+{
+    GRand *rand;
+    gint src_type, dest_type;
+    guint i;
+
+    rand = g_rand_new_with_seed (base_flags + 1);
+
+    for (src_type = 0; src_type < SMOL_PIXEL_MAX; src_type++)
+    {
+        for (dest_type = 0; dest_type < SMOL_PIXEL_MAX; dest_type++)
+        {
+            for (i = 0; i < G_N_ELEMENTS (dims); i++)
+            {
+                /* Pair each horizontal case with a different vertical one */
+                check_scale (rand, src_type, dest_type,
+                             dims [i], dims [(i * 5 + 7) % G_N_ELEMENTS (dims)],
+                             base_flags);
+            }
+        }
+    }
+
+    g_rand_free (rand);
+}
+
+static void
+linear_test (void)
+{
+    check_all_pixel_types (SMOL_NO_FLAGS);
+}
+
+static void
+compressed_test (void)
+{
+    check_all_pixel_types (SMOL_DISABLE_SRGB_LINEARIZATION);
+}
+
+int
+main (int argc, char *argv [])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/smolscale/linear", linear_test);
+    g_test_add_func ("/smolscale/compressed", compressed_test);
+
+    return g_test_run ();
+}
@@ -0,0 +1,454 @@
+#include "config.h"
+
+#include <chafa.h>
+#include "internal/chafa-private.h"
+#include "internal/chafa-work-cell.h"
+
+#define N_CELLS 200
+#define N_PEN_CELLS 40
+#define N_PERF_CELLS 2000
+#define N_GLYPHS 256
+#define GLYPH_BASE 0xe000
+
+/* Straightforward per-pixel error; what the renderer's kernels compute */
+static gint
+calc_error_reference (const ChafaWorkCell *wcell, const ChafaSymbol *sym,
+                      const ChafaColorPair *pair, gint n_channels)
+{
+    gint error = 0;
+    gint i, ch;
+
+    for (i = 0; i < CHAFA_SYMBOL_N_PIXELS; i++)
+    {
+        const ChafaColor *col = &pair->colors [(sym->bitmap >> (63 - i)) & 1];
+
+        for (ch = 0; ch < n_channels; ch++)
+        {
+            gint d = (gint) wcell->pixels [i].col.ch [ch] - (gint) col->ch [ch];
+            error += d * d;
+        }
+    }
+
+    return error;
+}
+
+static void
+gen_random_color (GRand *rand, ChafaColor *col, ChafaColorSpace color_space)
+{
+    ChafaColor rgb;
+    gint ch;
+
+    for (ch = 0; ch < 4; ch++)
+        rgb.ch [ch] = g_rand_int_range (rand, 0, 256);
+
+    if (color_space == CHAFA_COLOR_SPACE_DIN99D)
+    {
+        chafa_color_rgb_to_din99d (&rgb, col);
+        col->ch [3] = rgb.ch [3];
+    }
+    else
+    {
+        *col = rgb;
+    }
+}
+
+/* Cells are random noise, flat, or two colors split down the middle, so
+ * both small and large errors are covered */
+static void
+gen_cell (GRand *rand, ChafaColorSpace color_space, ChafaWorkCell *wcell)
+{
+    ChafaPixel pixels [CHAFA_SYMBOL_N_PIXELS];
+    ChafaColor a, b;
+    gint kind = g_rand_int_range (rand, 0, 3);
+    gint i;
+
+    gen_random_color (rand, &a, color_space);
+    gen_random_color (rand, &b, color_space);
+
+    for (i = 0; i < CHAFA_SYMBOL_N_PIXELS; i++)
+    {
+        if (kind == 0)
+            gen_random_color (rand, &pixels [i].col, color_space);
+        else if (kind == 1)
+            pixels [i].col = a;
+        else
+            pixels [i].col = (i % CHAFA_SYMBOL_WIDTH_PIXELS) < 4 ? a : b;
+    }
+
+    chafa_work_cell_init (wcell, pixels, CHAFA_SYMBOL_WIDTH_PIXELS, 0, 0);
+}
+
+/* Private use glyphs with random coverage, including empty and full ones */
+static ChafaSymbolMap *
+create_glyph_symbol_map (GRand *rand)
+{
+    ChafaSymbolMap *symbol_map;
+    guint8 pixels [CHAFA_SYMBOL_N_PIXELS * 4];
+    gint i, j;
+
+    symbol_map = chafa_symbol_map_new ();
+
+    for (i = 0; i < N_GLYPHS; i++)
+    {
+        gint density = i % 9;
+
+        for (j = 0; j < CHAFA_SYMBOL_N_PIXELS; j++)
+        {
+            guint8 v = g_rand_int_range (rand, 0, 8) < density ? 0xff : 0x00;
+
+            pixels [j * 4] = pixels [j * 4 + 1] = pixels [j * 4 + 2] = v;
+            pixels [j * 4 + 3] = 0xff;
+        }
+
+        chafa_symbol_map_add_glyph (symbol_map, GLYPH_BASE + i, CHAFA_PIXEL_RGBA8_UNASSOCIATED,
+                                    pixels, CHAFA_SYMBOL_WIDTH_PIXELS, CHAFA_SYMBOL_HEIGHT_PIXELS,
+                                    CHAFA_SYMBOL_WIDTH_PIXELS * 4);
+    }
+
+    chafa_symbol_map_add_by_range (symbol_map, GLYPH_BASE, GLYPH_BASE + N_GLYPHS - 1);
+    chafa_symbol_map_prepare (symbol_map);
+    g_assert_cmpint (symbol_map->n_symbols, >, 0);
+    return symbol_map;
+}
+
+static ChafaSymbolMap *
+create_builtin_symbol_map (void)
+{
+    ChafaSymbolMap *symbol_map;
+
+    symbol_map = chafa_symbol_map_new ();
+    chafa_symbol_map_add_by_tags (symbol_map, CHAFA_SYMBOL_TAG_ALL);
+    chafa_symbol_map_prepare (symbol_map);
+    g_assert_cmpint (symbol_map->n_symbols, >, 0);
+    return symbol_map;
+}
+
+static void
+check_symbol (GRand *rand, ChafaWorkCell *wcell, const ChafaSymbol *sym,
+              ChafaColorSpace color_space)
+{
+    ChafaColorMoments moments [2];
+    ChafaColorPair mean_pair, moments_pair, other_pair;
+    gint n_channels;
+
+    chafa_work_cell_get_moments_for_symbol (wcell, sym, moments);
+
+    /* Mean colors must be identical, rounding included */
+    chafa_work_cell_get_mean_colors_for_symbol (wcell, sym, &mean_pair);
+    chafa_color_moments_get_mean_colors (moments, sym, &moments_pair);
+    g_assert_cmpuint (chafa_color8_to_u32 (moments_pair.colors [0]), ==,
+                      chafa_color8_to_u32 (mean_pair.colors [0]));
+    g_assert_cmpuint (chafa_color8_to_u32 (moments_pair.colors [1]), ==,
+                      chafa_color8_to_u32 (mean_pair.colors [1]));
+
+    /* Any pair will do for the error, e.g. one picked from a palette */
+    gen_random_color (rand, &other_pair.colors [0], color_space);
+    gen_random_color (rand, &other_pair.colors [1], color_space);
+
+    for (n_channels = 3; n_channels <= 4; n_channels++)
+    {
+        g_assert_cmpint (chafa_color_moments_calc_error (moments, sym, &mean_pair, n_channels),
+                         ==, calc_error_reference (wcell, sym, &mean_pair, n_channels));
+        g_assert_cmpint (chafa_color_moments_calc_error (moments, sym, &other_pair, n_channels),
+                         ==, calc_error_reference (wcell, sym, &other_pair, n_channels));
+    }
+}
+
+static void
+check_symbol_map (GRand *rand, ChafaSymbolMap *symbol_map, ChafaColorSpace color_space)
+{
+    gint i, j;
+
+    for (i = 0; i < N_CELLS; i++)
+    {
+        ChafaWorkCell wcell;
+
+        gen_cell (rand, color_space, &wcell);
+
+        for (j = 0; j < symbol_map->n_symbols; j++)
+            check_symbol (rand, &wcell, &symbol_map->symbols [j], color_space);
+    }
+}
+
+/* The best pens must give the lowest error of any pen pair, and so can't
+ * do worse than quantizing the mean colors */
+static void
+check_symbol_pens (ChafaWorkCell *wcell, const ChafaSymbol *sym,
+                   const ChafaPalette **palettes, ChafaColorSpace color_space,
+                   const ChafaColor *pens, const gint *pen_norms, const gint *n_pens)
+{
+    ChafaColorMoments moments [2];
+    ChafaColorPair pair;
+    const ChafaCellPens *cell_pens;
+    gint fg_sums [3];
+    gint pair_pens [2];
+    gint best_pens [2];
+    gint best_error;
+    gint i, j;
+
+    chafa_work_cell_get_moments_for_symbol (wcell, sym, moments);
+    chafa_work_cell_get_fg_sums_for_symbol (wcell, sym, fg_sums);
+
+    for (i = 0; i < 3; i++)
+        g_assert_cmpint (fg_sums [i], ==, moments [CHAFA_COLOR_PAIR_FG].sum [i]);
+
+    cell_pens = chafa_work_cell_get_pens (wcell, pens, pen_norms, n_pens, 4);
+    best_error = chafa_cell_pens_find_best (cell_pens, pens, pen_norms,
+                                            fg_sums, sym->fg_weight, best_pens);
+
+    g_assert_cmpint (best_pens [CHAFA_COLOR_PAIR_BG], <, n_pens [CHAFA_COLOR_PAIR_BG]);
+    g_assert_cmpint (best_pens [CHAFA_COLOR_PAIR_FG], <, n_pens [CHAFA_COLOR_PAIR_FG]);
+
+    pair.colors [CHAFA_COLOR_PAIR_BG] = pens [best_pens [CHAFA_COLOR_PAIR_BG]];
+    pair.colors [CHAFA_COLOR_PAIR_FG] = pens [best_pens [CHAFA_COLOR_PAIR_FG]];
+    g_assert_cmpint (best_error, ==, calc_error_reference (wcell, sym, &pair, 4));
+
+    for (i = 0; i < n_pens [CHAFA_COLOR_PAIR_BG]; i++)
+    {
+        for (j = 0; j < n_pens [CHAFA_COLOR_PAIR_FG]; j++)
+        {
+            gint error;
+
+            pair.colors [CHAFA_COLOR_PAIR_BG] = pens [i];
+            pair.colors [CHAFA_COLOR_PAIR_FG] = pens [j];
+            error = chafa_color_moments_calc_error (moments, sym, &pair, 4);
+
+            pair_pens [CHAFA_COLOR_PAIR_BG] = i;
+            pair_pens [CHAFA_COLOR_PAIR_FG] = j;
+            g_assert_cmpint (error, ==, chafa_cell_pens_calc_error (cell_pens, pens, pen_norms,
+                                                                  fg_sums, sym->fg_weight,
+                                                                  pair_pens));
+            g_assert_cmpint (best_error, <=, error);
+        }
+    }
+
+    chafa_color_moments_get_mean_colors (moments, sym, &pair);
+
+    for (i = 0; i < 2; i++)
+        pair.colors [i] = *chafa_palette_get_color (
+            palettes [i], color_space,
+            chafa_palette_lookup_nearest (palettes [i], color_space, &pair.colors [i], NULL));
+
+    g_assert_cmpint (best_error, <=, calc_error_reference (wcell, sym, &pair, 4));
+}
+
+/* The BG palette has the same colors as the FG palette, or a prefix of them */
+static void
+init_pens (ChafaPalette *palettes, ChafaPaletteType fg_palette_type,
+           ChafaPaletteType bg_palette_type, ChafaColorSpace color_space,
+           ChafaColor *pens, gint *pen_norms, gint *n_pens)
+{
+    gint i;
+
+    chafa_palette_init (&palettes [CHAFA_COLOR_PAIR_BG], bg_palette_type);
+    chafa_palette_init (&palettes [CHAFA_COLOR_PAIR_FG], fg_palette_type);
+
+    for (i = 0; i < 2; i++)
+    {
+        chafa_palette_set_alpha_threshold (&palettes [i], 0);
+        n_pens [i] = chafa_palette_get_n_colors (&palettes [i]);
+    }
+
+    for (i = 0; i < n_pens [CHAFA_COLOR_PAIR_FG]; i++)
+    {
+        pens [i] = *chafa_palette_get_color (&palettes [CHAFA_COLOR_PAIR_FG], color_space, i);
+        pen_norms [i] = pens [i].ch [0] * pens [i].ch [0] + pens [i].ch [1] * pens [i].ch [1]
+            + pens [i].ch [2] * pens [i].ch [2];
+    }
+}
+
+static void
+check_pens (GRand *rand, ChafaSymbolMap *symbol_map, ChafaPaletteType fg_palette_type,
+            ChafaPaletteType bg_palette_type, ChafaColorSpace color_space)
+{
+    ChafaPalette palettes [2];
+    const ChafaPalette *palette_ptrs [2] = { &palettes [0], &palettes [1] };
+    ChafaColor pens [CHAFA_WORK_CELL_N_PENS_MAX];
+    gint pen_norms [CHAFA_WORK_CELL_N_PENS_MAX];
+    gint n_pens [2];
+    gint i, j;
+
+    init_pens (palettes, fg_palette_type, bg_palette_type, color_space,
+               pens, pen_norms, n_pens);
+
+    for (i = 0; i < N_PEN_CELLS; i++)
+    {
+        ChafaWorkCell wcell;
+
+        gen_cell (rand, color_space, &wcell);
+
+        for (j = 0; j < symbol_map->n_symbols; j++)
+            check_symbol_pens (&wcell, &symbol_map->symbols [j], palette_ptrs,
+                               color_space, pens, pen_norms, n_pens);
+    }
+
+    chafa_palette_deinit (&palettes [0]);
+    chafa_palette_deinit (&palettes [1]);
+}
+
+static void
+best_pens_test (void)
+{
+    ChafaSymbolMap *symbol_map;
+    GRand *rand;
+
+    rand = g_rand_new_with_seed (3);
+    symbol_map = create_builtin_symbol_map ();
+
+    check_pens (rand, symbol_map, CHAFA_PALETTE_TYPE_FIXED_16, CHAFA_PALETTE_TYPE_FIXED_16,
+                CHAFA_COLOR_SPACE_RGB);
+    check_pens (rand, symbol_map, CHAFA_PALETTE_TYPE_FIXED_16, CHAFA_PALETTE_TYPE_FIXED_16,
+                CHAFA_COLOR_SPACE_DIN99D);
+    check_pens (rand, symbol_map, CHAFA_PALETTE_TYPE_FIXED_16, CHAFA_PALETTE_TYPE_FIXED_8,
+                CHAFA_COLOR_SPACE_RGB);
+    check_pens (rand, symbol_map, CHAFA_PALETTE_TYPE_FIXED_8, CHAFA_PALETTE_TYPE_FIXED_8,
+                CHAFA_COLOR_SPACE_RGB);
+
+    chafa_symbol_map_unref (symbol_map);
+    g_rand_free (rand);
+}
+
+/* Compares the pen pair search with quantizing each symbol's mean colors,
+ * over every symbol for each cell, as in the exhaustive symbol search.
+ * Only runs in perf mode:
+ *
+ *   tests/symbol-error-test -m perf -p /symbol-error/pens-perf
+ */
+static void
+pens_perf_test (void)
+{
+    ChafaSymbolMap *symbol_map;
+    ChafaWorkCell *cells;
+    ChafaPalette palettes [2];
+    ChafaColor pens [CHAFA_WORK_CELL_N_PENS_MAX];
+    gint pen_norms [CHAFA_WORK_CELL_N_PENS_MAX];
+    gint n_pens [2];
+    gdouble pens_s, mean_s;
+    gint64 pens_error = 0, mean_error = 0;
+    GRand *rand;
+    gint i, j;
+
+    if (!g_test_perf ())
+    {
+        g_test_skip ("Only runs in perf mode");
+        return;
+    }
+
+    rand = g_rand_new_with_seed (4);
+    symbol_map = create_builtin_symbol_map ();
+    init_pens (palettes, CHAFA_PALETTE_TYPE_FIXED_16, CHAFA_PALETTE_TYPE_FIXED_16,
+               CHAFA_COLOR_SPACE_RGB, pens, pen_norms, n_pens);
+
+    cells = g_new (ChafaWorkCell, N_PERF_CELLS);
+    for (i = 0; i < N_PERF_CELLS; i++)
+        gen_cell (rand, CHAFA_COLOR_SPACE_RGB, &cells [i]);
+
+    g_test_timer_start ();
+
+    for (i = 0; i < N_PERF_CELLS; i++)
+    {
+        ChafaWorkCell wcell = cells [i];
+        const ChafaCellPens *cell_pens;
+
+        cell_pens = chafa_work_cell_get_pens (&wcell, pens, pen_norms, n_pens, 4);
+
+        for (j = 0; j < symbol_map->n_symbols; j++)
+        {
+            const ChafaSymbol *sym = &symbol_map->symbols [j];
+            gint fg_sums [3];
+            gint best_pens [2];
+
+            chafa_work_cell_get_fg_sums_for_symbol (&wcell, sym, fg_sums);
+            pens_error += chafa_cell_pens_find_best (cell_pens, pens, pen_norms,
+                                                     fg_sums, sym->fg_weight, best_pens);
+        }
+    }
+
+    pens_s = g_test_timer_elapsed ();
+    g_test_timer_start ();
+
+    for (i = 0; i < N_PERF_CELLS; i++)
+    {
+        ChafaWorkCell wcell = cells [i];
+
+        for (j = 0; j < symbol_map->n_symbols; j++)
+        {
+            const ChafaSymbol *sym = &symbol_map->symbols [j];
+            ChafaColorMoments moments [2];
+            ChafaColorPair pair;
+            gint k;
+
+            chafa_work_cell_get_moments_for_symbol (&wcell, sym, moments);
+            chafa_color_moments_get_mean_colors (moments, sym, &pair);
+
+            for (k = 0; k < 2; k++)
+                pair.colors [k] = *chafa_palette_get_color (
+                    &palettes [k], CHAFA_COLOR_SPACE_RGB,
+                    chafa_palette_lookup_nearest (&palettes [k], CHAFA_COLOR_SPACE_RGB,
+                                                  &pair.colors [k], NULL));
+
+            mean_error += chafa_color_moments_calc_error (moments, sym, &pair, 4);
+        }
+    }
+
+    mean_s = g_test_timer_elapsed ();
+
+    g_test_message ("%d cells x %d symbols, 16 colors", N_PERF_CELLS, symbol_map->n_symbols);
+    g_test_message ("pen pairs: %.2f us/cell, total error %" G_GINT64_FORMAT,
+                    pens_s * 1e6 / N_PERF_CELLS, pens_error);
+    g_test_message ("quantized means: %.2f us/cell, total error %" G_GINT64_FORMAT,
+                    mean_s * 1e6 / N_PERF_CELLS, mean_error);
+
+    g_assert_cmpint (pens_error, <=, mean_error);
+
+    g_free (cells);
+    chafa_palette_deinit (&palettes [0]);
+    chafa_palette_deinit (&palettes [1]);
+    chafa_symbol_map_unref (symbol_map);
+    g_rand_free (rand);
+}
+
+static void
+builtin_symbols_test (void)
+{
+    ChafaSymbolMap *symbol_map;
+    GRand *rand;
+
+    rand = g_rand_new_with_seed (1);
+    symbol_map = create_builtin_symbol_map ();
+
+    check_symbol_map (rand, symbol_map, CHAFA_COLOR_SPACE_RGB);
+    check_symbol_map (rand, symbol_map, CHAFA_COLOR_SPACE_DIN99D);
+
+    chafa_symbol_map_unref (symbol_map);
+    g_rand_free (rand);
+}
+
+static void
+glyph_symbols_test (void)
+{
+    ChafaSymbolMap *symbol_map;
+    GRand *rand;
+
+    rand = g_rand_new_with_seed (2);
+    symbol_map = create_glyph_symbol_map (rand);
+
+    check_symbol_map (rand, symbol_map, CHAFA_COLOR_SPACE_RGB);
+    check_symbol_map (rand, symbol_map, CHAFA_COLOR_SPACE_DIN99D);
+
+    chafa_symbol_map_unref (symbol_map);
+    g_rand_free (rand);
+}
+
+int
+main (int argc, char *argv [])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/symbol-error/builtin-symbols", builtin_symbols_test);
+    g_test_add_func ("/symbol-error/glyph-symbols", glyph_symbols_test);
+    g_test_add_func ("/symbol-error/best-pens", best_pens_test);
+    g_test_add_func ("/symbol-error/pens-perf", pens_perf_test);
+
+    return g_test_run ();
+}
@@ -0,0 +1,391 @@
+#include "config.h"
+
+#include <chafa.h>
+#include <string.h>
+
+#ifdef G_OS_UNIX
+# include <errno.h>
+# include <unistd.h>
+# include <sys/socket.h>
+# include <glib-unix.h>
+#endif
+
+#ifdef G_OS_UNIX
+
+/* The terminal side of a socketpair. The term gets the other end for both
+ * input and output. */
+typedef struct
+{
+    ChafaTerm *term;
+    gint peer_fd;
+    GString *received;
+}
+FakeTerm;
+
+typedef struct
+{
+    gboolean done;
+    gboolean success;
+    gint64 time_us;
+}
+ProbeResult;
+
+static void
+fake_term_init (FakeTerm *fake)
+{
+    gchar *envp [] = { "TERM=xterm-256color", NULL };
+    ChafaTermInfo *term_info;
+    gint fds [2];
+
+    g_assert_cmpint (socketpair (AF_UNIX, SOCK_STREAM, 0, fds), ==, 0);
+
+    term_info = chafa_term_db_detect (chafa_term_db_get_default (), envp);
+    fake->term = chafa_term_new (term_info, fds [0], fds [0], -1);
+    chafa_term_info_unref (term_info);
+
+    fake->peer_fd = fds [1];
+    g_unix_set_fd_nonblocking (fake->peer_fd, TRUE, NULL);
+    fake->received = g_string_new ("");
+}
+
+static void
+fake_term_deinit (FakeTerm *fake, gboolean destroy_term)
+{
+    if (destroy_term)
+        chafa_term_destroy (fake->term);
+    if (fake->peer_fd >= 0)
+        close (fake->peer_fd);
+    g_string_free (fake->received, TRUE);
+}
+
+static void
+fake_term_send (FakeTerm *fake, const gchar *str)
+{
+    g_assert_cmpint (write (fake->peer_fd, str, strlen (str)), ==, strlen (str));
+}
+
+/* Collects whatever the term has written so far */
+static void
+fake_term_receive (FakeTerm *fake)
+{
+    gchar buf [4096];
+    gint len;
+
+    while ((len = read (fake->peer_fd, buf, sizeof (buf))) > 0)
+        g_string_append_len (fake->received, buf, len);
+
+    g_assert (len < 0 && errno == EAGAIN);
+}
+
+/* One iteration of a minimal event loop. Returns FALSE if there was
+ * nothing to wait for. */
+static gboolean
+iterate (ChafaTerm *term, gint max_wait_ms)
+{
+    GPollFD pollfds [4];
+    gint n_pollfds, timeout_ms;
+
+    n_pollfds = chafa_term_get_pollfds (term, pollfds, G_N_ELEMENTS (pollfds), &timeout_ms);
+    g_assert_cmpint (n_pollfds, <=, 2);
+
+    if (n_pollfds == 0 && timeout_ms < 0)
+        return FALSE;
+
+    if (timeout_ms < 0 || timeout_ms > max_wait_ms)
+        timeout_ms = max_wait_ms;
+
+    g_poll (pollfds, n_pollfds, timeout_ms);
+    chafa_term_dispatch (term, pollfds, n_pollfds);
+    return TRUE;
+}
+
+static void
+probe_cb (ChafaTerm *term, gboolean success, gpointer user_data)
+{
+    ProbeResult *result = user_data;
+
+    g_assert (term != NULL);
+    g_assert (!result->done);
+
+    result->done = TRUE;
+    result->success = success;
+    result->time_us = g_get_monotonic_time ();
+}
+
+static void
+write_test (void)
+{
+    FakeTerm fake;
+    GPollFD pollfds [2];
+    GString *expected;
+    gint i;
+
+    fake_term_init (&fake);
+
+    /* Output isn't polled until there's something to write */
+    g_assert_cmpint (chafa_term_get_pollfds (fake.term, pollfds, 2, NULL), ==, 1);
+    g_assert_cmpint (pollfds [0].events & G_IO_OUT, ==, 0);
+
+    /* Much more than the socket buffer holds, so writes will be partial
+     * and the term must not block */
+    expected = g_string_new ("");
+    for (i = 0; i < 200000; i++)
+        g_string_append_printf (expected, "%d,", i);
+
+    chafa_term_write (fake.term, expected->str, expected->len);
+    chafa_term_print (fake.term, "%s", "end");
+    g_string_append (expected, "end");
+
+    while (fake.received->len < expected->len)
+    {
+        iterate (fake.term, 100);
+        fake_term_receive (&fake);
+    }
+
+    g_assert (fake.received->len == expected->len);
+    g_assert (memcmp (fake.received->str, expected->str, expected->len) == 0);
+
+    /* Everything's out, so only input is polled now */
+    g_assert (chafa_term_flush (fake.term));
+    g_assert_cmpint (chafa_term_get_pollfds (fake.term, pollfds, 2, NULL), ==, 1);
+    g_assert_cmpint (pollfds [0].events & G_IO_OUT, ==, 0);
+
+    g_string_free (expected, TRUE);
+    fake_term_deinit (&fake, TRUE);
+}
+
+/* Output still queued is written out on destroy */
+static void
+destroy_test (void)
+{
+    FakeTerm fake;
+
+    fake_term_init (&fake);
+
+    chafa_term_get_pollfds (fake.term, NULL, 0, NULL);
+    chafa_term_write (fake.term, "pending", 7);
+
+    /* Not written before the loop gets to it */
+    fake_term_receive (&fake);
+    g_assert_cmpuint (fake.received->len, ==, 0);
+
+    chafa_term_destroy (fake.term);
+    fake_term_receive (&fake);
+    g_assert_cmpstr (fake.received->str, ==, "pending");
+
+    fake_term_deinit (&fake, FALSE);
+}
+
+static void
+events_test (void)
+{
+    FakeTerm fake;
+    ChafaEvent *event;
+    GPollFD pollfds [2];
+    const gchar *p;
+
+    fake_term_init (&fake);
+
+    /* No input yet; must not block */
+    iterate (fake.term, 0);
+    g_assert (chafa_term_read_event (fake.term, 1000) == NULL);
+
+    fake_term_send (&fake, "abc");
+    iterate (fake.term, 1000);
+
+    for (p = "abc"; *p; p++)
+    {
+        event = chafa_term_read_event (fake.term, 0);
+        g_assert (event != NULL);
+        g_assert_cmpint (chafa_event_get_type (event), ==, CHAFA_UNICHAR_EVENT);
+        g_assert_cmpint (chafa_event_get_unichar (event), ==, *p);
+        g_free (event);
+    }
+
+    g_assert (chafa_term_read_event (fake.term, 0) == NULL);
+
+    /* Hanging up yields EOF, after which input is no longer polled */
+    close (fake.peer_fd);
+    fake.peer_fd = -1;
+    iterate (fake.term, 1000);
+
+    event = chafa_term_read_event (fake.term, 0);
+    g_assert (event != NULL);
+    g_assert_cmpint (chafa_event_get_type (event), ==, CHAFA_EOF_EVENT);
+    g_free (event);
+
+    g_assert_cmpint (chafa_term_get_pollfds (fake.term, pollfds, 2, NULL), ==, 0);
+
+    fake_term_deinit (&fake, TRUE);
+}
+
+static void
+probe_test (void)
+{
+    FakeTerm fake;
+    ProbeResult result = { 0 };
+    ChafaEvent *event;
+    gint width, height;
+    gint i;
+
+    fake_term_init (&fake);
+
+    chafa_term_probe_async (fake.term, 5000, probe_cb, &result);
+
+    /* Wait for the queries to arrive */
+    for (i = 0; i < 100 && !strstr (fake.received->str, "\033[0c"); i++)
+    {
+        iterate (fake.term, 10);
+        fake_term_receive (&fake);
+    }
+
+    g_assert (strstr (fake.received->str, "\033[0c") != NULL);
+    g_assert (!result.done);
+    g_assert (!chafa_term_info_have_seq (chafa_term_get_term_info (fake.term),
+                                         CHAFA_TERM_SEQ_BEGIN_SIXELS));
+
+    /* Reply in pieces; the parser must put them back together */
+    fake_term_send (&fake, "\033[8;50;");
+    iterate (fake.term, 10);
+    fake_term_send (&fake, "132t\033[?62;4");
+    iterate (fake.term, 10);
+    g_assert (!result.done);
+    fake_term_send (&fake, ";22c");
+
+    for (i = 0; i < 100 && !result.done; i++)
+        iterate (fake.term, 10);
+
+    g_assert (result.done);
+    g_assert (result.success);
+
+    chafa_term_get_size_cells (fake.term, &width, &height);
+    g_assert_cmpint (width, ==, 132);
+    g_assert_cmpint (height, ==, 50);
+
+    /* The reply said we have sixels */
+    g_assert (chafa_term_info_have_seq (chafa_term_get_term_info (fake.term),
+                                        CHAFA_TERM_SEQ_BEGIN_SIXELS));
+
+    /* The replies are also available as events */
+    event = chafa_term_read_event (fake.term, 0);
+    g_assert (event != NULL);
+    g_assert_cmpint (chafa_event_get_seq (event), ==, CHAFA_TERM_SEQ_TEXT_AREA_SIZE_CELLS);
+    g_free (event);
+
+    fake_term_deinit (&fake, TRUE);
+}
+
+static void
+probe_timeout_test (void)
+{
+    FakeTerm fake;
+    ProbeResult result = { 0 };
+    gint64 start_time_us;
+    gint i;
+
+    fake_term_init (&fake);
+
+    start_time_us = g_get_monotonic_time ();
+    chafa_term_probe_async (fake.term, 50, probe_cb, &result);
+
+    /* The terminal never answers */
+    for (i = 0; i < 100 && !result.done; i++)
+    {
+        iterate (fake.term, 1000);
+        fake_term_receive (&fake);
+    }
+
+    g_assert (result.done);
+    g_assert (!result.success);
+    g_assert_cmpint (result.time_us - start_time_us, >=, 50000);
+    g_assert_cmpint (result.time_us - start_time_us, <, 2000000);
+
+    fake_term_deinit (&fake, TRUE);
+}
+
+typedef struct
+{
+    ChafaTerm *term;
+    gint n_events;
+}
+SourceState;
+
+static gboolean
+source_state_cb (gpointer user_data)
+{
+    SourceState *state = user_data;
+    ChafaEvent *event;
+
+    while ((event = chafa_term_read_event (state->term, 0)))
+    {
+        state->n_events++;
+        g_free (event);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+/* Drives the same exchange as probe_test from a GMainContext */
+static void
+source_test (void)
+{
+    FakeTerm fake;
+    ProbeResult result = { 0 };
+    SourceState state = { 0 };
+    GMainContext *context;
+    GSource *source;
+    gint i;
+
+    fake_term_init (&fake);
+    state.term = fake.term;
+
+    context = g_main_context_new ();
+    source = chafa_term_create_source (fake.term);
+    g_source_set_callback (source, source_state_cb, &state, NULL);
+    g_source_attach (source, context);
+
+    chafa_term_write (fake.term, "hello", 5);
+    chafa_term_probe_async (fake.term, 5000, probe_cb, &result);
+
+    for (i = 0; i < 100 && !strstr (fake.received->str, "\033[0c"); i++)
+    {
+        g_main_context_iteration (context, FALSE);
+        g_usleep (1000);
+        fake_term_receive (&fake);
+    }
+
+    g_assert (g_str_has_prefix (fake.received->str, "hello"));
+
+    fake_term_send (&fake, "x\033[?62;4c");
+
+    for (i = 0; i < 1000 && !result.done; i++)
+        g_main_context_iteration (context, TRUE);
+
+    g_assert (result.done);
+    g_assert (result.success);
+    g_assert_cmpint (state.n_events, ==, 2);
+
+    g_source_destroy (source);
+    g_source_unref (source);
+    g_main_context_unref (context);
+    fake_term_deinit (&fake, TRUE);
+}
+
+#endif
+
+int
+main (int argc, char *argv [])
+{
+    g_test_init (&argc, &argv, NULL);
+
+#ifdef G_OS_UNIX
+    g_test_add_func ("/term-async/write", write_test);
+    g_test_add_func ("/term-async/destroy", destroy_test);
+    g_test_add_func ("/term-async/events", events_test);
+    g_test_add_func ("/term-async/probe", probe_test);
+    g_test_add_func ("/term-async/probe-timeout", probe_timeout_test);
+    g_test_add_func ("/term-async/source", source_test);
+#endif
+
+    return g_test_run ();
+}
@@ -0,0 +1,347 @@
+#include "config.h"
+
+#include <chafa.h>
+#include <string.h>
+
+/* 10x5 cells of 8x16 pixels, i.e. an 80x80 canvas. The source is 40x20,
+ * so when fitted, it covers the canvas' upper half at half the canvas'
+ * resolution. With terminal-side scaling, the canvas is sent at 40x40 and
+ * the source is copied unscaled. */
+#define WIDTH_CELLS 10
+#define HEIGHT_CELLS 5
+#define CELL_WIDTH 8
+#define CELL_HEIGHT 16
+#define SRC_WIDTH 40
+#define SRC_HEIGHT 20
+#define PLACEMENT_ID 7
+
+static guint8 *
+gen_image (void)
+{
+    guint8 *pixels, *p;
+    gint x, y;
+
+    pixels = p = g_malloc (SRC_WIDTH * SRC_HEIGHT * 4);
+
+    for (y = 0; y < SRC_HEIGHT; y++)
+    {
+        for (x = 0; x < SRC_WIDTH; x++)
+        {
+            *(p++) = x * 6;
+            *(p++) = y * 12;
+            *(p++) = (x ^ y) * 4;
+            *(p++) = 0xff;
+        }
+    }
+
+    return pixels;
+}
+
+static ChafaTermInfo *
+create_term_info (const gchar *var)
+{
+    gchar *envp [] = { (gchar *) var, NULL };
+
+    return chafa_term_db_detect (chafa_term_db_get_default (), envp);
+}
+
+static ChafaCanvas *
+create_canvas (ChafaPixelMode pixel_mode, ChafaPassthrough passthrough,
+               gboolean terminal_scaling, gint max_width, gint max_height,
+               const guint8 *pixels, gint placement_id)
+{
+    ChafaCanvasConfig *config;
+    ChafaCanvas *canvas;
+    ChafaFrame *frame;
+    ChafaImage *image;
+    ChafaPlacement *placement;
+
+    config = chafa_canvas_config_new ();
+    chafa_canvas_config_set_pixel_mode (config, pixel_mode);
+    chafa_canvas_config_set_geometry (config, WIDTH_CELLS, HEIGHT_CELLS);
+    chafa_canvas_config_set_cell_geometry (config, CELL_WIDTH, CELL_HEIGHT);
+    chafa_canvas_config_set_passthrough (config, passthrough);
+    chafa_canvas_config_set_terminal_scaling_enabled (config, terminal_scaling);
+    chafa_canvas_config_set_terminal_scaling_max_size (config, max_width, max_height);
+    canvas = chafa_canvas_new (config);
+    chafa_canvas_config_unref (config);
+
+    frame = chafa_frame_new (pixels, CHAFA_PIXEL_RGBA8_UNASSOCIATED,
+                             SRC_WIDTH, SRC_HEIGHT, SRC_WIDTH * 4);
+    image = chafa_image_new ();
+    chafa_image_set_frame (image, frame);
+    placement = chafa_placement_new (image, placement_id);
+    chafa_placement_set_tuck (placement, CHAFA_TUCK_FIT);
+    chafa_canvas_set_placement (canvas, placement);
+
+    chafa_placement_unref (placement);
+    chafa_image_unref (image);
+    chafa_frame_unref (frame);
+    return canvas;
+}
+
+/* Concatenates the base64 chunks of a direct Kitty transmission */
+static GByteArray *
+decode_kitty_chunks (const gchar *out)
+{
+    GByteArray *data = g_byte_array_new ();
+    const gchar *p = out;
+
+    while ((p = strstr (p, "m=1;")))
+    {
+        gchar *b64;
+        guchar *chunk;
+        gsize len;
+
+        p += strlen ("m=1;");
+        b64 = g_strndup (p, strcspn (p, "\033"));
+        chunk = g_base64_decode (b64, &len);
+        g_byte_array_append (data, chunk, len);
+
+        g_free (chunk);
+        g_free (b64);
+    }
+
+    return data;
+}
+
+/* The scaler may round differently in linear light, even when copying */
+static void
+assert_pixels_close (const guint8 *data, const guint8 *expected, gint n_bytes)
+{
+    gint i;
+
+    for (i = 0; i < n_bytes; i++)
+        g_assert_cmpint (ABS (data [i] - expected [i]), <=, 1);
+}
+
+static gint
+count_str (const gchar *haystack, const gchar *needle)
+{
+    gint n = 0;
+
+    while ((haystack = strstr (haystack, needle)))
+    {
+        haystack += strlen (needle);
+        n++;
+    }
+
+    return n;
+}
+
+static void
+kitty_native_test (void)
+{
+    ChafaTermInfo *term_info;
+    ChafaCanvas *canvas;
+    GByteArray *data;
+    GString *gs;
+    guint8 *pixels = gen_image ();
+
+    term_info = create_term_info ("TERM=xterm-kitty");
+    canvas = create_canvas (CHAFA_PIXEL_MODE_KITTY, CHAFA_PASSTHROUGH_NONE,
+                            TRUE, 0, 0, pixels, PLACEMENT_ID);
+
+    /* Stored under the placement ID, then placed */
+    gs = chafa_canvas_print (canvas, term_info);
+    g_assert (strstr (gs->str, "\033_Ga=t,q=2,f=32,s=40,v=40,i=7,m=1\033\\") == gs->str);
+    g_assert (g_str_has_suffix (gs->str, "\033_Ga=p,q=2,i=7,c=10,r=5\033\\"));
+
+    data = decode_kitty_chunks (gs->str);
+    g_assert_cmpuint (data->len, ==, 40 * 40 * 4);
+    assert_pixels_close (data->data, pixels, SRC_WIDTH * SRC_HEIGHT * 4);
+    g_byte_array_free (data, TRUE);
+    g_string_free (gs, TRUE);
+
+    /* Showing it at another size doesn't send it again */
+    gs = chafa_canvas_print_placement (canvas, term_info, 20, 10);
+    g_assert_cmpstr (gs->str, ==, "\033_Ga=p,q=2,i=7,c=20,r=10\033\\");
+    g_string_free (gs, TRUE);
+
+    gs = chafa_canvas_print_placement (canvas, term_info, 3, 2);
+    g_assert_cmpstr (gs->str, ==, "\033_Ga=p,q=2,i=7,c=3,r=2\033\\");
+    g_string_free (gs, TRUE);
+
+    chafa_canvas_unref (canvas);
+    chafa_term_info_unref (term_info);
+    g_free (pixels);
+}
+
+static void
+kitty_max_size_test (void)
+{
+    ChafaTermInfo *term_info;
+    ChafaCanvas *canvas;
+    GByteArray *data;
+    GString *gs;
+    guint8 *pixels = gen_image ();
+
+    term_info = create_term_info ("TERM=xterm-kitty");
+
+    canvas = create_canvas (CHAFA_PIXEL_MODE_KITTY, CHAFA_PASSTHROUGH_NONE,
+                            TRUE, 16, 0, pixels, PLACEMENT_ID);
+    gs = chafa_canvas_print (canvas, term_info);
+    g_assert (strstr (gs->str, "s=16,v=16,i=7,") != NULL);
+
+    data = decode_kitty_chunks (gs->str);
+    g_assert_cmpuint (data->len, ==, 16 * 16 * 4);
+    g_byte_array_free (data, TRUE);
+    g_string_free (gs, TRUE);
+    chafa_canvas_unref (canvas);
+
+    /* Both limits apply, and the aspect is kept */
+    canvas = create_canvas (CHAFA_PIXEL_MODE_KITTY, CHAFA_PASSTHROUGH_NONE,
+                            TRUE, 100, 10, pixels, PLACEMENT_ID);
+    gs = chafa_canvas_print (canvas, term_info);
+    g_assert (strstr (gs->str, "s=10,v=10,i=7,") != NULL);
+    g_string_free (gs, TRUE);
+    chafa_canvas_unref (canvas);
+
+    chafa_term_info_unref (term_info);
+    g_free (pixels);
+}
+
+static void
+kitty_virtual_test (void)
+{
+    ChafaTermInfo *term_info;
+    ChafaCanvas *canvas;
+    GString *gs;
+    guint8 *pixels = gen_image ();
+    gchar placeholder [8];
+
+    placeholder [g_unichar_to_utf8 (0x10eeee, placeholder)] = '\0';
+
+    term_info = create_term_info ("TERM=xterm-kitty");
+    chafa_term_info_set_seq (term_info, CHAFA_TERM_SEQ_BEGIN_TMUX_PASSTHROUGH, "\033Ptmux;", NULL);
+    chafa_term_info_set_seq (term_info, CHAFA_TERM_SEQ_END_TMUX_PASSTHROUGH, "\033\\", NULL);
+
+    canvas = create_canvas (CHAFA_PIXEL_MODE_KITTY, CHAFA_PASSTHROUGH_TMUX,
+                            TRUE, 0, 0, pixels, PLACEMENT_ID);
+
+    gs = chafa_canvas_print (canvas, term_info);
+    g_assert (strstr (gs->str, "a=T,U=1,q=2,f=32,s=40,v=40,c=10,r=5,i=7,") != NULL);
+    g_assert_cmpint (count_str (gs->str, placeholder), ==, 10 * 5);
+    g_string_free (gs, TRUE);
+
+    /* New virtual placement and placeholders only */
+    gs = chafa_canvas_print_placement (canvas, term_info, 20, 10);
+    g_assert (g_str_has_prefix (gs->str, "\033Ptmux;\033\033_Ga=p,U=1,q=2,i=7,c=20,r=10\033\033\\\033\\"));
+    g_assert (strstr (gs->str, "a=T") == NULL);
+    g_assert (strstr (gs->str, "m=1") == NULL);
+    g_assert_cmpint (count_str (gs->str, placeholder), ==, 20 * 10);
+    g_string_free (gs, TRUE);
+
+    chafa_canvas_unref (canvas);
+    chafa_term_info_unref (term_info);
+    g_free (pixels);
+}
+
+/* Without an ID to refer back to, the image must be sent again, but it's
+ * the same image */
+static void
+kitty_no_id_test (void)
+{
+    ChafaTermInfo *term_info;
+    ChafaCanvas *canvas;
+    GByteArray *data, *data2;
+    GString *gs, *gs2;
+    guint8 *pixels = gen_image ();
+
+    term_info = create_term_info ("TERM=xterm-kitty");
+    canvas = create_canvas (CHAFA_PIXEL_MODE_KITTY, CHAFA_PASSTHROUGH_NONE,
+                            TRUE, 0, 0, pixels, -1);
+
+    gs = chafa_canvas_print (canvas, term_info);
+    g_assert (g_str_has_prefix (gs->str, "\033_Ga=T,f=32,s=40,v=40,c=10,r=5,m=1\033\\"));
+    gs2 = chafa_canvas_print_placement (canvas, term_info, 20, 10);
+    g_assert (g_str_has_prefix (gs2->str, "\033_Ga=T,f=32,s=40,v=40,c=20,r=10,m=1\033\\"));
+
+    data = decode_kitty_chunks (gs->str);
+    data2 = decode_kitty_chunks (gs2->str);
+    g_assert_cmpuint (data->len, ==, data2->len);
+    g_assert (memcmp (data->data, data2->data, data->len) == 0);
+
+    g_byte_array_free (data2, TRUE);
+    g_byte_array_free (data, TRUE);
+    g_string_free (gs2, TRUE);
+    g_string_free (gs, TRUE);
+    chafa_canvas_unref (canvas);
+    chafa_term_info_unref (term_info);
+    g_free (pixels);
+}
+
+static void
+iterm2_test (void)
+{
+    ChafaTermInfo *term_info;
+    ChafaCanvas *canvas;
+    GString *gs, *gs2;
+    const gchar *payload, *payload2;
+    guint8 *pixels = gen_image ();
+
+    term_info = create_term_info ("LC_TERMINAL=iTerm2");
+    canvas = create_canvas (CHAFA_PIXEL_MODE_ITERM2, CHAFA_PASSTHROUGH_NONE,
+                            TRUE, 0, 0, pixels, PLACEMENT_ID);
+
+    gs = chafa_canvas_print (canvas, term_info);
+    g_assert (strstr (gs->str, "width=10;height=5;") != NULL);
+    gs2 = chafa_canvas_print_placement (canvas, term_info, 20, 10);
+    g_assert (strstr (gs2->str, "width=20;height=10;") != NULL);
+
+    /* The same 40x40 TIFF both times; its header is followed by the pixels */
+    payload = strchr (gs->str, ':');
+    payload2 = strchr (gs2->str, ':');
+    g_assert (payload != NULL && payload2 != NULL);
+    g_assert_cmpstr (payload, ==, payload2);
+    g_assert_cmpuint (strlen (payload), >, (40 * 40 * 4) * 4 / 3);
+    g_assert_cmpuint (strlen (payload), <, (80 * 80 * 4) * 4 / 3);
+
+    g_string_free (gs2, TRUE);
+    g_string_free (gs, TRUE);
+    chafa_canvas_unref (canvas);
+    chafa_term_info_unref (term_info);
+    g_free (pixels);
+}
+
+/* Without terminal-side scaling, the canvas is sent at its own size, and
+ * there's nothing to place */
+static void
+disabled_test (void)
+{
+    ChafaTermInfo *term_info;
+    ChafaCanvas *canvas;
+    GString *gs;
+    guint8 *pixels = gen_image ();
+
+    term_info = create_term_info ("TERM=xterm-kitty");
+    canvas = create_canvas (CHAFA_PIXEL_MODE_KITTY, CHAFA_PASSTHROUGH_NONE,
+                            FALSE, 0, 0, pixels, PLACEMENT_ID);
+
+    gs = chafa_canvas_print (canvas, term_info);
+    g_assert (g_str_has_prefix (gs->str, "\033_Ga=T,f=32,s=80,v=80,c=10,r=5,m=1\033\\"));
+    g_string_free (gs, TRUE);
+
+    gs = chafa_canvas_print_placement (canvas, term_info, 20, 10);
+    g_assert_cmpstr (gs->str, ==, "");
+    g_string_free (gs, TRUE);
+
+    chafa_canvas_unref (canvas);
+    chafa_term_info_unref (term_info);
+    g_free (pixels);
+}
+
+int
+main (int argc, char *argv [])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/terminal-scaling/kitty-native", kitty_native_test);
+    g_test_add_func ("/terminal-scaling/kitty-max-size", kitty_max_size_test);
+    g_test_add_func ("/terminal-scaling/kitty-virtual", kitty_virtual_test);
+    g_test_add_func ("/terminal-scaling/kitty-no-id", kitty_no_id_test);
+    g_test_add_func ("/terminal-scaling/iterm2", iterm2_test);
+    g_test_add_func ("/terminal-scaling/disabled", disabled_test);
+
+    return g_test_run ();
+}
@@ -0,0 +1,244 @@
+#include "config.h"
+
+#ifdef HAVE_SCHED_GETCPU
+# include <sched.h>
+#endif
+
+#include <chafa.h>
+#include "internal/chafa-batch.h"
+
+#define N_ROUNDS 3
+#define MAX_CPUS 8
+
+#if defined (HAVE_PTHREAD_SETAFFINITY_NP) && defined (HAVE_SCHED_GETAFFINITY) && defined (HAVE_SCHED_GETCPU)
+
+typedef struct
+{
+    gint *cpus;
+}
+RunCtx;
+
+/* One row per batch, so first_row is the batch index */
+static void
+record_cpu_func (gpointer data, gpointer user_data)
+{
+    ChafaBatchInfo *batch = data;
+    RunCtx *ctx = user_data;
+
+    ctx->cpus [batch->first_row] = sched_getcpu ();
+}
+
+static gint
+get_allowed_cpus (gint *cpus_out, gint max_cpus)
+{
+    cpu_set_t set;
+    gint n = 0, i;
+
+    g_assert (sched_getaffinity (0, sizeof (set), &set) == 0);
+
+    for (i = 0; i < CPU_SETSIZE && n < max_cpus; i++)
+    {
+        if (CPU_ISSET (i, &set))
+            cpus_out [n++] = i;
+    }
+
+    return n;
+}
+
+/* Checks that batch i runs on expected_cpus [i % n_threads], also over
+ * consecutive runs */
+static void
+check_placement (gint n_threads, const gint *expected_cpus)
+{
+    gint n_batches = n_threads * 2;
+    gint cpus [MAX_CPUS * 2];
+    RunCtx ctx = { cpus };
+    gint round, i;
+
+    chafa_set_n_threads (n_threads);
+
+    for (round = 0; round < N_ROUNDS; round++)
+    {
+        for (i = 0; i < n_batches; i++)
+            cpus [i] = -1;
+
+        chafa_process_batches (&ctx, record_cpu_func, NULL, n_batches, n_batches, 1);
+
+        for (i = 0; i < n_batches; i++)
+            g_assert_cmpint (cpus [i], ==, expected_cpus [i % n_threads]);
+    }
+}
+
+static void
+explicit_test (void)
+{
+    gint allowed [MAX_CPUS], list [MAX_CPUS];
+    gint n_allowed, i;
+
+    n_allowed = get_allowed_cpus (allowed, MAX_CPUS);
+
+    /* Reversed, so the order of the list is what matters */
+    for (i = 0; i < n_allowed; i++)
+        list [i] = allowed [n_allowed - 1 - i];
+
+    chafa_set_thread_affinity_policy (CHAFA_THREAD_AFFINITY_EXPLICIT, list, n_allowed);
+    g_assert_cmpint (chafa_get_thread_affinity_policy (), ==, CHAFA_THREAD_AFFINITY_EXPLICIT);
+
+    /* Use at least two threads so we get workers, even on a single CPU */
+    if (n_allowed >= 2)
+        check_placement (n_allowed, list);
+    else
+    {
+        gint two [2] = { list [0], list [0] };
+        check_placement (2, two);
+    }
+
+    chafa_set_thread_affinity_policy (CHAFA_THREAD_AFFINITY_NONE, NULL, 0);
+    chafa_set_n_threads (-1);
+}
+
+static void
+compact_test (void)
+{
+    gint allowed [MAX_CPUS];
+    gint n_allowed;
+
+    n_allowed = get_allowed_cpus (allowed, MAX_CPUS);
+    if (n_allowed < 2)
+    {
+        g_test_skip ("Needs at least two CPUs");
+        return;
+    }
+
+    chafa_set_thread_affinity_policy (CHAFA_THREAD_AFFINITY_COMPACT, NULL, 0);
+    check_placement (n_allowed, allowed);
+
+    chafa_set_thread_affinity_policy (CHAFA_THREAD_AFFINITY_NONE, NULL, 0);
+    chafa_set_n_threads (-1);
+}
+
+static void
+scatter_test (void)
+{
+    gint allowed [CPU_SETSIZE];
+    gint expected [2];
+    gint n_allowed;
+
+    n_allowed = get_allowed_cpus (allowed, CPU_SETSIZE);
+    if (n_allowed < 4)
+    {
+        g_test_skip ("Needs at least four CPUs");
+        return;
+    }
+
+    /* Two workers are spread evenly: the first CPU, then the one halfway
+     * down the list */
+    expected [0] = allowed [0];
+    expected [1] = allowed [n_allowed / 2];
+
+    chafa_set_n_threads (2);
+    chafa_set_thread_affinity_policy (CHAFA_THREAD_AFFINITY_SCATTER, NULL, 0);
+    check_placement (2, expected);
+
+    chafa_set_thread_affinity_policy (CHAFA_THREAD_AFFINITY_NONE, NULL, 0);
+    chafa_set_n_threads (-1);
+}
+
+/* Checks the mapping while another thread is running batches too. It used
+ * to depend on how many threads each call could get. */
+static gpointer
+concurrent_thread_func (gpointer data)
+{
+    const gint *list = data;
+
+    check_placement (2, list);
+    return NULL;
+}
+
+static void
+concurrent_test (void)
+{
+    gint allowed [MAX_CPUS], list [2];
+    GThread *threads [2];
+    gint n_allowed, i;
+
+    n_allowed = get_allowed_cpus (allowed, MAX_CPUS);
+    list [0] = allowed [n_allowed - 1];
+    list [1] = allowed [0];
+
+    chafa_set_n_threads (2);
+    chafa_set_thread_affinity_policy (CHAFA_THREAD_AFFINITY_EXPLICIT, list, 2);
+
+    for (i = 0; i < 2; i++)
+        threads [i] = g_thread_new ("caller", concurrent_thread_func, list);
+    for (i = 0; i < 2; i++)
+        g_thread_join (threads [i]);
+
+    chafa_set_thread_affinity_policy (CHAFA_THREAD_AFFINITY_NONE, NULL, 0);
+    chafa_set_n_threads (-1);
+}
+
+static gint
+count_threads (void)
+{
+    GDir *dir;
+    gint n = 0;
+
+    dir = g_dir_open ("/proc/self/task", 0, NULL);
+    if (!dir)
+        return -1;
+
+    while (g_dir_read_name (dir))
+        n++;
+
+    g_dir_close (dir);
+    return n;
+}
+
+static void
+shutdown_test (void)
+{
+    gint cpus [2] = { -1, -1 };
+    RunCtx ctx = { cpus };
+    gint n_before;
+
+    n_before = count_threads ();
+    if (n_before < 0)
+    {
+        g_test_skip ("Needs /proc/self/task");
+        return;
+    }
+
+    chafa_set_n_threads (2);
+    chafa_set_thread_affinity_policy (CHAFA_THREAD_AFFINITY_COMPACT, NULL, 0);
+    chafa_process_batches (&ctx, record_cpu_func, NULL, 2, 2, 1);
+    g_assert_cmpint (count_threads (), ==, n_before + 2);
+
+    /* A new thread count replaces the workers */
+    chafa_set_n_threads (3);
+    chafa_process_batches (&ctx, record_cpu_func, NULL, 2, 2, 1);
+    g_assert_cmpint (count_threads (), ==, n_before + 3);
+
+    chafa_set_thread_affinity_policy (CHAFA_THREAD_AFFINITY_NONE, NULL, 0);
+    g_assert_cmpint (count_threads (), ==, n_before);
+
+    chafa_set_n_threads (-1);
+}
+
+#endif
+
+int
+main (int argc, char *argv [])
+{
+    g_test_init (&argc, &argv, NULL);
+
+#if defined (HAVE_PTHREAD_SETAFFINITY_NP) && defined (HAVE_SCHED_GETAFFINITY) && defined (HAVE_SCHED_GETCPU)
+    g_test_add_func ("/thread-affinity/explicit", explicit_test);
+    g_test_add_func ("/thread-affinity/compact", compact_test);
+    g_test_add_func ("/thread-affinity/scatter", scatter_test);
+    g_test_add_func ("/thread-affinity/concurrent", concurrent_test);
+    g_test_add_func ("/thread-affinity/shutdown", shutdown_test);
+#endif
+
+    return g_test_run ();
+}
@@ -0,0 +1,161 @@
+#include "config.h"
+
+#include <chafa.h>
+#include "internal/chafa-canvas-internal.h"
+
+#define WIDTH_CELLS 40
+#define HEIGHT_CELLS 20
+#define SRC_WIDTH 160
+#define SRC_HEIGHT 160
+
+/* Opaque discs with soft edges on a clear background, and a faint haze
+ * below the alpha threshold in one corner */
+static guint8 *
+gen_image (gint seed)
+{
+    guint8 *pixels, *p;
+    gint x, y;
+
+    pixels = p = g_malloc (SRC_WIDTH * SRC_HEIGHT * 4);
+
+    for (y = 0; y < SRC_HEIGHT; y++)
+    {
+        for (x = 0; x < SRC_WIDTH; x++)
+        {
+            gint d0, d1, a;
+
+            d0 = (x - 50 - seed * 7) * (x - 50 - seed * 7) + (y - 60) * (y - 60);
+            d1 = (x - 120) * (x - 120) + (y - 110 + seed * 5) * (y - 110 + seed * 5);
+
+            if (d0 < 30 * 30 || d1 < 20 * 20)
+                a = 0xff;
+            else if (d0 < 36 * 36 || d1 < 26 * 26)
+                a = 0x90 + ((x * 13 + y * 7) % 0x60);
+            else if (x < 40 && y > 120)
+                a = (x + y) % 0x60;
+            else
+                a = 0;
+
+            *(p++) = (x * 3 + seed * 40) & 0xff;
+            *(p++) = (y * 2) & 0xff;
+            *(p++) = ((x ^ y) * 5) & 0xff;
+            *(p++) = a;
+        }
+    }
+
+    return pixels;
+}
+
+static gchar *
+render (ChafaCanvasConfig *config, const guint8 *pixels, gboolean cull)
+{
+    ChafaCanvas *canvas;
+    gchar *str;
+
+    canvas = chafa_canvas_new (config);
+    if (!cull)
+        canvas->cull_transparent_cells = FALSE;
+
+    chafa_canvas_draw_all_pixels (canvas, CHAFA_PIXEL_RGBA8_UNASSOCIATED,
+                                  pixels, SRC_WIDTH, SRC_HEIGHT, SRC_WIDTH * 4);
+    str = g_string_free (chafa_canvas_print (canvas, NULL), FALSE);
+
+    chafa_canvas_unref (canvas);
+    return str;
+}
+
+static void
+check_config (ChafaCanvasMode canvas_mode, ChafaDitherMode dither_mode,
+              ChafaColorSpace color_space, const gchar *selectors, gfloat work_factor)
+{
+    ChafaCanvasConfig *config;
+    ChafaSymbolMap *symbol_map;
+    gint seed;
+
+    symbol_map = chafa_symbol_map_new ();
+    chafa_symbol_map_apply_selectors (symbol_map, selectors, NULL);
+
+    config = chafa_canvas_config_new ();
+    chafa_canvas_config_set_geometry (config, WIDTH_CELLS, HEIGHT_CELLS);
+    chafa_canvas_config_set_canvas_mode (config, canvas_mode);
+    chafa_canvas_config_set_dither_mode (config, dither_mode);
+    chafa_canvas_config_set_color_space (config, color_space);
+    chafa_canvas_config_set_symbol_map (config, symbol_map);
+    chafa_canvas_config_set_work_factor (config, work_factor);
+
+    for (seed = 0; seed < 3; seed++)
+    {
+        guint8 *pixels = gen_image (seed);
+        gchar *str_full, *str_culled;
+
+        str_full = render (config, pixels, FALSE);
+        str_culled = render (config, pixels, TRUE);
+        g_assert_cmpstr (str_culled, ==, str_full);
+
+        g_free (str_full);
+        g_free (str_culled);
+        g_free (pixels);
+    }
+
+    chafa_canvas_config_unref (config);
+    chafa_symbol_map_unref (symbol_map);
+}
+
+static void
+modes_test (void)
+{
+    static const ChafaCanvasMode modes [] =
+    {
+        CHAFA_CANVAS_MODE_TRUECOLOR,
+        CHAFA_CANVAS_MODE_INDEXED_256,
+        CHAFA_CANVAS_MODE_INDEXED_240,
+        CHAFA_CANVAS_MODE_INDEXED_16,
+        CHAFA_CANVAS_MODE_INDEXED_16_8,
+        CHAFA_CANVAS_MODE_INDEXED_8,
+        CHAFA_CANVAS_MODE_FGBG_BGFG,
+        CHAFA_CANVAS_MODE_FGBG
+    };
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (modes); i++)
+    {
+        check_config (modes [i], CHAFA_DITHER_MODE_NONE, CHAFA_COLOR_SPACE_RGB,
+                      "block+border+space", 0.5f);
+        check_config (modes [i], CHAFA_DITHER_MODE_NONE, CHAFA_COLOR_SPACE_RGB,
+                      "block+border+space", 1.0f);
+    }
+}
+
+static void
+dither_test (void)
+{
+    check_config (CHAFA_CANVAS_MODE_INDEXED_256, CHAFA_DITHER_MODE_ORDERED,
+                  CHAFA_COLOR_SPACE_RGB, "block+border+space", 1.0f);
+    check_config (CHAFA_CANVAS_MODE_INDEXED_16, CHAFA_DITHER_MODE_DIFFUSION,
+                  CHAFA_COLOR_SPACE_RGB, "block+border+space", 1.0f);
+    check_config (CHAFA_CANVAS_MODE_INDEXED_240, CHAFA_DITHER_MODE_NOISE,
+                  CHAFA_COLOR_SPACE_DIN99D, "block+border+space", 0.5f);
+}
+
+static void
+symbols_test (void)
+{
+    check_config (CHAFA_CANVAS_MODE_TRUECOLOR, CHAFA_DITHER_MODE_NONE,
+                  CHAFA_COLOR_SPACE_RGB, "all-wide", 1.0f);
+    check_config (CHAFA_CANVAS_MODE_INDEXED_256, CHAFA_DITHER_MODE_NONE,
+                  CHAFA_COLOR_SPACE_RGB, "braille+ascii", 0.5f);
+    check_config (CHAFA_CANVAS_MODE_INDEXED_16_8, CHAFA_DITHER_MODE_NONE,
+                  CHAFA_COLOR_SPACE_RGB, "vhalf", 1.0f);
+}
+
+int
+main (int argc, char *argv [])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/transparent-cells/modes", modes_test);
+    g_test_add_func ("/transparent-cells/dither", dither_test);
+    g_test_add_func ("/transparent-cells/symbols", symbols_test);
+
+    return g_test_run ();
+}
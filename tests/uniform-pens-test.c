@@ -0,0 +1,167 @@
+#include "config.h"
+
+#include <chafa.h>
+
+#define WIDTH_CELLS 40
+#define HEIGHT_CELLS 20
+#define SRC_WIDTH 160
+#define SRC_HEIGHT 160
+
+/* Enough for the adaptive symbol search to start using its hot symbols */
+#define N_FRAMES 24
+
+/* Flat areas in palette-ish colors, a slow gradient and a noisy band, so
+ * cells fall both within one pen and across several */
+static guint8 *
+gen_image (gint seed)
+{
+    guint8 *pixels, *p;
+    GRand *rand;
+    gint x, y;
+
+    rand = g_rand_new_with_seed (seed);
+    pixels = p = g_malloc (SRC_WIDTH * SRC_HEIGHT * 4);
+
+    for (y = 0; y < SRC_HEIGHT; y++)
+    {
+        for (x = 0; x < SRC_WIDTH; x++)
+        {
+            gint r, g, b;
+
+            if (y < 50)
+            {
+                r = (x / 40) & 1 ? 0xe0 : 0x10;
+                g = (x / 40) & 2 ? 0xe0 : 0x10;
+                b = seed & 1 ? 0xc0 : 0x20;
+            }
+            else if (y < 110)
+            {
+                r = x + seed * 30;
+                g = y;
+                b = 0x80;
+            }
+            else
+            {
+                r = g_rand_int_range (rand, 0, 256);
+                g = g_rand_int_range (rand, 0, 256);
+                b = (x * 7 + y * 3) & 0xff;
+            }
+
+            *(p++) = CLAMP (r, 0, 255);
+            *(p++) = CLAMP (g, 0, 255);
+            *(p++) = CLAMP (b, 0, 255);
+            *(p++) = 0xff;
+        }
+    }
+
+    g_rand_free (rand);
+    return pixels;
+}
+
+/* Returns a checksum of the printed frames */
+static gchar *
+print_frames (ChafaCanvasConfig *config)
+{
+    ChafaCanvas *canvas;
+    GString *printed;
+    gchar *checksum;
+    gint i;
+
+    canvas = chafa_canvas_new (config);
+    printed = g_string_new ("");
+
+    for (i = 0; i < N_FRAMES; i++)
+    {
+        guint8 *pixels = gen_image (i);
+        GString *gs;
+
+        chafa_canvas_draw_all_pixels (canvas, CHAFA_PIXEL_RGBA8_UNASSOCIATED,
+                                      pixels, SRC_WIDTH, SRC_HEIGHT, SRC_WIDTH * 4);
+        gs = chafa_canvas_print (canvas, NULL);
+        g_string_append (printed, gs->str);
+
+        g_string_free (gs, TRUE);
+        g_free (pixels);
+    }
+
+    checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, printed->str, printed->len);
+
+    g_string_free (printed, TRUE);
+    chafa_canvas_unref (canvas);
+    return checksum;
+}
+
+typedef struct
+{
+    ChafaCanvasMode canvas_mode;
+    const gchar *selectors;
+    const gchar *checksum;
+}
+PinnedOutput;
+
+/* Output of the pen pair search, including for cells within one pen, where
+ * every symbol ties and the foreground color of blank cells gets printed
+ * too. The pen pair search is only used with the exhaustive search, which
+ * starts with the hot symbols once enough frames have been seen. */
+static const PinnedOutput pinned_outputs [] =
+{
+    { CHAFA_CANVAS_MODE_INDEXED_16, "block+border+space",
+      "50ad984eb18fd7cb12c65b2f9c3dea09d70ecff1" },
+    { CHAFA_CANVAS_MODE_INDEXED_16, "all",
+      "cbabceea6ebffd4c07f8970ead4faee990c58550" },
+    { CHAFA_CANVAS_MODE_INDEXED_16_8, "block+border+space",
+      "5db1089a3803cb57005f751d280ec2ea9e11ae07" },
+    { CHAFA_CANVAS_MODE_INDEXED_16_8, "braille+ascii",
+      "c815e1d3c1e8b9f1640133a9db7c34b18aaf9155" },
+    { CHAFA_CANVAS_MODE_INDEXED_8, "block+border+space",
+      "c6a18756824884b7c289a8e9c4125f3be93a2bff" },
+    { CHAFA_CANVAS_MODE_INDEXED_8, "braille+ascii",
+      "806aba313ba20d880c8374ac40b4c4dabf7dcd9e" }
+};
+
+static void
+check_pinned (const PinnedOutput *pinned)
+{
+    ChafaCanvasConfig *config;
+    ChafaSymbolMap *symbol_map;
+    gchar *checksum;
+
+    symbol_map = chafa_symbol_map_new ();
+    chafa_symbol_map_apply_selectors (symbol_map, pinned->selectors, NULL);
+
+    config = chafa_canvas_config_new ();
+    chafa_canvas_config_set_geometry (config, WIDTH_CELLS, HEIGHT_CELLS);
+    chafa_canvas_config_set_canvas_mode (config, pinned->canvas_mode);
+    chafa_canvas_config_set_color_space (config, CHAFA_COLOR_SPACE_RGB);
+    chafa_canvas_config_set_dither_mode (config, CHAFA_DITHER_MODE_NONE);
+    chafa_canvas_config_set_preprocessing_enabled (config, FALSE);
+    chafa_canvas_config_set_symbol_map (config, symbol_map);
+    chafa_canvas_config_set_work_factor (config, 1.0f);
+    chafa_canvas_config_set_adaptive_symbols_enabled (config, TRUE);
+
+    checksum = print_frames (config);
+    g_assert_cmpstr (checksum, ==, pinned->checksum);
+
+    g_free (checksum);
+    chafa_canvas_config_unref (config);
+    chafa_symbol_map_unref (symbol_map);
+}
+
+static void
+pinned_test (void)
+{
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (pinned_outputs); i++)
+        check_pinned (&pinned_outputs [i]);
+}
+
+int
+main (int argc, char *argv [])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/uniform-pens/pinned", pinned_test);
+
+    return g_test_run ();
+}
@@ -38,11 +38,14 @@
 
 #include <chafa.h>
 #include "chicle-font-loader.h"
+#include "chicle-frame-pipeline.h"
 #include "chicle-grid-layout.h"
 #include "chicle-media-pipeline.h"
 #include "chicle-options.h"
 #include "chicle-path-queue.h"
 #include "chicle-placement-counter.h"
+#include "chicle-rate-control.h"
+#include "chicle-recording.h"
 #include "chicle-util.h"
 
 /* Include after glib.h for G_OS_WIN32 */
@@ -68,6 +71,7 @@ extern int _CRT_glob = 1;
 
 static volatile sig_atomic_t interrupted_by_user = FALSE;
 static ChiclePlacementCounter *placement_counter;
+static ChicleRecorder *recorder;
 
 #ifdef HAVE_TERMIOS_H
 static struct termios saved_termios;
@@ -430,6 +434,77 @@ write_image (GString **gsa, gint dest_width)
     }
 }
 
+static gsize
+get_gstring_array_len (GString **gsa)
+{
+    gsize len = 0;
+    gint i;
+
+    for (i = 0; gsa [i]; i++)
+        len += gsa [i]->len;
+
+    return len;
+}
+
+static void
+print_frame (const gchar *path, GString **gsa, gint dest_width, gint dest_height,
+             gboolean is_first_file, gboolean is_first_frame, gboolean is_animation,
+             gboolean sync_updates)
+{
+    /* The previous frame may still be draining in the writer thread;
+     * we rendered this one in the meantime. Wait for it to finish so
+     * we never have more than one frame queued up. */
+    if (is_animation)
+        chafa_term_flush (term);
+
+    if (sync_updates)
+        chafa_term_print_seq (term, CHAFA_TERM_SEQ_BEGIN_SYNCHRONIZED_UPDATE, -1);
+
+    write_image_prologue (path, is_first_file, is_first_frame, is_animation, dest_height);
+    write_image (gsa, dest_width);
+
+    /* No inter-frame epilogue in animations; this prevents unwanted
+     * scrolling when we get the sixel overshoot quirk wrong (#255). */
+    if (!is_animation)
+        write_image_epilogue (path, is_animation, dest_width);
+
+    if (sync_updates)
+        chafa_term_print_seq (term, CHAFA_TERM_SEQ_END_SYNCHRONIZED_UPDATE, -1);
+
+    if (!is_animation)
+        chafa_term_flush (term);
+}
+
+static gdouble
+get_frame_interval_ms (gint delay_ms)
+{
+    gdouble interval_ms;
+
+    if (options.anim_fps > 0.0)
+        interval_ms = 1000.0 / options.anim_fps;
+    else
+        interval_ms = delay_ms;
+
+    return interval_ms / options.anim_speed_multiplier;
+}
+
+/* Sleep for the remainder of the frame interval */
+static void
+wait_for_next_frame (GTimer *timer, gdouble interval_ms, gint delay_ms,
+                     gdouble *anim_elapsed_s)
+{
+    gdouble elapsed_ms, remain_ms;
+
+    /* Account for time spent converting and printing frame */
+    elapsed_ms = g_timer_elapsed (timer, NULL) * 1000.0;
+    remain_ms = MAX (interval_ms - elapsed_ms, 0);
+
+    if (remain_ms > 0.0001 && 1000.0 / (gdouble) remain_ms < CHICLE_ANIM_FPS_MAX)
+        interruptible_usleep (remain_ms * 1000.0);
+
+    *anim_elapsed_s += MAX (elapsed_ms, delay_ms) / 1000.0;
+}
+
 static ChafaCanvasConfig *
 build_config (gint dest_width, gint dest_height, gboolean is_animation)
 {
@@ -449,6 +524,12 @@ build_config (gint dest_width, gint dest_height, gboolean is_animation)
     chafa_canvas_config_set_preprocessing_enabled (config, options.preprocess);
     chafa_canvas_config_set_fg_only_enabled (config, options.fg_only);
     chafa_canvas_config_set_passthrough (config, options.passthrough);
+    chafa_canvas_config_set_kitty_transport (config, options.kitty_transport);
+    chafa_canvas_config_set_terminal_scaling_enabled (config, options.terminal_scaling);
+    chafa_canvas_config_set_terminal_scaling_max_size (config,
+                                                       options.terminal_scaling_max_width,
+                                                       options.terminal_scaling_max_height);
+    chafa_canvas_config_set_color_merge_threshold (config, options.color_merge_threshold);
 
     /* With Kitty and sixels, animation frames should have an opaque background.
      * Otherwise, previous frames will show through transparent areas. */
@@ -471,24 +552,88 @@ build_config (gint dest_width, gint dest_height, gboolean is_animation)
     chafa_canvas_config_set_work_factor (config, (options.work_factor - 1) / 8.0f);
 
     chafa_canvas_config_set_optimizations (config, options.optimizations);
+
+    /* Successive frames tend to use the same symbols. This only pays off
+     * if the canvas is kept between frames; see build_frame_canvas (). */
+    if (is_animation)
+        chafa_canvas_config_set_adaptive_symbols_enabled (config, TRUE);
+
     return config;
 }
 
-static ChafaCanvas *
-build_canvas (ChafaPixelType pixel_type, const guint8 *pixels,
+/* Sixels can only use the source palette if the image is placed without
+ * scaling, which is decided like in chafa_tuck_and_align (). Checking up
+ * front spares the loader from indexing frames that can't use it. */
+static gboolean
+can_use_source_palette (const ChafaCanvasConfig *config,
+                        gint src_width, gint src_height, ChafaTuck tuck)
+{
+    gint width_cells, height_cells;
+    gint cell_width_px, cell_height_px;
+    gint width_px, height_px;
+
+    if (chafa_canvas_config_get_pixel_mode (config) != CHAFA_PIXEL_MODE_SIXELS
+        || chafa_canvas_config_get_canvas_mode (config) != CHAFA_CANVAS_MODE_TRUECOLOR)
+        return FALSE;
+
+    chafa_canvas_config_get_geometry (config, &width_cells, &height_cells);
+    chafa_canvas_config_get_cell_geometry (config, &cell_width_px, &cell_height_px);
+    width_px = width_cells * cell_width_px;
+    height_px = height_cells * cell_height_px;
+
+    if (src_width > width_px || src_height > height_px)
+        return FALSE;
+
+    switch (tuck)
+    {
+        case CHAFA_TUCK_STRETCH:
+            return src_width == width_px && src_height == height_px;
+        case CHAFA_TUCK_FIT:
+            /* Fitting leaves the size alone only if it fills one dimension */
+            return src_width == width_px || src_height == height_px;
+        case CHAFA_TUCK_SHRINK_TO_FIT:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+/* If copy_pixels is set, the placement gets its own copy of the pixels, so
+ * it can be drawn after the source buffer has been reused. The pixels are
+ * the current frame of media_loader, if any. */
+static ChafaPlacement *
+build_placement (ChafaPixelType pixel_type, const guint8 *pixels,
               gint src_width, gint src_height, gint src_rowstride,
+              ChicleMediaLoader *media_loader,
               const ChafaCanvasConfig *config,
               gint placement_id,
-              ChafaTuck tuck)
+              ChafaTuck tuck,
+              gboolean copy_pixels)
 {
     ChafaFrame *frame;
     ChafaImage *image;
     ChafaPlacement *placement;
-    ChafaCanvas *canvas;
 
-    canvas = chafa_canvas_new (config);
-    frame = chafa_frame_new_borrow (pixels, pixel_type,
-                                    src_width, src_height, src_rowstride);
+    if (copy_pixels)
+        frame = chafa_frame_new (pixels, pixel_type,
+                                 src_width, src_height, src_rowstride);
+    else
+        frame = chafa_frame_new_borrow (pixels, pixel_type,
+                                        src_width, src_height, src_rowstride);
+
+    /* Sixels can use the source palette as-is, if there is one */
+    if (media_loader && can_use_source_palette (config, src_width, src_height, tuck))
+    {
+        const guint8 *indices;
+        const guint32 *colors;
+        gint n_colors, index_rowstride;
+
+        indices = chicle_media_loader_get_frame_indices (media_loader, &colors,
+                                                         &n_colors, &index_rowstride);
+        if (indices)
+            chafa_frame_set_indexed_pixels (frame, indices, index_rowstride,
+                                            colors, n_colors);
+    }
     image = chafa_image_new ();
     chafa_image_set_frame (image, frame);
 
@@ -496,12 +641,10 @@ build_canvas (ChafaPixelType pixel_type, const guint8 *pixels,
     chafa_placement_set_tuck (placement, tuck);
     chafa_placement_set_halign (placement, options.horiz_align);
     chafa_placement_set_valign (placement, options.vert_align);
-    chafa_canvas_set_placement (canvas, placement);
 
-    chafa_placement_unref (placement);
     chafa_image_unref (image);
     chafa_frame_unref (frame);
-    return canvas;
+    return placement;
 }
 
 typedef enum
@@ -514,7 +657,8 @@ RunResult;
 
 /* Prescaling is for structured formats like SVG where the intrinsic size may be
  * too small or too large and we'd rather rasterize to something closer to our
- * final output size. */
+ * final output size. Loaders for huge raster formats may also use it to
+ * shrink the image while decoding. */
 static void
 calc_prescale_size_px (gint *prescale_width_out, gint *prescale_height_out)
 {
@@ -536,8 +680,354 @@ calc_prescale_size_px (gint *prescale_width_out, gint *prescale_height_out)
     *prescale_height_out = cell_height_px
         * (options.height > 0 ? options.height : options.view_height);
 
-    *prescale_width_out = MAX (*prescale_width_out, 160);
-    *prescale_height_out = MAX (*prescale_height_out, 160);
+    /* When the terminal does the scaling, the pixels we send may be larger
+     * than the cell area. Don't rasterize below the requested limit. A limit
+     * of zero means native size, so there's no prescaling in that dimension. */
+    if (options.terminal_scaling
+        && (options.pixel_mode == CHAFA_PIXEL_MODE_KITTY
+            || options.pixel_mode == CHAFA_PIXEL_MODE_ITERM2))
+    {
+        *prescale_width_out = options.terminal_scaling_max_width > 0
+            ? MAX (*prescale_width_out, options.terminal_scaling_max_width) : 0;
+        *prescale_height_out = options.terminal_scaling_max_height > 0
+            ? MAX (*prescale_height_out, options.terminal_scaling_max_height) : 0;
+    }
+
+    if (*prescale_width_out > 0)
+        *prescale_width_out = MAX (*prescale_width_out, 160);
+    if (*prescale_height_out > 0)
+        *prescale_height_out = MAX (*prescale_height_out, 160);
+}
+
+/* Works out the frame geometry and returns the frame's placement along with
+ * the config for a canvas to draw it on. Drawing is left to the caller. */
+static ChafaPlacement *
+build_frame_placement (ChafaPixelType pixel_type, const guint8 *pixels,
+                       gint src_width, gint src_height, gint src_rowstride,
+                       ChicleMediaLoader *media_loader,
+                       gboolean is_animation, gint placement_id,
+                       ChicleRateControl *rate_control, gboolean copy_pixels,
+                       ChafaCanvasConfig **config_out,
+                       gint *dest_width_out, gint *dest_height_out)
+{
+    gint uncorrected_src_width, uncorrected_src_height;
+    gint virt_src_width, virt_src_height;
+    gint image_width = src_width, image_height = src_height;
+    gint dest_width, dest_height;
+    ChafaCanvasConfig *config;
+    ChafaPlacement *placement;
+    ChafaTuck tuck;
+
+    /* The loader may have reduced the pixels to fit the prescale size. The
+     * layout is still based on the image's own size, so it doesn't get
+     * scaled down twice. */
+    if (media_loader)
+        chicle_media_loader_get_image_size (media_loader, &image_width, &image_height);
+
+    if (options.use_exact_size == CHICLE_TRISTATE_TRUE)
+    {
+        /* True */
+        tuck = CHAFA_TUCK_SHRINK_TO_FIT;
+    }
+    else
+    {
+        /* False/auto */
+        if (options.stretch)
+        {
+            tuck = CHAFA_TUCK_STRETCH;
+        }
+        else
+        {
+            tuck = CHAFA_TUCK_FIT;
+        }
+    }
+
+    /* Hack to work around the fact that chafa_calc_canvas_geometry() doesn't
+     * support arbitrary scaling. Instead, we manipulate the source size to
+     * achieve the desired effect. */
+    if (using_detected_size && options.scale < CHICLE_SCALE_MAX - 0.1)
+    {
+        pixel_to_cell_dimensions (options.scale,
+                                  options.cell_width, options.cell_height,
+                                  image_width, image_height,
+                                  &uncorrected_src_width, &uncorrected_src_height);
+
+        virt_src_width = uncorrected_src_width;
+        if (options.cell_width > 0 && options.cell_height > 0)
+            virt_src_height = uncorrected_src_height / options.font_ratio;
+        else
+            virt_src_height = uncorrected_src_height;
+
+        virt_src_height = MAX (virt_src_height, 1);
+    }
+    else
+    {
+        virt_src_width = uncorrected_src_width = image_width;
+        virt_src_height = uncorrected_src_height = image_height;
+    }
+
+    if (options.use_exact_size == CHICLE_TRISTATE_TRUE)
+    {
+        dest_width = virt_src_width;
+        dest_height = virt_src_height;
+    }
+    else
+    {
+        dest_width = options.width;
+        dest_height = options.height;
+    }
+
+    chafa_calc_canvas_geometry (virt_src_width,
+                                virt_src_height,
+                                &dest_width,
+                                &dest_height,
+                                options.font_ratio,
+                                options.scale >= CHICLE_SCALE_MAX - 0.1 ? TRUE : FALSE,
+                                options.stretch);
+
+    if (options.use_exact_size == CHICLE_TRISTATE_AUTO
+        && dest_width == uncorrected_src_width
+        && dest_height == uncorrected_src_height)
+    {
+        tuck = (options.pixel_mode == CHAFA_PIXEL_MODE_SYMBOLS
+                ? CHAFA_TUCK_FIT : CHAFA_TUCK_SHRINK_TO_FIT);
+    }
+
+#if 0
+    /* The size calculations are too convoluted, so we may need this to
+     * debug --exact-size. */
+    g_printerr ("src=(%dx%d) unc=(%dx%d) virt=(%dx%d) dest=(%dx%d)\n",
+                src_width, src_height,
+                uncorrected_src_width, uncorrected_src_height,
+                virt_src_width, virt_src_height,
+                dest_width, dest_height);
+#endif
+
+    config = build_config (dest_width, dest_height, is_animation);
+    if (rate_control)
+        chicle_rate_control_apply (rate_control, config);
+
+    placement = build_placement (pixel_type, pixels,
+                                 src_width, src_height, src_rowstride,
+                                 media_loader, config,
+                                 placement_id, tuck, copy_pixels);
+
+    *config_out = config;
+    *dest_width_out = dest_width;
+    *dest_height_out = dest_height;
+    return placement;
+}
+
+/* Checks if a canvas can draw a frame with the given config. Symbol
+ * canvases are kept between frames so they can learn which symbols the
+ * animation uses. */
+static gboolean
+can_reuse_canvas (ChafaCanvas *canvas, const ChafaCanvasConfig *config)
+{
+    const ChafaCanvasConfig *old_config;
+    gint old_width, old_height;
+    gint width, height;
+
+    if (!canvas || chafa_canvas_config_get_pixel_mode (config) != CHAFA_PIXEL_MODE_SYMBOLS)
+        return FALSE;
+
+    old_config = chafa_canvas_peek_config (canvas);
+    chafa_canvas_config_get_geometry (old_config, &old_width, &old_height);
+    chafa_canvas_config_get_geometry (config, &width, &height);
+
+    return width == old_width && height == old_height;
+}
+
+/* Works out the frame geometry and builds a canvas for it. If prev_canvas
+ * can be used for the new frame, it's drawn to and returned with an extra
+ * reference. Rate control changes the config from frame to frame, so it
+ * always gets a new canvas. */
+static ChafaCanvas *
+build_frame_canvas (ChafaPixelType pixel_type, const guint8 *pixels,
+                    gint src_width, gint src_height, gint src_rowstride,
+                    ChicleMediaLoader *media_loader,
+                    gboolean is_animation, gint placement_id,
+                    ChicleRateControl *rate_control,
+                    ChafaCanvas *prev_canvas,
+                    gint *dest_width_out, gint *dest_height_out)
+{
+    ChafaCanvasConfig *config;
+    ChafaPlacement *placement;
+    ChafaCanvas *canvas;
+
+    placement = build_frame_placement (pixel_type, pixels,
+                                       src_width, src_height, src_rowstride,
+                                       media_loader, is_animation, placement_id,
+                                       rate_control, FALSE,
+                                       &config, dest_width_out, dest_height_out);
+
+    if (!rate_control && can_reuse_canvas (prev_canvas, config))
+    {
+        canvas = prev_canvas;
+        chafa_canvas_ref (canvas);
+    }
+    else
+    {
+        canvas = chafa_canvas_new (config);
+    }
+
+    chafa_canvas_set_placement (canvas, placement);
+
+    chafa_placement_unref (placement);
+    chafa_canvas_config_unref (config);
+    return canvas;
+}
+
+/* Everything that happens to a frame after it's been rendered */
+static void
+output_frame (const gchar *filename, GString **gsa,
+              gint dest_width, gint dest_height, gint delay_ms,
+              gint frame_n, gint loop_n, ChicleRateControl *rate_control,
+              gboolean is_first_file, gboolean is_first_frame, gboolean is_animation,
+              gboolean sync_updates)
+{
+    if (rate_control || options.do_dump_frame_bytes)
+    {
+        gsize n_bytes = get_gstring_array_len (gsa);
+
+        if (options.do_dump_frame_bytes)
+            g_printerr ("frame %d: %" G_GSIZE_FORMAT " bytes, level %d\n",
+                        frame_n, n_bytes,
+                        rate_control ? chicle_rate_control_get_level (rate_control) : 0);
+
+        if (rate_control)
+            chicle_rate_control_end_frame (rate_control, n_bytes);
+    }
+
+    /* Later passes are identical, so we only need the first one */
+    if (recorder && loop_n == 0)
+        chicle_recorder_add_frame (recorder, gsa, dest_width, dest_height, delay_ms);
+
+    print_frame (filename, gsa, dest_width, dest_height,
+                 is_first_file, is_first_frame, is_animation, sync_updates);
+}
+
+typedef struct
+{
+    gint dest_width, dest_height;
+    gint delay_ms;
+    gint frame_n, loop_n;
+    gint placement_id;
+}
+PipelinedFrame;
+
+/* Plays an animation with several frames rendered ahead on a worker pool.
+ * The frames are printed in order and with the same timing as when played
+ * sequentially. Returns FALSE if the first frame could not be decoded. */
+static gboolean
+play_animation_pipelined (const gchar *filename, ChicleMediaLoader *media_loader,
+                          gboolean is_first_file, gboolean is_first_frame,
+                          gint placement_id, gint *shown_placement_id,
+                          gboolean sync_updates, gint *dest_width_out)
+{
+    gdouble anim_duration_s = options.file_duration_s >= 0.0 ? options.file_duration_s : G_MAXDOUBLE;
+    gdouble anim_elapsed_s = 0.0;
+    ChicleFramePipeline *pipeline;
+    gboolean have_source = TRUE;
+    gint src_frame_n = 0, src_loop_n = 0;
+    gint n_pushed = 0;
+    gboolean result = TRUE;
+    GTimer *timer;
+
+    timer = g_timer_new ();
+    pipeline = chicle_frame_pipeline_new (options.term_info, options.n_frame_threads, g_free);
+
+    chicle_media_loader_goto_first_frame (media_loader);
+
+    while (!interrupted_by_user)
+    {
+        PipelinedFrame *frame;
+        GString **gsa;
+
+        g_timer_start (timer);
+
+        /* Keep the workers busy */
+
+        while (have_source && !chicle_frame_pipeline_is_full (pipeline))
+        {
+            ChafaPixelType pixel_type;
+            gint src_width, src_height, src_rowstride;
+            const guint8 *pixels;
+            ChafaCanvasConfig *config;
+            ChafaPlacement *placement;
+
+            pixels = chicle_media_loader_get_frame_data (media_loader,
+                                                         &pixel_type,
+                                                         &src_width,
+                                                         &src_height,
+                                                         &src_rowstride);
+            if (!pixels)
+            {
+                if (src_frame_n == 0 && src_loop_n == 0)
+                    result = FALSE;
+                have_source = FALSE;
+                break;
+            }
+
+            frame = g_new (PipelinedFrame, 1);
+            frame->delay_ms = chicle_media_loader_get_frame_delay (media_loader);
+            frame->frame_n = src_frame_n++;
+            frame->loop_n = src_loop_n;
+            frame->placement_id = placement_id >= 0 ? placement_id + (n_pushed++ % 2) : -1;
+
+            /* The workers draw the frame, so it gets its own copy of the pixels */
+            placement = build_frame_placement (pixel_type, pixels,
+                                               src_width, src_height, src_rowstride,
+                                               media_loader,
+                                               TRUE,
+                                               frame->placement_id,
+                                               NULL, TRUE, &config,
+                                               &frame->dest_width, &frame->dest_height);
+            chicle_frame_pipeline_push (pipeline, config, placement, frame);
+
+            if (!chicle_media_loader_goto_next_frame (media_loader))
+            {
+                /* In watch mode, we only play it once per file change */
+                if (options.watch)
+                {
+                    have_source = FALSE;
+                    break;
+                }
+
+                chicle_media_loader_goto_first_frame (media_loader);
+                src_loop_n++;
+            }
+        }
+
+        gsa = chicle_frame_pipeline_pop (pipeline, (gpointer *) &frame);
+        if (!gsa)
+            break;
+
+        /* Frames rendered ahead past the end of the duration are discarded */
+        if (frame->loop_n > 0 && anim_elapsed_s >= anim_duration_s)
+        {
+            chafa_free_gstring_array (gsa);
+            g_free (frame);
+            break;
+        }
+
+        output_frame (filename, gsa, frame->dest_width, frame->dest_height, frame->delay_ms,
+                      frame->frame_n, frame->loop_n, NULL,
+                      is_first_file, is_first_frame, TRUE, sync_updates);
+        *dest_width_out = frame->dest_width;
+        *shown_placement_id = frame->placement_id;
+        is_first_frame = FALSE;
+
+        wait_for_next_frame (timer, get_frame_interval_ms (frame->delay_ms), frame->delay_ms,
+                             &anim_elapsed_s);
+
+        chafa_free_gstring_array (gsa);
+        g_free (frame);
+    }
+
+    chicle_frame_pipeline_destroy (pipeline);
+    g_timer_destroy (timer);
+    return result;
 }
 
 static RunResult
@@ -550,10 +1040,15 @@ run_generic (const gchar *filename, ChicleMediaLoader *media_loader,
     GTimer *timer;
     gint loop_n = 0;
     GString **gsa;
+    ChafaCanvas *anim_canvas = NULL;
     gint placement_id = -1;
+    gint shown_placement_id = -1;
     gint frame_count = 0;
+    gint frame_n = 0;
     RunResult result = FILE_FAILED;
     gint dest_width = 0, dest_height = 0;
+    ChicleRateControl *rate_control = NULL;
+    gboolean sync_updates = FALSE;
     GError *error = NULL;
 
     timer = g_timer_new ();
@@ -573,6 +1068,27 @@ run_generic (const gchar *filename, ChicleMediaLoader *media_loader,
     is_animation = options.animate ? chicle_media_loader_get_is_animation (media_loader) : FALSE;
     result = is_animation ? FILE_WAS_ANIMATION : FILE_WAS_STILL;
 
+    if (is_animation && (options.max_bandwidth > 0 || options.frame_bytes_budget > 0))
+        rate_control = chicle_rate_control_new (options.max_bandwidth, options.frame_bytes_budget);
+
+    /* Have the terminal show each frame in one go, so it doesn't redraw
+     * while the frame is being written out. */
+    sync_updates = (is_animation || options.watch)
+        && chafa_term_info_have_seq (options.term_info, CHAFA_TERM_SEQ_BEGIN_SYNCHRONIZED_UPDATE);
+
+    if (recorder)
+        chicle_recorder_begin_image (recorder, filename, options.pixel_mode, is_animation);
+
+    /* Frames can be rendered ahead unless rate control needs the size of
+     * each one before it can do the next */
+    if (is_animation && !rate_control && options.n_frame_threads > 1)
+    {
+        if (!play_animation_pipelined (filename, media_loader, is_first_file, is_first_frame,
+                                       placement_id, &shown_placement_id, sync_updates, &dest_width))
+            result = FILE_FAILED;
+        goto anim_done;
+    }
+
     do
     {
         gboolean have_frame;
@@ -585,149 +1101,77 @@ run_generic (const gchar *filename, ChicleMediaLoader *media_loader,
              have_frame && !interrupted_by_user && (loop_n == 0 || anim_elapsed_s < anim_duration_s);
              have_frame = chicle_media_loader_goto_next_frame (media_loader))
         {
-            gdouble elapsed_ms, remain_ms;
+            gdouble interval_ms;
             gint delay_ms;
             ChafaPixelType pixel_type;
             gint src_width, src_height, src_rowstride;
-            gint uncorrected_src_width, uncorrected_src_height;
-            gint virt_src_width, virt_src_height;
             const guint8 *pixels;
-            ChafaCanvasConfig *config;
             ChafaCanvas *canvas;
-            ChafaTuck tuck;
+            gint frame_placement_id;
 
             g_timer_start (timer);
 
-            if (options.use_exact_size == CHICLE_TRISTATE_TRUE)
-            {
-                /* True */
-                tuck = CHAFA_TUCK_SHRINK_TO_FIT;
-            }
-            else
-            {
-                /* False/auto */
-                if (options.stretch)
-                {
-                    tuck = CHAFA_TUCK_STRETCH;
-                }
-                else
-                {
-                    tuck = CHAFA_TUCK_FIT;
-                }
-            }
-
             pixels = chicle_media_loader_get_frame_data (media_loader,
                                                          &pixel_type,
                                                          &src_width,
                                                          &src_height,
                                                          &src_rowstride);
-            /* FIXME: This shouldn't happen -- but if it does, our
-             * options for handling it gracefully here aren't great.
-             * Needs refactoring. */
+            /* Loaders may decode lazily, so this can fail for a still
+             * that looked fine when opened. Mid-animation, our options for
+             * handling it gracefully here aren't great. Needs refactoring. */
             if (!pixels)
-                break;
-
-            delay_ms = chicle_media_loader_get_frame_delay (media_loader);
-
-            /* Hack to work around the fact that chafa_calc_canvas_geometry() doesn't
-             * support arbitrary scaling. Instead, we manipulate the source size to
-             * achieve the desired effect. */
-            if (using_detected_size && options.scale < CHICLE_SCALE_MAX - 0.1)
             {
-                pixel_to_cell_dimensions (options.scale,
-                                          options.cell_width, options.cell_height,
-                                          src_width, src_height,
-                                          &uncorrected_src_width, &uncorrected_src_height);
-
-                virt_src_width = uncorrected_src_width;
-                if (options.cell_width > 0 && options.cell_height > 0)
-                    virt_src_height = uncorrected_src_height / options.font_ratio;
-                else
-                    virt_src_height = uncorrected_src_height;
-
-                virt_src_height = MAX (virt_src_height, 1);
-            }
-            else
-            {
-                virt_src_width = uncorrected_src_width = src_width;
-                virt_src_height = uncorrected_src_height = src_height;
+                if (frame_n == 0)
+                    result = FILE_FAILED;
+                break;
             }
 
-            if (options.use_exact_size == CHICLE_TRISTATE_TRUE)
-            {
-                dest_width = virt_src_width;
-                dest_height = virt_src_height;
-            }
-            else
-            {
-                dest_width = options.width;
-                dest_height = options.height;
-            }
+            delay_ms = chicle_media_loader_get_frame_delay (media_loader);
+            interval_ms = get_frame_interval_ms (delay_ms);
 
-            chafa_calc_canvas_geometry (virt_src_width,
-                                        virt_src_height,
-                                        &dest_width,
-                                        &dest_height,
-                                        options.font_ratio,
-                                        options.scale >= CHICLE_SCALE_MAX - 0.1 ? TRUE : FALSE,
-                                        options.stretch);
-
-            if (options.use_exact_size == CHICLE_TRISTATE_AUTO
-                && dest_width == uncorrected_src_width
-                && dest_height == uncorrected_src_height)
+            if (rate_control && !chicle_rate_control_begin_frame (rate_control, interval_ms))
             {
-                tuck = (options.pixel_mode == CHAFA_PIXEL_MODE_SYMBOLS
-                        ? CHAFA_TUCK_FIT : CHAFA_TUCK_SHRINK_TO_FIT);
+                if (options.do_dump_frame_bytes)
+                    g_printerr ("frame %d: dropped\n", frame_n);
+                if (recorder && loop_n == 0)
+                    chicle_recorder_add_frame (recorder, NULL, dest_width, dest_height, delay_ms);
+                goto frame_done;
             }
 
-#if 0
-            /* The size calculations are too convoluted, so we may need this to
-             * debug --exact-size. */
-            g_printerr ("src=(%dx%d) unc=(%dx%d) virt=(%dx%d) dest=(%dx%d)\n",
-                        src_width, src_height,
-                        uncorrected_src_width, uncorrected_src_height,
-                        virt_src_width, virt_src_height,
-                        dest_width, dest_height);
-#endif
-
-            config = build_config (dest_width, dest_height, is_animation);
-            canvas = build_canvas (pixel_type, pixels,
-                                   src_width, src_height, src_rowstride, config,
-                                   placement_id >= 0 ? placement_id + ((frame_count++) % 2) : -1,
-                                   tuck);
-
+            frame_placement_id = placement_id >= 0 ? placement_id + ((frame_count++) % 2) : -1;
+            canvas = build_frame_canvas (pixel_type, pixels,
+                                         src_width, src_height, src_rowstride,
+                                         media_loader,
+                                         is_animation,
+                                         frame_placement_id,
+                                         rate_control,
+                                         anim_canvas,
+                                         &dest_width, &dest_height);
             chafa_canvas_print_rows (canvas, options.term_info, &gsa, NULL);
 
-            write_image_prologue (filename, is_first_file, is_first_frame, is_animation, dest_height);
-            write_image (gsa, dest_width);
-
-            /* No inter-frame epilogue in animations; this prevents unwanted
-             * scrolling when we get the sixel overshoot quirk wrong (#255). */
-            if (!is_animation)
-                write_image_epilogue (filename, is_animation, dest_width);
+            output_frame (filename, gsa, dest_width, dest_height, delay_ms,
+                          frame_n, loop_n, rate_control,
+                          is_first_file, is_first_frame, is_animation, sync_updates);
+            shown_placement_id = frame_placement_id;
 
-            chafa_term_flush (term);
             chafa_free_gstring_array (gsa);
-            chafa_canvas_unref (canvas);
-            chafa_canvas_config_unref (config);
 
-            if (is_animation)
+            if (is_animation && canvas != anim_canvas)
             {
-                /* Account for time spent converting and printing frame */
-                elapsed_ms = g_timer_elapsed (timer, NULL) * 1000.0;
-
-                if (options.anim_fps > 0.0)
-                    remain_ms = 1000.0 / options.anim_fps;
-                else
-                    remain_ms = delay_ms;
-                remain_ms /= options.anim_speed_multiplier;
-                remain_ms = MAX (remain_ms - elapsed_ms, 0);
+                if (anim_canvas)
+                    chafa_canvas_unref (anim_canvas);
+                anim_canvas = canvas;
+            }
+            else
+            {
+                chafa_canvas_unref (canvas);
+            }
 
-                if (remain_ms > 0.0001 && 1000.0 / (gdouble) remain_ms < CHICLE_ANIM_FPS_MAX)
-                    interruptible_usleep (remain_ms * 1000.0);
+frame_done:
+            frame_n++;
 
-                anim_elapsed_s += MAX (elapsed_ms, delay_ms) / 1000.0;
-            }
+            if (is_animation)
+                wait_for_next_frame (timer, interval_ms, delay_ms, &anim_elapsed_s);
 
             is_first_frame = FALSE;
 
@@ -740,16 +1184,27 @@ run_generic (const gchar *filename, ChicleMediaLoader *media_loader,
     while (is_animation && !interrupted_by_user
            && !options.watch && anim_elapsed_s < anim_duration_s);
 
+anim_done:
     if (is_animation)
+    {
         write_image_epilogue (filename, is_animation, dest_width);
+        chafa_term_flush (term);
+    }
 
 out:
     /* We need two IDs per animation in order to do flicker-free flips. If the
-     * final frame got the higher ID, increment the global counter so the next
-     * image doesn't clobber it. */
-    if (placement_id >= 0 && !(frame_count % 2))
+     * final frame shown got the higher ID, increment the global counter so the
+     * next image doesn't clobber it. Frames rendered ahead but never shown
+     * don't count. */
+    if (placement_id >= 0 && shown_placement_id != placement_id)
         placement_id = chicle_placement_counter_get_next_id (placement_counter);
 
+    if (anim_canvas)
+        chafa_canvas_unref (anim_canvas);
+
+    if (rate_control)
+        chicle_rate_control_destroy (rate_control);
+
     g_timer_destroy (timer);
     g_clear_error (&error);
     return result;
@@ -803,6 +1258,265 @@ run_watch (const gchar *filename)
     return 0;
 }
 
+/* Keys that aren't in the terminal database, but that we'd like the parser
+ * to recognize in the panning viewer */
+static const struct
+{
+    ChafaTermSeq seq;
+    const gchar *str;
+}
+pan_key_seqs [] =
+{
+    { CHAFA_TERM_SEQ_UP_KEY, "\033[A" },
+    { CHAFA_TERM_SEQ_UP_SHIFT_KEY, "\033[1;2A" },
+    { CHAFA_TERM_SEQ_DOWN_KEY, "\033[B" },
+    { CHAFA_TERM_SEQ_DOWN_SHIFT_KEY, "\033[1;2B" },
+    { CHAFA_TERM_SEQ_RIGHT_KEY, "\033[C" },
+    { CHAFA_TERM_SEQ_RIGHT_SHIFT_KEY, "\033[1;2C" },
+    { CHAFA_TERM_SEQ_LEFT_KEY, "\033[D" },
+    { CHAFA_TERM_SEQ_LEFT_SHIFT_KEY, "\033[1;2D" },
+    { CHAFA_TERM_SEQ_PAGE_UP_KEY, "\033[5~" },
+    { CHAFA_TERM_SEQ_PAGE_DOWN_KEY, "\033[6~" }
+};
+
+/* Zoom is in powers of two over the size that fits the view */
+#define PAN_ZOOM_LEVEL_MAX 16
+
+typedef struct
+{
+    ChafaCanvas *canvas;
+    ChafaPixelType pixel_type;
+    const guint8 *pixels;
+    gint src_width, src_height, src_rowstride;
+
+    gint view_width, view_height;
+    gint fit_width, fit_height;
+    gint zoom_level, zoom_level_max;
+    gint zoom_width, zoom_height;
+
+    /* Viewport position in cells */
+    gint x, y;
+}
+PanState;
+
+static void
+pan_move (PanState *pan, gint x, gint y)
+{
+    pan->x = CLAMP (x, 0, MAX (pan->zoom_width - pan->view_width, 0));
+    pan->y = CLAMP (y, 0, MAX (pan->zoom_height - pan->view_height, 0));
+}
+
+static void
+pan_set_zoom_level (PanState *pan, gint zoom_level)
+{
+    gint64 center_x, center_y;
+    gint old_zoom_width = pan->zoom_width, old_zoom_height = pan->zoom_height;
+
+    pan->zoom_level = CLAMP (zoom_level, 0, pan->zoom_level_max);
+    pan->zoom_width = pan->fit_width << pan->zoom_level;
+    pan->zoom_height = pan->fit_height << pan->zoom_level;
+
+    if (old_zoom_width == pan->zoom_width && old_zoom_height == pan->zoom_height)
+        return;
+
+    /* This drops the cached tiles for the previous zoom level */
+    chafa_canvas_set_viewport_source (pan->canvas, pan->pixel_type, pan->pixels,
+                                      pan->src_width, pan->src_height, pan->src_rowstride,
+                                      pan->zoom_width, pan->zoom_height);
+
+    /* Keep the center of the view in place */
+    if (old_zoom_width > 0 && old_zoom_height > 0)
+    {
+        center_x = ((gint64) pan->x * 2 + pan->view_width) * pan->zoom_width / old_zoom_width;
+        center_y = ((gint64) pan->y * 2 + pan->view_height) * pan->zoom_height / old_zoom_height;
+        pan_move (pan,
+                  (center_x - pan->view_width) / 2,
+                  (center_y - pan->view_height) / 2);
+    }
+    else
+    {
+        pan_move (pan, pan->x, pan->y);
+    }
+}
+
+static void
+pan_draw (PanState *pan)
+{
+    GString **gsa;
+
+    chafa_canvas_set_viewport (pan->canvas, pan->x, pan->y);
+    chafa_canvas_print_rows (pan->canvas, options.term_info, &gsa, NULL);
+
+    /* Don't queue up more than one view if keys are repeating fast */
+    chafa_term_flush (term);
+
+    chafa_term_print_seq (term, CHAFA_TERM_SEQ_BEGIN_SYNCHRONIZED_UPDATE, -1);
+    chafa_term_print_seq (term, CHAFA_TERM_SEQ_CURSOR_TO_TOP_LEFT, -1);
+    write_image (gsa, pan->view_width);
+    chafa_term_print_seq (term, CHAFA_TERM_SEQ_END_SYNCHRONIZED_UPDATE, -1);
+
+    chafa_free_gstring_array (gsa);
+}
+
+/* Returns FALSE if the user wants to quit */
+static gboolean
+pan_handle_event (PanState *pan, ChafaEvent *event)
+{
+    gint step_x = MAX (pan->view_width / 8, 1);
+    gint step_y = MAX (pan->view_height / 8, 1);
+    gint page_x = MAX (pan->view_width / 2, 1);
+    gint page_y = MAX (pan->view_height / 2, 1);
+    gint dx = 0, dy = 0;
+
+    if (chafa_event_get_type (event) == CHAFA_EOF_EVENT)
+        return FALSE;
+
+    if (chafa_event_get_type (event) == CHAFA_UNICHAR_EVENT)
+    {
+        switch (chafa_event_get_unichar (event))
+        {
+            case 'q': case 'Q':
+                return FALSE;
+            case 'h': dx = -step_x; break;
+            case 'l': dx = step_x; break;
+            case 'k': dy = -step_y; break;
+            case 'j': dy = step_y; break;
+            case 'H': dx = -page_x; break;
+            case 'L': dx = page_x; break;
+            case 'K': dy = -page_y; break;
+            case 'J': dy = page_y; break;
+            case '+': case '=':
+                pan_set_zoom_level (pan, pan->zoom_level + 1);
+                break;
+            case '-': case '_':
+                pan_set_zoom_level (pan, pan->zoom_level - 1);
+                break;
+            default:
+                break;
+        }
+    }
+    else if (chafa_event_get_type (event) == CHAFA_SEQ_EVENT)
+    {
+        switch (chafa_event_get_seq (event))
+        {
+            case CHAFA_TERM_SEQ_LEFT_KEY: dx = -step_x; break;
+            case CHAFA_TERM_SEQ_RIGHT_KEY: dx = step_x; break;
+            case CHAFA_TERM_SEQ_UP_KEY: dy = -step_y; break;
+            case CHAFA_TERM_SEQ_DOWN_KEY: dy = step_y; break;
+            case CHAFA_TERM_SEQ_LEFT_SHIFT_KEY: dx = -page_x; break;
+            case CHAFA_TERM_SEQ_RIGHT_SHIFT_KEY: dx = page_x; break;
+            case CHAFA_TERM_SEQ_UP_SHIFT_KEY:
+            case CHAFA_TERM_SEQ_PAGE_UP_KEY: dy = -page_y; break;
+            case CHAFA_TERM_SEQ_DOWN_SHIFT_KEY:
+            case CHAFA_TERM_SEQ_PAGE_DOWN_KEY: dy = page_y; break;
+            default:
+                break;
+        }
+    }
+
+    pan_move (pan, pan->x + dx, pan->y + dy);
+    return TRUE;
+}
+
+static int
+run_pan (const gchar *filename)
+{
+    ChicleMediaLoader *media_loader;
+    ChafaCanvasConfig *config;
+    ChafaTermInfo *term_info;
+    PanState pan = { 0 };
+    GError *error = NULL;
+    gint last_x = -1, last_y = -1, last_zoom_level = -1;
+    guint i;
+
+    /* Zooming in needs the image at its full resolution, so no prescaling */
+    media_loader = chicle_media_loader_new (filename, 0, 0, &error);
+    if (!media_loader)
+    {
+        g_printerr ("%s: Failed to open '%s': %s\n",
+                    options.executable_name, filename,
+                    error ? error->message : "Unknown error");
+        g_clear_error (&error);
+        return 2;
+    }
+
+    pan.pixels = chicle_media_loader_get_frame_data (media_loader,
+                                                     &pan.pixel_type,
+                                                     &pan.src_width,
+                                                     &pan.src_height,
+                                                     &pan.src_rowstride);
+    if (!pan.pixels)
+    {
+        chicle_media_loader_destroy (media_loader);
+        return 2;
+    }
+
+    term_info = chafa_term_get_term_info (term);
+    for (i = 0; i < G_N_ELEMENTS (pan_key_seqs); i++)
+    {
+        if (!chafa_term_info_have_seq (term_info, pan_key_seqs [i].seq))
+            chafa_term_info_set_seq (term_info, pan_key_seqs [i].seq, pan_key_seqs [i].str, NULL);
+    }
+
+    pan.view_width = options.width;
+    pan.view_height = options.height;
+    pan.fit_width = options.width;
+    pan.fit_height = options.height;
+    chafa_calc_canvas_geometry (pan.src_width, pan.src_height,
+                                &pan.fit_width, &pan.fit_height,
+                                options.font_ratio, TRUE, options.stretch);
+
+    /* Stop zooming in when a source pixel covers a whole cell */
+    for (pan.zoom_level_max = 0;
+         pan.zoom_level_max < PAN_ZOOM_LEVEL_MAX
+             && (pan.fit_width << (pan.zoom_level_max + 1)) <= MAX (pan.src_width, pan.fit_width);
+         pan.zoom_level_max++)
+        ;
+
+    config = build_config (pan.view_width, pan.view_height, FALSE);
+    pan.canvas = chafa_canvas_new (config);
+    pan_set_zoom_level (&pan, 0);
+
+    chafa_term_print_seq (term, CHAFA_TERM_SEQ_ENABLE_ALT_SCREEN, -1);
+    chafa_term_print_seq (term, CHAFA_TERM_SEQ_CLEAR, -1);
+
+    while (!interrupted_by_user)
+    {
+        ChafaEvent *event;
+        gboolean keep_going;
+
+        if (pan.x != last_x || pan.y != last_y || pan.zoom_level != last_zoom_level)
+        {
+            if (pan.zoom_level != last_zoom_level)
+                chafa_term_print_seq (term, CHAFA_TERM_SEQ_CLEAR, -1);
+
+            pan_draw (&pan);
+            last_x = pan.x;
+            last_y = pan.y;
+            last_zoom_level = pan.zoom_level;
+        }
+
+        /* Time out now and then so we notice interrupts */
+        event = chafa_term_read_event (term, 100);
+        if (!event)
+            continue;
+
+        keep_going = pan_handle_event (&pan, event);
+        g_free (event);
+
+        if (!keep_going)
+            break;
+    }
+
+    chafa_term_print_seq (term, CHAFA_TERM_SEQ_DISABLE_ALT_SCREEN, -1);
+    chafa_term_flush (term);
+
+    chafa_canvas_unref (pan.canvas);
+    chafa_canvas_config_unref (config);
+    chicle_media_loader_destroy (media_loader);
+    return 0;
+}
+
 static int
 run_vertical (ChiclePathQueue *path_queue)
 {
@@ -840,6 +1554,10 @@ run_vertical (ChiclePathQueue *path_queue)
                 g_error_free (error);
             }
 
+            /* Keep the spacing between files intact on replay */
+            if (recorder)
+                chicle_recorder_begin_image (recorder, path ? path : "", options.pixel_mode, FALSE);
+
             g_free (path);
             n_failed++;
             continue;
@@ -867,6 +1585,140 @@ run_vertical (ChiclePathQueue *path_queue)
     return (n_failed > 0 && n_failed == n_processed) ? 2 : (n_failed > 0) ? 1 : 0;
 }
 
+/* Mirrors the timing and layout of run_generic (), but takes the frames
+ * from a recording instead of rendering them. */
+static RunResult
+replay_image (ChicleRecording *recording, const gchar *path,
+              gboolean is_animation, gboolean is_first_file)
+{
+    gdouble anim_duration_s = options.file_duration_s >= 0.0 ? options.file_duration_s : G_MAXDOUBLE;
+    gdouble anim_elapsed_s = 0.0;
+    gboolean is_first_frame = TRUE;
+    gboolean sync_updates;
+    GTimer *timer;
+    gint loop_n = 0;
+    gint frame_n = 0;
+    gint dest_width = 0, dest_height = 0;
+    RunResult result;
+
+    timer = g_timer_new ();
+    result = is_animation ? FILE_WAS_ANIMATION : FILE_WAS_STILL;
+
+    sync_updates = is_animation
+        && chafa_term_info_have_seq (options.term_info, CHAFA_TERM_SEQ_BEGIN_SYNCHRONIZED_UPDATE);
+
+    do
+    {
+        gboolean have_frame;
+
+        for (have_frame = chicle_recording_goto_first_frame (recording);
+             have_frame && !interrupted_by_user && (loop_n == 0 || anim_elapsed_s < anim_duration_s);
+             have_frame = chicle_recording_goto_next_frame (recording))
+        {
+            GString **gsa;
+            gint delay_ms;
+
+            g_timer_start (timer);
+
+            gsa = chicle_recording_get_frame (recording, &dest_width, &dest_height, &delay_ms);
+
+            /* Dropped frames only take up time */
+            if (gsa)
+                print_frame (path, gsa, dest_width, dest_height,
+                             is_first_file, is_first_frame, is_animation, sync_updates);
+
+            frame_n++;
+
+            if (is_animation)
+                wait_for_next_frame (timer, get_frame_interval_ms (delay_ms), delay_ms,
+                                     &anim_elapsed_s);
+
+            is_first_frame = FALSE;
+
+            if (!is_animation)
+                break;
+        }
+
+        /* Nothing was recorded; the file failed to load */
+        if (frame_n == 0)
+        {
+            result = FILE_FAILED;
+            break;
+        }
+
+        loop_n++;
+    }
+    while (is_animation && !interrupted_by_user && anim_elapsed_s < anim_duration_s);
+
+    if (is_animation)
+    {
+        write_image_epilogue (path, is_animation, dest_width);
+        chafa_term_flush (term);
+    }
+
+    g_timer_destroy (timer);
+    return result;
+}
+
+static int
+run_replay (ChiclePathQueue *path_queue)
+{
+    gdouble still_duration_s = options.file_duration_s > 0.0 ? options.file_duration_s : 0.0;
+    gint n_processed = 0;
+    gint n_failed = 0;
+    gchar *rec_path;
+
+    while (!interrupted_by_user
+           && (rec_path = chicle_path_queue_try_pop (path_queue)))
+    {
+        ChicleRecording *recording;
+        ChafaPixelMode pixel_mode;
+        gboolean is_animation;
+        gchar *path;
+        GError *error = NULL;
+
+        recording = chicle_recording_new (rec_path, &error);
+        if (!recording)
+        {
+            g_printerr ("%s: Failed to open '%s': %s\n",
+                        options.executable_name, rec_path, error->message);
+            g_error_free (error);
+            g_free (rec_path);
+            n_processed++;
+            n_failed++;
+            continue;
+        }
+
+        while (!interrupted_by_user
+               && chicle_recording_next_image (recording, &path, &pixel_mode, &is_animation))
+        {
+            RunResult result;
+
+            n_processed++;
+
+            /* Layout depends on how the frames were printed */
+            options.pixel_mode = pixel_mode;
+
+            result = replay_image (recording, path, is_animation, n_processed > 1 ? FALSE : TRUE);
+            if (result == FILE_FAILED)
+                n_failed++;
+
+            if (result == FILE_WAS_STILL && still_duration_s > 0.0)
+                interruptible_usleep (still_duration_s * 1000000.0);
+
+            g_free (path);
+        }
+
+        chicle_recording_destroy (recording);
+        g_free (rec_path);
+    }
+
+    if (!options.have_parking_row)
+        chafa_term_write (term, "\n", 1);
+
+    return (n_failed > 0 && n_failed == n_processed) ? 2 : (n_failed > 0) ? 1 : 0;
+}
+
 static gint
 run_grid (ChiclePathQueue *path_queue)
 {
@@ -954,10 +1806,39 @@ main (int argc, char *argv [])
 
     tty_options_init ();
 
-    if (options.grid_width > 0 || options.grid_height > 0)
+    if (options.record_path)
+    {
+        GError *error = NULL;
+
+        recorder = chicle_recorder_new (options.record_path, &error);
+        if (!recorder)
+        {
+            g_printerr ("%s: Failed to open '%s' for recording: %s\n",
+                        options.executable_name, options.record_path, error->message);
+            g_error_free (error);
+            ret = 2;
+            goto deinit;
+        }
+    }
+
+    if (options.replay)
+    {
+        ret = run_replay (global_path_queue);
+    }
+    else if (options.grid_width > 0 || options.grid_height > 0)
     {
         ret = run_grid (global_path_queue);
     }
+    else if (options.pan)
+    {
+        gchar *path = chicle_path_queue_try_pop (global_path_queue);
+
+        if (path)
+        {
+            ret = run_pan (path);
+            g_free (path);
+        }
+    }
     else if (options.watch)
     {
         gchar *path = chicle_path_queue_try_pop (global_path_queue);
@@ -973,6 +1854,19 @@ main (int argc, char *argv [])
         ret = run_vertical (global_path_queue);
     }
 
+    if (recorder)
+    {
+        GError *error = NULL;
+
+        if (!chicle_recorder_close (recorder, &error))
+        {
+            g_printerr ("%s: %s\n", options.executable_name, error->message);
+            g_error_free (error);
+            ret = 2;
+        }
+    }
+
+deinit:
     tty_options_deinit ();
 
 out:
@@ -990,6 +1884,7 @@ out:
         chafa_symbol_map_unref (options.fill_symbol_map);
     if (options.term_info)
         chafa_term_info_unref (options.term_info);
+    g_free (options.record_path);
 
     chicle_path_queue_unref (global_path_queue);
     return ret;
@@ -0,0 +1,658 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* Copyright (C) 2025 Hans Petter Jansson
+ *
+ * This file is part of Chafa, a program that shows pictures on text terminals.
+ *
+ * Chafa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Chafa is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Chafa.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "config.h"
+#include <string.h>
+
+#include <chafa.h>
+#include "chicle-bmp-loader.h"
+
+/* Loads Windows BMP images with a BITMAPINFOHEADER or one of its later
+ * versions: 1, 4 and 8 bits per pixel with a palette, optionally RLE
+ * compressed, and 16, 24 and 32 bits per pixel with or without bitfields.
+ *
+ * Top-down 24-bit images and top-down 32-bit images in the usual BGRA
+ * layout are passed on straight from the file mapping. Bottom-up rows are
+ * copied in reverse order, since rowstrides can't be negative. Everything
+ * else is expanded to RGBA8. Paletted images also make their indices
+ * available. */
+
+#define FILE_HEADER_SIZE 14
+
+#define DIM_MAX ((1 << 28) - 1)
+#define N_PIXELS_MAX (1 << 29)
+
+#define PACK_RGBA(r, g, b, a) \
+    GUINT32_TO_LE ((guint32) (r) | ((guint32) (g) << 8) \
+                   | ((guint32) (b) << 16) | ((guint32) (a) << 24))
+
+typedef enum
+{
+    BMP_COMPRESSION_RGB = 0,
+    BMP_COMPRESSION_RLE8 = 1,
+    BMP_COMPRESSION_RLE4 = 2,
+    BMP_COMPRESSION_BITFIELDS = 3,
+    BMP_COMPRESSION_ALPHABITFIELDS = 6
+}
+BmpCompression;
+
+struct ChicleBmpLoader
+{
+    ChicleFileMapping *mapping;
+    const guint8 *file_data;
+    gsize file_data_len;
+
+    /* Points into the mapping */
+    const guint8 *raster;
+    gsize raster_len;
+    gint raster_rowstride;
+
+    gint width, height;
+    gint bpp;
+    BmpCompression compression;
+    guint is_top_down : 1;
+    guint32 masks [4];
+
+    /* Palette as 0xAARRGGBB. Entries past the ones in the file are opaque
+     * black, so any index is valid. */
+    guint32 colors [256];
+    gint n_colors;
+
+    /* Points into the mapping for uncompressed, top-down 8-bit images */
+    const guint8 *index_data;
+    guint8 *index_data_owned;
+    gint index_rowstride;
+
+    /* If NULL, the raster is used as-is */
+    gpointer frame_data;
+    ChafaPixelType pixel_type;
+    gint rowstride;
+};
+
+static guint16
+get_u16 (const guint8 *p)
+{
+    return p [0] | (p [1] << 8);
+}
+
+static guint32
+get_u32 (const guint8 *p)
+{
+    return p [0] | (p [1] << 8) | (p [2] << 16) | ((guint32) p [3] << 24);
+}
+
+/* --- Header parsing --- */
+
+static gboolean
+load_masks (ChicleBmpLoader *loader, guint32 header_size, gsize *ofs)
+{
+    const guint8 *data = loader->file_data;
+    gint n_masks = 3;
+    gint i;
+
+    if (loader->compression == BMP_COMPRESSION_ALPHABITFIELDS || header_size >= 56)
+        n_masks = 4;
+
+    /* In the original header, the masks follow it. Later versions
+     * include them. Either way, they're in the same place. */
+    if (FILE_HEADER_SIZE + 40 + n_masks * 4 > loader->file_data_len)
+        return FALSE;
+
+    for (i = 0; i < n_masks; i++)
+        loader->masks [i] = get_u32 (data + FILE_HEADER_SIZE + 40 + i * 4);
+
+    if (header_size == 40)
+        *ofs += n_masks * 4;
+
+    return TRUE;
+}
+
+static void
+set_default_masks (ChicleBmpLoader *loader)
+{
+    if (loader->bpp == 16)
+    {
+        loader->masks [0] = 0x7c00;
+        loader->masks [1] = 0x03e0;
+        loader->masks [2] = 0x001f;
+    }
+    else
+    {
+        loader->masks [0] = 0x00ff0000;
+        loader->masks [1] = 0x0000ff00;
+        loader->masks [2] = 0x000000ff;
+    }
+
+    /* The fourth byte of 32-bit pixels is undefined without a mask */
+    loader->masks [3] = 0;
+}
+
+static gboolean
+load_palette (ChicleBmpLoader *loader, guint32 n_colors, gsize ofs)
+{
+    const guint8 *data = loader->file_data;
+    guint32 i;
+
+    if (n_colors == 0 || n_colors > (1U << loader->bpp))
+        n_colors = 1U << loader->bpp;
+
+    if (ofs + n_colors * 4 > loader->file_data_len)
+        return FALSE;
+
+    for (i = 0; i < 256; i++)
+        loader->colors [i] = 0xff000000;
+
+    for (i = 0; i < n_colors; i++)
+    {
+        const guint8 *p = data + ofs + i * 4;
+
+        loader->colors [i] = 0xff000000 | (p [2] << 16) | (p [1] << 8) | p [0];
+    }
+
+    loader->n_colors = n_colors;
+    return TRUE;
+}
+
+static gboolean
+load_header (ChicleBmpLoader *loader)
+{
+    const guint8 *data;
+    guint32 header_size, data_ofs, n_colors;
+    gint32 height;
+    gsize ofs;
+
+    if (!chicle_file_mapping_has_magic (loader->mapping, 0, "BM", 2))
+        return FALSE;
+
+    loader->file_data = chicle_file_mapping_get_data (loader->mapping, &loader->file_data_len);
+    if (!loader->file_data || loader->file_data_len < FILE_HEADER_SIZE + 40)
+        return FALSE;
+
+    data = loader->file_data;
+    data_ofs = get_u32 (data + 10);
+    header_size = get_u32 (data + 14);
+
+    /* BITMAPINFOHEADER and its successors. The OS/2 headers are rare. */
+    if (header_size < 40 || header_size > 124
+        || FILE_HEADER_SIZE + (gsize) header_size > loader->file_data_len)
+        return FALSE;
+
+    loader->width = (gint32) get_u32 (data + 18);
+    height = (gint32) get_u32 (data + 22);
+    loader->bpp = get_u16 (data + 28);
+    loader->compression = get_u32 (data + 30);
+    n_colors = get_u32 (data + 46);
+
+    if (height == G_MININT32)
+        return FALSE;
+
+    loader->is_top_down = height < 0;
+    loader->height = ABS (height);
+
+    if (loader->width < 1 || loader->width > DIM_MAX
+        || loader->height < 1 || loader->height > DIM_MAX
+        || loader->width * (guint64) loader->height > N_PIXELS_MAX)
+        return FALSE;
+
+    ofs = FILE_HEADER_SIZE + header_size;
+
+    switch (loader->compression)
+    {
+        case BMP_COMPRESSION_RGB:
+            if (loader->bpp != 1 && loader->bpp != 4 && loader->bpp != 8
+                && loader->bpp != 16 && loader->bpp != 24 && loader->bpp != 32)
+                return FALSE;
+            if (loader->bpp == 16 || loader->bpp == 32)
+                set_default_masks (loader);
+            break;
+        case BMP_COMPRESSION_RLE8:
+            if (loader->bpp != 8 || loader->is_top_down)
+                return FALSE;
+            break;
+        case BMP_COMPRESSION_RLE4:
+            if (loader->bpp != 4 || loader->is_top_down)
+                return FALSE;
+            break;
+        case BMP_COMPRESSION_BITFIELDS:
+        case BMP_COMPRESSION_ALPHABITFIELDS:
+            if (loader->bpp != 16 && loader->bpp != 32)
+                return FALSE;
+            if (!load_masks (loader, header_size, &ofs))
+                return FALSE;
+            break;
+        default:
+            return FALSE;
+    }
+
+    if (loader->bpp <= 8 && !load_palette (loader, n_colors, ofs))
+        return FALSE;
+
+    if (data_ofs >= loader->file_data_len)
+        return FALSE;
+
+    loader->raster = data + data_ofs;
+    loader->raster_len = loader->file_data_len - data_ofs;
+    loader->raster_rowstride = ((loader->width * (guint64) loader->bpp + 31) / 32) * 4;
+
+    /* Compressed images may end early; the rest is transparent */
+    if (loader->compression != BMP_COMPRESSION_RLE8
+        && loader->compression != BMP_COMPRESSION_RLE4
+        && loader->raster_len < (gsize) loader->raster_rowstride * loader->height)
+        return FALSE;
+
+    return TRUE;
+}
+
+/* --- Decoding --- */
+
+static const guint8 *
+get_raster_row (ChicleBmpLoader *loader, gint y)
+{
+    if (!loader->is_top_down)
+        y = loader->height - 1 - y;
+
+    return loader->raster + (gsize) y * loader->raster_rowstride;
+}
+
+static void
+unpack_indices (ChicleBmpLoader *loader)
+{
+    gint x, y;
+
+    loader->index_data_owned = g_malloc ((gsize) loader->width * loader->height);
+    loader->index_data = loader->index_data_owned;
+    loader->index_rowstride = loader->width;
+
+    for (y = 0; y < loader->height; y++)
+    {
+        const guint8 *src = get_raster_row (loader, y);
+        guint8 *dest = loader->index_data_owned + (gsize) y * loader->width;
+
+        if (loader->bpp == 8)
+        {
+            memcpy (dest, src, loader->width);
+        }
+        else if (loader->bpp == 4)
+        {
+            for (x = 0; x < loader->width; x++)
+                dest [x] = (src [x / 2] >> ((x & 1) ? 0 : 4)) & 0x0f;
+        }
+        else
+        {
+            for (x = 0; x < loader->width; x++)
+                dest [x] = (src [x / 8] >> (7 - (x & 7))) & 1;
+        }
+    }
+}
+
+/* Pixels skipped by the RLE stream get an extra transparent palette entry
+ * if there is room for one. Otherwise, they get the first color. */
+static void
+decode_rle (ChicleBmpLoader *loader)
+{
+    const guint8 *src = loader->raster;
+    const guint8 *src_end = loader->raster + loader->raster_len;
+    gboolean is_rle4 = loader->compression == BMP_COMPRESSION_RLE4;
+    gint n_palette_colors = loader->n_colors;
+    guint8 fill = 0;
+    gint x = 0, y = 0;
+
+    if (loader->n_colors < 256)
+    {
+        fill = loader->n_colors;
+        loader->colors [loader->n_colors++] = 0;
+    }
+
+    loader->index_data_owned = g_malloc ((gsize) loader->width * loader->height);
+    memset (loader->index_data_owned, fill, (gsize) loader->width * loader->height);
+    loader->index_data = loader->index_data_owned;
+    loader->index_rowstride = loader->width;
+
+#define PUT_INDEX(i) \
+    G_STMT_START { \
+        if (x < loader->width && y < loader->height) \
+            loader->index_data_owned [(gsize) (loader->height - 1 - y) * loader->width + x] \
+                = MIN ((i), n_palette_colors - 1); \
+        x++; \
+    } G_STMT_END
+
+    while (src + 2 <= src_end && y < loader->height)
+    {
+        guint n = src [0];
+        guint v = src [1];
+        guint i;
+
+        src += 2;
+
+        if (n > 0)
+        {
+            /* Run */
+            for (i = 0; i < n; i++)
+                PUT_INDEX (is_rle4 ? ((i & 1) ? v & 0x0f : v >> 4) : v);
+        }
+        else if (v == 0)
+        {
+            /* End of line */
+            x = 0;
+            y++;
+        }
+        else if (v == 1)
+        {
+            /* End of bitmap */
+            break;
+        }
+        else if (v == 2)
+        {
+            /* Delta */
+            if (src + 2 > src_end)
+                break;
+            x += src [0];
+            y += src [1];
+            src += 2;
+        }
+        else
+        {
+            /* Absolute run of v indices, padded to a 16-bit boundary */
+            guint n_bytes = is_rle4 ? (v + 1) / 2 : v;
+
+            if (src + n_bytes > src_end)
+                break;
+
+            for (i = 0; i < v; i++)
+                PUT_INDEX (is_rle4 ? ((i & 1) ? src [i / 2] & 0x0f : src [i / 2] >> 4) : src [i]);
+
+            src += n_bytes + (n_bytes & 1);
+        }
+    }
+
+#undef PUT_INDEX
+}
+
+static void
+expand_indices (ChicleBmpLoader *loader)
+{
+    guint32 pixels [256];
+    guint32 *dest;
+    gint i, x, y;
+
+    for (i = 0; i < 256; i++)
+    {
+        guint32 c = loader->colors [i];
+
+        pixels [i] = PACK_RGBA ((c >> 16) & 0xff, (c >> 8) & 0xff, c & 0xff, c >> 24);
+    }
+
+    dest = loader->frame_data = g_new (guint32, (gsize) loader->width * loader->height);
+
+    for (y = 0; y < loader->height; y++)
+    {
+        const guint8 *src = loader->index_data + (gsize) y * loader->index_rowstride;
+
+        for (x = 0; x < loader->width; x++)
+            *(dest++) = pixels [src [x]];
+    }
+}
+
+/* Copies rows top-down, for passing on packed pixels that are stored
+ * bottom-up */
+static void
+flip_rows (ChicleBmpLoader *loader)
+{
+    guint8 *dest;
+    gint y;
+
+    dest = loader->frame_data = g_malloc ((gsize) loader->raster_rowstride * loader->height);
+
+    for (y = 0; y < loader->height; y++)
+    {
+        memcpy (dest, get_raster_row (loader, y), loader->raster_rowstride);
+        dest += loader->raster_rowstride;
+    }
+}
+
+static void
+get_mask_shift_and_scale (guint32 mask, gint *shift_out, guint32 *max_out)
+{
+    gint shift = 0;
+
+    if (!mask)
+    {
+        *shift_out = 0;
+        *max_out = 0;
+        return;
+    }
+
+    while (!(mask & 1))
+    {
+        mask >>= 1;
+        shift++;
+    }
+
+    *shift_out = shift;
+    *max_out = mask;
+}
+
+/* 16- and 32-bit pixels with any masks. Without an alpha mask, pixels are
+ * opaque. */
+static void
+expand_bitfields (ChicleBmpLoader *loader)
+{
+    gint shifts [4];
+    guint32 maxes [4];
+    guint32 *dest;
+    gint i, x, y;
+
+    for (i = 0; i < 4; i++)
+        get_mask_shift_and_scale (loader->masks [i], &shifts [i], &maxes [i]);
+
+    dest = loader->frame_data = g_new (guint32, (gsize) loader->width * loader->height);
+
+    for (y = 0; y < loader->height; y++)
+    {
+        const guint8 *src = get_raster_row (loader, y);
+
+        for (x = 0; x < loader->width; x++)
+        {
+            guint32 p;
+            guint8 ch [4];
+
+            if (loader->bpp == 16)
+            {
+                p = get_u16 (src);
+                src += 2;
+            }
+            else
+            {
+                p = get_u32 (src);
+                src += 4;
+            }
+
+            /* Masks can be up to 32 bits wide, so scale in 64 bits */
+            for (i = 0; i < 4; i++)
+            {
+                if (maxes [i])
+                    ch [i] = ((guint64) ((p & loader->masks [i]) >> shifts [i]) * 255
+                              + maxes [i] / 2) / maxes [i];
+                else
+                    ch [i] = (i == 3) ? 0xff : 0;
+            }
+
+            *(dest++) = PACK_RGBA (ch [0], ch [1], ch [2], ch [3]);
+        }
+    }
+}
+
+static gboolean
+has_bgra_masks (ChicleBmpLoader *loader)
+{
+    return loader->masks [0] == 0x00ff0000
+        && loader->masks [1] == 0x0000ff00
+        && loader->masks [2] == 0x000000ff
+        && loader->masks [3] == 0xff000000;
+}
+
+static void
+prepare_frame (ChicleBmpLoader *loader)
+{
+    if (loader->bpp == 24 || (loader->bpp == 32 && has_bgra_masks (loader)))
+    {
+        loader->pixel_type = loader->bpp == 24 ? CHAFA_PIXEL_BGR8 : CHAFA_PIXEL_BGRA8_UNASSOCIATED;
+        loader->rowstride = loader->raster_rowstride;
+
+        /* Zero copy if top-down */
+        if (!loader->is_top_down)
+            flip_rows (loader);
+        return;
+    }
+
+    loader->pixel_type = CHAFA_PIXEL_RGBA8_UNASSOCIATED;
+    loader->rowstride = loader->width * 4;
+
+    if (loader->compression == BMP_COMPRESSION_RLE8
+        || loader->compression == BMP_COMPRESSION_RLE4)
+    {
+        decode_rle (loader);
+        expand_indices (loader);
+    }
+    else if (loader->bpp <= 8)
+    {
+        /* Indices aren't checked against the palette */
+        loader->n_colors = 1 << loader->bpp;
+
+        if (loader->bpp == 8 && loader->is_top_down)
+        {
+            loader->index_data = loader->raster;
+            loader->index_rowstride = loader->raster_rowstride;
+        }
+        else
+        {
+            unpack_indices (loader);
+        }
+
+        expand_indices (loader);
+    }
+    else
+    {
+        expand_bitfields (loader);
+    }
+}
+
+/* --- Public API --- */
+
+static ChicleBmpLoader *
+chicle_bmp_loader_new (void)
+{
+    return g_new0 (ChicleBmpLoader, 1);
+}
+
+ChicleBmpLoader *
+chicle_bmp_loader_new_from_mapping (ChicleFileMapping *mapping)
+{
+    ChicleBmpLoader *loader;
+
+    g_return_val_if_fail (mapping != NULL, NULL);
+
+    loader = chicle_bmp_loader_new ();
+    loader->mapping = mapping;
+
+    if (!load_header (loader))
+    {
+        g_free (loader);
+        return NULL;
+    }
+
+    prepare_frame (loader);
+    return loader;
+}
+
+void
+chicle_bmp_loader_destroy (ChicleBmpLoader *loader)
+{
+    if (loader->mapping)
+        chicle_file_mapping_destroy (loader->mapping);
+
+    g_free (loader->index_data_owned);
+    g_free (loader->frame_data);
+    g_free (loader);
+}
+
+gboolean
+chicle_bmp_loader_get_is_animation (G_GNUC_UNUSED ChicleBmpLoader *loader)
+{
+    return FALSE;
+}
+
+gconstpointer
+chicle_bmp_loader_get_frame_data (ChicleBmpLoader *loader,
+                                  ChafaPixelType *pixel_type_out,
+                                  gint *width_out,
+                                  gint *height_out,
+                                  gint *rowstride_out)
+{
+    g_return_val_if_fail (loader != NULL, NULL);
+
+    if (pixel_type_out)
+        *pixel_type_out = loader->pixel_type;
+    if (width_out)
+        *width_out = loader->width;
+    if (height_out)
+        *height_out = loader->height;
+    if (rowstride_out)
+        *rowstride_out = loader->rowstride;
+
+    return loader->frame_data ? (gconstpointer) loader->frame_data : loader->raster;
+}
+
+const guint8 *
+chicle_bmp_loader_get_frame_indices (ChicleBmpLoader *loader,
+                                     const guint32 **colors_out,
+                                     gint *n_colors_out,
+                                     gint *rowstride_out)
+{
+    g_return_val_if_fail (loader != NULL, NULL);
+
+    if (!loader->index_data)
+        return NULL;
+
+    if (colors_out)
+        *colors_out = loader->colors;
+    if (n_colors_out)
+        *n_colors_out = loader->n_colors;
+    if (rowstride_out)
+        *rowstride_out = loader->index_rowstride;
+
+    return loader->index_data;
+}
+
+gint
+chicle_bmp_loader_get_frame_delay (G_GNUC_UNUSED ChicleBmpLoader *loader)
+{
+    return 0;
+}
+
+void
+chicle_bmp_loader_goto_first_frame (G_GNUC_UNUSED ChicleBmpLoader *loader)
+{
+}
+
+gboolean
+chicle_bmp_loader_goto_next_frame (G_GNUC_UNUSED ChicleBmpLoader *loader)
+{
+    return FALSE;
+}
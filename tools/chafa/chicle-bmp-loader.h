@@ -0,0 +1,51 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* Copyright (C) 2025 Hans Petter Jansson
+ *
+ * This file is part of Chafa, a program that shows pictures on text terminals.
+ *
+ * Chafa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Chafa is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Chafa.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef __CHICLE_BMP_LOADER_H__
+#define __CHICLE_BMP_LOADER_H__
+
+#include <glib.h>
+#include "chicle-file-mapping.h"
+
+G_BEGIN_DECLS
+
+typedef struct ChicleBmpLoader ChicleBmpLoader;
+
+ChicleBmpLoader *chicle_bmp_loader_new_from_mapping (ChicleFileMapping *mapping);
+void chicle_bmp_loader_destroy (ChicleBmpLoader *loader);
+
+gboolean chicle_bmp_loader_get_is_animation (ChicleBmpLoader *loader);
+
+gconstpointer chicle_bmp_loader_get_frame_data (ChicleBmpLoader *loader,
+                                                ChafaPixelType *pixel_type_out,
+                                                gint *width_out,
+                                                gint *height_out,
+                                                gint *rowstride_out);
+const guint8 *chicle_bmp_loader_get_frame_indices (ChicleBmpLoader *loader,
+                                                   const guint32 **colors_out,
+                                                   gint *n_colors_out,
+                                                   gint *rowstride_out);
+gint chicle_bmp_loader_get_frame_delay (ChicleBmpLoader *loader);
+
+void chicle_bmp_loader_goto_first_frame (ChicleBmpLoader *loader);
+gboolean chicle_bmp_loader_goto_next_frame (ChicleBmpLoader *loader);
+
+G_END_DECLS
+
+#endif /* __CHICLE_BMP_LOADER_H__ */
@@ -74,6 +74,15 @@
 /* Size of buffer used for copying stdin to file */
 #define COPY_BUFFER_SIZE 8192
 
+/* Maximum number of bytes to move per splice () when spooling stdin */
+#define SPOOL_CHUNK_SIZE (1024 * 1024)
+
+/* On Unix, a piped stdin is copied to a file by a background thread, and
+ * we can look at the data while it's still arriving. */
+#ifdef G_OS_UNIX
+# define SPOOL_STDIN 1
+#endif
+
 /* A contiguous magic string can't be longer than this */
 #define MAGIC_LENGTH_MAX 1024
 
@@ -85,6 +94,19 @@ struct ChicleFileMapping
     gint fd;
     guint failed : 1;
     guint is_mmapped : 1;
+
+#ifdef SPOOL_STDIN
+    /* Copies stdin to fd. spool_length is the number of bytes written so
+     * far, and is final when spool_done is set. spool_error is set if the
+     * stream failed before its end. */
+    GThread *spool_thread;
+    GMutex spool_mutex;
+    GCond spool_cond;
+    gint spool_src_fd;
+    goffset spool_length;
+    GError *spool_error;
+    guint spool_done : 1;
+#endif
 };
 
 static gboolean
@@ -214,6 +236,16 @@ safe_copy (gint src_fd, gint dest_fd)
 static void
 free_file_data (ChicleFileMapping *file_mapping)
 {
+#ifdef SPOOL_STDIN
+    /* The spooler writes to fd, so it has to finish first. This waits for
+     * the end of the stream, like caching it up front would have. */
+    if (file_mapping->spool_thread)
+    {
+        g_thread_join (file_mapping->spool_thread);
+        file_mapping->spool_thread = NULL;
+    }
+#endif
+
     if (file_mapping->data)
     {
 #ifdef HAVE_MMAP
@@ -275,6 +307,13 @@ open_temp_file_in_path (const gchar *base_path)
     if (!base_path)
         return -1;
 
+#ifdef O_TMPFILE
+    /* Unnamed file that never shows up in the directory */
+    fd = g_open (base_path, O_TMPFILE | O_RDWR | O_BINARY, S_IRUSR | S_IWUSR);
+    if (fd >= 0)
+        return fd;
+#endif
+
     cache_path = g_strdup_printf ("%s%schafa-%016" G_GINT64_MODIFIER "x",
                                   base_path,
                                   G_DIR_SEPARATOR_S,
@@ -305,6 +344,184 @@ open_temp_file (void)
     return fd;
 }
 
+#ifdef SPOOL_STDIN
+
+static gint
+open_spool_file (void)
+{
+    gint fd = -1;
+
+#ifdef HAVE_MEMFD_CREATE
+    fd = memfd_create ("chafa-stdin", MFD_CLOEXEC);
+#endif
+
+    if (fd < 0)
+        fd = open_temp_file ();
+
+    return fd;
+}
+
+static gboolean
+safe_pwrite (gint fd, gconstpointer buf, gsize len, goffset ofs)
+{
+    const guint8 *buffer = buf;
+
+    while (len > 0)
+    {
+        gssize n_written = pwrite (fd, buffer, MIN (len, INT_MAX), ofs);
+
+        if (n_written < 0)
+        {
+            if (errno != EINTR)
+                return FALSE;
+        }
+        else
+        {
+            buffer += n_written;
+            len -= n_written;
+            ofs += n_written;
+        }
+    }
+
+    return TRUE;
+}
+
+/* Moves up to SPOOL_CHUNK_SIZE bytes from src_fd to dest_fd at ofs. Uses
+ * splice () to avoid copying through userspace when possible. Returns the
+ * number of bytes moved, 0 at the end of the stream, or -1 on error. Does
+ * not touch dest_fd's file position, since readers are using it. */
+static gssize
+spool_chunk (gint src_fd, gint dest_fd, goffset ofs, gboolean *use_splice, guint8 **buf)
+{
+    gssize n;
+
+#ifdef HAVE_SPLICE
+    while (*use_splice)
+    {
+        loff_t dest_ofs = ofs;
+
+        n = splice (src_fd, NULL, dest_fd, &dest_ofs, SPOOL_CHUNK_SIZE,
+                    SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (n >= 0)
+            return n;
+
+        /* Not a pipe, or the destination doesn't support it */
+        if (errno == EINVAL || errno == ENOSYS)
+            *use_splice = FALSE;
+        else if (errno != EINTR)
+            return -1;
+    }
+#endif
+
+    if (!*buf)
+        *buf = g_malloc (COPY_BUFFER_SIZE);
+
+    do
+    {
+        n = read (src_fd, *buf, COPY_BUFFER_SIZE);
+    }
+    while (n < 0 && errno == EINTR);
+
+    if (n > 0 && !safe_pwrite (dest_fd, *buf, n, ofs))
+        n = -1;
+
+    return n;
+}
+
+static gpointer
+spool_thread_func (gpointer data)
+{
+    ChicleFileMapping *file_mapping = data;
+    gboolean use_splice = TRUE;
+    guint8 *buf = NULL;
+    GError *error = NULL;
+    goffset ofs = 0;
+
+    for (;;)
+    {
+        gssize n = spool_chunk (file_mapping->spool_src_fd, file_mapping->fd, ofs,
+                                &use_splice, &buf);
+        if (n < 0)
+        {
+            gint saved_errno = errno;
+
+            error = g_error_new (G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+                                 "Could not read input stream: %s", g_strerror (saved_errno));
+            break;
+        }
+
+        if (n == 0)
+            break;
+
+        ofs += n;
+
+        g_mutex_lock (&file_mapping->spool_mutex);
+        file_mapping->spool_length = ofs;
+        g_cond_broadcast (&file_mapping->spool_cond);
+        g_mutex_unlock (&file_mapping->spool_mutex);
+    }
+
+    g_mutex_lock (&file_mapping->spool_mutex);
+    file_mapping->spool_error = error;
+    file_mapping->spool_done = TRUE;
+    g_cond_broadcast (&file_mapping->spool_cond);
+    g_mutex_unlock (&file_mapping->spool_mutex);
+
+    g_free (buf);
+    return NULL;
+}
+
+/* Waits until the first length bytes are in the file, or the stream ends.
+ * Returns the number of bytes available, or -1 if the stream failed. A
+ * failed stream is truncated, so we don't hand out any of it. */
+static goffset
+wait_for_spool (ChicleFileMapping *file_mapping, goffset length)
+{
+    goffset spool_length;
+
+    /* Once the spooler has been joined, its results can be read freely */
+    if (!file_mapping->spool_thread)
+        return file_mapping->spool_error ? -1 : G_MAXINT64;
+
+    g_mutex_lock (&file_mapping->spool_mutex);
+    while (file_mapping->spool_length < length && !file_mapping->spool_done)
+        g_cond_wait (&file_mapping->spool_cond, &file_mapping->spool_mutex);
+    spool_length = file_mapping->spool_error ? -1 : file_mapping->spool_length;
+    g_mutex_unlock (&file_mapping->spool_mutex);
+
+    return spool_length;
+}
+
+static gboolean
+spool_stdin (ChicleFileMapping *file_mapping, gint stdin_fd)
+{
+    file_mapping->fd = open_spool_file ();
+    if (file_mapping->fd < 0)
+        return FALSE;
+
+    file_mapping->spool_src_fd = stdin_fd;
+    file_mapping->spool_thread = g_thread_new ("spool-stdin", spool_thread_func, file_mapping);
+
+    /* An empty stream is an error */
+    if (wait_for_spool (file_mapping, 1) < 1)
+    {
+        free_file_data (file_mapping);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+#else
+
+static goffset
+wait_for_spool (G_GNUC_UNUSED ChicleFileMapping *file_mapping, G_GNUC_UNUSED goffset length)
+{
+    return G_MAXINT64;
+}
+
+#endif
+
 static gint
 cache_stdin (ChicleFileMapping *file_mapping, GError **error)
 {
@@ -321,6 +538,41 @@ cache_stdin (ChicleFileMapping *file_mapping, GError **error)
     setmode (stdin_fd, O_BINARY);
 #endif
 
+#ifdef SPOOL_STDIN
+    {
+        struct stat sb;
+
+        /* If stdin is a file, we can map it directly */
+        if (!fstat (stdin_fd, &sb) && S_ISREG (sb.st_mode)
+            && lseek (stdin_fd, 0, SEEK_CUR) == 0)
+        {
+            cache_fd = dup (stdin_fd);
+            if (cache_fd >= 0)
+            {
+                success = TRUE;
+                goto out;
+            }
+        }
+
+        if (spool_stdin (file_mapping, stdin_fd))
+        {
+            cache_fd = file_mapping->fd;
+            success = TRUE;
+            goto out;
+        }
+
+        /* An empty or failed stream can't be retried */
+        if (file_mapping->spool_error)
+        {
+            g_propagate_error (error, g_error_copy (file_mapping->spool_error));
+            goto out;
+        }
+
+        if (file_mapping->spool_done)
+            goto out;
+    }
+#endif
+
     /* Read from stdin */
 
     buf = g_malloc (FILE_MEMORY_CACHE_MAX);
@@ -467,6 +719,10 @@ map_or_read_file (ChicleFileMapping *file_mapping)
         if (file_mapping->fd < 0)
             goto out;
 
+        /* We need all of it */
+        if (wait_for_spool (file_mapping, G_MAXINT64) < 0)
+            goto out;
+
         t = fstat (file_mapping->fd, &sbuf);
         if (sbuf.st_size > FILE_SIZE_MAX)
             goto out;
@@ -521,6 +777,11 @@ chicle_file_mapping_new (const gchar *path)
     file_mapping->path = g_strdup (path);
     file_mapping->fd = -1;
 
+#ifdef SPOOL_STDIN
+    g_mutex_init (&file_mapping->spool_mutex);
+    g_cond_init (&file_mapping->spool_cond);
+#endif
+
     return file_mapping;
 }
 
@@ -528,6 +789,13 @@ void
 chicle_file_mapping_destroy (ChicleFileMapping *file_mapping)
 {
     free_file_data (file_mapping);
+
+#ifdef SPOOL_STDIN
+    g_clear_error (&file_mapping->spool_error);
+    g_mutex_clear (&file_mapping->spool_mutex);
+    g_cond_clear (&file_mapping->spool_cond);
+#endif
+
     g_free (file_mapping->path);
     g_free (file_mapping);
 }
@@ -551,6 +819,22 @@ chicle_file_mapping_open_now (ChicleFileMapping *file_mapping, GError **error)
     return FALSE;
 }
 
+/* Returns TRUE if the file could not be read in full, and sets error to
+ * the reason if known */
+gboolean
+chicle_file_mapping_get_error (ChicleFileMapping *file_mapping, GError **error)
+{
+#ifdef SPOOL_STDIN
+    if (wait_for_spool (file_mapping, 0) < 0)
+    {
+        g_propagate_error (error, g_error_copy (file_mapping->spool_error));
+        return TRUE;
+    }
+#endif
+
+    return file_mapping->failed ? TRUE : FALSE;
+}
+
 const gchar *
 chicle_file_mapping_get_path (ChicleFileMapping *file_mapping)
 {
@@ -589,6 +873,9 @@ chicle_file_mapping_taste (ChicleFileMapping *file_mapping, gpointer out, goffse
     if (file_mapping->fd < 0)
         return FALSE;
 
+    if (wait_for_spool (file_mapping, ofs + length) < 0)
+        return FALSE;
+
     if (lseek (file_mapping->fd, ofs, SEEK_SET) != ofs)
         return FALSE;
 
@@ -620,6 +907,9 @@ chicle_file_mapping_read (ChicleFileMapping *file_mapping, gpointer out, goffset
     if (file_mapping->fd < 0)
         return -1;
 
+    if (wait_for_spool (file_mapping, ofs + length) < 0)
+        return -1;
+
     if (lseek (file_mapping->fd, ofs, SEEK_SET) != ofs)
         return -1;
 
@@ -649,6 +939,9 @@ chicle_file_mapping_has_magic (ChicleFileMapping *file_mapping, goffset ofs, gco
     if (file_mapping->fd < 0)
         return FALSE;
 
+    if (wait_for_spool (file_mapping, ofs + length) < 0)
+        return FALSE;
+
     if (lseek (file_mapping->fd, ofs, SEEK_SET) != ofs)
         return FALSE;
 
@@ -30,6 +30,7 @@ ChicleFileMapping *chicle_file_mapping_new (const gchar *path);
 void chicle_file_mapping_destroy (ChicleFileMapping *file_mapping);
 
 gboolean chicle_file_mapping_open_now (ChicleFileMapping *file_mapping, GError **error);
+gboolean chicle_file_mapping_get_error (ChicleFileMapping *file_mapping, GError **error);
 
 const gchar *chicle_file_mapping_get_path (ChicleFileMapping *file_mapping);
 
@@ -0,0 +1,214 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* Copyright (C) 2018-2025 Hans Petter Jansson
+ *
+ * This file is part of Chafa, a program that shows pictures on text terminals.
+ *
+ * Chafa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Chafa is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Chafa.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "config.h"
+#include <string.h>
+#include <chafa.h>
+#include "chicle-frame-pipeline.h"
+
+/* Draws and prints consecutive animation frames concurrently, each on its
+ * own canvas, and hands the output back in the order the frames were pushed.
+ * This complements the row parallelism in libchafa, which runs out of
+ * rows to share with small canvases.
+ *
+ * Frames must not depend on each other's output, so rate control and the
+ * like can't be used with it. */
+
+typedef struct
+{
+    ChafaCanvasConfig *config;
+    ChafaPlacement *placement;
+    gpointer user_data;
+    GString **output;
+    guint in_use : 1;
+    guint is_done : 1;
+}
+Slot;
+
+struct ChicleFramePipeline
+{
+    GThreadPool *thread_pool;
+    ChafaTermInfo *term_info;
+    GDestroyNotify user_data_free_func;
+    GMutex mutex;
+    GCond cond;
+    Slot *slot_ring;
+    gint first_slot;
+    gint n_slots;
+    gint n_queued;
+};
+
+static void
+thread_func (gpointer data, gpointer user_data)
+{
+    Slot *slot = data;
+    ChicleFramePipeline *pipeline = user_data;
+    ChafaCanvas *canvas;
+    GString **output = NULL;
+
+    /* The slot's frame is ours until we mark it done. Setting the placement
+     * draws it, which is most of the work. */
+    canvas = chafa_canvas_new (slot->config);
+    chafa_canvas_set_placement (canvas, slot->placement);
+    chafa_canvas_print_rows (canvas, pipeline->term_info, &output, NULL);
+    chafa_canvas_unref (canvas);
+
+    g_mutex_lock (&pipeline->mutex);
+
+    chafa_placement_unref (slot->placement);
+    chafa_canvas_config_unref (slot->config);
+    slot->placement = NULL;
+    slot->config = NULL;
+    slot->output = output;
+    slot->is_done = TRUE;
+
+    g_cond_broadcast (&pipeline->cond);
+    g_mutex_unlock (&pipeline->mutex);
+}
+
+static gint
+nth_slot (ChicleFramePipeline *pipeline, gint n)
+{
+    return (pipeline->first_slot + n) % (pipeline->n_slots);
+}
+
+ChicleFramePipeline *
+chicle_frame_pipeline_new (ChafaTermInfo *term_info, gint n_slots,
+                           GDestroyNotify user_data_free_func)
+{
+    ChicleFramePipeline *pipeline;
+
+    g_return_val_if_fail (term_info != NULL, NULL);
+    g_return_val_if_fail (n_slots > 0, NULL);
+
+    pipeline = g_new0 (ChicleFramePipeline, 1);
+
+    pipeline->n_slots = n_slots;
+    pipeline->slot_ring = g_new0 (Slot, pipeline->n_slots);
+    chafa_term_info_ref (term_info);
+    pipeline->term_info = term_info;
+    pipeline->user_data_free_func = user_data_free_func;
+    g_mutex_init (&pipeline->mutex);
+    g_cond_init (&pipeline->cond);
+    pipeline->thread_pool = g_thread_pool_new ((GFunc) thread_func,
+                                               (gpointer) pipeline,
+                                               pipeline->n_slots,
+                                               FALSE,
+                                               NULL);
+    return pipeline;
+}
+
+void
+chicle_frame_pipeline_destroy (ChicleFramePipeline *pipeline)
+{
+    gint i;
+
+    /* Lets frames in progress finish, so we can free them below */
+    g_thread_pool_free (pipeline->thread_pool, FALSE, TRUE);
+    g_mutex_clear (&pipeline->mutex);
+    g_cond_clear (&pipeline->cond);
+
+    for (i = 0; i < pipeline->n_slots; i++)
+    {
+        Slot *slot = &pipeline->slot_ring [i];
+
+        if (!slot->in_use)
+            continue;
+
+        if (slot->output)
+            chafa_free_gstring_array (slot->output);
+        if (slot->user_data && pipeline->user_data_free_func)
+            pipeline->user_data_free_func (slot->user_data);
+    }
+
+    chafa_term_info_unref (pipeline->term_info);
+    g_free (pipeline->slot_ring);
+    g_free (pipeline);
+}
+
+gboolean
+chicle_frame_pipeline_is_full (ChicleFramePipeline *pipeline)
+{
+    return pipeline->n_queued >= pipeline->n_slots;
+}
+
+/* Takes ownership of the config and placement. A worker draws the placement
+ * on a new canvas with the config, so the placement's image must not borrow
+ * pixels that may change before that. */
+void
+chicle_frame_pipeline_push (ChicleFramePipeline *pipeline,
+                            ChafaCanvasConfig *config,
+                            ChafaPlacement *placement,
+                            gpointer user_data)
+{
+    Slot *slot;
+
+    g_return_if_fail (config != NULL);
+    g_return_if_fail (placement != NULL);
+    g_return_if_fail (!chicle_frame_pipeline_is_full (pipeline));
+
+    g_mutex_lock (&pipeline->mutex);
+
+    slot = &pipeline->slot_ring [nth_slot (pipeline, pipeline->n_queued)];
+    memset (slot, 0, sizeof (*slot));
+    slot->config = config;
+    slot->placement = placement;
+    slot->user_data = user_data;
+    slot->in_use = TRUE;
+    pipeline->n_queued++;
+
+    g_mutex_unlock (&pipeline->mutex);
+
+    g_thread_pool_push (pipeline->thread_pool, slot, NULL);
+}
+
+/* Waits for the oldest frame to finish and returns its output. Returns NULL
+ * if there are no frames in the pipeline. */
+GString **
+chicle_frame_pipeline_pop (ChicleFramePipeline *pipeline,
+                           gpointer *user_data_out)
+{
+    GString **output = NULL;
+    Slot *slot;
+
+    g_mutex_lock (&pipeline->mutex);
+
+    if (pipeline->n_queued == 0)
+        goto out;
+
+    slot = &pipeline->slot_ring [nth_slot (pipeline, 0)];
+
+    while (!slot->is_done)
+        g_cond_wait (&pipeline->cond, &pipeline->mutex);
+
+    output = slot->output;
+
+    if (user_data_out)
+        *user_data_out = slot->user_data;
+    else if (slot->user_data && pipeline->user_data_free_func)
+        pipeline->user_data_free_func (slot->user_data);
+
+    memset (slot, 0, sizeof (*slot));
+    pipeline->first_slot = nth_slot (pipeline, 1);
+    pipeline->n_queued--;
+
+out:
+    g_mutex_unlock (&pipeline->mutex);
+    return output;
+}
@@ -0,0 +1,44 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* Copyright (C) 2018-2025 Hans Petter Jansson
+ *
+ * This file is part of Chafa, a program that shows pictures on text terminals.
+ *
+ * Chafa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Chafa is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Chafa.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef __CHICLE_FRAME_PIPELINE_H__
+#define __CHICLE_FRAME_PIPELINE_H__
+
+#include <chafa.h>
+
+G_BEGIN_DECLS
+
+typedef struct ChicleFramePipeline ChicleFramePipeline;
+
+ChicleFramePipeline *chicle_frame_pipeline_new (ChafaTermInfo *term_info,
+                                                gint n_slots,
+                                                GDestroyNotify user_data_free_func);
+void chicle_frame_pipeline_destroy (ChicleFramePipeline *pipeline);
+
+gboolean chicle_frame_pipeline_is_full (ChicleFramePipeline *pipeline);
+void chicle_frame_pipeline_push (ChicleFramePipeline *pipeline,
+                                 ChafaCanvasConfig *config,
+                                 ChafaPlacement *placement,
+                                 gpointer user_data);
+GString **chicle_frame_pipeline_pop (ChicleFramePipeline *pipeline,
+                                     gpointer *user_data_out);
+
+G_END_DECLS
+
+#endif /* __CHICLE_FRAME_PIPELINE_H__ */
@@ -31,6 +31,7 @@
 #include <chafa.h>
 #include <libnsgif.h>
 #include "chicle-gif-loader.h"
+#include "chicle-util.h"
 
 #define BYTES_PER_PIXEL 4
 #define IMAGE_BUFFER_SIZE_MAX (0xffffffffU >> 2)
@@ -43,9 +44,18 @@ struct ChicleGifLoader
     gif_animation gif;
     gif_result code;
     gint current_frame_index;
+
+    /* The current frame as palette indices, made on demand */
+    guint8 *index_data;
+    gsize index_data_size;
+    guint32 index_colors [256];
+    gint n_index_colors;
+
     guint gif_is_initialized : 1;
     guint frame_is_decoded : 1;
     guint frame_is_success : 1;
+    guint frame_is_indexed : 1;
+    guint frame_has_indices : 1;
 };
 
 static void *
@@ -188,6 +198,7 @@ chicle_gif_loader_destroy (ChicleGifLoader *loader)
     if (loader->gif_is_initialized)
         gif_finalise (&loader->gif);
 
+    g_free (loader->index_data);
     g_free (loader);
 }
 
@@ -225,6 +236,57 @@ chicle_gif_loader_get_frame_data (ChicleGifLoader *loader,
     return loader->gif.frame_image;
 }
 
+/* libnsgif composites each frame into RGBA, and frames may use different
+ * local palettes, so we recover the indices from the composited pixels. This
+ * is cheap compared to quantizing them, and fails if there turn out to be
+ * more than 256 colors. */
+const guint8 *
+chicle_gif_loader_get_frame_indices (ChicleGifLoader *loader,
+                                     const guint32 **colors_out,
+                                     gint *n_colors_out,
+                                     gint *rowstride_out)
+{
+    g_return_val_if_fail (loader != NULL, NULL);
+    g_return_val_if_fail (loader->gif_is_initialized, NULL);
+
+    if (!maybe_decode_frame (loader))
+        return NULL;
+
+    if (!loader->frame_is_indexed)
+    {
+        gsize size = (gsize) loader->gif.width * loader->gif.height;
+
+        /* The canvas may grow as frames are decoded */
+        if (size > loader->index_data_size)
+        {
+            g_free (loader->index_data);
+            loader->index_data = g_malloc (size);
+            loader->index_data_size = size;
+        }
+
+        loader->frame_has_indices = chicle_index_rgba8 (loader->gif.frame_image,
+                                                        loader->gif.width,
+                                                        loader->gif.height,
+                                                        loader->gif.width * 4,
+                                                        loader->index_data,
+                                                        loader->index_colors,
+                                                        &loader->n_index_colors);
+        loader->frame_is_indexed = TRUE;
+    }
+
+    if (!loader->frame_has_indices)
+        return NULL;
+
+    if (colors_out)
+        *colors_out = loader->index_colors;
+    if (n_colors_out)
+        *n_colors_out = loader->n_index_colors;
+    if (rowstride_out)
+        *rowstride_out = loader->gif.width;
+
+    return loader->index_data;
+}
+
 gint
 chicle_gif_loader_get_frame_delay (ChicleGifLoader *loader)
 {
@@ -249,18 +311,34 @@ chicle_gif_loader_get_frame_delay (ChicleGifLoader *loader)
     return frame_delay_ms;
 }
 
+gboolean
+chicle_gif_loader_goto_frame (ChicleGifLoader *loader, gint frame_index)
+{
+    g_return_val_if_fail (loader != NULL, FALSE);
+    g_return_val_if_fail (loader->gif_is_initialized, FALSE);
+
+    if (frame_index < 0 || frame_index >= (gint) loader->gif.frame_count)
+        return FALSE;
+
+    if (frame_index == loader->current_frame_index)
+        return TRUE;
+
+    /* Decoding is deferred until the frame data is requested. libnsgif
+     * picks up from the closest keyframe, so this is cheap in any order. */
+    loader->current_frame_index = frame_index;
+    loader->frame_is_decoded = FALSE;
+    loader->frame_is_success = FALSE;
+    loader->frame_is_indexed = FALSE;
+    return TRUE;
+}
+
 void
 chicle_gif_loader_goto_first_frame (ChicleGifLoader *loader)
 {
     g_return_if_fail (loader != NULL);
     g_return_if_fail (loader->gif_is_initialized);
 
-    if (loader->current_frame_index == 0)
-        return;
-
-    loader->current_frame_index = 0;
-    loader->frame_is_decoded = FALSE;
-    loader->frame_is_success = FALSE;
+    chicle_gif_loader_goto_frame (loader, 0);
 }
 
 gboolean
@@ -269,10 +347,5 @@ chicle_gif_loader_goto_next_frame (ChicleGifLoader *loader)
     g_return_val_if_fail (loader != NULL, FALSE);
     g_return_val_if_fail (loader->gif_is_initialized, FALSE);
 
-    if (loader->current_frame_index + 1 >= (gint) loader->gif.frame_count)
-        return FALSE;
-
-    loader->current_frame_index++;
-    loader->frame_is_decoded = FALSE;
-    return TRUE;
+    return chicle_gif_loader_goto_frame (loader, loader->current_frame_index + 1);
 }
@@ -37,10 +37,15 @@ gconstpointer chicle_gif_loader_get_frame_data (ChicleGifLoader *loader,
                                                 gint *width_out,
                                                 gint *height_out,
                                                 gint *rowstride_out);
+const guint8 *chicle_gif_loader_get_frame_indices (ChicleGifLoader *loader,
+                                                   const guint32 **colors_out,
+                                                   gint *n_colors_out,
+                                                   gint *rowstride_out);
 gint chicle_gif_loader_get_frame_delay (ChicleGifLoader *loader);
 
 void chicle_gif_loader_goto_first_frame (ChicleGifLoader *loader);
 gboolean chicle_gif_loader_goto_next_frame (ChicleGifLoader *loader);
+gboolean chicle_gif_loader_goto_frame (ChicleGifLoader *loader, gint frame_index);
 
 G_END_DECLS
 
@@ -31,39 +31,146 @@
 #include <chafa.h>
 #include <libheif/heif.h>
 #include "chicle-heif-loader.h"
+#include "chicle-util.h"
 
 #define BYTES_PER_PIXEL 4
 #define IMAGE_BUFFER_SIZE_MAX (0xffffffffU >> 2)
 
+typedef struct
+{
+    struct heif_image *image;
+    const uint8_t *data;
+    gint width, height;
+    gint stride;
+}
+HeifFrame;
+
 struct ChicleHeifLoader
 {
     ChicleFileMapping *mapping;
     const guint8 *file_data;
     size_t file_data_len;
-    gint width, height;
-    gint stride;
 
     struct heif_context *ctx;
     struct heif_image_handle *handle;
-    struct heif_image *image;
-    const uint8_t *frame_data;
+
+    /* The primary image is decoded on first use */
+    HeifFrame frame;
+    guint tried_decode : 1;
+
+    HeifFrame thumb_frame;
 };
 
+static void
+free_heif_frame (HeifFrame *frame)
+{
+    if (frame->image)
+        heif_image_release (frame->image);
+
+    memset (frame, 0, sizeof (*frame));
+}
+
 static void
 free_heif_handles (ChicleHeifLoader *loader)
 {
-    if (loader->image)
-        heif_image_release (loader->image);
+    free_heif_frame (&loader->frame);
+    free_heif_frame (&loader->thumb_frame);
+
     if (loader->handle)
         heif_image_handle_release (loader->handle);
     if (loader->ctx)
         heif_context_free (loader->ctx);
 
-    loader->image = NULL;
     loader->handle = NULL;
     loader->ctx = NULL;
 }
 
+static gboolean
+decode_frame (struct heif_image_handle *handle, HeifFrame *frame)
+{
+    heif_decode_image (handle,
+                       &frame->image,
+                       heif_colorspace_RGB,
+                       heif_chroma_interleaved_RGBA,
+                       NULL);
+    if (!frame->image)
+        goto fail;
+
+    frame->width = heif_image_get_primary_width (frame->image);
+    frame->height = heif_image_get_primary_height (frame->image);
+
+    if (frame->width < 1 || frame->width >= (1 << 28)
+        || frame->height < 1 || frame->height >= (1 << 28))
+        goto fail;
+
+    if ((unsigned int) frame->width * frame->height * BYTES_PER_PIXEL > IMAGE_BUFFER_SIZE_MAX)
+        goto fail;
+
+    frame->data = heif_image_get_plane_readonly (frame->image,
+                                                 heif_channel_interleaved,
+                                                 &frame->stride);
+    if (!frame->data || frame->stride < 1)
+        goto fail;
+
+    return TRUE;
+
+fail:
+    free_heif_frame (frame);
+    return FALSE;
+}
+
+/* Picks the smallest usable thumbnail item attached to the primary image.
+ * The handle sizes include any transformations, so they can be compared
+ * directly. */
+static struct heif_image_handle *
+get_thumbnail_handle (ChicleHeifLoader *loader, gint min_width, gint min_height)
+{
+    struct heif_image_handle *best = NULL;
+    heif_item_id *ids;
+    gint image_width, image_height;
+    gint n_ids, i;
+
+    n_ids = heif_image_handle_get_number_of_thumbnails (loader->handle);
+    if (n_ids < 1)
+        return NULL;
+
+    image_width = heif_image_handle_get_width (loader->handle);
+    image_height = heif_image_handle_get_height (loader->handle);
+
+    ids = g_new (heif_item_id, n_ids);
+    n_ids = heif_image_handle_get_list_of_thumbnail_IDs (loader->handle, ids, n_ids);
+
+    for (i = 0; i < n_ids; i++)
+    {
+        struct heif_image_handle *thumb = NULL;
+        gint width, height;
+
+        if (heif_image_handle_get_thumbnail (loader->handle, ids [i], &thumb).code
+            != heif_error_Ok || !thumb)
+            continue;
+
+        width = heif_image_handle_get_width (thumb);
+        height = heif_image_handle_get_height (thumb);
+
+        if (chicle_thumbnail_is_usable (width, height, image_width, image_height,
+                                        min_width, min_height)
+            && (!best || width * height < heif_image_handle_get_width (best)
+                * heif_image_handle_get_height (best)))
+        {
+            if (best)
+                heif_image_handle_release (best);
+            best = thumb;
+        }
+        else
+        {
+            heif_image_handle_release (thumb);
+        }
+    }
+
+    g_free (ids);
+    return best;
+}
+
 static ChicleHeifLoader *
 chicle_heif_loader_new (void)
 {
@@ -106,29 +213,8 @@ chicle_heif_loader_new_from_mapping (ChicleFileMapping *mapping)
     if (!loader->handle)
         goto out;
 
-    heif_decode_image (loader->handle,
-                       &loader->image,
-                       heif_colorspace_RGB,
-                       heif_chroma_interleaved_RGBA,
-                       NULL);
-    if (!loader->image)
-        goto out;
-
-    loader->width = heif_image_get_primary_width (loader->image);
-    loader->height = heif_image_get_primary_height (loader->image);
-
-    if (loader->width < 1 || loader->width >= (1 << 28)
-        || loader->height < 1 || loader->height >= (1 << 28))
-        goto out;
-
-    if ((unsigned int) loader->width * loader->height * BYTES_PER_PIXEL > IMAGE_BUFFER_SIZE_MAX)
-        goto out;
-
-    loader->frame_data = heif_image_get_plane_readonly (loader->image,
-                                                        heif_channel_interleaved,
-                                                        &loader->stride);
-    if (!loader->frame_data || loader->stride < 1)
-        goto out;
+    /* The image data is decoded when it's first requested, so we can skip
+     * it if a thumbnail will do */
 
     success = TRUE;
 
@@ -165,6 +251,31 @@ chicle_heif_loader_get_is_animation (ChicleHeifLoader *loader)
     return FALSE;
 }
 
+static gconstpointer
+get_heif_frame_data (HeifFrame *frame,
+                     ChafaPixelType *pixel_type_out,
+                     gint *width_out,
+                     gint *height_out,
+                     gint *rowstride_out)
+{
+    if (!frame->data)
+        return NULL;
+
+    if (pixel_type_out)
+    {
+        *pixel_type_out = heif_image_is_premultiplied_alpha (frame->image)
+            ? CHAFA_PIXEL_RGBA8_PREMULTIPLIED : CHAFA_PIXEL_RGBA8_UNASSOCIATED;
+    }
+    if (width_out)
+        *width_out = frame->width;
+    if (height_out)
+        *height_out = frame->height;
+    if (rowstride_out)
+        *rowstride_out = frame->stride;
+
+    return frame->data;
+}
+
 gconstpointer
 chicle_heif_loader_get_frame_data (ChicleHeifLoader *loader,
                                    ChafaPixelType *pixel_type_out,
@@ -174,19 +285,47 @@ chicle_heif_loader_get_frame_data (ChicleHeifLoader *loader,
 {
     g_return_val_if_fail (loader != NULL, NULL);
 
-    if (pixel_type_out)
+    if (!loader->tried_decode)
     {
-        *pixel_type_out = heif_image_is_premultiplied_alpha (loader->image)
-            ? CHAFA_PIXEL_RGBA8_PREMULTIPLIED : CHAFA_PIXEL_RGBA8_UNASSOCIATED;
+        loader->tried_decode = TRUE;
+        decode_frame (loader->handle, &loader->frame);
+    }
+
+    return get_heif_frame_data (&loader->frame, pixel_type_out,
+                                width_out, height_out, rowstride_out);
+}
+
+gconstpointer
+chicle_heif_loader_get_thumbnail_frame (ChicleHeifLoader *loader,
+                                        gint min_width,
+                                        gint min_height,
+                                        ChafaPixelType *pixel_type_out,
+                                        gint *width_out,
+                                        gint *height_out,
+                                        gint *rowstride_out)
+{
+    g_return_val_if_fail (loader != NULL, NULL);
+
+    /* A thumbnail picked for an earlier, smaller target may not do */
+    if (loader->thumb_frame.data
+        && !chicle_thumbnail_covers (loader->thumb_frame.width, loader->thumb_frame.height,
+                                     min_width, min_height))
+        free_heif_frame (&loader->thumb_frame);
+
+    if (!loader->thumb_frame.data)
+    {
+        struct heif_image_handle *thumb;
+
+        thumb = get_thumbnail_handle (loader, min_width, min_height);
+        if (!thumb)
+            return NULL;
+
+        decode_frame (thumb, &loader->thumb_frame);
+        heif_image_handle_release (thumb);
     }
-    if (width_out)
-        *width_out = loader->width;
-    if (height_out)
-        *height_out = loader->height;
-    if (rowstride_out)
-        *rowstride_out = loader->stride;
 
-    return loader->frame_data;
+    return get_heif_frame_data (&loader->thumb_frame, pixel_type_out,
+                                width_out, height_out, rowstride_out);
 }
 
 gint
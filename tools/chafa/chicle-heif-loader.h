@@ -37,6 +37,13 @@ gconstpointer chicle_heif_loader_get_frame_data (ChicleHeifLoader *loader,
                                                  gint *width_out,
                                                  gint *height_out,
                                                  gint *rowstride_out);
+gconstpointer chicle_heif_loader_get_thumbnail_frame (ChicleHeifLoader *loader,
+                                                      gint min_width,
+                                                      gint min_height,
+                                                      ChafaPixelType *pixel_type_out,
+                                                      gint *width_out,
+                                                      gint *height_out,
+                                                      gint *rowstride_out);
 gint chicle_heif_loader_get_frame_delay (ChicleHeifLoader *loader);
 
 void chicle_heif_loader_goto_first_frame (ChicleHeifLoader *loader);
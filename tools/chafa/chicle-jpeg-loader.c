@@ -48,10 +48,34 @@ struct JpegLoader
     ChicleFileMapping *mapping;
     const guint8 *file_data;
     size_t file_data_len;
+    ChicleRotationType rotation;
+
+    /* Undecoded dimensions of the main image */
+    guint image_width, image_height;
+
+    /* The main image is decoded on first use */
     gpointer frame_data;
     gint width, height, rowstride;
+    guint tried_decode : 1;
+
+    gpointer thumb_data;
+    gint thumb_width, thumb_height, thumb_rowstride;
 };
 
+/* An embedded thumbnail. It's either a complete JPEG stream or packed RGB8
+ * (from JFIF and JFXX). Dimensions are before orientation is applied. */
+typedef struct
+{
+    const guint8 *data;
+    gsize data_len;
+    guint width, height;
+    gboolean is_rgb;
+}
+JpegThumbnail;
+
+/* Exif, JFIF and JFXX can each contribute one */
+#define N_THUMBNAILS_MAX 3
+
 /* ----------------------- *
  * Exif orientation reader *
  * ----------------------- */
@@ -274,13 +298,7 @@ have_any_apptype_magic (ChicleFileMapping *mapping)
     return chicle_file_mapping_has_magic (mapping, 0, magic, 4);
 }
 
-/* --- Loader --- */
-
-static JpegLoader *
-chicle_jpeg_loader_new (void)
-{
-    return g_new0 (JpegLoader, 1);
-}
+/* --- Decoder --- */
 
 static guchar
 convert_cmyk_ch_to_rgb (gint k, gint cmy)
@@ -314,36 +332,56 @@ convert_cmyk_row_to_rgb (const guchar *cmyk, guchar *rgb, gint width)
         convert_cmyk_pixel_to_rgb (cmyk + 4 * i, rgb + 3 * i);
 }
 
-JpegLoader *
-chicle_jpeg_loader_new_from_mapping (ChicleFileMapping *mapping)
+static gboolean
+read_jpeg_size (const guint8 *data, gsize data_len, guint *width_out, guint *height_out)
 {
-    guint width, height;
-    guint rowstride;
     struct jpeg_decompress_struct cinfo = { 0 };
     struct my_jpeg_error_mgr my_jerr;
-    JpegLoader * volatile loader = NULL;
-    gpointer frame_data = NULL;
-    volatile gboolean convert_cmyk_to_rgb = FALSE;
-    guchar *cmyk_buf = NULL;
     volatile gboolean have_decompress = FALSE;
     volatile gboolean success = FALSE;
 
-    g_return_val_if_fail (mapping != NULL, NULL);
-
-    /* Check magic */
+    cinfo.err = jpeg_std_error ((struct jpeg_error_mgr *) &my_jerr);
+    my_jerr.jerr.error_exit = my_jpeg_error_exit;
+    my_jerr.jerr.output_message = my_jpeg_output_message;
 
-    if (!have_any_apptype_magic (mapping))
+    if (setjmp (my_jerr.setjmp_buffer))
         goto out;
 
-    loader = chicle_jpeg_loader_new ();
-    loader->mapping = mapping;
+    jpeg_create_decompress (&cinfo);
+    have_decompress = TRUE;
 
-    /* Get file data */
+    my_jpeg_mem_src (&cinfo, data, data_len);
+    (void) jpeg_read_header (&cinfo, TRUE);
 
-    loader->file_data = chicle_file_mapping_get_data (loader->mapping, &loader->file_data_len);
-    if (!loader->file_data)
+    if (cinfo.image_width < 1 || cinfo.image_height < 1)
         goto out;
 
+    *width_out = cinfo.image_width;
+    *height_out = cinfo.image_height;
+    success = TRUE;
+
+out:
+    if (have_decompress)
+        jpeg_destroy_decompress (&cinfo);
+
+    return success;
+}
+
+static gboolean
+decode_jpeg (const guint8 *data, gsize data_len,
+             gpointer *frame_data_out, guint *width_out, guint *height_out,
+             guint *rowstride_out)
+{
+    guint width, height;
+    guint rowstride;
+    struct jpeg_decompress_struct cinfo = { 0 };
+    struct my_jpeg_error_mgr my_jerr;
+    gpointer volatile frame_data = NULL;
+    volatile gboolean convert_cmyk_to_rgb = FALSE;
+    guchar * volatile cmyk_buf = NULL;
+    volatile gboolean have_decompress = FALSE;
+    volatile gboolean success = FALSE;
+
     /* Prepare to decode */
 
     cinfo.err = jpeg_std_error ((struct jpeg_error_mgr *) &my_jerr);
@@ -365,7 +403,7 @@ chicle_jpeg_loader_new_from_mapping (ChicleFileMapping *mapping)
     cinfo.mem->max_memory_to_use = IMAGE_BUFFER_SIZE_MAX;
     have_decompress = TRUE;
 
-    my_jpeg_mem_src (&cinfo, loader->file_data, loader->file_data_len);
+    my_jpeg_mem_src (&cinfo, data, data_len);
     (void) jpeg_read_header (&cinfo, TRUE);
 
     if (cinfo.jpeg_color_space == JCS_CMYK
@@ -408,7 +446,9 @@ chicle_jpeg_loader_new_from_mapping (ChicleFileMapping *mapping)
 
         if (convert_cmyk_to_rgb)
         {
-            if (jpeg_read_scanlines (&cinfo, &cmyk_buf, 1) < 1)
+            guchar *cmyk_row = cmyk_buf;
+
+            if (jpeg_read_scanlines (&cinfo, &cmyk_row, 1) < 1)
                 goto out;
 
             convert_cmyk_row_to_rgb (cmyk_buf, row_data, width);
@@ -420,31 +460,249 @@ chicle_jpeg_loader_new_from_mapping (ChicleFileMapping *mapping)
         }
     }
 
-    /* Orientation and cleanup */
-
     (void) jpeg_finish_decompress (&cinfo);
 
-    chicle_rotate_image (&frame_data, &width, &height, &rowstride, 3,
-                         chicle_invert_rotation (read_orientation (loader)));
-
-    loader->frame_data = frame_data;
-    loader->width = (gint) width;
-    loader->height = (gint) height;
-    loader->rowstride = (gint) rowstride;
+    *frame_data_out = frame_data;
+    frame_data = NULL;
+    *width_out = width;
+    *height_out = height;
+    *rowstride_out = rowstride;
 
     success = TRUE;
 
 out:
     g_free (cmyk_buf);
+    g_free (frame_data);
 
     if (have_decompress)
         jpeg_destroy_decompress (&cinfo);
 
-    if (!success)
+    return success;
+}
+
+/* --- Embedded thumbnails --- */
+
+/* Looks for a JPEG thumbnail in IFD1. The pointer is to the TIFF header
+ * following the Exif marker. */
+static gboolean
+find_exif_thumbnail (const guchar *p0, gsize len, JpegThumbnail *thumb_out)
+{
+    gboolean is_big_endian;
+    guint32 ifd, ofs = 0, ofs_len = 0;
+    guint n, i;
+
+    if (len < 8)
+        return FALSE;
+
+    n = read_uint16 (p0, TRUE);
+    if (n == 0x4949)
+        is_big_endian = FALSE;
+    else if (n == 0x4d4d)
+        is_big_endian = TRUE;
+    else
+        return FALSE;
+
+    if (read_uint16 (p0 + 2, is_big_endian) != 0x002a)
+        return FALSE;
+
+    /* Skip IFD0 to get to IFD1 */
+    ifd = read_uint32 (p0 + 4, is_big_endian);
+    if (ifd > len - 2)
+        return FALSE;
+
+    n = read_uint16 (p0 + ifd, is_big_endian);
+    if ((gsize) ifd + 2 + n * 12 + 4 > len)
+        return FALSE;
+
+    ifd = read_uint32 (p0 + ifd + 2 + n * 12, is_big_endian);
+    if (ifd == 0 || ifd > len - 2)
+        return FALSE;
+
+    n = read_uint16 (p0 + ifd, is_big_endian);
+    if ((gsize) ifd + 2 + n * 12 > len)
+        return FALSE;
+
+    for (i = 0; i < n; i++)
+    {
+        const guchar *entry = p0 + ifd + 2 + i * 12;
+        guint16 tagnum = read_uint16 (entry, is_big_endian);
+
+        if (tagnum == 0x0201)  /* JPEGInterchangeFormat */
+            ofs = read_uint32 (entry + 8, is_big_endian);
+        else if (tagnum == 0x0202)  /* JPEGInterchangeFormatLength */
+            ofs_len = read_uint32 (entry + 8, is_big_endian);
+    }
+
+    if (ofs == 0 || ofs_len == 0 || ofs > len || ofs_len > len - ofs)
+        return FALSE;
+
+    thumb_out->data = p0 + ofs;
+    thumb_out->data_len = ofs_len;
+    thumb_out->is_rgb = FALSE;
+
+    return read_jpeg_size (thumb_out->data, thumb_out->data_len,
+                           &thumb_out->width, &thumb_out->height);
+}
+
+static gboolean
+set_rgb_thumbnail (const guchar *p, gsize len, JpegThumbnail *thumb_out)
+{
+    guint width = p [0], height = p [1];
+
+    if (width < 1 || height < 1 || len < 2 + width * height * 3)
+        return FALSE;
+
+    thumb_out->data = p + 2;
+    thumb_out->data_len = width * height * 3;
+    thumb_out->width = width;
+    thumb_out->height = height;
+    thumb_out->is_rgb = TRUE;
+    return TRUE;
+}
+
+/* Collects the thumbnails stored in application markers ahead of the
+ * first scan. Returns the number found. */
+static gint
+find_thumbnails (JpegLoader *loader, JpegThumbnail *thumbs)
+{
+    const guchar *p, *end;
+    gint n_thumbs = 0;
+
+    p = loader->file_data + 2;
+    end = loader->file_data + loader->file_data_len;
+
+    while (p + 4 <= end && n_thumbs < N_THUMBNAILS_MAX)
     {
-        if (frame_data)
-            g_free (frame_data);
+        guint marker = read_uint16 (p, TRUE);
+        guint seg_len = read_uint16 (p + 2, TRUE);
+        const guchar *seg = p + 4;
+        gsize payload_len;
+
+        /* Stop at start of scan, or if we lost track of the markers */
+        if ((marker & 0xff00) != 0xff00 || marker == 0xffda
+            || seg_len < 2 || seg_len > (gsize) (end - p) - 2)
+            break;
+
+        payload_len = seg_len - 2;
+
+        if (marker == 0xffe1 && payload_len > 6
+            && !memcmp (seg, "Exif\0\0", 6))
+        {
+            if (find_exif_thumbnail (seg + 6, payload_len - 6, &thumbs [n_thumbs]))
+                n_thumbs++;
+        }
+        else if (marker == 0xffe0 && payload_len >= 14
+                 && !memcmp (seg, "JFIF\0", 5))
+        {
+            /* Uncompressed RGB thumbnail after the density fields */
+            if (set_rgb_thumbnail (seg + 12, payload_len - 12, &thumbs [n_thumbs]))
+                n_thumbs++;
+        }
+        else if (marker == 0xffe0 && payload_len >= 8
+                 && !memcmp (seg, "JFXX\0", 5))
+        {
+            if (seg [5] == 0x10)
+            {
+                /* JPEG-compressed thumbnail */
+                thumbs [n_thumbs].data = seg + 6;
+                thumbs [n_thumbs].data_len = payload_len - 6;
+                thumbs [n_thumbs].is_rgb = FALSE;
+
+                if (read_jpeg_size (thumbs [n_thumbs].data, thumbs [n_thumbs].data_len,
+                                    &thumbs [n_thumbs].width, &thumbs [n_thumbs].height))
+                    n_thumbs++;
+            }
+            else if (seg [5] == 0x13)
+            {
+                if (set_rgb_thumbnail (seg + 6, payload_len - 6, &thumbs [n_thumbs]))
+                    n_thumbs++;
+            }
+        }
+
+        p += 2 + seg_len;
+    }
+
+    return n_thumbs;
+}
+
+static gboolean
+decode_thumbnail (const JpegThumbnail *thumb,
+                  gpointer *frame_data_out, guint *width_out, guint *height_out,
+                  guint *rowstride_out)
+{
+    guchar *frame_data;
+    guint rowstride, i;
+
+    if (!thumb->is_rgb)
+        return decode_jpeg (thumb->data, thumb->data_len,
+                            frame_data_out, width_out, height_out, rowstride_out);
+
+    rowstride = ROWSTRIDE_PAD (thumb->width * BYTES_PER_PIXEL);
+    frame_data = g_malloc (thumb->height * rowstride);
+
+    for (i = 0; i < thumb->height; i++)
+        memcpy (frame_data + i * rowstride,
+                thumb->data + i * thumb->width * BYTES_PER_PIXEL,
+                thumb->width * BYTES_PER_PIXEL);
+
+    *frame_data_out = frame_data;
+    *width_out = thumb->width;
+    *height_out = thumb->height;
+    *rowstride_out = rowstride;
+    return TRUE;
+}
+
+static gboolean
+rotation_swaps_axes (ChicleRotationType rot)
+{
+    return rot == CHICLE_ROTATION_90 || rot == CHICLE_ROTATION_90_MIRROR
+        || rot == CHICLE_ROTATION_270 || rot == CHICLE_ROTATION_270_MIRROR;
+}
+
+/* --- Loader --- */
+
+static JpegLoader *
+chicle_jpeg_loader_new (void)
+{
+    return g_new0 (JpegLoader, 1);
+}
+
+JpegLoader *
+chicle_jpeg_loader_new_from_mapping (ChicleFileMapping *mapping)
+{
+    JpegLoader *loader = NULL;
+    gboolean success = FALSE;
+
+    g_return_val_if_fail (mapping != NULL, NULL);
+
+    /* Check magic */
+
+    if (!have_any_apptype_magic (mapping))
+        goto out;
+
+    loader = chicle_jpeg_loader_new ();
+    loader->mapping = mapping;
+
+    /* Get file data */
+
+    loader->file_data = chicle_file_mapping_get_data (loader->mapping, &loader->file_data_len);
+    if (!loader->file_data)
+        goto out;
 
+    /* Only read the header for now. The image data is decoded when it's
+     * first requested, so we can skip it if a thumbnail will do. */
+
+    if (!read_jpeg_size (loader->file_data, loader->file_data_len,
+                         &loader->image_width, &loader->image_height))
+        goto out;
+
+    loader->rotation = read_orientation (loader);
+
+    success = TRUE;
+
+out:
+    if (!success)
+    {
         if (loader)
         {
             g_free (loader);
@@ -462,7 +720,10 @@ chicle_jpeg_loader_destroy (JpegLoader *loader)
         chicle_file_mapping_destroy (loader->mapping);
 
     if (loader->frame_data)
-        free (loader->frame_data);
+        g_free (loader->frame_data);
+
+    if (loader->thumb_data)
+        g_free (loader->thumb_data);
 
     g_free (loader);
 }
@@ -484,6 +745,29 @@ chicle_jpeg_loader_get_frame_data (JpegLoader *loader,
 {
     g_return_val_if_fail (loader != NULL, NULL);
 
+    if (!loader->tried_decode)
+    {
+        gpointer frame_data;
+        guint width, height, rowstride;
+
+        loader->tried_decode = TRUE;
+
+        if (decode_jpeg (loader->file_data, loader->file_data_len,
+                         &frame_data, &width, &height, &rowstride))
+        {
+            chicle_rotate_image (&frame_data, &width, &height, &rowstride, 3,
+                                 chicle_invert_rotation (loader->rotation));
+
+            loader->frame_data = frame_data;
+            loader->width = (gint) width;
+            loader->height = (gint) height;
+            loader->rowstride = (gint) rowstride;
+        }
+    }
+
+    if (!loader->frame_data)
+        return NULL;
+
     if (pixel_type_out)
         *pixel_type_out = CHAFA_PIXEL_RGB8;
     if (width_out)
@@ -496,6 +780,80 @@ chicle_jpeg_loader_get_frame_data (JpegLoader *loader,
     return loader->frame_data;
 }
 
+gconstpointer
+chicle_jpeg_loader_get_thumbnail_frame (JpegLoader *loader,
+                                        gint min_width,
+                                        gint min_height,
+                                        ChafaPixelType *pixel_type_out,
+                                        gint *width_out,
+                                        gint *height_out,
+                                        gint *rowstride_out)
+{
+    JpegThumbnail thumbs [N_THUMBNAILS_MAX];
+    const JpegThumbnail *best = NULL;
+    gint n_thumbs, i;
+
+    g_return_val_if_fail (loader != NULL, NULL);
+
+    /* A thumbnail picked for an earlier, smaller target may not do */
+    if (loader->thumb_data
+        && !chicle_thumbnail_covers (loader->thumb_width, loader->thumb_height,
+                                     min_width, min_height))
+    {
+        g_free (loader->thumb_data);
+        loader->thumb_data = NULL;
+    }
+
+    if (!loader->thumb_data)
+    {
+        gpointer frame_data;
+        guint width, height, rowstride;
+
+        /* Thumbnails are stored in the same orientation as the image */
+        if (rotation_swaps_axes (loader->rotation))
+        {
+            gint t = min_width;
+            min_width = min_height;
+            min_height = t;
+        }
+
+        n_thumbs = find_thumbnails (loader, thumbs);
+
+        for (i = 0; i < n_thumbs; i++)
+        {
+            if (!chicle_thumbnail_is_usable (thumbs [i].width, thumbs [i].height,
+                                             loader->image_width, loader->image_height,
+                                             min_width, min_height))
+                continue;
+
+            if (!best || thumbs [i].width * thumbs [i].height < best->width * best->height)
+                best = &thumbs [i];
+        }
+
+        if (!best || !decode_thumbnail (best, &frame_data, &width, &height, &rowstride))
+            return NULL;
+
+        chicle_rotate_image (&frame_data, &width, &height, &rowstride, 3,
+                             chicle_invert_rotation (loader->rotation));
+
+        loader->thumb_data = frame_data;
+        loader->thumb_width = (gint) width;
+        loader->thumb_height = (gint) height;
+        loader->thumb_rowstride = (gint) rowstride;
+    }
+
+    if (pixel_type_out)
+        *pixel_type_out = CHAFA_PIXEL_RGB8;
+    if (width_out)
+        *width_out = loader->thumb_width;
+    if (height_out)
+        *height_out = loader->thumb_height;
+    if (rowstride_out)
+        *rowstride_out = loader->thumb_rowstride;
+
+    return loader->thumb_data;
+}
+
 gint
 chicle_jpeg_loader_get_frame_delay (JpegLoader *loader)
 {
@@ -37,6 +37,13 @@ gconstpointer chicle_jpeg_loader_get_frame_data (JpegLoader *loader,
                                                  gint *width_out,
                                                  gint *height_out,
                                                  gint *rowstride_out);
+gconstpointer chicle_jpeg_loader_get_thumbnail_frame (JpegLoader *loader,
+                                                      gint min_width,
+                                                      gint min_height,
+                                                      ChafaPixelType *pixel_type_out,
+                                                      gint *width_out,
+                                                      gint *height_out,
+                                                      gint *rowstride_out);
 gint chicle_jpeg_loader_get_frame_delay (JpegLoader *loader);
 
 void chicle_jpeg_loader_goto_first_frame (JpegLoader *loader);
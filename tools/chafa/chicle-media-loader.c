@@ -29,12 +29,14 @@
 #include <sys/stat.h>
 
 #include <chafa.h>
+#include "chicle-bmp-loader.h"
 #include "chicle-file-mapping.h"
 #include "chicle-gif-loader.h"
 #include "chicle-xwd-loader.h"
 #include "chicle-jpeg-loader.h"
 #include "chicle-media-loader.h"
 #include "chicle-png-loader.h"
+#include "chicle-pnm-loader.h"
 #include "chicle-qoi-loader.h"
 #include "chicle-svg-loader.h"
 #include "chicle-tiff-loader.h"
@@ -50,6 +52,8 @@ typedef enum
     LOADER_TYPE_PNG,
     LOADER_TYPE_XWD,
     LOADER_TYPE_QOI,
+    LOADER_TYPE_PNM,
+    LOADER_TYPE_BMP,
     LOADER_TYPE_JPEG,
     LOADER_TYPE_TIFF,
     LOADER_TYPE_WEBP,
@@ -76,6 +80,9 @@ static const struct
     gboolean (*goto_next_frame) (gpointer);
     gconstpointer (*get_frame_data) (gpointer, gpointer, gpointer, gpointer, gpointer);
     gint (*get_frame_delay) (gpointer);
+    gconstpointer (*get_thumbnail_frame) (gpointer, gint, gint, gpointer, gpointer, gpointer, gpointer);
+    gconstpointer (*get_frame_indices) (gpointer, gpointer, gpointer, gpointer);
+    void (*get_image_size) (gpointer, gpointer, gpointer);
 }
 loader_vtable [LOADER_TYPE_LAST] =
 {
@@ -89,7 +96,9 @@ loader_vtable [LOADER_TYPE_LAST] =
         (void (*)(gpointer)) chicle_gif_loader_goto_first_frame,
         (gboolean (*)(gpointer)) chicle_gif_loader_goto_next_frame,
         (gconstpointer (*) (gpointer, gpointer, gpointer, gpointer, gpointer)) chicle_gif_loader_get_frame_data,
-        (gint (*) (gpointer)) chicle_gif_loader_get_frame_delay
+        (gint (*) (gpointer)) chicle_gif_loader_get_frame_delay,
+        (gconstpointer (*) (gpointer, gint, gint, gpointer, gpointer, gpointer, gpointer)) NULL,
+        (gconstpointer (*) (gpointer, gpointer, gpointer, gpointer)) chicle_gif_loader_get_frame_indices
     },
     [LOADER_TYPE_PNG] =
     {
@@ -101,7 +110,9 @@ loader_vtable [LOADER_TYPE_LAST] =
         (void (*)(gpointer)) chicle_png_loader_goto_first_frame,
         (gboolean (*)(gpointer)) chicle_png_loader_goto_next_frame,
         (gconstpointer (*) (gpointer, gpointer, gpointer, gpointer, gpointer)) chicle_png_loader_get_frame_data,
-        (gint (*) (gpointer)) chicle_png_loader_get_frame_delay
+        (gint (*) (gpointer)) chicle_png_loader_get_frame_delay,
+        (gconstpointer (*) (gpointer, gint, gint, gpointer, gpointer, gpointer, gpointer)) NULL,
+        (gconstpointer (*) (gpointer, gpointer, gpointer, gpointer)) chicle_png_loader_get_frame_indices
     },
     [LOADER_TYPE_XWD] =
     {
@@ -113,7 +124,8 @@ loader_vtable [LOADER_TYPE_LAST] =
         (void (*)(gpointer)) chicle_xwd_loader_goto_first_frame,
         (gboolean (*)(gpointer)) chicle_xwd_loader_goto_next_frame,
         (gconstpointer (*) (gpointer, gpointer, gpointer, gpointer, gpointer)) chicle_xwd_loader_get_frame_data,
-        (gint (*) (gpointer)) chicle_xwd_loader_get_frame_delay
+        (gint (*) (gpointer)) chicle_xwd_loader_get_frame_delay,
+        (gconstpointer (*) (gpointer, gint, gint, gpointer, gpointer, gpointer, gpointer)) NULL
     },
     [LOADER_TYPE_QOI] =
     {
@@ -125,7 +137,37 @@ loader_vtable [LOADER_TYPE_LAST] =
         (void (*)(gpointer)) chicle_qoi_loader_goto_first_frame,
         (gboolean (*)(gpointer)) chicle_qoi_loader_goto_next_frame,
         (gconstpointer (*) (gpointer, gpointer, gpointer, gpointer, gpointer)) chicle_qoi_loader_get_frame_data,
-        (gint (*) (gpointer)) chicle_qoi_loader_get_frame_delay
+        (gint (*) (gpointer)) chicle_qoi_loader_get_frame_delay,
+        (gconstpointer (*) (gpointer, gint, gint, gpointer, gpointer, gpointer, gpointer)) NULL,
+        (gconstpointer (*) (gpointer, gpointer, gpointer, gpointer)) NULL,
+        (void (*) (gpointer, gpointer, gpointer)) chicle_qoi_loader_get_image_size
+    },
+    [LOADER_TYPE_PNM] =
+    {
+        "PNM",
+        (void (*)(void)) chicle_pnm_loader_new_from_mapping,
+        (gpointer (*)(gconstpointer)) NULL,
+        (void (*)(gpointer)) chicle_pnm_loader_destroy,
+        (gboolean (*)(gpointer)) chicle_pnm_loader_get_is_animation,
+        (void (*)(gpointer)) chicle_pnm_loader_goto_first_frame,
+        (gboolean (*)(gpointer)) chicle_pnm_loader_goto_next_frame,
+        (gconstpointer (*) (gpointer, gpointer, gpointer, gpointer, gpointer)) chicle_pnm_loader_get_frame_data,
+        (gint (*) (gpointer)) chicle_pnm_loader_get_frame_delay,
+        (gconstpointer (*) (gpointer, gint, gint, gpointer, gpointer, gpointer, gpointer)) NULL
+    },
+    [LOADER_TYPE_BMP] =
+    {
+        "BMP",
+        (void (*)(void)) chicle_bmp_loader_new_from_mapping,
+        (gpointer (*)(gconstpointer)) NULL,
+        (void (*)(gpointer)) chicle_bmp_loader_destroy,
+        (gboolean (*)(gpointer)) chicle_bmp_loader_get_is_animation,
+        (void (*)(gpointer)) chicle_bmp_loader_goto_first_frame,
+        (gboolean (*)(gpointer)) chicle_bmp_loader_goto_next_frame,
+        (gconstpointer (*) (gpointer, gpointer, gpointer, gpointer, gpointer)) chicle_bmp_loader_get_frame_data,
+        (gint (*) (gpointer)) chicle_bmp_loader_get_frame_delay,
+        (gconstpointer (*) (gpointer, gint, gint, gpointer, gpointer, gpointer, gpointer)) NULL,
+        (gconstpointer (*) (gpointer, gpointer, gpointer, gpointer)) chicle_bmp_loader_get_frame_indices
     },
 #ifdef HAVE_JPEG
     [LOADER_TYPE_JPEG] =
@@ -138,7 +180,8 @@ loader_vtable [LOADER_TYPE_LAST] =
         (void (*)(gpointer)) chicle_jpeg_loader_goto_first_frame,
         (gboolean (*)(gpointer)) chicle_jpeg_loader_goto_next_frame,
         (gconstpointer (*) (gpointer, gpointer, gpointer, gpointer, gpointer)) chicle_jpeg_loader_get_frame_data,
-        (gint (*) (gpointer)) chicle_jpeg_loader_get_frame_delay
+        (gint (*) (gpointer)) chicle_jpeg_loader_get_frame_delay,
+        (gconstpointer (*) (gpointer, gint, gint, gpointer, gpointer, gpointer, gpointer)) chicle_jpeg_loader_get_thumbnail_frame
     },
 #endif
 #ifdef HAVE_SVG
@@ -152,7 +195,8 @@ loader_vtable [LOADER_TYPE_LAST] =
         (void (*)(gpointer)) chicle_svg_loader_goto_first_frame,
         (gboolean (*)(gpointer)) chicle_svg_loader_goto_next_frame,
         (gconstpointer (*) (gpointer, gpointer, gpointer, gpointer, gpointer)) chicle_svg_loader_get_frame_data,
-        (gint (*) (gpointer)) chicle_svg_loader_get_frame_delay
+        (gint (*) (gpointer)) chicle_svg_loader_get_frame_delay,
+        (gconstpointer (*) (gpointer, gint, gint, gpointer, gpointer, gpointer, gpointer)) NULL
     },
 #endif
 #ifdef HAVE_TIFF
@@ -166,7 +210,8 @@ loader_vtable [LOADER_TYPE_LAST] =
         (void (*)(gpointer)) chicle_tiff_loader_goto_first_frame,
         (gboolean (*)(gpointer)) chicle_tiff_loader_goto_next_frame,
         (gconstpointer (*) (gpointer, gpointer, gpointer, gpointer, gpointer)) chicle_tiff_loader_get_frame_data,
-        (gint (*) (gpointer)) chicle_tiff_loader_get_frame_delay
+        (gint (*) (gpointer)) chicle_tiff_loader_get_frame_delay,
+        (gconstpointer (*) (gpointer, gint, gint, gpointer, gpointer, gpointer, gpointer)) chicle_tiff_loader_get_thumbnail_frame
     },
 #endif
 #ifdef HAVE_WEBP
@@ -180,7 +225,8 @@ loader_vtable [LOADER_TYPE_LAST] =
         (void (*)(gpointer)) chicle_webp_loader_goto_first_frame,
         (gboolean (*)(gpointer)) chicle_webp_loader_goto_next_frame,
         (gconstpointer (*) (gpointer, gpointer, gpointer, gpointer, gpointer)) chicle_webp_loader_get_frame_data,
-        (gint (*) (gpointer)) chicle_webp_loader_get_frame_delay
+        (gint (*) (gpointer)) chicle_webp_loader_get_frame_delay,
+        (gconstpointer (*) (gpointer, gint, gint, gpointer, gpointer, gpointer, gpointer)) NULL
     },
 #endif
 #ifdef HAVE_AVIF
@@ -194,7 +240,8 @@ loader_vtable [LOADER_TYPE_LAST] =
         (void (*)(gpointer)) chicle_avif_loader_goto_first_frame,
         (gboolean (*)(gpointer)) chicle_avif_loader_goto_next_frame,
         (gconstpointer (*) (gpointer, gpointer, gpointer, gpointer, gpointer)) chicle_avif_loader_get_frame_data,
-        (gint (*) (gpointer)) chicle_avif_loader_get_frame_delay
+        (gint (*) (gpointer)) chicle_avif_loader_get_frame_delay,
+        (gconstpointer (*) (gpointer, gint, gint, gpointer, gpointer, gpointer, gpointer)) NULL
     },
 #endif
 #ifdef HAVE_JXL
@@ -208,7 +255,8 @@ loader_vtable [LOADER_TYPE_LAST] =
         (void (*)(gpointer)) chicle_jxl_loader_goto_first_frame,
         (gboolean (*)(gpointer)) chicle_jxl_loader_goto_next_frame,
         (gconstpointer (*) (gpointer, gpointer, gpointer, gpointer, gpointer)) chicle_jxl_loader_get_frame_data,
-        (gint (*) (gpointer)) chicle_jxl_loader_get_frame_delay
+        (gint (*) (gpointer)) chicle_jxl_loader_get_frame_delay,
+        (gconstpointer (*) (gpointer, gint, gint, gpointer, gpointer, gpointer, gpointer)) NULL
     },
 #endif
 #ifdef HAVE_COREGRAPHICS
@@ -222,7 +270,8 @@ loader_vtable [LOADER_TYPE_LAST] =
         (void (*)(gpointer)) chicle_coregraphics_loader_goto_first_frame,
         (gboolean (*)(gpointer)) chicle_coregraphics_loader_goto_next_frame,
         (gconstpointer (*) (gpointer, gpointer, gpointer, gpointer, gpointer)) chicle_coregraphics_loader_get_frame_data,
-        (gint (*) (gpointer)) chicle_coregraphics_loader_get_frame_delay
+        (gint (*) (gpointer)) chicle_coregraphics_loader_get_frame_delay,
+        (gconstpointer (*) (gpointer, gint, gint, gpointer, gpointer, gpointer, gpointer)) NULL
     },
 #endif
 #ifdef HAVE_HEIF
@@ -237,7 +286,8 @@ loader_vtable [LOADER_TYPE_LAST] =
         (void (*)(gpointer)) chicle_heif_loader_goto_first_frame,
         (gboolean (*)(gpointer)) chicle_heif_loader_goto_next_frame,
         (gconstpointer (*) (gpointer, gpointer, gpointer, gpointer, gpointer)) chicle_heif_loader_get_frame_data,
-        (gint (*) (gpointer)) chicle_heif_loader_get_frame_delay
+        (gint (*) (gpointer)) chicle_heif_loader_get_frame_delay,
+        (gconstpointer (*) (gpointer, gint, gint, gpointer, gpointer, gpointer, gpointer)) chicle_heif_loader_get_thumbnail_frame
     },
 #endif
 };
@@ -304,8 +354,13 @@ chicle_media_loader_new (const gchar *path, gint target_width, gint target_heigh
 out:
     if (!success)
     {
+        /* A failed read is a better explanation than the format */
         if (mapping)
+        {
+            if (!error || !*error)
+                chicle_file_mapping_get_error (mapping, error);
             chicle_file_mapping_destroy (mapping);
+        }
 
         chicle_media_loader_destroy (loader);
         loader = NULL;
@@ -361,6 +416,69 @@ chicle_media_loader_get_frame_data (ChicleMediaLoader *loader,
                                                                width_out, height_out, rowstride_out);
 }
 
+/* Returns an embedded thumbnail if the loader has one that's big enough to
+ * fill min_width x min_height pixels when fitted. Otherwise, this returns
+ * the full-size frame. */
+gconstpointer
+chicle_media_loader_get_thumbnail_frame (ChicleMediaLoader *loader,
+                                         gint min_width,
+                                         gint min_height,
+                                         ChafaPixelType *pixel_type_out,
+                                         gint *width_out,
+                                         gint *height_out,
+                                         gint *rowstride_out)
+{
+    gconstpointer pixels = NULL;
+
+    if (loader_vtable [loader->loader_type].get_thumbnail_frame)
+    {
+        pixels = loader_vtable [loader->loader_type].get_thumbnail_frame (loader->loader,
+                                                                          min_width, min_height,
+                                                                          pixel_type_out,
+                                                                          width_out, height_out,
+                                                                          rowstride_out);
+    }
+
+    if (!pixels)
+        pixels = chicle_media_loader_get_frame_data (loader, pixel_type_out,
+                                                     width_out, height_out, rowstride_out);
+
+    return pixels;
+}
+
+/* Returns the current frame as palette indices, if the loader has them.
+ * Otherwise, this returns NULL. They describe the same pixels as
+ * chicle_media_loader_get_frame_data (), which must be called first. */
+const guint8 *
+chicle_media_loader_get_frame_indices (ChicleMediaLoader *loader,
+                                       const guint32 **colors_out,
+                                       gint *n_colors_out,
+                                       gint *rowstride_out)
+{
+    if (!loader_vtable [loader->loader_type].get_frame_indices)
+        return NULL;
+
+    return loader_vtable [loader->loader_type].get_frame_indices (loader->loader, colors_out,
+                                                                  n_colors_out, rowstride_out);
+}
+
+/* Returns the size the image should be laid out at. Loaders may reduce the
+ * image while decoding when given a target size, so the frame data can be
+ * smaller than this. Scaling it up again is left to Chafa. */
+void
+chicle_media_loader_get_image_size (ChicleMediaLoader *loader,
+                                    gint *width_out,
+                                    gint *height_out)
+{
+    ChafaPixelType pixel_type;
+    gint rowstride;
+
+    if (loader_vtable [loader->loader_type].get_image_size)
+        loader_vtable [loader->loader_type].get_image_size (loader->loader, width_out, height_out);
+    else
+        chicle_media_loader_get_frame_data (loader, &pixel_type, width_out, height_out, &rowstride);
+}
+
 gint
 chicle_media_loader_get_frame_delay (ChicleMediaLoader *loader)
 {
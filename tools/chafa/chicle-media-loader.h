@@ -42,6 +42,20 @@ gconstpointer chicle_media_loader_get_frame_data (ChicleMediaLoader *loader,
                                                   gint *width_out,
                                                   gint *height_out,
                                                   gint *rowstride_out);
+gconstpointer chicle_media_loader_get_thumbnail_frame (ChicleMediaLoader *loader,
+                                                       gint min_width,
+                                                       gint min_height,
+                                                       ChafaPixelType *pixel_type_out,
+                                                       gint *width_out,
+                                                       gint *height_out,
+                                                       gint *rowstride_out);
+const guint8 *chicle_media_loader_get_frame_indices (ChicleMediaLoader *loader,
+                                                     const guint32 **colors_out,
+                                                     gint *n_colors_out,
+                                                     gint *rowstride_out);
+void chicle_media_loader_get_image_size (ChicleMediaLoader *loader,
+                                         gint *width_out,
+                                         gint *height_out);
 gint chicle_media_loader_get_frame_delay (ChicleMediaLoader *loader);
 
 gchar **chicle_get_loader_names (void);
@@ -82,6 +82,33 @@ build_canvas (ChafaPixelType pixel_type, const guint8 *pixels,
     return canvas;
 }
 
+/* Gets the smallest source image size that will fill the canvas without
+ * upscaling. Symbols only need a fixed number of pixels per cell. */
+static void
+get_min_source_size (const ChafaCanvasConfig *config, gint *width_out, gint *height_out)
+{
+    gint cell_width_px, cell_height_px;
+
+    if (chafa_canvas_config_get_pixel_mode (config) == CHAFA_PIXEL_MODE_SYMBOLS)
+    {
+        cell_width_px = CHAFA_SYMBOL_WIDTH_PIXELS;
+        cell_height_px = CHAFA_SYMBOL_HEIGHT_PIXELS;
+    }
+    else
+    {
+        chafa_canvas_config_get_cell_geometry (config, &cell_width_px, &cell_height_px);
+        if (cell_width_px < 1 || cell_height_px < 1)
+        {
+            cell_width_px = 10;
+            cell_height_px = 20;
+        }
+    }
+
+    chafa_canvas_config_get_geometry (config, width_out, height_out);
+    *width_out *= cell_width_px;
+    *height_out *= cell_height_px;
+}
+
 static GString **
 format_image (ChicleMediaPipeline *pipeline, ChicleMediaLoader *loader)
 {
@@ -89,13 +116,19 @@ format_image (ChicleMediaPipeline *pipeline, ChicleMediaLoader *loader)
     gconstpointer pixels;
     ChafaCanvas *canvas = NULL;
     gint src_width, src_height, src_rowstride;
+    gint min_width, min_height;
     GString **output = NULL;
 
-    pixels = chicle_media_loader_get_frame_data (loader,
-                                                 &pixel_type,
-                                                 &src_width,
-                                                 &src_height,
-                                                 &src_rowstride);
+    /* We only show the first frame, and an embedded thumbnail will do if
+     * it's big enough. This saves a lot of work with camera images. */
+    get_min_source_size (pipeline->canvas_config, &min_width, &min_height);
+    pixels = chicle_media_loader_get_thumbnail_frame (loader,
+                                                      min_width,
+                                                      min_height,
+                                                      &pixel_type,
+                                                      &src_width,
+                                                      &src_height,
+                                                      &src_rowstride);
     if (!pixels)
         goto out;
 
@@ -138,6 +171,26 @@ thread_func (gpointer ctx, gpointer data)
                          "Decoding failed");
     }
 
+    if (loader
+        && pipeline->want_loader
+        && !chicle_media_loader_get_is_animation (loader))
+    {
+        ChafaPixelType pixel_type;
+        gint width, height, rowstride;
+
+        /* Some loaders defer decoding until the frame is requested. Make
+         * sure stills are decoded here, so it happens in parallel and
+         * failures are reported up front. */
+        if (!chicle_media_loader_get_frame_data (loader, &pixel_type,
+                                                 &width, &height, &rowstride))
+        {
+            g_set_error (&error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                         "Decoding failed");
+            chicle_media_loader_destroy (loader);
+            loader = NULL;
+        }
+    }
+
     if (loader
         && !pipeline->want_loader)
     {
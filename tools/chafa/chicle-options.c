@@ -237,6 +237,13 @@ print_summary (void)
     "                     rows instead for e.g. 'less -R' interop. Defaults to off.\n"
     "      --passthrough=MODE  Graphics protocol passthrough [auto, none, screen,\n"
     "                     tmux]. Used to show pixel graphics through multiplexers.\n"
+    "      --kitty-transport=MODE  How to send Kitty images [direct, file, shm].\n"
+    "                     File and shm are much faster, but only work when the\n"
+    "                     terminal runs on the same host. Defaults to direct.\n"
+    "      --terminal-scaling=SIZE  Let the terminal scale Kitty and iTerm2 images\n"
+    "                     [off, native, WxH]. Native sends images at their own\n"
+    "                     resolution. WxH does the same, but limits the size in\n"
+    "                     pixels. Defaults to off.\n"
     "      --polite=BOOL  Polite mode [on, off]. Inhibits escape sequences that may\n"
     "                     confuse other programs. Defaults to off.\n"
 
@@ -260,6 +267,10 @@ print_summary (void)
     "                     prevent images from scrolling out. Defaults to 1.\n"
     "      --margin-right=NUM  When terminal size is detected, reserve at least NUM\n"
     "                     columns safety margin on right-hand side. Defaults to 0.\n"
+    "      --pan          Show a single image in an interactive viewer that can pan\n"
+    "                     and zoom. Use the arrow keys or hjkl to move, shift or\n"
+    "                     HJKL to move by half a screen, +/- to zoom and q to quit.\n"
+    "                     Symbols output only.\n"
     "      --scale=NUM    Scale image, respecting view's dimensions. 1.0 approximates\n"
     "                     image's pixel dimensions. Specify \"max\" to fit view.\n"
     "                     Defaults to 1.0 for pixel graphics and 4.0 for symbols.\n"
@@ -280,6 +291,16 @@ print_summary (void)
     "                     defaults to zero for a still image and infinite for an\n"
     "                     animation. For multiple files, defaults to zero. Animations\n"
     "                     will always be played through at least once.\n"
+    "      --frame-bytes-budget=NUM  Average number of bytes to spend on each\n"
+    "                     animation frame. Quality is lowered or frames are dropped\n"
+    "                     to stay within budget. Accepts K, M and G suffixes.\n"
+    "      --max-bandwidth=NUM  Maximum bytes per second to spend on animations.\n"
+    "                     Like --frame-bytes-budget, but relative to frame delay.\n"
+    "      --record=PATH  Save the printed frames to a file that can be played back\n"
+    "                     later with --replay.\n"
+    "      --replay       Treat input files as recordings made with --record, and\n"
+    "                     play them back without processing. Terminal and layout\n"
+    "                     options should match the ones used for recording.\n"
     "      --speed=SPEED  Animation speed. Either a unitless multiplier, or a real\n"
     "                     number followed by \"fps\" to apply a specific framerate.\n"
     "      --watch        Watch a single input file, redisplaying it whenever its\n"
@@ -293,6 +314,9 @@ print_summary (void)
     "                     256, full]. Defaults to best guess.\n"
     "      --color-extractor=EXTR  Method for extracting color from an area\n"
     "                     [average, median]. Average is the default.\n"
+    "      --color-merge=NUM  Reuse the previous cell's colors when they differ by\n"
+    "                     less than NUM [0.0 - 1.0]. Reduces output size in truecolor\n"
+    "                     and 256-color modes at some cost in accuracy. Defaults to 0.\n"
     "      --color-space=CS  Color space used for quantization; one of [rgb, din99d].\n"
     "                     Defaults to rgb, which is faster but less accurate.\n"
     "      --dither=DITHER  Set output dither mode; one of [none, ordered,\n"
@@ -310,8 +334,15 @@ print_summary (void)
 
     "\nResource allocation:\n"
 
+    "      --frame-threads=NUM  Number of animation frames to render at the same\n"
+    "                     time. Speeds up animations with small canvases, where\n"
+    "                     frames can't be split up much. No effect with rate\n"
+    "                     control. Defaults to 1.\n"
     "      --threads=NUM  Maximum number of CPU threads to use. If left unspecified\n"
     "                     or negative, this will equal available CPU cores.\n"
+    "      --thread-affinity=POLICY  Pin worker threads to CPUs; one of [none,\n"
+    "                     compact, scatter] or a list of CPUs like 0-3,8. Defaults\n"
+    "                     to none.\n"
     "  -w, --work=NUM     How hard to work in terms of CPU and memory [1-9]. 1 is the\n"
     "                     cheapest, 9 is the most accurate. Defaults to 5.\n"
 
@@ -742,6 +773,26 @@ out:
     return success;
 }
 
+static gboolean
+parse_color_merge_arg (G_GNUC_UNUSED const gchar *option_name, const gchar *value, G_GNUC_UNUSED gpointer data, GError **error)
+{
+    gdouble threshold = -1.0;
+    gboolean success = FALSE;
+
+    if (!parse_fraction_or_real (value, &threshold) || threshold < 0.0 || threshold > 1.0)
+    {
+        g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                     "Color merge threshold must be a real number or fraction in the range [0.0-1.0].");
+        goto out;
+    }
+
+    options.color_merge_threshold = threshold;
+    success = TRUE;
+
+out:
+    return success;
+}
+
 static gboolean
 parse_dither_intensity_arg (G_GNUC_UNUSED const gchar *option_name, const gchar *value, G_GNUC_UNUSED gpointer data, GError **error)
 {
@@ -788,6 +839,149 @@ out:
     return success;
 }
 
+static gboolean
+parse_byte_count (const gchar *str, gint64 *count_out)
+{
+    gdouble d;
+    gchar *endptr;
+
+    d = g_strtod (str, &endptr);
+    if (endptr == str || d < 0.0)
+        return FALSE;
+
+    while (g_ascii_isspace (*endptr))
+        endptr++;
+
+    switch (g_ascii_toupper (*endptr))
+    {
+        case 'G':
+            d *= 1024.0;
+            /* Fall through */
+        case 'M':
+            d *= 1024.0;
+            /* Fall through */
+        case 'K':
+            d *= 1024.0;
+            endptr++;
+            break;
+        default:
+            break;
+    }
+
+    /* Allow e.g. "64k", "64kB" and "64KiB" */
+    if (*endptr == 'i')
+        endptr++;
+    if (g_ascii_toupper (*endptr) == 'B')
+        endptr++;
+
+    /* A zero budget would drop every frame but the first */
+    if (*endptr != '\0' || d < 1.0 || d >= (gdouble) G_MAXINT64)
+        return FALSE;
+
+    *count_out = (gint64) d;
+    return TRUE;
+}
+
+static gboolean
+parse_max_bandwidth_arg (G_GNUC_UNUSED const gchar *option_name, const gchar *value, G_GNUC_UNUSED gpointer data, GError **error)
+{
+    if (!parse_byte_count (value, &options.max_bandwidth))
+    {
+        g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                     "Bandwidth must be a positive number of bytes per second, optionally followed by K, M or G.");
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+parse_frame_bytes_budget_arg (G_GNUC_UNUSED const gchar *option_name, const gchar *value, G_GNUC_UNUSED gpointer data, GError **error)
+{
+    if (!parse_byte_count (value, &options.frame_bytes_budget))
+    {
+        g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                     "Frame budget must be a positive number of bytes, optionally followed by K, M or G.");
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Parses a list of CPUs like "0-3,8,10-11" */
+static gboolean
+parse_cpu_list (const gchar *value, GArray *cpus_out)
+{
+    gchar **parts;
+    gboolean result = FALSE;
+    gint i;
+
+    parts = g_strsplit (value, ",", -1);
+
+    for (i = 0; parts [i]; i++)
+    {
+        gchar *p = parts [i], *end;
+        gint64 first, last, j;
+
+        first = last = g_ascii_strtoll (p, &end, 10);
+        if (end == p || first < 0)
+            goto out;
+
+        if (*end == '-')
+        {
+            p = end + 1;
+            last = g_ascii_strtoll (p, &end, 10);
+            if (end == p || last < first)
+                goto out;
+        }
+
+        if (*end != '\0' || last >= 65536)
+            goto out;
+
+        for (j = first; j <= last; j++)
+        {
+            gint cpu = j;
+            g_array_append_val (cpus_out, cpu);
+        }
+    }
+
+    result = cpus_out->len > 0;
+
+out:
+    g_strfreev (parts);
+    return result;
+}
+
+static gboolean
+parse_thread_affinity_arg (G_GNUC_UNUSED const gchar *option_name, const gchar *value, G_GNUC_UNUSED gpointer data, GError **error)
+{
+    GArray *cpus;
+    gboolean result = TRUE;
+
+    cpus = g_array_new (FALSE, FALSE, sizeof (gint));
+
+    if (!g_ascii_strcasecmp (value, "none"))
+        options.thread_affinity = CHAFA_THREAD_AFFINITY_NONE;
+    else if (!g_ascii_strcasecmp (value, "compact"))
+        options.thread_affinity = CHAFA_THREAD_AFFINITY_COMPACT;
+    else if (!g_ascii_strcasecmp (value, "scatter"))
+        options.thread_affinity = CHAFA_THREAD_AFFINITY_SCATTER;
+    else if (parse_cpu_list (value, cpus))
+        options.thread_affinity = CHAFA_THREAD_AFFINITY_EXPLICIT;
+    else
+    {
+        g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                     "Thread affinity must be one of [none, compact, scatter] or a list of CPUs.");
+        result = FALSE;
+    }
+
+    g_free (options.thread_affinity_cpus);
+    options.n_thread_affinity_cpus = cpus->len;
+    options.thread_affinity_cpus = (gint *) g_array_free (cpus, FALSE);
+
+    return result;
+}
+
 static gboolean
 parse_symbols_arg (G_GNUC_UNUSED const gchar *option_name, const gchar *value, G_GNUC_UNUSED gpointer data, GError **error)
 {
@@ -1059,6 +1253,69 @@ out:
     return result;
 }
 
+static gboolean
+parse_kitty_transport_arg (G_GNUC_UNUSED const gchar *option_name, const gchar *value, G_GNUC_UNUSED gpointer data, GError **error)
+{
+    gboolean result = TRUE;
+
+    if (!g_ascii_strcasecmp (value, "direct"))
+        options.kitty_transport = CHAFA_KITTY_TRANSPORT_DIRECT;
+    else if (!g_ascii_strcasecmp (value, "file"))
+        options.kitty_transport = CHAFA_KITTY_TRANSPORT_TEMP_FILE;
+    else if (!g_ascii_strcasecmp (value, "shm"))
+        options.kitty_transport = CHAFA_KITTY_TRANSPORT_SHARED_MEMORY;
+    else
+    {
+        g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                     "Kitty transport must be one of [direct, file, shm].");
+        result = FALSE;
+    }
+
+    return result;
+}
+
+static gboolean
+parse_terminal_scaling_arg (G_GNUC_UNUSED const gchar *option_name, const gchar *value, G_GNUC_UNUSED gpointer data, GError **error)
+{
+    gboolean result = TRUE;
+    gint width, height;
+
+    options.terminal_scaling_max_width = 0;
+    options.terminal_scaling_max_height = 0;
+
+    if (!g_ascii_strcasecmp (value, "off"))
+    {
+        options.terminal_scaling = FALSE;
+        return TRUE;
+    }
+
+    options.terminal_scaling = TRUE;
+
+    if (!g_ascii_strcasecmp (value, "native"))
+        return TRUE;
+
+    parse_2d_size (value, &width, &height);
+
+    if (width < 0 && height < 0)
+    {
+        g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                     "Terminal scaling must be one of [off, native] or a size specified as [width]x[height], [width]x or x[height], e.g 1920x1080.");
+        result = FALSE;
+    }
+    else if (width == 0 || height == 0)
+    {
+        g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                     "Terminal scaling size must be at least 1x1.");
+        result = FALSE;
+    }
+
+    /* A missing dimension means no limit */
+    options.terminal_scaling_max_width = MAX (width, 0);
+    options.terminal_scaling_max_height = MAX (height, 0);
+
+    return result;
+}
+
 static gboolean
 parse_passthrough_arg (G_GNUC_UNUSED const gchar *option_name, const gchar *value, G_GNUC_UNUSED gpointer data, GError **error)
 {
@@ -1536,6 +1793,7 @@ fuzz_options_with_seed (ChicleOptions *opt, gconstpointer seed, gint seed_len)
     opt->transparency_threshold = fuzz_seed_get_double (seed, seed_len, &ofs, 0.0, 1.0);
     opt->transparency_threshold_set = TRUE;
     opt->use_exact_size = fuzz_seed_get_tristate (seed, seed_len, &ofs);
+    opt->color_merge_threshold = fuzz_seed_get_double (seed, seed_len, &ofs, 0.0, 1.0);
 }
 
 static void
@@ -1776,11 +2034,13 @@ chicle_parse_options (int *argc, char **argv [])
         { "clear",       '\0', 0, G_OPTION_ARG_NONE,     &options.clear,        "Clear", NULL },
         { "colors",      'c',  0, G_OPTION_ARG_CALLBACK, parse_colors_arg,      "Colors (none, 2, 16, 256, 240 or full)", NULL },
         { "color-extractor", '\0', 0, G_OPTION_ARG_CALLBACK, parse_color_extractor_arg, "Color extractor (average or median)", NULL },
+        { "color-merge", '\0', 0, G_OPTION_ARG_CALLBACK, parse_color_merge_arg, "Color merge threshold", NULL },
         { "color-space", '\0', 0, G_OPTION_ARG_CALLBACK, parse_color_space_arg, "Color space (rgb or din99d)", NULL },
         { "dither",      '\0', 0, G_OPTION_ARG_CALLBACK, parse_dither_arg,      "Dither", NULL },
         { "dither-grain",'\0', 0, G_OPTION_ARG_CALLBACK, parse_dither_grain_arg, "Dither grain", NULL },
         { "dither-intensity", '\0', 0, G_OPTION_ARG_CALLBACK, parse_dither_intensity_arg, "Dither intensity", NULL },
         { "dump-detect", '\0', 0, G_OPTION_ARG_NONE,     &options.do_dump_detect, "Dump detection results", NULL },
+        { "dump-frame-bytes", '\0', 0, G_OPTION_ARG_NONE,  &options.do_dump_frame_bytes, "Dump frame sizes", NULL },
         { "dump-glyph-file", '\0', 0, G_OPTION_ARG_CALLBACK, parse_dump_glyph_file_arg, "Dump glyph file", NULL },
         { "duration",    'd',  0, G_OPTION_ARG_CALLBACK, parse_duration_arg,    "Duration", NULL },
         { "exact-size",  '\0', 0, G_OPTION_ARG_CALLBACK, parse_exact_size_arg,  "Whether to prefer the original image size", NULL },
@@ -1792,28 +2052,37 @@ chicle_parse_options (int *argc, char **argv [])
         { "fit-width",   '\0', 0, G_OPTION_ARG_NONE,     &options.fit_to_width, "Fit to width", NULL },
         { "font-ratio",  '\0', 0, G_OPTION_ARG_CALLBACK, parse_font_ratio_arg,  "Font ratio", NULL },
         { "format",      'f',  0, G_OPTION_ARG_CALLBACK, parse_format_arg,      "Format of output pixel data (iterm, kitty, sixels or symbols)", NULL },
+        { "frame-bytes-budget", '\0', 0, G_OPTION_ARG_CALLBACK, parse_frame_bytes_budget_arg, "Frame bytes budget", NULL },
+        { "frame-threads", '\0', 0, G_OPTION_ARG_INT,   &options.n_frame_threads, "Frame threads", NULL },
         { "fuzz-options", '\0', 0, G_OPTION_ARG_NONE,    &options.fuzz_options, "Fuzz the options", NULL },
         { "glyph-file",  '\0', 0, G_OPTION_ARG_CALLBACK, parse_glyph_file_arg,  "Glyph file", NULL },
         { "grid",        '\0', 0, G_OPTION_ARG_CALLBACK, parse_grid_arg,        "Grid", NULL },
         { "grid-on",     'g',  0, G_OPTION_ARG_NONE,     &options.grid_on,      "Grid on", NULL },
         { "invert",      '\0', 0, G_OPTION_ARG_NONE,     &options.invert,       "Invert foreground/background", NULL },
+        { "kitty-transport", '\0', 0, G_OPTION_ARG_CALLBACK, parse_kitty_transport_arg, "Kitty transport", NULL },
         { "label",       '\0', 0, G_OPTION_ARG_CALLBACK, parse_label_arg,       "Print labels", NULL },
         { "label-on",    'l',  0, G_OPTION_ARG_NONE,     &options.label,        "Print labels on", NULL },
         { "link",        '\0', 0, G_OPTION_ARG_CALLBACK, parse_link_arg,        "Link labels", NULL },
         { "margin-bottom", '\0', 0, G_OPTION_ARG_INT,    &options.margin_bottom,  "Bottom margin", NULL },
         { "margin-right", '\0', 0, G_OPTION_ARG_INT,     &options.margin_right,  "Right margin", NULL },
+        { "max-bandwidth", '\0', 0, G_OPTION_ARG_CALLBACK, parse_max_bandwidth_arg, "Maximum bandwidth", NULL },
         { "optimize",    'O',  0, G_OPTION_ARG_INT,      &options.optimization_level,  "Optimization", NULL },
+        { "pan",         '\0', 0, G_OPTION_ARG_NONE,     &options.pan,          "Interactive panning", NULL },
         { "passthrough", '\0', 0, G_OPTION_ARG_CALLBACK, parse_passthrough_arg, "Passthrough", NULL },
         { "polite",      '\0', 0, G_OPTION_ARG_CALLBACK, parse_polite_arg,      "Polite", NULL },
         { "preprocess",  'p',  0, G_OPTION_ARG_CALLBACK, parse_preprocess_arg,  "Preprocessing", NULL },
         { "probe",       '\0', 0, G_OPTION_ARG_CALLBACK, parse_probe_arg,       "Terminal probing", NULL },
+        { "record",      '\0', 0, G_OPTION_ARG_FILENAME, &options.record_path, "Record to file", NULL },
         { "relative",    '\0', 0, G_OPTION_ARG_CALLBACK, parse_relative_arg,    "Relative", NULL },
+        { "replay",      '\0', 0, G_OPTION_ARG_NONE,     &options.replay,       "Replay recordings", NULL },
         { "scale",       '\0', 0, G_OPTION_ARG_CALLBACK, parse_scale_arg,       "Scale", NULL },
         { "size",        's',  0, G_OPTION_ARG_CALLBACK, parse_size_arg,        "Output size", NULL },
         { "speed",       '\0', 0, G_OPTION_ARG_CALLBACK, parse_anim_speed_arg,  "Animation speed", NULL },
         { "stretch",     '\0', 0, G_OPTION_ARG_NONE,     &options.stretch,      "Stretch image to fix output dimensions", NULL },
         { "symbols",     '\0', 0, G_OPTION_ARG_CALLBACK, parse_symbols_arg,     "Output symbols", NULL },
+        { "terminal-scaling", '\0', 0, G_OPTION_ARG_CALLBACK, parse_terminal_scaling_arg, "Terminal scaling", NULL },
         { "threads",     '\0', 0, G_OPTION_ARG_INT,      &options.n_threads,    "Number of threads", NULL },
+        { "thread-affinity", '\0', 0, G_OPTION_ARG_CALLBACK, parse_thread_affinity_arg, "Thread affinity", NULL },
         { "threshold",   't',  0, G_OPTION_ARG_CALLBACK, parse_threshold_arg,   "Transparency threshold", NULL },
         { "view-size",   '\0', 0, G_OPTION_ARG_CALLBACK, parse_view_size_arg,   "View size", NULL },
         { "watch",       '\0', 0, G_OPTION_ARG_NONE,     &options.watch,        "Watch a file's contents", NULL },
@@ -1877,12 +2146,17 @@ chicle_parse_options (int *argc, char **argv [])
     options.work_factor = 5;
     options.optimization_level = G_MININT;  /* Unset */
     options.n_threads = -1;
+    options.n_frame_threads = 1;
+    options.thread_affinity = CHAFA_THREAD_AFFINITY_NONE;
     options.fg_color = 0xffffff;
     options.bg_color = 0x000000;
     options.transparency_threshold = G_MAXDOUBLE;  /* Unset */
+    options.color_merge_threshold = 0.0;
     options.file_duration_s = -1.0;  /* Unset */
     options.anim_fps = -1.0;
     options.anim_speed_multiplier = 1.0;
+    options.max_bandwidth = 0;  /* Unlimited */
+    options.frame_bytes_budget = 0;  /* Unlimited */
     options.use_exact_size = CHICLE_TRISTATE_AUTO;
     options.cell_width = 10;
     options.cell_height = 20;
@@ -2110,6 +2384,19 @@ chicle_parse_options (int *argc, char **argv [])
         }
     }
 
+    /* The panning viewer works on character cells */
+
+    if (options.pan)
+    {
+        if (options.pixel_mode_set && options.pixel_mode != CHAFA_PIXEL_MODE_SYMBOLS)
+        {
+            g_printerr ("%s: Can only use --pan with symbols output.\n", options.executable_name);
+            goto out;
+        }
+
+        options.pixel_mode = CHAFA_PIXEL_MODE_SYMBOLS;
+    }
+
     /* Now we've established the pixel mode, apply dependent defaults */
 
     if (options.pixel_mode == CHAFA_PIXEL_MODE_SYMBOLS)
@@ -2208,6 +2495,12 @@ chicle_parse_options (int *argc, char **argv [])
         goto out;
     }
 
+    if (options.n_frame_threads < 1)
+    {
+        g_printerr ("%s: Frame threads must be at least 1.\n", options.executable_name);
+        goto out;
+    }
+
     if (options.transparency_threshold == G_MAXDOUBLE)
         options.transparency_threshold = 0.5;
     else
@@ -2266,6 +2559,44 @@ chicle_parse_options (int *argc, char **argv [])
         }
     }
 
+    if (options.pan)
+    {
+        if (g_list_length (options.args) != 1 || chicle_path_queue_get_length (global_path_queue) != 0)
+        {
+            g_printerr ("%s: Can only use --pan with exactly one file.\n", options.executable_name);
+            goto out;
+        }
+
+        if (!strcmp (options.args->data, "-") || !options.is_interactive)
+        {
+            g_printerr ("%s: Can only use --pan with a filename in an interactive terminal.\n",
+                        options.executable_name);
+            goto out;
+        }
+
+        if (options.watch || options.grid_width > 0 || options.grid_height > 0)
+        {
+            g_printerr ("%s: Can't use --pan with --watch or --grid.\n", options.executable_name);
+            goto out;
+        }
+    }
+
+    if (options.record_path || options.replay)
+    {
+        if (options.record_path && options.replay)
+        {
+            g_printerr ("%s: Can't use --record with --replay.\n", options.executable_name);
+            goto out;
+        }
+
+        if (options.watch || options.pan || options.grid_width > 0 || options.grid_height > 0)
+        {
+            g_printerr ("%s: Can't use --record or --replay with --watch, --pan or --grid.\n",
+                        options.executable_name);
+            goto out;
+        }
+    }
+
     if (options.zoom)
     {
         g_printerr ("%s: Warning: --zoom is deprecated, use --scale max instead.\n",
@@ -2340,6 +2671,13 @@ chicle_parse_options (int *argc, char **argv [])
 
     chafa_set_n_threads (options.n_threads);
 
+    if (options.thread_affinity != CHAFA_THREAD_AFFINITY_NONE)
+        chafa_set_thread_affinity_policy (options.thread_affinity,
+                                          options.thread_affinity_cpus,
+                                          options.n_thread_affinity_cpus);
+    g_free (options.thread_affinity_cpus);
+    options.thread_affinity_cpus = NULL;
+
     result = TRUE;
 
 out:
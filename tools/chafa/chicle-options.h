@@ -106,6 +106,7 @@ typedef struct
     gboolean stretch;
     gboolean zoom;
     gboolean watch;
+    gboolean pan;
     gboolean fg_only;
     gboolean animate;
     gboolean relative;
@@ -129,15 +130,29 @@ typedef struct
     gint work_factor;
     gint optimization_level;
     gint n_threads;
+
+    /* Number of animation frames to render concurrently. See
+     * chicle-frame-pipeline.c. */
+    gint n_frame_threads;
+    ChafaThreadAffinity thread_affinity;
+    gint *thread_affinity_cpus;
+    gint n_thread_affinity_cpus;
     ChafaOptimizations optimizations;
     ChafaPassthrough passthrough;
     gboolean passthrough_set;
+    ChafaKittyTransport kitty_transport;
+
+    /* Let the terminal scale images. Limits of 0 mean native resolution. */
+    gboolean terminal_scaling;
+    gint terminal_scaling_max_width;
+    gint terminal_scaling_max_height;
     guint32 fg_color;
     gboolean fg_color_set;
     guint32 bg_color;
     gboolean bg_color_set;
     gdouble transparency_threshold;
     gboolean transparency_threshold_set;
+    gdouble color_merge_threshold;
     gdouble file_duration_s;
 
     /* If > 0.0, override the framerate specified by the input file. */
@@ -147,6 +162,20 @@ typedef struct
      * eliminate interframe delay altogether. */
     gdouble anim_speed_multiplier;
 
+    /* If > 0, degrade animation frames or drop them to stay within these
+     * limits. See chicle-rate-control.c. */
+    gint64 max_bandwidth;
+    gint64 frame_bytes_budget;
+
+    /* Print the size of each animation frame to stderr. This is independent
+     * of output speed, so it can be used to test rate control. */
+    gboolean do_dump_frame_bytes;
+
+    /* Save printed frames to this file, or play back input files saved this
+     * way instead of rendering them. See chicle-recording.c. */
+    gchar *record_path;
+    gboolean replay;
+
     ChicleTristate use_exact_size;
 
     /* Automatically set if terminal size is detected and there is
@@ -42,6 +42,11 @@ struct ChiclePngLoader
     size_t file_data_len;
     gpointer frame_data;
     gint width, height;
+
+    /* Palette images only */
+    guint8 *index_data;
+    guint32 index_colors [256];
+    gint n_index_colors;
 };
 
 static ChiclePngLoader *
@@ -50,6 +55,65 @@ chicle_png_loader_new (void)
     return g_new0 (ChiclePngLoader, 1);
 }
 
+/* Decodes a palette image to 8-bit indices, and expands them to RGBA8
+ * ourselves, so the indices can be used too */
+static gboolean
+decode_palette_image (ChiclePngLoader *loader, LodePNGState *lode_state,
+                      guint *width_out, guint *height_out, unsigned char **frame_data_out)
+{
+    const LodePNGColorMode *color = &lode_state->info_png.color;
+    unsigned char *index_data = NULL;
+    guint32 *frame_data;
+    gsize i, n_pixels;
+
+    lode_state->info_raw.colortype = LCT_PALETTE;
+    lode_state->info_raw.bitdepth = 8;
+
+    if (lodepng_decode (&index_data, width_out, height_out,
+                        lode_state,
+                        loader->file_data, loader->file_data_len) != 0)
+    {
+        free (index_data);
+        return FALSE;
+    }
+
+    g_assert (color->palette != NULL);
+
+    /* Out-of-range indices are opaque black, like in lodepng */
+    for (i = 0; i < 256; i++)
+    {
+        const unsigned char *p = color->palette + i * 4;
+
+        loader->index_colors [i] = i < color->palettesize
+            ? ((guint32) p [3] << 24) | (p [0] << 16) | (p [1] << 8) | p [2]
+            : 0xff000000;
+    }
+
+    n_pixels = (gsize) *width_out * *height_out;
+    frame_data = malloc (n_pixels * BYTES_PER_PIXEL);
+    if (!frame_data)
+    {
+        free (index_data);
+        return FALSE;
+    }
+
+    for (i = 0; i < n_pixels; i++)
+    {
+        guint32 c = loader->index_colors [index_data [i]];
+        guint8 *p = (guint8 *) (frame_data + i);
+
+        p [0] = c >> 16;
+        p [1] = c >> 8;
+        p [2] = c;
+        p [3] = c >> 24;
+    }
+
+    loader->index_data = index_data;
+    loader->n_index_colors = color->palettesize;
+    *frame_data_out = (unsigned char *) frame_data;
+    return TRUE;
+}
+
 ChiclePngLoader *
 chicle_png_loader_new_from_mapping (ChicleFileMapping *mapping)
 {
@@ -74,15 +138,26 @@ chicle_png_loader_new_from_mapping (ChicleFileMapping *mapping)
     if (!loader->file_data)
         goto out;
 
-    lode_state.info_raw.colortype = LCT_RGBA;
-    lode_state.info_raw.bitdepth = 8;
     lode_state.decoder.zlibsettings.max_output_size = IMAGE_BUFFER_SIZE_MAX;
 
-    /* Decodes to RGBA8 */
-    if ((lode_error = lodepng_decode (&frame_data, &width, &height,
-                                      &lode_state,
-                                      loader->file_data, loader->file_data_len)) != 0)
-        goto out;
+    if (lodepng_inspect (&width, &height, &lode_state,
+                         loader->file_data, loader->file_data_len) == 0
+        && lode_state.info_png.color.colortype == LCT_PALETTE
+        && decode_palette_image (loader, &lode_state, &width, &height, &frame_data))
+    {
+        /* Decoded to indices and RGBA8 */
+    }
+    else
+    {
+        lode_state.info_raw.colortype = LCT_RGBA;
+        lode_state.info_raw.bitdepth = 8;
+
+        /* Decodes to RGBA8 */
+        if ((lode_error = lodepng_decode (&frame_data, &width, &height,
+                                          &lode_state,
+                                          loader->file_data, loader->file_data_len)) != 0)
+            goto out;
+    }
 
     if (width < 1 || width >= (1 << 28)
         || height < 1 || height >= (1 << 28))
@@ -99,6 +174,7 @@ out:
     {
         if (loader)
         {
+            free (loader->index_data);
             g_free (loader);
             loader = NULL;
         }
@@ -120,6 +196,7 @@ chicle_png_loader_destroy (ChiclePngLoader *loader)
     if (loader->frame_data)
         free (loader->frame_data);
 
+    free (loader->index_data);
     g_free (loader);
 }
 
@@ -152,6 +229,27 @@ chicle_png_loader_get_frame_data (ChiclePngLoader *loader,
     return loader->frame_data;
 }
 
+const guint8 *
+chicle_png_loader_get_frame_indices (ChiclePngLoader *loader,
+                                     const guint32 **colors_out,
+                                     gint *n_colors_out,
+                                     gint *rowstride_out)
+{
+    g_return_val_if_fail (loader != NULL, NULL);
+
+    if (!loader->index_data)
+        return NULL;
+
+    if (colors_out)
+        *colors_out = loader->index_colors;
+    if (n_colors_out)
+        *n_colors_out = loader->n_index_colors;
+    if (rowstride_out)
+        *rowstride_out = loader->width;
+
+    return loader->index_data;
+}
+
 gint
 chicle_png_loader_get_frame_delay (ChiclePngLoader *loader)
 {
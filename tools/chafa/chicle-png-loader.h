@@ -37,6 +37,10 @@ gconstpointer chicle_png_loader_get_frame_data (ChiclePngLoader *loader,
                                                 gint *width_out,
                                                 gint *height_out,
                                                 gint *rowstride_out);
+const guint8 *chicle_png_loader_get_frame_indices (ChiclePngLoader *loader,
+                                                   const guint32 **colors_out,
+                                                   gint *n_colors_out,
+                                                   gint *rowstride_out);
 gint chicle_png_loader_get_frame_delay (ChiclePngLoader *loader);
 
 void chicle_png_loader_goto_first_frame (ChiclePngLoader *loader);
@@ -0,0 +1,481 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* Copyright (C) 2025 Hans Petter Jansson
+ *
+ * This file is part of Chafa, a program that shows pictures on text terminals.
+ *
+ * Chafa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Chafa is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Chafa.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "config.h"
+#include <string.h>
+
+#include <chafa.h>
+#include "chicle-pnm-loader.h"
+
+/* Loads binary Netpbm images: PBM (P4), PGM (P5), PPM (P6) and PAM (P7).
+ * 8-bit RGB and RGBA rasters are passed on straight from the file mapping.
+ * Everything else is expanded to RGBA8. Only the first image in a file is
+ * used. */
+
+#define DIM_MAX ((1 << 28) - 1)
+#define N_PIXELS_MAX (1 << 29)
+#define HEADER_VALUE_MAX (1 << 30)
+
+#define PACK_RGBA(r, g, b, a) \
+    GUINT32_TO_LE ((guint32) (r) | ((guint32) (g) << 8) \
+                   | ((guint32) (b) << 16) | ((guint32) (a) << 24))
+
+struct ChiclePnmLoader
+{
+    ChicleFileMapping *mapping;
+    const guint8 *file_data;
+    gsize file_data_len;
+
+    /* Points into the mapping */
+    const guint8 *raster;
+
+    /* Expanded pixels, or NULL if the raster is used as-is */
+    guint32 *frame_data;
+
+    gint width, height;
+    gint depth;
+    guint maxval;
+    guint is_bitmap : 1;
+
+    ChafaPixelType pixel_type;
+    gint rowstride;
+};
+
+/* --- Header parsing --- */
+
+static gboolean
+is_space (guint8 c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static void
+skip_space_and_comments (const guint8 *data, gsize len, gsize *ofs)
+{
+    while (*ofs < len)
+    {
+        if (data [*ofs] == '#')
+        {
+            while (*ofs < len && data [*ofs] != '\n')
+                (*ofs)++;
+        }
+        else if (is_space (data [*ofs]))
+        {
+            (*ofs)++;
+        }
+        else
+        {
+            break;
+        }
+    }
+}
+
+static gboolean
+parse_uint (const guint8 *data, gsize len, gsize *ofs, guint *value_out)
+{
+    guint value = 0;
+    gsize start;
+
+    skip_space_and_comments (data, len, ofs);
+
+    for (start = *ofs; *ofs < len && data [*ofs] >= '0' && data [*ofs] <= '9'; (*ofs)++)
+    {
+        value = value * 10 + data [*ofs] - '0';
+        if (value > HEADER_VALUE_MAX)
+            return FALSE;
+    }
+
+    *value_out = value;
+    return *ofs > start;
+}
+
+static gboolean
+parse_token (const guint8 *data, gsize len, gsize *ofs, const gchar **token_out, gsize *token_len_out)
+{
+    gsize start;
+
+    skip_space_and_comments (data, len, ofs);
+
+    for (start = *ofs; *ofs < len && !is_space (data [*ofs]); (*ofs)++)
+        ;
+
+    *token_out = (const gchar *) data + start;
+    *token_len_out = *ofs - start;
+    return *ofs > start;
+}
+
+static gboolean
+token_equals (const gchar *token, gsize token_len, const gchar *str)
+{
+    return token_len == strlen (str) && !memcmp (token, str, token_len);
+}
+
+/* P4, P5 and P6: The header is terminated by a single whitespace char */
+static gboolean
+parse_classic_header (ChiclePnmLoader *loader, guint type, gsize *ofs)
+{
+    const guint8 *data = loader->file_data;
+    gsize len = loader->file_data_len;
+    guint width, height, maxval = 1;
+
+    if (!parse_uint (data, len, ofs, &width)
+        || !parse_uint (data, len, ofs, &height))
+        return FALSE;
+
+    if (type != 4 && !parse_uint (data, len, ofs, &maxval))
+        return FALSE;
+
+    if (*ofs >= len || !is_space (data [*ofs]))
+        return FALSE;
+    (*ofs)++;
+
+    loader->width = width;
+    loader->height = height;
+    loader->maxval = maxval;
+    loader->depth = (type == 6) ? 3 : 1;
+    loader->is_bitmap = (type == 4);
+    return TRUE;
+}
+
+/* P7: Keyword/value lines terminated by ENDHDR. The tuple type is implied
+ * by the depth, so it isn't checked beyond that. */
+static gboolean
+parse_pam_header (ChiclePnmLoader *loader, gsize *ofs)
+{
+    const guint8 *data = loader->file_data;
+    gsize len = loader->file_data_len;
+    guint width = 0, height = 0, depth = 0, maxval = 0;
+
+    for (;;)
+    {
+        const gchar *token;
+        gsize token_len;
+        guint *value = NULL;
+
+        if (!parse_token (data, len, ofs, &token, &token_len))
+            return FALSE;
+
+        if (token_equals (token, token_len, "ENDHDR"))
+            break;
+        else if (token_equals (token, token_len, "WIDTH"))
+            value = &width;
+        else if (token_equals (token, token_len, "HEIGHT"))
+            value = &height;
+        else if (token_equals (token, token_len, "DEPTH"))
+            value = &depth;
+        else if (token_equals (token, token_len, "MAXVAL"))
+            value = &maxval;
+        else if (!token_equals (token, token_len, "TUPLTYPE"))
+            return FALSE;
+
+        if (value)
+        {
+            if (!parse_uint (data, len, ofs, value))
+                return FALSE;
+        }
+        else
+        {
+            while (*ofs < len && data [*ofs] != '\n')
+                (*ofs)++;
+        }
+    }
+
+    /* The raster starts after the end of the ENDHDR line */
+    while (*ofs < len && data [*ofs] != '\n')
+        (*ofs)++;
+    if (*ofs >= len)
+        return FALSE;
+    (*ofs)++;
+
+    if (depth < 1 || depth > 4)
+        return FALSE;
+
+    loader->width = width;
+    loader->height = height;
+    loader->maxval = maxval;
+    loader->depth = depth;
+    loader->is_bitmap = FALSE;
+    return TRUE;
+}
+
+static gsize
+get_raster_rowstride (ChiclePnmLoader *loader)
+{
+    if (loader->is_bitmap)
+        return (loader->width + 7) / 8;
+
+    return (gsize) loader->width * loader->depth * (loader->maxval > 255 ? 2 : 1);
+}
+
+static gboolean
+load_header (ChiclePnmLoader *loader)
+{
+    guint8 magic [3];
+    guint type;
+    gsize ofs = 2;
+
+    if (!chicle_file_mapping_taste (loader->mapping, magic, 0, sizeof (magic)))
+        return FALSE;
+
+    if (magic [0] != 'P' || magic [1] < '4' || magic [1] > '7' || !is_space (magic [2]))
+        return FALSE;
+
+    type = magic [1] - '0';
+
+    loader->file_data = chicle_file_mapping_get_data (loader->mapping, &loader->file_data_len);
+    if (!loader->file_data)
+        return FALSE;
+
+    if (type == 7)
+    {
+        if (!parse_pam_header (loader, &ofs))
+            return FALSE;
+    }
+    else
+    {
+        if (!parse_classic_header (loader, type, &ofs))
+            return FALSE;
+    }
+
+    if (loader->width < 1 || loader->width > DIM_MAX
+        || loader->height < 1 || loader->height > DIM_MAX
+        || loader->width * (guint64) loader->height > N_PIXELS_MAX
+        || loader->maxval < 1 || loader->maxval > 65535)
+        return FALSE;
+
+    if (loader->file_data_len - ofs < get_raster_rowstride (loader) * loader->height)
+        return FALSE;
+
+    loader->raster = loader->file_data + ofs;
+    return TRUE;
+}
+
+/* --- Expansion to RGBA8 --- */
+
+/* PBM rows through a table of eight pixels per byte. 1 is black. */
+static void
+expand_bitmap (ChiclePnmLoader *loader)
+{
+    guint32 table [256] [8];
+    gsize src_rowstride = get_raster_rowstride (loader);
+    gint n_full_bytes = loader->width / 8;
+    gint n_rem = loader->width % 8;
+    gint i, j, y;
+
+    for (i = 0; i < 256; i++)
+    {
+        for (j = 0; j < 8; j++)
+            table [i] [j] = ((i >> (7 - j)) & 1) ? PACK_RGBA (0, 0, 0, 0xff)
+                : PACK_RGBA (0xff, 0xff, 0xff, 0xff);
+    }
+
+    for (y = 0; y < loader->height; y++)
+    {
+        const guint8 *src = loader->raster + y * src_rowstride;
+        guint32 *dest = loader->frame_data + (gsize) y * loader->width;
+
+        for (i = 0; i < n_full_bytes; i++)
+            memcpy (dest + i * 8, table [src [i]], 8 * sizeof (guint32));
+
+        if (n_rem)
+            memcpy (dest + i * 8, table [src [i]], n_rem * sizeof (guint32));
+    }
+}
+
+/* Simple enough for the compiler to vectorize */
+static void
+expand_gray8_row (const guint8 *src, guint32 *dest, gint width)
+{
+    gint x;
+
+    for (x = 0; x < width; x++)
+        dest [x] = GUINT32_TO_LE ((src [x] * 0x010101U) | 0xff000000U);
+}
+
+/* Any depth and maxval. Samples are scaled to 0-255 through a table. */
+static void
+expand_samples (ChiclePnmLoader *loader)
+{
+    gsize src_rowstride = get_raster_rowstride (loader);
+    gboolean is_wide = loader->maxval > 255;
+    guint8 *scale;
+    guint i;
+    gint x, y;
+
+    scale = g_malloc (loader->maxval + 1);
+    for (i = 0; i <= loader->maxval; i++)
+        scale [i] = (i * 255 + loader->maxval / 2) / loader->maxval;
+
+    for (y = 0; y < loader->height; y++)
+    {
+        const guint8 *src = loader->raster + y * src_rowstride;
+        guint32 *dest = loader->frame_data + (gsize) y * loader->width;
+
+        for (x = 0; x < loader->width; x++)
+        {
+            guint8 s [4] = { 0, 0, 0, 0xff };
+            gint ch;
+
+            for (ch = 0; ch < loader->depth; ch++)
+            {
+                guint v;
+
+                if (is_wide)
+                {
+                    v = (src [0] << 8) | src [1];
+                    src += 2;
+                }
+                else
+                {
+                    v = *(src++);
+                }
+
+                /* Out-of-range samples are invalid; clamp them */
+                s [ch] = scale [MIN (v, loader->maxval)];
+            }
+
+            if (loader->depth == 1)
+                dest [x] = PACK_RGBA (s [0], s [0], s [0], 0xff);
+            else if (loader->depth == 2)
+                dest [x] = PACK_RGBA (s [0], s [0], s [0], s [1]);
+            else
+                dest [x] = PACK_RGBA (s [0], s [1], s [2], s [3]);
+        }
+    }
+
+    g_free (scale);
+}
+
+static void
+prepare_frame (ChiclePnmLoader *loader)
+{
+    gint y;
+
+    if (!loader->is_bitmap && loader->maxval == 255
+        && (loader->depth == 3 || loader->depth == 4))
+    {
+        /* Zero copy */
+        loader->pixel_type = loader->depth == 3 ? CHAFA_PIXEL_RGB8
+            : CHAFA_PIXEL_RGBA8_UNASSOCIATED;
+        loader->rowstride = get_raster_rowstride (loader);
+        return;
+    }
+
+    loader->frame_data = g_new (guint32, (gsize) loader->width * loader->height);
+    loader->pixel_type = CHAFA_PIXEL_RGBA8_UNASSOCIATED;
+    loader->rowstride = loader->width * 4;
+
+    if (loader->is_bitmap)
+    {
+        expand_bitmap (loader);
+    }
+    else if (loader->depth == 1 && loader->maxval == 255)
+    {
+        for (y = 0; y < loader->height; y++)
+            expand_gray8_row (loader->raster + (gsize) y * loader->width,
+                              loader->frame_data + (gsize) y * loader->width,
+                              loader->width);
+    }
+    else
+    {
+        expand_samples (loader);
+    }
+}
+
+/* --- Public API --- */
+
+static ChiclePnmLoader *
+chicle_pnm_loader_new (void)
+{
+    return g_new0 (ChiclePnmLoader, 1);
+}
+
+ChiclePnmLoader *
+chicle_pnm_loader_new_from_mapping (ChicleFileMapping *mapping)
+{
+    ChiclePnmLoader *loader;
+
+    g_return_val_if_fail (mapping != NULL, NULL);
+
+    loader = chicle_pnm_loader_new ();
+    loader->mapping = mapping;
+
+    if (!load_header (loader))
+    {
+        g_free (loader);
+        return NULL;
+    }
+
+    prepare_frame (loader);
+    return loader;
+}
+
+void
+chicle_pnm_loader_destroy (ChiclePnmLoader *loader)
+{
+    if (loader->mapping)
+        chicle_file_mapping_destroy (loader->mapping);
+
+    g_free (loader->frame_data);
+    g_free (loader);
+}
+
+gboolean
+chicle_pnm_loader_get_is_animation (G_GNUC_UNUSED ChiclePnmLoader *loader)
+{
+    return FALSE;
+}
+
+gconstpointer
+chicle_pnm_loader_get_frame_data (ChiclePnmLoader *loader,
+                                  ChafaPixelType *pixel_type_out,
+                                  gint *width_out,
+                                  gint *height_out,
+                                  gint *rowstride_out)
+{
+    g_return_val_if_fail (loader != NULL, NULL);
+
+    if (pixel_type_out)
+        *pixel_type_out = loader->pixel_type;
+    if (width_out)
+        *width_out = loader->width;
+    if (height_out)
+        *height_out = loader->height;
+    if (rowstride_out)
+        *rowstride_out = loader->rowstride;
+
+    return loader->frame_data ? (gconstpointer) loader->frame_data : loader->raster;
+}
+
+gint
+chicle_pnm_loader_get_frame_delay (G_GNUC_UNUSED ChiclePnmLoader *loader)
+{
+    return 0;
+}
+
+void
+chicle_pnm_loader_goto_first_frame (G_GNUC_UNUSED ChiclePnmLoader *loader)
+{
+}
+
+gboolean
+chicle_pnm_loader_goto_next_frame (G_GNUC_UNUSED ChiclePnmLoader *loader)
+{
+    return FALSE;
+}
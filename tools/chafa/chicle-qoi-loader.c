@@ -37,6 +37,10 @@
 
 #define BYTES_PER_PIXEL 4
 
+/* Largest reduction factor we'll apply while decoding. Keeps the block sums
+ * well within range. */
+#define REDUCTION_MAX 256
+
 struct ChicleQoiLoader
 {
     ChicleFileMapping *mapping;
@@ -44,8 +48,230 @@ struct ChicleQoiLoader
     size_t file_data_len;
     gpointer frame_data;
     gint width, height;
+
+    /* Before reduction. The image should be laid out at this size. */
+    gint image_width, image_height;
+
+    ChafaPixelType pixel_type;
 };
 
+/* --- Streaming decoder --- */
+
+/* This decodes exactly like qoi_decode (), but one row at a time, so we
+ * never need to hold the full-size image in memory. */
+
+typedef struct
+{
+    const guint8 *bytes;
+    gint p, chunks_len;
+    gint run;
+    qoi_rgba_t px;
+    qoi_rgba_t index [64];
+}
+QoiStream;
+
+static gboolean
+qoi_stream_init (QoiStream *stream, const guint8 *data, gsize data_len, qoi_desc *desc)
+{
+    guint header_magic;
+
+    memset (stream, 0, sizeof (*stream));
+
+    if (data_len < QOI_HEADER_SIZE + sizeof (qoi_padding)
+        || data_len > G_MAXINT)
+        return FALSE;
+
+    stream->bytes = data;
+
+    header_magic = qoi_read_32 (data, &stream->p);
+    desc->width = qoi_read_32 (data, &stream->p);
+    desc->height = qoi_read_32 (data, &stream->p);
+    desc->channels = data [stream->p++];
+    desc->colorspace = data [stream->p++];
+
+    /* Same limits as our qoi_decode () */
+    if (desc->width == 0 || desc->height == 0
+        || desc->channels < 3 || desc->channels > 4
+        || desc->colorspace > 1
+        || header_magic != QOI_MAGIC
+        || desc->height >= QOI_PIXELS_MAX / desc->width
+        || desc->width > 65535
+        || desc->height > 65535
+        || desc->width * (guint64) desc->height * BYTES_PER_PIXEL > (0xffffffffU >> 2))
+        return FALSE;
+
+    stream->chunks_len = data_len - sizeof (qoi_padding);
+    stream->px.rgba.a = 255;
+    return TRUE;
+}
+
+/* Decodes the next row to RGBA8. Like qoi_decode (), this repeats the last
+ * pixel if the data runs out. */
+static void
+qoi_stream_read_row (QoiStream *stream, guint8 *row_out, gint width)
+{
+    const guint8 *bytes = stream->bytes;
+    qoi_rgba_t px = stream->px;
+    gint p = stream->p;
+    gint run = stream->run;
+    gint i;
+
+    for (i = 0; i < width; i++)
+    {
+        if (run > 0)
+        {
+            run--;
+        }
+        else if (p < stream->chunks_len)
+        {
+            gint b1 = bytes [p++];
+
+            if (b1 == QOI_OP_RGB)
+            {
+                px.rgba.r = bytes [p++];
+                px.rgba.g = bytes [p++];
+                px.rgba.b = bytes [p++];
+            }
+            else if (b1 == QOI_OP_RGBA)
+            {
+                px.rgba.r = bytes [p++];
+                px.rgba.g = bytes [p++];
+                px.rgba.b = bytes [p++];
+                px.rgba.a = bytes [p++];
+            }
+            else if ((b1 & QOI_MASK_2) == QOI_OP_INDEX)
+            {
+                px = stream->index [b1];
+            }
+            else if ((b1 & QOI_MASK_2) == QOI_OP_DIFF)
+            {
+                px.rgba.r += ((b1 >> 4) & 0x03) - 2;
+                px.rgba.g += ((b1 >> 2) & 0x03) - 2;
+                px.rgba.b += (b1 & 0x03) - 2;
+            }
+            else if ((b1 & QOI_MASK_2) == QOI_OP_LUMA)
+            {
+                gint b2 = bytes [p++];
+                gint vg = (b1 & 0x3f) - 32;
+
+                px.rgba.r += vg - 8 + ((b2 >> 4) & 0x0f);
+                px.rgba.g += vg;
+                px.rgba.b += vg - 8 + (b2 & 0x0f);
+            }
+            else if ((b1 & QOI_MASK_2) == QOI_OP_RUN)
+            {
+                run = (b1 & 0x3f);
+            }
+
+            stream->index [QOI_COLOR_HASH (px) % 64] = px;
+        }
+
+        row_out [i * 4 + 0] = px.rgba.r;
+        row_out [i * 4 + 1] = px.rgba.g;
+        row_out [i * 4 + 2] = px.rgba.b;
+        row_out [i * 4 + 3] = px.rgba.a;
+    }
+
+    stream->px = px;
+    stream->p = p;
+    stream->run = run;
+}
+
+/* --- Reduction --- */
+
+/* QOI has no progressive or scaled decoding, so when the image is much bigger
+ * than we need, we shrink it by an integer factor as the rows come in. The
+ * result is kept at least as big as the target in both dimensions, leaving
+ * the final resampling to Chafa. */
+static gint
+calc_reduction_factor (gint width, gint height, gint target_width, gint target_height)
+{
+    gint factor;
+
+    if (target_width < 1 || target_height < 1)
+        return 1;
+
+    factor = MIN (width / target_width, height / target_height);
+    return CLAMP (factor, 1, REDUCTION_MAX);
+}
+
+static gpointer
+decode_full (QoiStream *stream, gint width, gint height)
+{
+    guint8 *frame_data;
+    gint y;
+
+    frame_data = g_malloc (width * (gsize) height * BYTES_PER_PIXEL);
+
+    for (y = 0; y < height; y++)
+        qoi_stream_read_row (stream, frame_data + y * (gsize) width * BYTES_PER_PIXEL, width);
+
+    return frame_data;
+}
+
+/* Box-filters factor x factor blocks. Color is weighted by alpha, so the
+ * output has premultiplied alpha. Partial blocks at the right and bottom
+ * edges are averaged over the pixels they have. */
+static gpointer
+decode_reduced (QoiStream *stream, gint width, gint height, gint factor,
+                gint *width_out, gint *height_out)
+{
+    gint dest_width = (width + factor - 1) / factor;
+    gint dest_height = (height + factor - 1) / factor;
+    guint8 *frame_data, *row;
+    guint64 *sums;
+    gint x, y;
+
+    frame_data = g_malloc (dest_width * (gsize) dest_height * BYTES_PER_PIXEL);
+    sums = g_new (guint64, dest_width * 4);
+    row = g_malloc (width * (gsize) BYTES_PER_PIXEL);
+
+    for (y = 0; y < dest_height; y++)
+    {
+        gint n_rows = MIN (factor, height - y * factor);
+        guint8 *dest = frame_data + y * (gsize) dest_width * BYTES_PER_PIXEL;
+        gint i;
+
+        memset (sums, 0, dest_width * 4 * sizeof (guint64));
+
+        for (i = 0; i < n_rows; i++)
+        {
+            qoi_stream_read_row (stream, row, width);
+
+            for (x = 0; x < width; x++)
+            {
+                const guint8 *src = row + x * BYTES_PER_PIXEL;
+                guint64 *sum = sums + (x / factor) * 4;
+
+                sum [0] += src [0] * src [3];
+                sum [1] += src [1] * src [3];
+                sum [2] += src [2] * src [3];
+                sum [3] += src [3];
+            }
+        }
+
+        for (x = 0; x < dest_width; x++)
+        {
+            guint64 n = (guint64) n_rows * MIN (factor, width - x * factor);
+            const guint64 *sum = sums + x * 4;
+
+            dest [x * 4 + 0] = (sum [0] + n * 255 / 2) / (n * 255);
+            dest [x * 4 + 1] = (sum [1] + n * 255 / 2) / (n * 255);
+            dest [x * 4 + 2] = (sum [2] + n * 255 / 2) / (n * 255);
+            dest [x * 4 + 3] = (sum [3] + n / 2) / n;
+        }
+    }
+
+    g_free (row);
+    g_free (sums);
+
+    *width_out = dest_width;
+    *height_out = dest_height;
+    return frame_data;
+}
+
+/* --- Loader --- */
+
 static ChicleQoiLoader *
 chicle_qoi_loader_new (void)
 {
@@ -53,12 +279,14 @@ chicle_qoi_loader_new (void)
 }
 
 ChicleQoiLoader *
-chicle_qoi_loader_new_from_mapping (ChicleFileMapping *mapping)
+chicle_qoi_loader_new_from_mapping (ChicleFileMapping *mapping,
+                                    gint target_width, gint target_height)
 {
     ChicleQoiLoader *loader = NULL;
     gboolean success = FALSE;
-    unsigned char *frame_data = NULL;
+    QoiStream stream;
     qoi_desc desc;
+    gint factor;
 
     g_return_val_if_fail (mapping != NULL, NULL);
 
@@ -72,18 +300,28 @@ chicle_qoi_loader_new_from_mapping (ChicleFileMapping *mapping)
     if (!loader->file_data)
         goto out;
 
-    /* Decodes to RGBA8 */
-    frame_data = qoi_decode (loader->file_data, loader->file_data_len, &desc, BYTES_PER_PIXEL);
-    if (!frame_data)
+    if (!qoi_stream_init (&stream, loader->file_data, loader->file_data_len, &desc))
         goto out;
 
-    if (desc.width < 1 || desc.width >= (1 << 16)
-        || desc.height < 1 || desc.height >= (1 << 16))
-        goto out;
+    loader->image_width = desc.width;
+    loader->image_height = desc.height;
 
-    loader->frame_data = frame_data;
-    loader->width = desc.width;
-    loader->height = desc.height;
+    /* Decodes to RGBA8 */
+    factor = calc_reduction_factor (desc.width, desc.height, target_width, target_height);
+
+    if (factor > 1)
+    {
+        loader->frame_data = decode_reduced (&stream, desc.width, desc.height, factor,
+                                             &loader->width, &loader->height);
+        loader->pixel_type = CHAFA_PIXEL_RGBA8_PREMULTIPLIED;
+    }
+    else
+    {
+        loader->frame_data = decode_full (&stream, desc.width, desc.height);
+        loader->width = desc.width;
+        loader->height = desc.height;
+        loader->pixel_type = CHAFA_PIXEL_RGBA8_UNASSOCIATED;
+    }
 
     success = TRUE;
 
@@ -95,9 +333,6 @@ out:
             g_free (loader);
             loader = NULL;
         }
-
-        if (frame_data)
-            free (frame_data);
     }
 
     return loader;
@@ -110,7 +345,7 @@ chicle_qoi_loader_destroy (ChicleQoiLoader *loader)
         chicle_file_mapping_destroy (loader->mapping);
 
     if (loader->frame_data)
-        free (loader->frame_data);
+        g_free (loader->frame_data);
 
     g_free (loader);
 }
@@ -133,7 +368,7 @@ chicle_qoi_loader_get_frame_data (ChicleQoiLoader *loader,
     g_return_val_if_fail (loader != NULL, NULL);
 
     if (pixel_type_out)
-        *pixel_type_out = CHAFA_PIXEL_RGBA8_UNASSOCIATED;
+        *pixel_type_out = loader->pixel_type;
     if (width_out)
         *width_out = loader->width;
     if (height_out)
@@ -144,6 +379,20 @@ chicle_qoi_loader_get_frame_data (ChicleQoiLoader *loader,
     return loader->frame_data;
 }
 
+/* The frame data may be smaller than this, if it was reduced while decoding */
+void
+chicle_qoi_loader_get_image_size (ChicleQoiLoader *loader,
+                                  gint *width_out,
+                                  gint *height_out)
+{
+    g_return_if_fail (loader != NULL);
+
+    if (width_out)
+        *width_out = loader->image_width;
+    if (height_out)
+        *height_out = loader->image_height;
+}
+
 gint
 chicle_qoi_loader_get_frame_delay (ChicleQoiLoader *loader)
 {
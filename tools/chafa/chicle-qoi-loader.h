@@ -27,7 +27,8 @@ G_BEGIN_DECLS
 
 typedef struct ChicleQoiLoader ChicleQoiLoader;
 
-ChicleQoiLoader *chicle_qoi_loader_new_from_mapping (ChicleFileMapping *mapping);
+ChicleQoiLoader *chicle_qoi_loader_new_from_mapping (ChicleFileMapping *mapping,
+                                                     gint target_width, gint target_height);
 void chicle_qoi_loader_destroy (ChicleQoiLoader *loader);
 
 gboolean chicle_qoi_loader_get_is_animation (ChicleQoiLoader *loader);
@@ -37,6 +38,9 @@ gconstpointer chicle_qoi_loader_get_frame_data (ChicleQoiLoader *loader,
                                                 gint *width_out,
                                                 gint *height_out,
                                                 gint *rowstride_out);
+void chicle_qoi_loader_get_image_size (ChicleQoiLoader *loader,
+                                       gint *width_out,
+                                       gint *height_out);
 gint chicle_qoi_loader_get_frame_delay (ChicleQoiLoader *loader);
 
 void chicle_qoi_loader_goto_first_frame (ChicleQoiLoader *loader);
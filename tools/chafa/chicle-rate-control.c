@@ -0,0 +1,255 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* Copyright (C) 2018-2025 Hans Petter Jansson
+ *
+ * This file is part of Chafa, a program that shows pictures on text terminals.
+ *
+ * Chafa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Chafa is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Chafa.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "config.h"
+
+#include <chafa.h>
+#include "chicle-rate-control.h"
+
+/* Quality levels, from best to cheapest. Level 1 lowers the work factor,
+ * drops truecolor to 256 colors and lets similar colors in neighboring cells
+ * be merged; level 2 drops to 16 colors. Colors are what
+ * dominates the size of symbol output, since every change costs an SGR
+ * sequence. Pixel modes have no cheaper variant, so for them we go straight
+ * to dropping frames. */
+#define LEVEL_MAX 2
+
+/* Work factor and color merge threshold used at level 1 and up */
+#define REDUCED_WORK_FACTOR 0.25f
+#define REDUCED_COLOR_MERGE_THRESHOLD 0.05f
+
+/* Number of consecutive frames that must fit comfortably within budget before
+ * we try a better level. This prevents oscillation. */
+#define N_CALM_FRAMES_TO_RAISE 4
+
+/* Frames with no interval (--speed max, or zero delays in the file) are
+ * budgeted for the time that actually passed since the previous one, but
+ * never less than this. Otherwise the bandwidth would buy them nothing. */
+#define MIN_FRAME_INTERVAL_MS 1.0
+
+struct ChicleRateControl
+{
+    gint64 max_bytes_per_s;
+    gint64 max_bytes_per_frame;
+
+    /* Budget for the frame in progress */
+    gint64 frame_budget;
+
+    /* Leaky bucket. Refilled by frame_budget for each frame, drained by
+     * the bytes actually emitted. Frames are dropped while it's negative. */
+    gint64 credit;
+
+    gint level;
+    gint max_level;
+    gint n_calm_frames;
+    gint n_frames;
+    gboolean just_lowered;
+
+    /* Monotonic time of the previous begin_frame, in microseconds */
+    gint64 last_begin_time;
+
+    /* Size of the most recent frame emitted at each level, and the observed
+     * cost of each level relative to the one below it. Used to estimate
+     * whether we can afford to go back up. */
+    gsize last_bytes [LEVEL_MAX + 1];
+    gdouble level_ratio [LEVEL_MAX];
+};
+
+static gint64
+calc_frame_budget (ChicleRateControl *rate_control, gdouble frame_interval_ms)
+{
+    gint64 budget = G_MAXINT64;
+
+    if (rate_control->max_bytes_per_frame > 0)
+        budget = rate_control->max_bytes_per_frame;
+
+    if (rate_control->max_bytes_per_s > 0)
+    {
+        gdouble d = (gdouble) rate_control->max_bytes_per_s * frame_interval_ms / 1000.0;
+
+        if (d < (gdouble) budget)
+            budget = (gint64) d;
+    }
+
+    return budget;
+}
+
+ChicleRateControl *
+chicle_rate_control_new (gint64 max_bytes_per_s, gint64 max_bytes_per_frame)
+{
+    ChicleRateControl *rate_control;
+
+    rate_control = g_new0 (ChicleRateControl, 1);
+    rate_control->max_bytes_per_s = max_bytes_per_s;
+    rate_control->max_bytes_per_frame = max_bytes_per_frame;
+    rate_control->max_level = LEVEL_MAX;
+
+    return rate_control;
+}
+
+void
+chicle_rate_control_destroy (ChicleRateControl *rate_control)
+{
+    g_free (rate_control);
+}
+
+/* Returns FALSE if the frame should be dropped. The first frame is always
+ * shown, so there is something on screen even with a tiny budget. */
+gboolean
+chicle_rate_control_begin_frame (ChicleRateControl *rate_control, gdouble frame_interval_ms)
+{
+    gint64 now;
+
+    g_return_val_if_fail (rate_control != NULL, TRUE);
+
+    now = g_get_monotonic_time ();
+
+    if (frame_interval_ms < MIN_FRAME_INTERVAL_MS)
+    {
+        frame_interval_ms = MIN_FRAME_INTERVAL_MS;
+        if (rate_control->n_frames > 0)
+            frame_interval_ms = MAX (frame_interval_ms,
+                                     (now - rate_control->last_begin_time) / 1000.0);
+    }
+
+    rate_control->last_begin_time = now;
+    rate_control->frame_budget = calc_frame_budget (rate_control, frame_interval_ms);
+
+    /* Don't let unused budget accumulate beyond one frame's worth. Otherwise
+     * a run of cheap frames would let a later burst through unchecked. */
+    if (rate_control->credit > G_MAXINT64 - rate_control->frame_budget)
+        rate_control->credit = G_MAXINT64;
+    else
+        rate_control->credit += rate_control->frame_budget;
+    rate_control->credit = MIN (rate_control->credit, rate_control->frame_budget);
+
+    if (rate_control->credit < 0 && rate_control->n_frames > 0)
+        return FALSE;
+
+    rate_control->n_frames++;
+    return TRUE;
+}
+
+void
+chicle_rate_control_apply (ChicleRateControl *rate_control, ChafaCanvasConfig *config)
+{
+    ChafaCanvasMode mode;
+
+    g_return_if_fail (rate_control != NULL);
+    g_return_if_fail (config != NULL);
+
+    if (chafa_canvas_config_get_pixel_mode (config) != CHAFA_PIXEL_MODE_SYMBOLS)
+    {
+        rate_control->max_level = 0;
+        rate_control->level = 0;
+        return;
+    }
+
+    rate_control->max_level = LEVEL_MAX;
+    mode = chafa_canvas_config_get_canvas_mode (config);
+
+    if (rate_control->level >= 1)
+    {
+        chafa_canvas_config_set_work_factor (config,
+                                             MIN (chafa_canvas_config_get_work_factor (config),
+                                                  REDUCED_WORK_FACTOR));
+        chafa_canvas_config_set_color_merge_threshold (config,
+                                                       MAX (chafa_canvas_config_get_color_merge_threshold (config),
+                                                            REDUCED_COLOR_MERGE_THRESHOLD));
+
+        if (mode == CHAFA_CANVAS_MODE_TRUECOLOR)
+            mode = CHAFA_CANVAS_MODE_INDEXED_256;
+    }
+
+    if (rate_control->level >= 2)
+    {
+        if (mode == CHAFA_CANVAS_MODE_INDEXED_256
+            || mode == CHAFA_CANVAS_MODE_INDEXED_240)
+            mode = CHAFA_CANVAS_MODE_INDEXED_16;
+    }
+
+    chafa_canvas_config_set_canvas_mode (config, mode);
+}
+
+void
+chicle_rate_control_end_frame (ChicleRateControl *rate_control, gsize n_bytes)
+{
+    gint64 budget;
+    gint level;
+
+    g_return_if_fail (rate_control != NULL);
+
+    budget = rate_control->frame_budget;
+    level = rate_control->level;
+    rate_control->credit -= (gint64) MIN (n_bytes, (gsize) G_MAXINT64 / 2);
+
+    /* The first frame after stepping down tells us how much we saved. Frames
+     * next to each other tend to be similar, so this is a fair estimate of
+     * the cost ratio between the two levels. */
+    if (rate_control->just_lowered && n_bytes > 0)
+        rate_control->level_ratio [level - 1] =
+            (gdouble) rate_control->last_bytes [level - 1] / (gdouble) n_bytes;
+
+    rate_control->just_lowered = FALSE;
+    rate_control->last_bytes [level] = n_bytes;
+
+    if ((gint64) n_bytes > budget)
+    {
+        rate_control->n_calm_frames = 0;
+        if (level < rate_control->max_level)
+        {
+            rate_control->level++;
+            rate_control->just_lowered = TRUE;
+        }
+        return;
+    }
+
+    if (level == 0)
+        return;
+
+    /* Only go back up if the better level is likely to fit with some margin */
+    if (rate_control->level_ratio [level - 1] > 0.0
+        && (gdouble) n_bytes * rate_control->level_ratio [level - 1] > budget * 0.9)
+    {
+        rate_control->n_calm_frames = 0;
+        return;
+    }
+
+    if (++rate_control->n_calm_frames >= N_CALM_FRAMES_TO_RAISE)
+    {
+        rate_control->level--;
+        rate_control->n_calm_frames = 0;
+    }
+}
+
+gint
+chicle_rate_control_get_level (ChicleRateControl *rate_control)
+{
+    g_return_val_if_fail (rate_control != NULL, 0);
+
+    return rate_control->level;
+}
+
+gint64
+chicle_rate_control_get_frame_budget (ChicleRateControl *rate_control)
+{
+    g_return_val_if_fail (rate_control != NULL, G_MAXINT64);
+
+    return rate_control->frame_budget;
+}
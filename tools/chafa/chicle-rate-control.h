@@ -0,0 +1,42 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* Copyright (C) 2018-2025 Hans Petter Jansson
+ *
+ * This file is part of Chafa, a program that shows pictures on text terminals.
+ *
+ * Chafa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Chafa is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Chafa.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef __CHICLE_RATE_CONTROL_H__
+#define __CHICLE_RATE_CONTROL_H__
+
+#include <glib.h>
+#include <chafa.h>
+
+G_BEGIN_DECLS
+
+typedef struct ChicleRateControl ChicleRateControl;
+
+ChicleRateControl *chicle_rate_control_new (gint64 max_bytes_per_s, gint64 max_bytes_per_frame);
+void chicle_rate_control_destroy (ChicleRateControl *rate_control);
+
+gboolean chicle_rate_control_begin_frame (ChicleRateControl *rate_control, gdouble frame_interval_ms);
+void chicle_rate_control_apply (ChicleRateControl *rate_control, ChafaCanvasConfig *config);
+void chicle_rate_control_end_frame (ChicleRateControl *rate_control, gsize n_bytes);
+
+gint chicle_rate_control_get_level (ChicleRateControl *rate_control);
+gint64 chicle_rate_control_get_frame_budget (ChicleRateControl *rate_control);
+
+G_END_DECLS
+
+#endif /* __CHICLE_RATE_CONTROL_H__ */
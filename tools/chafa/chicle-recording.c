@@ -0,0 +1,517 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* Copyright (C) 2018-2025 Hans Petter Jansson
+ *
+ * This file is part of Chafa, a program that shows pictures on text terminals.
+ *
+ * Chafa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Chafa is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Chafa.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>  /* memcmp */
+#include <glib/gstdio.h>
+
+#include <chafa.h>
+#include "chicle-file-mapping.h"
+#include "chicle-recording.h"
+
+/* A recording holds the printed rows of each frame, exactly as they came
+ * out of chafa_canvas_print_rows (). Replaying one only has to write them
+ * out again, so it skips decoding, scaling, symbol matching and printing.
+ * Since the rows depend on the term info and canvas options, a recording is
+ * only valid for the terminal it was made for.
+ *
+ * Integers are unsigned LEB128 varints. The format is:
+ *
+ *   Header:  "chafarec" magic, version
+ *   Image:   IMAGE tag, path length, path, pixel mode,
+ *            flags (bit 0 = animation)
+ *   Frame:   FRAME tag, delay in ms, width and height in cells, n_rows
+ *   Row:     prefix length, suffix length, middle length, middle bytes
+ *
+ * The path is kept for labels. An image is followed by its frames, from
+ * the first pass only; images that failed to load have none. Each row is
+ * delta-coded against the same row of the image's previous non-empty frame:
+ * the prefix and suffix are copied from it, and the middle is stored
+ * verbatim. In animations where little changes, most rows are a few bytes.
+ * A frame with zero rows was dropped by rate control, and only its delay
+ * matters. */
+
+#define MAGIC "chafarec"
+#define MAGIC_LEN 8
+#define FORMAT_VERSION 1
+
+#define TAG_IMAGE 1
+#define TAG_FRAME 2
+
+#define IMAGE_FLAG_ANIMATION (1 << 0)
+
+/* Limits for sanity checking on read */
+#define N_ROWS_MAX 65536
+#define DIMENSION_MAX 65536
+
+static void
+free_gstring (GString *gs)
+{
+    g_string_free (gs, TRUE);
+}
+
+/* --- Writer --- */
+
+struct ChicleRecorder
+{
+    gchar *path;
+    FILE *file;
+    GString *buf;
+
+    /* Rows of the previous non-empty frame in the current image */
+    GPtrArray *prev_rows;
+};
+
+static void
+put_uint (GString *buf, guint64 n)
+{
+    do
+    {
+        guint8 c = n & 0x7f;
+
+        n >>= 7;
+        if (n)
+            c |= 0x80;
+        g_string_append_c (buf, c);
+    }
+    while (n);
+}
+
+static void
+flush_buf (ChicleRecorder *recorder)
+{
+    if (recorder->buf->len > 0)
+        fwrite (recorder->buf->str, 1, recorder->buf->len, recorder->file);
+    g_string_truncate (recorder->buf, 0);
+}
+
+static void
+put_row (GString *buf, const GString *ref, const GString *row)
+{
+    gsize ref_len = ref ? ref->len : 0;
+    gsize max_common = MIN (ref_len, row->len);
+    gsize prefix, suffix;
+
+    for (prefix = 0; prefix < max_common; prefix++)
+    {
+        if (ref->str [prefix] != row->str [prefix])
+            break;
+    }
+
+    for (suffix = 0; suffix < max_common - prefix; suffix++)
+    {
+        if (ref->str [ref_len - suffix - 1] != row->str [row->len - suffix - 1])
+            break;
+    }
+
+    put_uint (buf, prefix);
+    put_uint (buf, suffix);
+    put_uint (buf, row->len - prefix - suffix);
+    g_string_append_len (buf, row->str + prefix, row->len - prefix - suffix);
+}
+
+ChicleRecorder *
+chicle_recorder_new (const gchar *path, GError **error)
+{
+    ChicleRecorder *recorder;
+    FILE *file;
+
+    file = g_fopen (path, "wb");
+    if (!file)
+    {
+        gint saved_errno = errno;
+
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+                     "%s", g_strerror (saved_errno));
+        return NULL;
+    }
+
+    recorder = g_new0 (ChicleRecorder, 1);
+    recorder->path = g_strdup (path);
+    recorder->file = file;
+    recorder->buf = g_string_new ("");
+    recorder->prev_rows = g_ptr_array_new_with_free_func ((GDestroyNotify) free_gstring);
+
+    g_string_append_len (recorder->buf, MAGIC, MAGIC_LEN);
+    put_uint (recorder->buf, FORMAT_VERSION);
+    flush_buf (recorder);
+
+    return recorder;
+}
+
+gboolean
+chicle_recorder_close (ChicleRecorder *recorder, GError **error)
+{
+    gboolean success;
+
+    flush_buf (recorder);
+    success = !ferror (recorder->file);
+    if (fclose (recorder->file) != 0)
+        success = FALSE;
+
+    if (!success)
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_IO,
+                     "Failed to write '%s'", recorder->path);
+
+    g_ptr_array_free (recorder->prev_rows, TRUE);
+    g_string_free (recorder->buf, TRUE);
+    g_free (recorder->path);
+    g_free (recorder);
+    return success;
+}
+
+void
+chicle_recorder_begin_image (ChicleRecorder *recorder, const gchar *path,
+                             ChafaPixelMode pixel_mode, gboolean is_animation)
+{
+    gsize path_len = strlen (path);
+
+    put_uint (recorder->buf, TAG_IMAGE);
+    put_uint (recorder->buf, path_len);
+    g_string_append_len (recorder->buf, path, path_len);
+    put_uint (recorder->buf, pixel_mode);
+    put_uint (recorder->buf, is_animation ? IMAGE_FLAG_ANIMATION : 0);
+    flush_buf (recorder);
+
+    g_ptr_array_set_size (recorder->prev_rows, 0);
+}
+
+/* Pass NULL for @gsa to record a dropped frame */
+void
+chicle_recorder_add_frame (ChicleRecorder *recorder, GString **gsa,
+                           gint dest_width, gint dest_height, gint delay_ms)
+{
+    GPtrArray *prev_rows = recorder->prev_rows;
+    guint n_rows = 0;
+    guint i;
+
+    if (gsa)
+    {
+        while (gsa [n_rows])
+            n_rows++;
+    }
+
+    put_uint (recorder->buf, TAG_FRAME);
+    put_uint (recorder->buf, MAX (delay_ms, 0));
+    put_uint (recorder->buf, dest_width);
+    put_uint (recorder->buf, dest_height);
+    put_uint (recorder->buf, n_rows);
+
+    for (i = 0; i < n_rows; i++)
+    {
+        put_row (recorder->buf, i < prev_rows->len ? g_ptr_array_index (prev_rows, i) : NULL,
+                 gsa [i]);
+    }
+
+    flush_buf (recorder);
+
+    if (n_rows > 0)
+    {
+        g_ptr_array_set_size (prev_rows, 0);
+        for (i = 0; i < n_rows; i++)
+            g_ptr_array_add (prev_rows, g_string_new_len (gsa [i]->str, gsa [i]->len));
+    }
+}
+
+/* --- Reader --- */
+
+struct ChicleRecording
+{
+    ChicleFileMapping *mapping;
+    const guint8 *data;
+    gsize len;
+
+    /* Read position, and the start of the current image's frames */
+    gsize ofs;
+    gsize image_ofs;
+
+    /* Rows of the last non-empty frame, plus a NULL terminator. This is
+     * what the current frame shows, unless it was dropped. */
+    GPtrArray *rows;
+    gboolean frame_is_dropped;
+    gint dest_width, dest_height;
+    gint delay_ms;
+};
+
+static gboolean
+get_uint (ChicleRecording *recording, guint64 *n_out)
+{
+    guint64 n = 0;
+    gint shift;
+
+    for (shift = 0; shift < 64; shift += 7)
+    {
+        guint8 c;
+
+        if (recording->ofs >= recording->len)
+            return FALSE;
+
+        c = recording->data [recording->ofs++];
+        n |= (guint64) (c & 0x7f) << shift;
+
+        if (!(c & 0x80))
+        {
+            *n_out = n;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static gboolean
+get_bounded_uint (ChicleRecording *recording, guint64 max, gint *n_out)
+{
+    guint64 n;
+
+    if (!get_uint (recording, &n) || n > max)
+        return FALSE;
+
+    *n_out = n;
+    return TRUE;
+}
+
+static gboolean
+get_row (ChicleRecording *recording, guint i)
+{
+    GString *ref = i < recording->rows->len - 1 ? g_ptr_array_index (recording->rows, i) : NULL;
+    gsize ref_len = ref ? ref->len : 0;
+    guint64 prefix, suffix, middle;
+    GString *row;
+
+    if (!get_uint (recording, &prefix)
+        || !get_uint (recording, &suffix)
+        || !get_uint (recording, &middle)
+        || prefix > ref_len || suffix > ref_len - prefix
+        || middle > recording->len - recording->ofs)
+        return FALSE;
+
+    row = g_string_sized_new (prefix + middle + suffix);
+    if (prefix > 0)
+        g_string_append_len (row, ref->str, prefix);
+    g_string_append_len (row, (const gchar *) recording->data + recording->ofs, middle);
+    if (suffix > 0)
+        g_string_append_len (row, ref->str + ref_len - suffix, suffix);
+    recording->ofs += middle;
+
+    /* Rows only refer to their own index, so they can be replaced in place */
+    if (i < recording->rows->len - 1)
+    {
+        free_gstring (g_ptr_array_index (recording->rows, i));
+        g_ptr_array_index (recording->rows, i) = row;
+    }
+    else
+    {
+        g_ptr_array_index (recording->rows, recording->rows->len - 1) = row;
+        g_ptr_array_add (recording->rows, NULL);
+    }
+
+    return TRUE;
+}
+
+static gboolean
+read_frame (ChicleRecording *recording)
+{
+    guint64 tag;
+    gint n_rows;
+    gint i;
+
+    if (recording->ofs >= recording->len)
+        return FALSE;
+
+    /* Peek, so the next image stays put */
+    if (recording->data [recording->ofs] != TAG_FRAME)
+        return FALSE;
+
+    if (!get_uint (recording, &tag)
+        || !get_bounded_uint (recording, G_MAXINT, &recording->delay_ms)
+        || !get_bounded_uint (recording, DIMENSION_MAX, &recording->dest_width)
+        || !get_bounded_uint (recording, DIMENSION_MAX, &recording->dest_height)
+        || !get_bounded_uint (recording, N_ROWS_MAX, &n_rows))
+        goto corrupt;
+
+    recording->frame_is_dropped = (n_rows == 0);
+    if (recording->frame_is_dropped)
+        return TRUE;
+
+    for (i = 0; i < n_rows; i++)
+    {
+        if (!get_row (recording, i))
+            goto corrupt;
+    }
+
+    /* Drop rows beyond the new count, keeping the terminator */
+    while (recording->rows->len - 1 > (guint) n_rows)
+    {
+        free_gstring (g_ptr_array_index (recording->rows, recording->rows->len - 2));
+        g_ptr_array_remove_index (recording->rows, recording->rows->len - 2);
+    }
+
+    return TRUE;
+
+corrupt:
+    /* Stop here; there's no way to resynchronize */
+    recording->ofs = recording->len;
+    return FALSE;
+}
+
+static void
+reset_rows (ChicleRecording *recording)
+{
+    guint i;
+
+    for (i = 0; i + 1 < recording->rows->len; i++)
+        free_gstring (g_ptr_array_index (recording->rows, i));
+
+    g_ptr_array_set_size (recording->rows, 0);
+    g_ptr_array_add (recording->rows, NULL);
+}
+
+ChicleRecording *
+chicle_recording_new (const gchar *path, GError **error)
+{
+    ChicleRecording *recording;
+    ChicleFileMapping *mapping;
+    const guint8 *data;
+    guint64 version;
+    gsize len;
+
+    mapping = chicle_file_mapping_new (path);
+    if (!chicle_file_mapping_open_now (mapping, error))
+    {
+        chicle_file_mapping_destroy (mapping);
+        return NULL;
+    }
+
+    data = chicle_file_mapping_get_data (mapping, &len);
+    if (!data || len < MAGIC_LEN || memcmp (data, MAGIC, MAGIC_LEN))
+    {
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                     "Not a recording");
+        chicle_file_mapping_destroy (mapping);
+        return NULL;
+    }
+
+    recording = g_new0 (ChicleRecording, 1);
+    recording->mapping = mapping;
+    recording->data = data;
+    recording->len = len;
+    recording->ofs = MAGIC_LEN;
+    recording->rows = g_ptr_array_new ();
+    g_ptr_array_add (recording->rows, NULL);
+
+    if (!get_uint (recording, &version) || version != FORMAT_VERSION)
+    {
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                     "Unsupported recording version");
+        chicle_recording_destroy (recording);
+        return NULL;
+    }
+
+    recording->image_ofs = recording->ofs;
+    return recording;
+}
+
+void
+chicle_recording_destroy (ChicleRecording *recording)
+{
+    reset_rows (recording);
+    g_ptr_array_free (recording->rows, TRUE);
+    chicle_file_mapping_destroy (recording->mapping);
+    g_free (recording);
+}
+
+/* Skips any remaining frames of the current image and reads the header of
+ * the next one. */
+gboolean
+chicle_recording_next_image (ChicleRecording *recording,
+                             gchar **path_out,
+                             ChafaPixelMode *pixel_mode_out,
+                             gboolean *is_animation_out)
+{
+    guint64 tag, path_len;
+    gsize path_ofs;
+    gint pixel_mode, flags;
+
+    while (read_frame (recording))
+        ;
+
+    if (!get_uint (recording, &tag)
+        || tag != TAG_IMAGE
+        || !get_uint (recording, &path_len)
+        || path_len > recording->len - recording->ofs)
+        goto corrupt;
+
+    path_ofs = recording->ofs;
+    recording->ofs += path_len;
+
+    if (!get_bounded_uint (recording, CHAFA_PIXEL_MODE_MAX - 1, &pixel_mode)
+        || !get_bounded_uint (recording, G_MAXINT, &flags))
+        goto corrupt;
+
+    recording->image_ofs = recording->ofs;
+    reset_rows (recording);
+
+    if (path_out)
+        *path_out = g_strndup ((const gchar *) recording->data + path_ofs, path_len);
+    if (pixel_mode_out)
+        *pixel_mode_out = pixel_mode;
+    if (is_animation_out)
+        *is_animation_out = (flags & IMAGE_FLAG_ANIMATION) ? TRUE : FALSE;
+
+    return TRUE;
+
+corrupt:
+    recording->ofs = recording->len;
+    return FALSE;
+}
+
+gboolean
+chicle_recording_goto_first_frame (ChicleRecording *recording)
+{
+    recording->ofs = recording->image_ofs;
+    reset_rows (recording);
+    return read_frame (recording);
+}
+
+gboolean
+chicle_recording_goto_next_frame (ChicleRecording *recording)
+{
+    return read_frame (recording);
+}
+
+/* Returns a NULL-terminated array of rows owned by the recording, or NULL
+ * if the frame was dropped. */
+GString **
+chicle_recording_get_frame (ChicleRecording *recording,
+                            gint *dest_width_out, gint *dest_height_out,
+                            gint *delay_ms_out)
+{
+    if (dest_width_out)
+        *dest_width_out = recording->dest_width;
+    if (dest_height_out)
+        *dest_height_out = recording->dest_height;
+    if (delay_ms_out)
+        *delay_ms_out = recording->delay_ms;
+
+    return recording->frame_is_dropped ? NULL : (GString **) recording->rows->pdata;
+}
@@ -0,0 +1,59 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/* Copyright (C) 2018-2025 Hans Petter Jansson
+ *
+ * This file is part of Chafa, a program that shows pictures on text terminals.
+ *
+ * Chafa is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Chafa is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Chafa.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef __CHICLE_RECORDING_H__
+#define __CHICLE_RECORDING_H__
+
+#include <glib.h>
+#include <chafa.h>
+
+G_BEGIN_DECLS
+
+/* Writer */
+
+typedef struct ChicleRecorder ChicleRecorder;
+
+ChicleRecorder *chicle_recorder_new (const gchar *path, GError **error);
+gboolean chicle_recorder_close (ChicleRecorder *recorder, GError **error);
+
+void chicle_recorder_begin_image (ChicleRecorder *recorder, const gchar *path,
+                                  ChafaPixelMode pixel_mode, gboolean is_animation);
+void chicle_recorder_add_frame (ChicleRecorder *recorder, GString **gsa,
+                                gint dest_width, gint dest_height, gint delay_ms);
+
+/* Reader */
+
+typedef struct ChicleRecording ChicleRecording;
+
+ChicleRecording *chicle_recording_new (const gchar *path, GError **error);
+void chicle_recording_destroy (ChicleRecording *recording);
+
+gboolean chicle_recording_next_image (ChicleRecording *recording,
+                                      gchar **path_out,
+                                      ChafaPixelMode *pixel_mode_out,
+                                      gboolean *is_animation_out);
+gboolean chicle_recording_goto_first_frame (ChicleRecording *recording);
+gboolean chicle_recording_goto_next_frame (ChicleRecording *recording);
+GString **chicle_recording_get_frame (ChicleRecording *recording,
+                                      gint *dest_width_out, gint *dest_height_out,
+                                      gint *delay_ms_out);
+
+G_END_DECLS
+
+#endif /* __CHICLE_RECORDING_H__ */
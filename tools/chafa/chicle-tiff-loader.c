@@ -33,6 +33,7 @@
 
 #include <chafa.h>
 #include "chicle-tiff-loader.h"
+#include "chicle-util.h"
 
 /* ----------------------- *
  * Global macros and types *
@@ -46,9 +47,17 @@ struct ChicleTiffLoader
     ChicleFileMapping *mapping;
     const guint8 *file_data;
     size_t file_data_len;
+    TIFF *tiff;
+
+    /* The main image is decoded on first use */
     gpointer frame_data;
     gint width, height;
     ChafaPixelType pixel_type;
+    guint tried_decode : 1;
+
+    gpointer thumb_data;
+    gint thumb_width, thumb_height;
+    ChafaPixelType thumb_pixel_type;
 
     toff_t file_pos;
 };
@@ -149,63 +158,29 @@ my_tiff_warning_handler (G_GNUC_UNUSED const char *module, G_GNUC_UNUSED const c
 {
 }
 
-/* --- Loader --- */
+/* --- Decoder --- */
 
-static ChicleTiffLoader *
-chicle_tiff_loader_new (void)
+/* Decodes the current directory */
+static gboolean
+decode_directory (TIFF *tiff, gpointer *frame_data_out, gint *width_out, gint *height_out,
+                  ChafaPixelType *pixel_type_out)
 {
-    return g_new0 (ChicleTiffLoader, 1);
-}
-
-ChicleTiffLoader *
-chicle_tiff_loader_new_from_mapping (ChicleFileMapping *mapping)
-{
-    ChicleTiffLoader *loader = NULL;
-    gboolean success = FALSE;
     gpointer frame_data = NULL;
-    TIFF *tiff = NULL;
-    gint samples_per_pixel = 4;
+    ChafaPixelType pixel_type;
+    uint16_t samples_per_pixel = 4;
     uint32_t width, height;
 
-    g_return_val_if_fail (mapping != NULL, NULL);
-
-    if (!((chicle_file_mapping_has_magic (mapping, 0, "II", 2)
-           && chicle_file_mapping_has_magic (mapping, 2, "\x2a\x00", 2))
-          || (chicle_file_mapping_has_magic (mapping, 0, "MM", 2)
-              && chicle_file_mapping_has_magic (mapping, 2, "\x00\x2a", 2))))
-        goto out;
-
-    loader = chicle_tiff_loader_new ();
-    loader->mapping = mapping;
-
-    /* Get file data */
-
-    loader->file_data = chicle_file_mapping_get_data (loader->mapping, &loader->file_data_len);
-    if (!loader->file_data)
-        goto out;
-
-    /* Prepare to decode */
-
-    TIFFSetErrorHandler (my_tiff_error_handler);
-    TIFFSetWarningHandler (my_tiff_warning_handler);
-
-    tiff = TIFFClientOpen ("Memory", "r", (thandle_t) loader,
-                           my_tiff_read, my_tiff_write, my_tiff_seek, my_tiff_close,
-                           my_tiff_size, my_tiff_map, my_tiff_unmap);
-    if (!tiff)
-        goto out;
-
     if (!TIFFGetField (tiff, TIFFTAG_IMAGEWIDTH, &width))
-        goto out;
+        goto fail;
     if (!TIFFGetField (tiff, TIFFTAG_IMAGELENGTH, &height))
-        goto out;
+        goto fail;
     if (!TIFFGetField (tiff, TIFFTAG_SAMPLESPERPIXEL, &samples_per_pixel))
-        goto out;
+        goto fail;
 
     if (width < 1 || width > (1 << 28)
         || height < 1 || height > (1 << 28)
         || (width * (guint64) height * BYTES_PER_PIXEL > IMAGE_BUFFER_SIZE_MAX))
-        goto out;
+        goto fail;
 
     /* An opaque image with unassociated alpha set to 0xff is equivalent to
      * premultiplied alpha. This will speed up resampling later on.
@@ -215,7 +190,7 @@ chicle_tiff_loader_new_from_mapping (ChicleFileMapping *mapping)
      * for an EXTRASAMPLES field, and if it doesn't explicitly specify
      * premultiplied alpha, we fail safe to unassociated alpha. */
 
-    loader->pixel_type = CHAFA_PIXEL_RGBA8_PREMULTIPLIED;
+    pixel_type = CHAFA_PIXEL_RGBA8_PREMULTIPLIED;
 
     if (samples_per_pixel == 2 || samples_per_pixel >= 4)
     {
@@ -224,37 +199,177 @@ chicle_tiff_loader_new_from_mapping (ChicleFileMapping *mapping)
 
         if (TIFFGetField (tiff, TIFFTAG_EXTRASAMPLES, &n_extra_samples, &extra_samples)
             && n_extra_samples >= 1 && extra_samples && extra_samples [0] != EXTRASAMPLE_ASSOCALPHA)
-            loader->pixel_type = CHAFA_PIXEL_RGBA8_UNASSOCIATED;
+            pixel_type = CHAFA_PIXEL_RGBA8_UNASSOCIATED;
     }
 
     frame_data = _TIFFmalloc (width * height * (guint64) BYTES_PER_PIXEL);
     if (!frame_data)
-        goto out;
+        goto fail;
 
     /* Decode and rotate the image */
 
     if (!TIFFReadRGBAImageOriented (tiff, width, height, (uint32_t *) frame_data, ORIENTATION_TOPLEFT, 0))
+        goto fail;
+
+    *frame_data_out = frame_data;
+    *width_out = width;
+    *height_out = height;
+    *pixel_type_out = pixel_type;
+    return TRUE;
+
+fail:
+    if (frame_data)
+        _TIFFfree (frame_data);
+    return FALSE;
+}
+
+static gboolean
+get_directory_size (TIFF *tiff, gint *width_out, gint *height_out)
+{
+    uint32_t width, height;
+
+    if (!TIFFGetField (tiff, TIFFTAG_IMAGEWIDTH, &width)
+        || !TIFFGetField (tiff, TIFFTAG_IMAGELENGTH, &height)
+        || width < 1 || width > (1 << 28)
+        || height < 1 || height > (1 << 28))
+        return FALSE;
+
+    *width_out = width;
+    *height_out = height;
+    return TRUE;
+}
+
+/* Finds the smallest usable reduced-resolution version of the first image
+ * and makes it the current directory. These are stored either in SubIFDs
+ * (e.g. DNG, pyramidal TIFF) or as top-level directories flagged as
+ * reduced images. */
+static gboolean
+goto_thumbnail_directory (TIFF *tiff, gint min_width, gint min_height)
+{
+    toff_t *subifds = NULL;
+    uint16_t n_subifds = 0;
+    gint image_width, image_height;
+    gint best_area = G_MAXINT;
+    toff_t best_subifd = 0;
+    tdir_t best_dir = 0;
+    tdir_t n_dirs, i;
+    gboolean found = FALSE;
+
+    if (!TIFFSetDirectory (tiff, 0)
+        || !get_directory_size (tiff, &image_width, &image_height))
+        return FALSE;
+
+    if (TIFFGetField (tiff, TIFFTAG_SUBIFD, &n_subifds, &subifds) && n_subifds > 0)
+        subifds = g_memdup (subifds, n_subifds * sizeof (toff_t));
+    else
+        n_subifds = 0;
+
+    for (i = 0; i < n_subifds; i++)
+    {
+        gint width, height;
+
+        if (!TIFFSetSubDirectory (tiff, subifds [i])
+            || !get_directory_size (tiff, &width, &height)
+            || !chicle_thumbnail_is_usable (width, height, image_width, image_height,
+                                            min_width, min_height)
+            || width * height >= best_area)
+            continue;
+
+        best_area = width * height;
+        best_subifd = subifds [i];
+        found = TRUE;
+    }
+
+    n_dirs = TIFFNumberOfDirectories (tiff);
+
+    for (i = 1; i < n_dirs; i++)
+    {
+        uint32_t subfile_type = 0;
+        gint width, height;
+
+        if (!TIFFSetDirectory (tiff, i)
+            || !TIFFGetField (tiff, TIFFTAG_SUBFILETYPE, &subfile_type)
+            || !(subfile_type & FILETYPE_REDUCEDIMAGE)
+            || !get_directory_size (tiff, &width, &height)
+            || !chicle_thumbnail_is_usable (width, height, image_width, image_height,
+                                            min_width, min_height)
+            || width * height >= best_area)
+            continue;
+
+        best_area = width * height;
+        best_subifd = 0;
+        best_dir = i;
+        found = TRUE;
+    }
+
+    g_free (subifds);
+
+    if (!found)
+        return FALSE;
+
+    return best_subifd ? TIFFSetSubDirectory (tiff, best_subifd)
+        : TIFFSetDirectory (tiff, best_dir);
+}
+
+/* --- Loader --- */
+
+static ChicleTiffLoader *
+chicle_tiff_loader_new (void)
+{
+    return g_new0 (ChicleTiffLoader, 1);
+}
+
+ChicleTiffLoader *
+chicle_tiff_loader_new_from_mapping (ChicleFileMapping *mapping)
+{
+    ChicleTiffLoader *loader = NULL;
+    gboolean success = FALSE;
+    gint width, height;
+
+    g_return_val_if_fail (mapping != NULL, NULL);
+
+    if (!((chicle_file_mapping_has_magic (mapping, 0, "II", 2)
+           && chicle_file_mapping_has_magic (mapping, 2, "\x2a\x00", 2))
+          || (chicle_file_mapping_has_magic (mapping, 0, "MM", 2)
+              && chicle_file_mapping_has_magic (mapping, 2, "\x00\x2a", 2))))
+        goto out;
+
+    loader = chicle_tiff_loader_new ();
+    loader->mapping = mapping;
+
+    /* Get file data */
+
+    loader->file_data = chicle_file_mapping_get_data (loader->mapping, &loader->file_data_len);
+    if (!loader->file_data)
         goto out;
 
-    /* Finish up */
+    /* Prepare to decode */
 
-    loader->width = width;
-    loader->height = height;
-    loader->frame_data = frame_data;
+    TIFFSetErrorHandler (my_tiff_error_handler);
+    TIFFSetWarningHandler (my_tiff_warning_handler);
+
+    loader->tiff = TIFFClientOpen ("Memory", "r", (thandle_t) loader,
+                                   my_tiff_read, my_tiff_write, my_tiff_seek, my_tiff_close,
+                                   my_tiff_size, my_tiff_map, my_tiff_unmap);
+    if (!loader->tiff)
+        goto out;
+
+    /* The image data is decoded when it's first requested, so we can skip
+     * it if a thumbnail will do */
+
+    if (!get_directory_size (loader->tiff, &width, &height))
+        goto out;
 
     success = TRUE;
 
 out:
-    if (tiff)
-        TIFFClose (tiff);
-
     if (!success)
     {
-        if (frame_data)
-            _TIFFfree (frame_data);
-
         if (loader)
         {
+            if (loader->tiff)
+                TIFFClose (loader->tiff);
+
             g_free (loader);
             loader = NULL;
         }
@@ -266,12 +381,18 @@ out:
 void
 chicle_tiff_loader_destroy (ChicleTiffLoader *loader)
 {
+    if (loader->tiff)
+        TIFFClose (loader->tiff);
+
     if (loader->mapping)
         chicle_file_mapping_destroy (loader->mapping);
 
     if (loader->frame_data)
         _TIFFfree (loader->frame_data);
 
+    if (loader->thumb_data)
+        _TIFFfree (loader->thumb_data);
+
     g_free (loader);
 }
 
@@ -292,6 +413,18 @@ chicle_tiff_loader_get_frame_data (ChicleTiffLoader *loader,
 {
     g_return_val_if_fail (loader != NULL, NULL);
 
+    if (!loader->tried_decode)
+    {
+        loader->tried_decode = TRUE;
+
+        if (TIFFSetDirectory (loader->tiff, 0))
+            decode_directory (loader->tiff, &loader->frame_data,
+                              &loader->width, &loader->height, &loader->pixel_type);
+    }
+
+    if (!loader->frame_data)
+        return NULL;
+
     if (pixel_type_out)
         *pixel_type_out = loader->pixel_type;
     if (width_out)
@@ -304,6 +437,47 @@ chicle_tiff_loader_get_frame_data (ChicleTiffLoader *loader,
     return loader->frame_data;
 }
 
+gconstpointer
+chicle_tiff_loader_get_thumbnail_frame (ChicleTiffLoader *loader,
+                                        gint min_width,
+                                        gint min_height,
+                                        ChafaPixelType *pixel_type_out,
+                                        gint *width_out,
+                                        gint *height_out,
+                                        gint *rowstride_out)
+{
+    g_return_val_if_fail (loader != NULL, NULL);
+
+    /* A thumbnail picked for an earlier, smaller target may not do */
+    if (loader->thumb_data
+        && !chicle_thumbnail_covers (loader->thumb_width, loader->thumb_height,
+                                     min_width, min_height))
+    {
+        _TIFFfree (loader->thumb_data);
+        loader->thumb_data = NULL;
+    }
+
+    if (!loader->thumb_data)
+    {
+        if (!goto_thumbnail_directory (loader->tiff, min_width, min_height)
+            || !decode_directory (loader->tiff, &loader->thumb_data,
+                                  &loader->thumb_width, &loader->thumb_height,
+                                  &loader->thumb_pixel_type))
+            return NULL;
+    }
+
+    if (pixel_type_out)
+        *pixel_type_out = loader->thumb_pixel_type;
+    if (width_out)
+        *width_out = loader->thumb_width;
+    if (height_out)
+        *height_out = loader->thumb_height;
+    if (rowstride_out)
+        *rowstride_out = loader->thumb_width * BYTES_PER_PIXEL;
+
+    return loader->thumb_data;
+}
+
 gint
 chicle_tiff_loader_get_frame_delay (ChicleTiffLoader *loader)
 {
@@ -37,6 +37,13 @@ gconstpointer chicle_tiff_loader_get_frame_data (ChicleTiffLoader *loader,
                                                  gint *width_out,
                                                  gint *height_out,
                                                  gint *rowstride_out);
+gconstpointer chicle_tiff_loader_get_thumbnail_frame (ChicleTiffLoader *loader,
+                                                      gint min_width,
+                                                      gint min_height,
+                                                      ChafaPixelType *pixel_type_out,
+                                                      gint *width_out,
+                                                      gint *height_out,
+                                                      gint *rowstride_out);
 gint chicle_tiff_loader_get_frame_delay (ChicleTiffLoader *loader);
 
 void chicle_tiff_loader_goto_first_frame (ChicleTiffLoader *loader);
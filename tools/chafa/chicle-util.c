@@ -173,6 +173,108 @@ chicle_rotate_image (gpointer *src, guint *width, guint *height, guint *rowstrid
     *rowstride = dest_rowstride;
 }
 
+/* Some cameras letterbox their thumbnails, so we require the aspect ratio
+ * to match the full image within this tolerance */
+#define THUMBNAIL_ASPECT_TOLERANCE 0.02
+
+gboolean
+chicle_thumbnail_is_usable (gint thumb_width, gint thumb_height,
+                            gint image_width, gint image_height,
+                            gint min_width, gint min_height)
+{
+    gdouble aspect_ratio;
+
+    if (thumb_width < 1 || thumb_height < 1
+        || image_width < 1 || image_height < 1)
+        return FALSE;
+
+    /* Nothing to gain from a thumbnail that's as big as the image */
+    if (thumb_width >= image_width && thumb_height >= image_height)
+        return FALSE;
+
+    aspect_ratio = ((gdouble) thumb_width * image_height)
+        / ((gdouble) thumb_height * image_width);
+    if (aspect_ratio < 1.0 - THUMBNAIL_ASPECT_TOLERANCE
+        || aspect_ratio > 1.0 + THUMBNAIL_ASPECT_TOLERANCE)
+        return FALSE;
+
+    return chicle_thumbnail_covers (thumb_width, thumb_height, min_width, min_height);
+}
+
+/* When fitting, the tighter dimension decides the scale, so a thumbnail
+ * avoids upscaling if it covers the target in either dimension */
+gboolean
+chicle_thumbnail_covers (gint thumb_width, gint thumb_height,
+                         gint min_width, gint min_height)
+{
+    return thumb_width >= min_width || thumb_height >= min_height;
+}
+
+/* Open addressing; at most 256 entries, so it never gets more than a
+ * quarter full */
+#define INDEX_HASH_SIZE 1024
+
+/* Turns RGBA8 pixels with at most 256 distinct colors back into palette
+ * indices, for sources like GIF where the decoder only gives us pixels.
+ * All fully transparent pixels share one entry. The colors are packed as
+ * 0xAARRGGBB. Returns FALSE if there are too many colors. */
+gboolean
+chicle_index_rgba8 (const guint8 *pixels, gint width, gint height, gint rowstride,
+                    guint8 *indices_out, guint32 *colors_out, gint *n_colors_out)
+{
+    guint32 keys [INDEX_HASH_SIZE];
+    gint16 values [INDEX_HASH_SIZE];
+    guint32 prev_key = 0;
+    gint prev_index = -1;
+    gint n_colors = 0;
+    gint x, y;
+
+    memset (values, 0xff, sizeof (values));
+
+    for (y = 0; y < height; y++)
+    {
+        const guint8 *p = pixels + y * rowstride;
+        guint8 *out = indices_out + y * width;
+
+        for (x = 0; x < width; x++, p += 4)
+        {
+            guint32 key;
+            guint slot;
+
+            key = p [3] ? ((guint32) p [3] << 24) | (p [0] << 16) | (p [1] << 8) | p [2] : 0;
+
+            /* Runs of one color are common */
+            if (key == prev_key && prev_index >= 0)
+            {
+                out [x] = prev_index;
+                continue;
+            }
+
+            for (slot = (key * 2654435761U) >> 22;
+                 values [slot] >= 0 && keys [slot] != key;
+                 slot = (slot + 1) % INDEX_HASH_SIZE)
+                ;
+
+            if (values [slot] < 0)
+            {
+                if (n_colors == 256)
+                    return FALSE;
+
+                keys [slot] = key;
+                values [slot] = n_colors;
+                colors_out [n_colors++] = key;
+            }
+
+            prev_key = key;
+            prev_index = values [slot];
+            out [x] = prev_index;
+        }
+    }
+
+    *n_colors_out = n_colors;
+    return TRUE;
+}
+
 void
 chicle_flatten_cntrl_inplace (gchar *str)
 {
@@ -46,6 +46,15 @@ ChicleRotationType chicle_invert_rotation (ChicleRotationType rot);
 void chicle_rotate_image (gpointer *src, guint *width, guint *height, guint *rowstride,
                           guint n_channels, ChicleRotationType rot);
 
+gboolean chicle_thumbnail_is_usable (gint thumb_width, gint thumb_height,
+                                     gint image_width, gint image_height,
+                                     gint min_width, gint min_height);
+gboolean chicle_thumbnail_covers (gint thumb_width, gint thumb_height,
+                                  gint min_width, gint min_height);
+
+gboolean chicle_index_rgba8 (const guint8 *pixels, gint width, gint height, gint rowstride,
+                             guint8 *indices_out, guint32 *colors_out, gint *n_colors_out);
+
 void chicle_flatten_cntrl_inplace (gchar *str);
 gchar *chicle_ellipsize_string (const gchar *str, gint len_max,
                                 gboolean use_unicode);